@@ -30,12 +30,12 @@ if not exist "app.o" (
 )
 
 echo Compiling application...
-g++ -o spectrogram_gui.exe spectrogram_lines.cpp ^
+g++ -o spectrogram_gui.exe spectrogram_lines.cpp spectrogram_engine.cpp ^
 app.o imgui/imgui.cpp imgui/imgui_draw.cpp imgui/imgui_tables.cpp imgui/imgui_widgets.cpp ^
 imgui/backends/imgui_impl_glfw.cpp imgui/backends/imgui_impl_opengl3.cpp -I./imgui -I./imgui/backends ^
 -DGLEW_STATIC -mwindows -static -static-libgcc -static-libstdc++ -lglew32 -lglfw3 -lopengl32 -lportaudio ^
--lfftw3 -lsndfile -lvorbisenc -lvorbisfile -lvorbis -lFLAC -lmp3lame -lmpg123 -lopus -logg -lgdi32 ^
--lwinmm -lole32 -lcomdlg32 -lsetupapi -lksuser -lpsapi -lshlwapi -std=c++11 -O2
+-lfftw3f -lsndfile -lvorbisenc -lvorbisfile -lvorbis -lFLAC -lmp3lame -lmpg123 -lopus -logg -lgdi32 ^
+-lwinmm -lole32 -lcomdlg32 -lsetupapi -lksuser -lpsapi -lshlwapi -lws2_32 -std=c++11 -O2
 
 if errorlevel 1 (
     echo.
@@ -29,10 +29,10 @@ fi
 echo "Compiling application..."
 
 if [ "${PLATFORM}" = "Linux" ]; then
-    g++ -o spectrogram_gui spectrogram_lines.cpp \
+    g++ -o spectrogram_gui spectrogram_lines.cpp spectrogram_engine.cpp \
     imgui/imgui.cpp imgui/imgui_draw.cpp imgui/imgui_tables.cpp imgui/imgui_widgets.cpp \
     imgui/backends/imgui_impl_glfw.cpp imgui/backends/imgui_impl_opengl3.cpp -I./imgui -I./imgui/backends \
-    -lGLEW -lglfw -lGL -lportaudio -lfftw3 -lsndfile -lpthread -ldl -std=c++11 -O2
+    -lGLEW -lglfw -lGL -lportaudio -lfftw3f -lsndfile -lpthread -ldl -std=c++11 -O2
 
 elif [ "${PLATFORM}" = "macOS" ]; then
     # Check for Homebrew installation paths
@@ -42,11 +42,11 @@ elif [ "${PLATFORM}" = "macOS" ]; then
         BREW_PREFIX="/usr/local"
     fi
     
-    g++ -o spectrogram_gui spectrogram_lines.cpp \
+    g++ -o spectrogram_gui spectrogram_lines.cpp spectrogram_engine.cpp \
     imgui/imgui.cpp imgui/imgui_draw.cpp imgui/imgui_tables.cpp imgui/imgui_widgets.cpp \
     imgui/backends/imgui_impl_glfw.cpp imgui/backends/imgui_impl_opengl3.cpp -I./imgui -I./imgui/backends \
     -I${BREW_PREFIX}/include -L${BREW_PREFIX}/lib \
-    -lGLEW -lglfw -framework OpenGL -lportaudio -lfftw3 -lsndfile -std=c++11 -O2
+    -lGLEW -lglfw -framework OpenGL -lportaudio -lfftw3f -lsndfile -std=c++11 -O2
 else
     echo "Unsupported platform: ${PLATFORM}"
     exit 1
@@ -0,0 +1,944 @@
+// SpectrogramEngine implementation, plus the DSP it shares with the viewer:
+// tabulated window normalised by its coherent gain, |X| magnitudes, log-spaced
+// bars that interpolate between bins while narrower than one bin and take the
+// peak over every covered bin once wider, then log compression to 0..1. The
+// viewer (spectrogram_lines.cpp) links this file and calls the same code, so a
+// stream looks the same whichever of the two analysed it.
+#include "spectrogram_engine.h"
+
+#include <fftw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define SPECTROGRAM_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SPECTROGRAM_NEON 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// ===================== Shared DSP =====================
+std::mutex& spectrogramPlannerMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Zeroth-order modified Bessel function (series), for Kaiser windows
+double spectrogramBesselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    const double q = x * x * 0.25;
+    for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+        term *= q / ((double)k * (double)k);
+        sum += term;
+    }
+    return sum;
+}
+
+double spectrogramTabulateWindow(int type, int n, std::vector<float>& w) {
+    w.resize((size_t)n);
+    const double denom = (double)std::max(1, n - 1);
+    const double kaiserBeta = 8.0;
+    const double kaiserNorm = 1.0 / spectrogramBesselI0(kaiserBeta);
+
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) {
+        const double x = (double)i / denom;  // 0..1
+        double v;
+        switch (type) {
+            case SPECTROGRAM_WINDOW_BLACKMAN_HARRIS:
+                v = 0.35875 - 0.48829 * std::cos(2.0 * M_PI * x)
+                            + 0.14128 * std::cos(4.0 * M_PI * x)
+                            - 0.01168 * std::cos(6.0 * M_PI * x);
+                break;
+            case SPECTROGRAM_WINDOW_KAISER: {
+                const double t = 2.0 * x - 1.0;
+                v = spectrogramBesselI0(kaiserBeta * std::sqrt(std::max(0.0, 1.0 - t * t))) * kaiserNorm;
+                break;
+            }
+            case SPECTROGRAM_WINDOW_HANN:
+            default:
+                v = 0.5 * (1.0 - std::cos(2.0 * M_PI * x));
+                break;
+        }
+        w[(size_t)i] = (float)v;
+        sum += v;
+    }
+    return sum;
+}
+
+int spectrogramBuildBarTables(int bars, float sampleRate, int fftSize, float minFreq,
+                              int32_t* bin0, int32_t* bin1, float* frac) {
+    const float minF = std::max(minFreq, 1.0f);
+    const float maxF = std::max(minF * 1.001f, sampleRate * 0.5f);
+    const float ratio = maxF / minF;
+    const int numFreqs = fftSize / 2;
+    const float binsPerHz = (float)fftSize / sampleRate;
+    const float step = (bars == 1) ? 1.0f : 1.0f / (float)(bars - 1);
+
+    int split = bars;
+    for (int i = 0; i < bars; i++) {
+        const float t = (bars == 1) ? 0.0f : (float)i / (float)(bars - 1);
+        float binF = minF * std::pow(ratio, t) * binsPerHz;
+
+        // Bin-space edges halfway (in log frequency) to the neighbouring bars
+        const float edgeLo = minF * std::pow(ratio, t - 0.5f * step) * binsPerHz;
+        const float edgeHi = minF * std::pow(ratio, t + 0.5f * step) * binsPerHz;
+
+        // Spacing grows monotonically, so everything past the first wide bar aggregates
+        if (split == bars && edgeHi - edgeLo >= 1.0f) split = i;
+
+        if (i < split) {
+            binF = std::max(1.0f, std::min(binF, (float)(numFreqs - 2)));
+            const int b = (int)binF;
+            bin0[i] = b;
+            bin1[i] = b + 1;
+            frac[i] = binF - (float)b;
+        } else {
+            const int lo = std::max(1, std::min((int)std::ceil(edgeLo), numFreqs - 1));
+            const int hi = std::max(lo, std::min((int)std::floor(edgeHi), numFreqs - 1));
+            bin0[i] = lo;
+            bin1[i] = hi;
+            frac[i] = 0.0f;
+        }
+    }
+    return split;
+}
+
+float spectrogramBarFrequency(int bar, int bars, float sampleRate, float minFreq) {
+    if (bar < 0 || bar >= bars) return 0.0f;
+    const float minF = std::max(minFreq, 1.0f);
+    const float maxF = std::max(minF * 1.001f, sampleRate * 0.5f);
+    const float t = (bars == 1) ? 0.0f : (float)bar / (float)(bars - 1);
+    return minF * std::pow(maxF / minF, t);
+}
+
+void spectrogramMapBars(const float* mag, float* out, const int32_t* bin0, const int32_t* bin1,
+                        const float* frac, int begin, int split, int end) {
+    // Narrow bars: linear interpolation between neighbouring bins
+    for (int i = begin; i < split; i++) {
+        const float a = mag[bin0[i]];
+        out[i] = a + (mag[bin0[i] + 1] - a) * frac[i];
+    }
+
+    // Wide bars: peak over every bin the bar covers (nothing is skipped, so
+    // narrow tones between bar centres do not alias or vanish)
+    for (int i = split; i < end; i++) {
+        float peak = 0.0f;
+        for (int b = bin0[i]; b <= bin1[i]; b++) peak = std::max(peak, mag[b]);
+        out[i] = peak;
+    }
+}
+
+// ===================== Kernels =====================
+// The passes around the FFT (window, magnitudes, log compression) exist once
+// per instruction set: the SSE2 / NEON baseline, plus AVX2 and AVX-512 via
+// target attributes on x86 GCC / Clang. Each is a template on its trip count,
+// instantiated for every FFT size the viewer offers and the common bar counts,
+// so the compiler sees constant loop bounds (no tails, full unrolling). N = 0
+// is the any-count fallback; a fixed-N instance called with another count
+// forwards to it. spectrogramSelectKernels() hands out the set for one size.
+static inline float clamp01(float v) {
+    return std::max(0.0f, std::min(1.0f, v));
+}
+
+#if defined(SPECTROGRAM_SSE2) && defined(__GNUC__) && !defined(_WIN32)
+// (Not on Windows: MinGW does not align the stack for 256/512-bit spills)
+#define SPECTROGRAM_X86_DISPATCH 1
+#define SPECTROGRAM_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define SPECTROGRAM_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#endif
+
+// x[i] *= w[i]
+template <int N>
+static void applyWindowBase(float* x, const float* w, int n) {
+    if (N != 0) {
+        if (n != N) return applyWindowBase<0>(x, w, n);
+        n = N;
+    }
+    int i = 0;
+#if defined(SPECTROGRAM_SSE2)
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(w + i)));
+    }
+#elif defined(SPECTROGRAM_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(x + i, vmulq_f32(vld1q_f32(x + i), vld1q_f32(w + i)));
+    }
+#endif
+    for (; i < n; i++) x[i] *= w[i];
+}
+
+// out[i] = |in[i]| * scale
+template <int N>
+static void computeMagnitudesBase(const float* c, float* out, int count, float scale) {
+    if (N != 0) {
+        if (count != N) return computeMagnitudesBase<0>(c, out, count, scale);
+        count = N;
+    }
+    const fftwf_complex* in = (const fftwf_complex*)c;  // Interleaved re, im
+    int i = 0;
+#if defined(SPECTROGRAM_SSE2)
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = _mm_loadu_ps(c + 2 * i);      // re0 im0 re1 im1
+        __m128 b = _mm_loadu_ps(c + 2 * i + 4);  // re2 im2 re3 im3
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+        __m128 re2 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im2 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(re2, im2)), vscale));
+    }
+#elif defined(SPECTROGRAM_NEON)
+    const float32x4_t vscale = vdupq_n_f32(scale);
+    for (; i + 4 <= count; i += 4) {
+        float32x4x2_t v = vld2q_f32(c + 2 * i);  // De-interleaves re / im
+        float32x4_t m = vmlaq_f32(vmulq_f32(v.val[0], v.val[0]), v.val[1], v.val[1]);
+#if defined(__aarch64__)
+        float32x4_t r = vsqrtq_f32(m);
+#else
+        // ARMv7 has no vector sqrt: refine the rsqrt estimate twice (~23 bits)
+        const float32x4_t mc = vmaxq_f32(m, vdupq_n_f32(1e-30f));
+        float32x4_t e = vrsqrteq_f32(mc);
+        e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(mc, e), e));
+        e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(mc, e), e));
+        float32x4_t r = vmulq_f32(m, e);
+#endif
+        vst1q_f32(out + i, vmulq_f32(r, vscale));
+    }
+#endif
+    for (; i < count; i++) {
+        const float re = in[i][0], im = in[i][1];
+        out[i] = std::sqrt(re * re + im * im) * scale;
+    }
+}
+
+#if defined(SPECTROGRAM_X86_DISPATCH)
+template <int N>
+static SPECTROGRAM_TARGET_AVX2 void applyWindowAvx2(float* x, const float* w, int n) {
+    if (N != 0) {
+        if (n != N) return applyWindowAvx2<0>(x, w, n);
+        n = N;
+    }
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(w + i)));
+    }
+    for (; i < n; i++) x[i] *= w[i];
+}
+
+template <int N>
+static SPECTROGRAM_TARGET_AVX512 void applyWindowAvx512(float* x, const float* w, int n) {
+    if (N != 0) {
+        if (n != N) return applyWindowAvx512<0>(x, w, n);
+        n = N;
+    }
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(x + i, _mm512_mul_ps(_mm512_loadu_ps(x + i), _mm512_loadu_ps(w + i)));
+    }
+    for (; i < n; i++) x[i] *= w[i];
+}
+
+template <int N>
+static SPECTROGRAM_TARGET_AVX2 void computeMagnitudesAvx2(const float* c, float* out, int count, float scale) {
+    if (N != 0) {
+        if (count != N) return computeMagnitudesAvx2<0>(c, out, count, scale);
+        count = N;
+    }
+    const fftwf_complex* in = (const fftwf_complex*)c;
+    const __m256 vscale = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_loadu_ps(c + 2 * i);      // c0..c3
+        __m256 b = _mm256_loadu_ps(c + 2 * i + 8);  // c4..c7
+        // hadd works per 128-bit lane: [m0 m1 m4 m5 | m2 m3 m6 m7]
+        __m256 m = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+        m = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(m), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sqrt_ps(m), vscale));
+    }
+    for (; i < count; i++) {
+        const float re = in[i][0], im = in[i][1];
+        out[i] = std::sqrt(re * re + im * im) * scale;
+    }
+}
+
+template <int N>
+static SPECTROGRAM_TARGET_AVX512 void computeMagnitudesAvx512(const float* c, float* out, int count, float scale) {
+    if (N != 0) {
+        if (count != N) return computeMagnitudesAvx512<0>(c, out, count, scale);
+        count = N;
+    }
+    const fftwf_complex* in = (const fftwf_complex*)c;
+    const __m512 vscale = _mm512_set1_ps(scale);
+    const __m512i even = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
+    const __m512i odd = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17, 15, 13, 11, 9, 7, 5, 3, 1);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 a = _mm512_loadu_ps(c + 2 * i);       // c0..c7
+        __m512 b = _mm512_loadu_ps(c + 2 * i + 16);  // c8..c15
+        a = _mm512_mul_ps(a, a);
+        b = _mm512_mul_ps(b, b);
+        const __m512 m = _mm512_add_ps(_mm512_permutex2var_ps(a, even, b), _mm512_permutex2var_ps(a, odd, b));
+        _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_sqrt_ps(m), vscale));
+    }
+    for (; i < count; i++) {
+        const float re = in[i][0], im = in[i][1];
+        out[i] = std::sqrt(re * re + im * im) * scale;
+    }
+}
+#endif
+
+// log2(x) for positive, finite x: exponent plus an atanh series for the
+// mantissa (max error ~2e-5, far below one 16-bit texel)
+static inline float fastLog2(float x) {
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    const float e = (float)((int)(bits >> 23) - 127);
+    bits = (bits & 0x007FFFFFu) | 0x3F800000u;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+    const float t = (m - 1.0f) / (m + 1.0f);
+    const float t2 = t * t;
+    return e + t * (2.8853901f + t2 * (0.9617967f + t2 * (0.5770780f + t2 * 0.4121986f)));
+}
+
+// v[i] = clamp01(log(1 + v[i] * gain) / log(1 + gain))
+template <int N>
+static void compressMagnitudesBase(float* v, int count, float gain) {
+    if (N != 0) {
+        if (count != N) return compressMagnitudesBase<0>(v, count, gain);
+        count = N;
+    }
+    const float invDen = 1.0f / std::log2(1.0f + gain);
+    int i = 0;
+#if defined(SPECTROGRAM_SSE2)
+    const __m128 one = _mm_set1_ps(1.0f), vgain = _mm_set1_ps(gain), vinv = _mm_set1_ps(invDen);
+    const __m128i mantMask = _mm_set1_epi32(0x007FFFFF), oneBits = _mm_set1_epi32(0x3F800000);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_add_ps(one, _mm_mul_ps(_mm_max_ps(_mm_loadu_ps(v + i), _mm_setzero_ps()), vgain));
+        __m128i bits = _mm_castps_si128(x);
+        __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+        __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantMask), oneBits));
+        __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 p = _mm_add_ps(_mm_set1_ps(0.5770780f), _mm_mul_ps(t2, _mm_set1_ps(0.4121986f)));
+        p = _mm_add_ps(_mm_set1_ps(0.9617967f), _mm_mul_ps(t2, p));
+        p = _mm_add_ps(_mm_set1_ps(2.8853901f), _mm_mul_ps(t2, p));
+        __m128 r = _mm_mul_ps(_mm_add_ps(e, _mm_mul_ps(t, p)), vinv);
+        _mm_storeu_ps(v + i, _mm_min_ps(_mm_max_ps(r, _mm_setzero_ps()), one));
+    }
+#elif defined(SPECTROGRAM_NEON)
+    const float32x4_t one = vdupq_n_f32(1.0f), vgain = vdupq_n_f32(gain), vinv = vdupq_n_f32(invDen);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vmlaq_f32(one, vmaxq_f32(vld1q_f32(v + i), vdupq_n_f32(0.0f)), vgain);
+        uint32x4_t bits = vreinterpretq_u32_f32(x);
+        float32x4_t e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+        float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007FFFFF)), vdupq_n_u32(0x3F800000)));
+        float32x4_t den = vaddq_f32(m, one);
+        float32x4_t rcp = vrecpeq_f32(den);
+        rcp = vmulq_f32(rcp, vrecpsq_f32(den, rcp));
+        rcp = vmulq_f32(rcp, vrecpsq_f32(den, rcp));
+        float32x4_t t = vmulq_f32(vsubq_f32(m, one), rcp);
+        float32x4_t t2 = vmulq_f32(t, t);
+        float32x4_t p = vmlaq_f32(vdupq_n_f32(0.5770780f), t2, vdupq_n_f32(0.4121986f));
+        p = vmlaq_f32(vdupq_n_f32(0.9617967f), t2, p);
+        p = vmlaq_f32(vdupq_n_f32(2.8853901f), t2, p);
+        float32x4_t r = vmulq_f32(vmlaq_f32(e, t, p), vinv);
+        vst1q_f32(v + i, vminq_f32(vmaxq_f32(r, vdupq_n_f32(0.0f)), one));
+    }
+#endif
+    for (; i < count; i++) {
+        v[i] = clamp01(fastLog2(1.0f + std::max(0.0f, v[i]) * gain) * invDen);
+    }
+}
+
+#if defined(SPECTROGRAM_X86_DISPATCH)
+template <int N>
+static SPECTROGRAM_TARGET_AVX2 void compressMagnitudesAvx2(float* v, int count, float gain) {
+    if (N != 0) {
+        if (count != N) return compressMagnitudesAvx2<0>(v, count, gain);
+        count = N;
+    }
+    const float invDen = 1.0f / std::log2(1.0f + gain);
+    const __m256 one = _mm256_set1_ps(1.0f), vgain = _mm256_set1_ps(gain), vinv = _mm256_set1_ps(invDen);
+    const __m256i mantMask = _mm256_set1_epi32(0x007FFFFF), oneBits = _mm256_set1_epi32(0x3F800000);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_fmadd_ps(_mm256_max_ps(_mm256_loadu_ps(v + i), _mm256_setzero_ps()), vgain, one);
+        __m256i bits = _mm256_castps_si256(x);
+        __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+        __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mantMask), oneBits));
+        __m256 t = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 p = _mm256_fmadd_ps(t2, _mm256_set1_ps(0.4121986f), _mm256_set1_ps(0.5770780f));
+        p = _mm256_fmadd_ps(t2, p, _mm256_set1_ps(0.9617967f));
+        p = _mm256_fmadd_ps(t2, p, _mm256_set1_ps(2.8853901f));
+        __m256 r = _mm256_mul_ps(_mm256_fmadd_ps(t, p, e), vinv);
+        _mm256_storeu_ps(v + i, _mm256_min_ps(_mm256_max_ps(r, _mm256_setzero_ps()), one));
+    }
+    for (; i < count; i++) {
+        v[i] = clamp01(fastLog2(1.0f + std::max(0.0f, v[i]) * gain) * invDen);
+    }
+}
+
+template <int N>
+static SPECTROGRAM_TARGET_AVX512 void compressMagnitudesAvx512(float* v, int count, float gain) {
+    if (N != 0) {
+        if (count != N) return compressMagnitudesAvx512<0>(v, count, gain);
+        count = N;
+    }
+    const float invDen = 1.0f / std::log2(1.0f + gain);
+    const __m512 one = _mm512_set1_ps(1.0f), vgain = _mm512_set1_ps(gain), vinv = _mm512_set1_ps(invDen);
+    const __m512i mantMask = _mm512_set1_epi32(0x007FFFFF), oneBits = _mm512_set1_epi32(0x3F800000);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 x = _mm512_fmadd_ps(_mm512_max_ps(_mm512_loadu_ps(v + i), _mm512_setzero_ps()), vgain, one);
+        __m512i bits = _mm512_castps_si512(x);
+        __m512 e = _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(127)));
+        __m512 m = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(bits, mantMask), oneBits));
+        __m512 t = _mm512_div_ps(_mm512_sub_ps(m, one), _mm512_add_ps(m, one));
+        __m512 t2 = _mm512_mul_ps(t, t);
+        __m512 p = _mm512_fmadd_ps(t2, _mm512_set1_ps(0.4121986f), _mm512_set1_ps(0.5770780f));
+        p = _mm512_fmadd_ps(t2, p, _mm512_set1_ps(0.9617967f));
+        p = _mm512_fmadd_ps(t2, p, _mm512_set1_ps(2.8853901f));
+        __m512 r = _mm512_mul_ps(_mm512_fmadd_ps(t, p, e), vinv);
+        _mm512_storeu_ps(v + i, _mm512_min_ps(_mm512_max_ps(r, _mm512_setzero_ps()), one));
+    }
+    for (; i < count; i++) {
+        v[i] = clamp01(fastLog2(1.0f + std::max(0.0f, v[i]) * gain) * invDen);
+    }
+}
+#endif
+
+typedef void (*WindowKernel)(float*, const float*, int);
+typedef void (*MagnitudeKernel)(const float*, float*, int, float);
+typedef void (*CompressKernel)(float*, int, float);
+
+static const int kKernelSizes[] = { 512, 1024, 2048, 4096, 8192, 16384 };
+static constexpr int NUM_KERNEL_SIZES = (int)(sizeof(kKernelSizes) / sizeof(kKernelSizes[0]));
+
+// ---- Kernel dispatch ----
+enum KernelIsa { KERNEL_BASE = 0, KERNEL_AVX2, KERNEL_AVX512, KERNEL_ISA_COUNT };
+#if defined(SPECTROGRAM_SSE2)
+static const char* kernelIsaNames[KERNEL_ISA_COUNT] = { "SSE2", "AVX2", "AVX-512" };
+#elif defined(SPECTROGRAM_NEON)
+static const char* kernelIsaNames[KERNEL_ISA_COUNT] = { "NEON", "AVX2", "AVX-512" };
+#else
+static const char* kernelIsaNames[KERNEL_ISA_COUNT] = { "scalar", "AVX2", "AVX-512" };
+#endif
+
+static const int kKernelBars[] = { 250, 500, 1000, 2000, 4000 };
+static constexpr int NUM_KERNEL_BARS = (int)(sizeof(kKernelBars) / sizeof(kKernelBars[0]));
+
+// One entry per kKernelSizes / kKernelBars value, then the any-count fallback
+struct KernelTable {
+    WindowKernel window[NUM_KERNEL_SIZES + 1];
+    MagnitudeKernel magnitudes[NUM_KERNEL_SIZES + 1];
+    CompressKernel compress[NUM_KERNEL_BARS + 1];
+};
+
+#define SPECTROGRAM_SIZE_KERNELS(fn, div) \
+    { &fn<512 / div>, &fn<1024 / div>, &fn<2048 / div>, &fn<4096 / div>, &fn<8192 / div>, &fn<16384 / div>, &fn<0> }
+#define SPECTROGRAM_BAR_KERNELS(fn) { &fn<250>, &fn<500>, &fn<1000>, &fn<2000>, &fn<4000>, &fn<0> }
+
+static const KernelTable kKernelTables[] = {
+    { SPECTROGRAM_SIZE_KERNELS(applyWindowBase, 1), SPECTROGRAM_SIZE_KERNELS(computeMagnitudesBase, 2),
+      SPECTROGRAM_BAR_KERNELS(compressMagnitudesBase) },
+#if defined(SPECTROGRAM_X86_DISPATCH)
+    { SPECTROGRAM_SIZE_KERNELS(applyWindowAvx2, 1), SPECTROGRAM_SIZE_KERNELS(computeMagnitudesAvx2, 2),
+      SPECTROGRAM_BAR_KERNELS(compressMagnitudesAvx2) },
+    { SPECTROGRAM_SIZE_KERNELS(applyWindowAvx512, 1), SPECTROGRAM_SIZE_KERNELS(computeMagnitudesAvx512, 2),
+      SPECTROGRAM_BAR_KERNELS(compressMagnitudesAvx512) },
+#endif
+};
+
+#undef SPECTROGRAM_SIZE_KERNELS
+#undef SPECTROGRAM_BAR_KERNELS
+
+static int gKernelIsa = -1;  // Detected once; SPECTROGRAM_ISA=base|avx2|avx512 overrides
+
+static int detectKernelIsa() {
+    int isa = KERNEL_BASE;
+#if defined(SPECTROGRAM_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) isa = KERNEL_AVX512;
+    else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) isa = KERNEL_AVX2;
+#endif
+    const int supported = isa;
+    if (const char* forced = std::getenv("SPECTROGRAM_ISA")) {
+        const std::string name = forced;
+        if (name == "base") isa = KERNEL_BASE;
+        else if (name == "avx2") isa = std::min(supported, (int)KERNEL_AVX2);
+        else if (name == "avx512") isa = std::min(supported, (int)KERNEL_AVX512);
+        else std::cerr << "Error: SPECTROGRAM_ISA must be base, avx2 or avx512\n";
+    }
+    return isa;
+}
+
+SpectrogramKernels spectrogramSelectKernels(int fftSize, int bars) {
+    static std::mutex detectMutex;
+    {
+        std::lock_guard<std::mutex> lock(detectMutex);
+        if (gKernelIsa < 0) gKernelIsa = detectKernelIsa();
+    }
+    const KernelTable& table = kKernelTables[gKernelIsa];
+    int sizeIndex = NUM_KERNEL_SIZES, barIndex = NUM_KERNEL_BARS;
+    for (int i = 0; i < NUM_KERNEL_SIZES; i++) {
+        if (kKernelSizes[i] == fftSize) sizeIndex = i;
+    }
+    for (int i = 0; i < NUM_KERNEL_BARS; i++) {
+        if (kKernelBars[i] == bars) barIndex = i;
+    }
+
+    SpectrogramKernels k;
+    k.window = table.window[sizeIndex];
+    k.magnitudes = table.magnitudes[sizeIndex];
+    k.compress = table.compress[barIndex];
+    k.isa = kernelIsaNames[gKernelIsa];
+    k.specialized = sizeIndex < NUM_KERNEL_SIZES && barIndex < NUM_KERNEL_BARS;
+    return k;
+}
+
+// ===================== Thread Pool =====================
+static thread_local SpectrogramThreadPool* tlsPool = nullptr;  // Pool the current thread works for
+static thread_local int tlsWorker = -1;
+
+SpectrogramThreadPool::SpectrogramThreadPool(int threadCount) {
+    if (threadCount <= 0) threadCount = (int)std::thread::hardware_concurrency();
+    if (threadCount <= 0) threadCount = 2;
+    for (int i = 0; i < threadCount; i++) workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    for (int i = 0; i < threadCount; i++) threads.push_back(std::thread(&SpectrogramThreadPool::workerLoop, this, i));
+}
+
+SpectrogramThreadPool::~SpectrogramThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+}
+
+SpectrogramThreadPool& SpectrogramThreadPool::shared() {
+    static SpectrogramThreadPool pool;
+    return pool;
+}
+
+void SpectrogramThreadPool::submit(std::function<void()> task) {
+    const int n = (int)workers.size();
+    const int target = (tlsPool == this && tlsWorker >= 0) ? tlsWorker
+                                                           : (int)(nextWorker.fetch_add(1, std::memory_order_relaxed) % (unsigned)n);
+    {
+        std::lock_guard<std::mutex> lock(workers[(size_t)target]->mutex);
+        workers[(size_t)target]->tasks.push_back(std::move(task));
+    }
+    {
+        // Count under sleepMutex so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake.notify_one();
+}
+
+bool SpectrogramThreadPool::popTask(int self, std::function<void()>& task) {
+    // Own deque first, newest first (still warm in cache)
+    {
+        Worker& w = *workers[(size_t)self];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (!w.tasks.empty()) {
+            task = std::move(w.tasks.back());
+            w.tasks.pop_back();
+            return true;
+        }
+    }
+    // Then steal the oldest task of the next busy worker
+    const int n = (int)workers.size();
+    for (int k = 1; k < n; k++) {
+        Worker& w = *workers[(size_t)((self + k) % n)];
+        std::lock_guard<std::mutex> lock(w.mutex);
+        if (!w.tasks.empty()) {
+            task = std::move(w.tasks.front());
+            w.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void SpectrogramThreadPool::workerLoop(int self) {
+    tlsPool = this;
+    tlsWorker = self;
+    for (;;) {
+        std::function<void()> task;
+        if (popTask(self, task)) {
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_relaxed) > 0; });
+        if (stopping && queued.load(std::memory_order_relaxed) == 0) return;
+    }
+}
+
+// ===================== Shared Plan Cache =====================
+// One r2c plan per (size, effort), shared by every engine at that size.
+// Planning and destruction happen under spectrogramPlannerMutex(), the lock the
+// viewer plans under too; execution uses each engine's own fftwf_malloc buffers.
+struct SpectrogramEngine::Plan {
+    int size = 0;
+    bool measure = false;
+    fftwf_plan plan = nullptr;
+    int refs = 0;
+};
+
+static std::map<std::pair<int, bool>, SpectrogramEngine::Plan*>* gEnginePlans = nullptr;  // Guarded by spectrogramPlannerMutex()
+
+static SpectrogramEngine::Plan* acquireEnginePlan(int size, bool measure) {
+    std::lock_guard<std::mutex> lock(spectrogramPlannerMutex());
+    if (!gEnginePlans) gEnginePlans = new std::map<std::pair<int, bool>, SpectrogramEngine::Plan*>();
+    const std::pair<int, bool> key(size, measure);
+    std::map<std::pair<int, bool>, SpectrogramEngine::Plan*>::iterator it = gEnginePlans->find(key);
+    if (it != gEnginePlans->end()) {
+        it->second->refs++;
+        return it->second;
+    }
+
+    // Plan on scratch buffers (MEASURE overwrites them); alignment matches
+    // what every engine gets from fftwf_malloc
+    float* in = (float*)fftwf_malloc(sizeof(float) * (size_t)size);
+    fftwf_complex* out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * (size_t)(size / 2 + 1));
+    fftwf_plan p = (in && out) ? fftwf_plan_dft_r2c_1d(size, in, out, measure ? FFTW_MEASURE : FFTW_ESTIMATE) : nullptr;
+    if (in) fftwf_free(in);
+    if (out) fftwf_free(out);
+    if (!p) return nullptr;
+
+    SpectrogramEngine::Plan* plan = new SpectrogramEngine::Plan();
+    plan->size = size;
+    plan->measure = measure;
+    plan->plan = p;
+    plan->refs = 1;
+    (*gEnginePlans)[key] = plan;
+    return plan;
+}
+
+static void releaseEnginePlan(SpectrogramEngine::Plan* plan) {
+    if (!plan) return;
+    std::lock_guard<std::mutex> lock(spectrogramPlannerMutex());
+    if (--plan->refs > 0) return;
+    gEnginePlans->erase(std::make_pair(plan->size, plan->measure));
+    fftwf_destroy_plan(plan->plan);
+    delete plan;
+}
+
+// ===================== Engine =====================
+static bool isPowerOfTwo(int n) { return n > 0 && (n & (n - 1)) == 0; }
+
+std::unique_ptr<SpectrogramEngine> SpectrogramEngine::create(const SpectrogramEngineConfig& config,
+                                                             SpectrogramThreadPool* pool) {
+    if (config.sampleRate <= 0) {
+        std::cerr << "Error: SpectrogramEngine sample rate must be positive (got " << config.sampleRate << ")" << std::endl;
+        return std::unique_ptr<SpectrogramEngine>();
+    }
+    if (!isPowerOfTwo(config.fftSize) || config.fftSize < 64 || config.fftSize > 65536) {
+        std::cerr << "Error: SpectrogramEngine FFT size must be a power of two in 64..65536 (got "
+                  << config.fftSize << ")" << std::endl;
+        return std::unique_ptr<SpectrogramEngine>();
+    }
+    if (config.hop <= 0 || config.numBars <= 0 || config.historyLines <= 0 || config.lineCapacity <= 0) {
+        std::cerr << "Error: SpectrogramEngine hop, bar count, history and line capacity must be positive" << std::endl;
+        return std::unique_ptr<SpectrogramEngine>();
+    }
+    if (config.window < SPECTROGRAM_WINDOW_HANN || config.window > SPECTROGRAM_WINDOW_KAISER) {
+        std::cerr << "Error: SpectrogramEngine unknown window type " << config.window << std::endl;
+        return std::unique_ptr<SpectrogramEngine>();
+    }
+
+    std::unique_ptr<SpectrogramEngine> engine(new SpectrogramEngine(config, pool ? pool : &SpectrogramThreadPool::shared()));
+    if (!engine->init()) return std::unique_ptr<SpectrogramEngine>();
+    return engine;
+}
+
+SpectrogramEngine::SpectrogramEngine(const SpectrogramEngineConfig& config, SpectrogramThreadPool* p)
+    : cfg(config), pool(p) {}
+
+SpectrogramEngine::~SpectrogramEngine() {
+    {
+        std::unique_lock<std::mutex> lock(inputMutex);
+        inputBuf.clear();
+        inputRead = 0;
+        idle.wait(lock, [this] { return !scheduled; });
+    }
+    releaseEnginePlan(plan);
+    if (fftIn) fftwf_free(fftIn);
+    if (fftOut) fftwf_free(fftOut);
+}
+
+bool SpectrogramEngine::init() {
+    const int n = cfg.fftSize;
+    fftIn = (float*)fftwf_malloc(sizeof(float) * (size_t)n);
+    fftOut = fftwf_malloc(sizeof(fftwf_complex) * (size_t)(n / 2 + 1));
+    plan = acquireEnginePlan(n, cfg.planMeasure);
+    if (!fftIn || !fftOut || !plan) {
+        std::cerr << "Error: SpectrogramEngine could not create an FFT plan of size " << n << std::endl;
+        return false;
+    }
+
+    mags.assign((size_t)(n / 2), 0.0f);
+    line.assign((size_t)cfg.numBars, 0.0f);
+    queue.assign((size_t)cfg.lineCapacity * (size_t)cfg.numBars, 0.0f);
+    queueStamps.assign((size_t)cfg.lineCapacity, 0);
+    history.assign((size_t)cfg.historyLines * (size_t)cfg.numBars, 0.0f);
+    kernels = spectrogramSelectKernels(n, cfg.numBars);
+    buildWindow();
+    buildMapping();
+    return true;
+}
+
+void SpectrogramEngine::buildWindow() {
+    windowScale = spectrogramWindowScale(spectrogramTabulateWindow(cfg.window, cfg.fftSize, windowTable));
+}
+
+void SpectrogramEngine::buildMapping() {
+    barBin0.assign((size_t)cfg.numBars, 0);
+    barBin1.assign((size_t)cfg.numBars, 0);
+    barFrac.assign((size_t)cfg.numBars, 0.0f);
+    barSplit = spectrogramBuildBarTables(cfg.numBars, (float)cfg.sampleRate, cfg.fftSize, cfg.minFreq,
+                                         barBin0.data(), barBin1.data(), barFrac.data());
+}
+
+float SpectrogramEngine::barFrequency(int bar) const {
+    return spectrogramBarFrequency(bar, cfg.numBars, (float)cfg.sampleRate, cfg.minFreq);
+}
+
+void SpectrogramEngine::pushSamples(const float* samples, size_t count) {
+    if (!samples || count == 0) return;
+    std::lock_guard<std::mutex> lock(inputMutex);
+    inputBuf.insert(inputBuf.end(), samples, samples + count);
+    scheduleLocked();
+}
+
+void SpectrogramEngine::pushInterleaved(const float* frames, size_t count, int channels) {
+    if (!frames || count == 0 || channels <= 0) return;
+    std::lock_guard<std::mutex> lock(inputMutex);
+    const size_t base = inputBuf.size();
+    inputBuf.resize(base + count);
+    const float invCh = 1.0f / (float)channels;
+    for (size_t i = 0; i < count; i++) {
+        float sum = 0.0f;
+        for (int ch = 0; ch < channels; ch++) sum += frames[i * (size_t)channels + (size_t)ch];
+        inputBuf[base + i] = sum * invCh;
+    }
+    scheduleLocked();
+}
+
+// Caller holds inputMutex. At most one task per engine is queued or running.
+void SpectrogramEngine::scheduleLocked() {
+    if (scheduled) return;
+    const uint64_t available = inputBase + (uint64_t)(inputBuf.size() - inputRead);
+    if (available < nextFrame + (uint64_t)cfg.fftSize) return;
+    scheduled = true;
+    pool->submit([this] { run(); });
+}
+
+// Pool task: analyse every complete window, then retire
+void SpectrogramEngine::run() {
+    const size_t n = (size_t)cfg.fftSize;
+    for (;;) {
+        uint64_t start;
+        {
+            std::lock_guard<std::mutex> lock(inputMutex);
+            // Samples before the next window are no longer needed
+            const uint64_t end = inputBase + (uint64_t)(inputBuf.size() - inputRead);
+            const uint64_t discard = std::min(nextFrame, end) - inputBase;
+            inputRead += (size_t)discard;
+            inputBase += discard;
+            if (inputRead > inputBuf.size() / 2 && inputRead >= n) {
+                inputBuf.erase(inputBuf.begin(), inputBuf.begin() + (std::ptrdiff_t)inputRead);
+                inputRead = 0;
+            }
+
+            if (end < nextFrame + (uint64_t)n) {
+                scheduled = false;
+                idle.notify_all();
+                return;
+            }
+            start = nextFrame;
+            std::memcpy(fftIn, &inputBuf[inputRead], sizeof(float) * n);
+            nextFrame += (uint64_t)cfg.hop;
+        }
+        analyseFrame(start);
+    }
+}
+
+void SpectrogramEngine::analyseFrame(uint64_t start) {
+    const int n = cfg.fftSize;
+    const int bars = cfg.numBars;
+
+    kernels.window(fftIn, windowTable.data(), n);
+    fftwf_execute_dft_r2c(plan->plan, fftIn, (fftwf_complex*)fftOut);
+    kernels.magnitudes((const float*)fftOut, mags.data(), n / 2, windowScale);
+    spectrogramMapBars(mags.data(), line.data(), barBin0.data(), barBin1.data(), barFrac.data(), 0, barSplit, bars);
+    kernels.compress(line.data(), bars, cfg.magGain);
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    historyHead = (historyHead + 1) % cfg.historyLines;
+    std::memcpy(&history[(size_t)historyHead * (size_t)bars], line.data(), sizeof(float) * (size_t)bars);
+    if (historyFill < cfg.historyLines) historyFill++;
+
+    // Full queue: the oldest unread line makes room
+    if (queueCount == (size_t)cfg.lineCapacity) {
+        queueHead = (queueHead + 1) % (size_t)cfg.lineCapacity;
+        queueCount--;
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    const size_t slot = (queueHead + queueCount) % (size_t)cfg.lineCapacity;
+    std::memcpy(&queue[slot * (size_t)bars], line.data(), sizeof(float) * (size_t)bars);
+    queueStamps[slot] = start;
+    queueCount++;
+}
+
+void SpectrogramEngine::flush() {
+    std::unique_lock<std::mutex> lock(inputMutex);
+    idle.wait(lock, [this] { return !scheduled; });
+}
+
+void SpectrogramEngine::reset() {
+    {
+        std::unique_lock<std::mutex> lock(inputMutex);
+        inputBuf.clear();
+        inputRead = 0;
+        inputBase = 0;
+        nextFrame = 0;
+        idle.wait(lock, [this] { return !scheduled; });
+    }
+    std::lock_guard<std::mutex> lock(outputMutex);
+    queueHead = queueCount = 0;
+    historyHead = -1;
+    historyFill = 0;
+    std::fill(history.begin(), history.end(), 0.0f);
+}
+
+bool SpectrogramEngine::popLine(float* out, uint64_t* position) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    if (queueCount == 0) return false;
+    if (out) std::memcpy(out, &queue[queueHead * (size_t)cfg.numBars], sizeof(float) * (size_t)cfg.numBars);
+    if (position) *position = queueStamps[queueHead];
+    queueHead = (queueHead + 1) % (size_t)cfg.lineCapacity;
+    queueCount--;
+    return true;
+}
+
+bool SpectrogramEngine::historyRow(int age, float* out) const {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    if (age < 0 || age >= historyFill || !out) return false;
+    const int row = (historyHead - age + cfg.historyLines) % cfg.historyLines;
+    std::memcpy(out, &history[(size_t)row * (size_t)cfg.numBars], sizeof(float) * (size_t)cfg.numBars);
+    return true;
+}
+
+int SpectrogramEngine::historyCount() const {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    return historyFill;
+}
+
+// ===================== C API =====================
+struct spectrogram_engine {
+    std::unique_ptr<SpectrogramEngine> engine;
+};
+
+extern "C" {
+
+void spectrogram_engine_default_config(spectrogram_engine_config_t* config) {
+    if (!config) return;
+    const SpectrogramEngineConfig d;
+    config->sample_rate = d.sampleRate;
+    config->fft_size = d.fftSize;
+    config->hop = d.hop;
+    config->num_bars = d.numBars;
+    config->history_lines = d.historyLines;
+    config->line_capacity = d.lineCapacity;
+    config->window = d.window;
+    config->plan_measure = d.planMeasure ? 1 : 0;
+    config->min_freq = d.minFreq;
+    config->mag_gain = d.magGain;
+}
+
+spectrogram_engine_t* spectrogram_engine_create(const spectrogram_engine_config_t* config) {
+    SpectrogramEngineConfig c;
+    if (config) {
+        c.sampleRate = config->sample_rate;
+        c.fftSize = config->fft_size;
+        c.hop = config->hop;
+        c.numBars = config->num_bars;
+        c.historyLines = config->history_lines;
+        c.lineCapacity = config->line_capacity;
+        c.window = config->window;
+        c.planMeasure = config->plan_measure != 0;
+        c.minFreq = config->min_freq;
+        c.magGain = config->mag_gain;
+    }
+    std::unique_ptr<SpectrogramEngine> engine = SpectrogramEngine::create(c);
+    if (!engine) return nullptr;
+    spectrogram_engine_t* handle = new spectrogram_engine();
+    handle->engine = std::move(engine);
+    return handle;
+}
+
+void spectrogram_engine_destroy(spectrogram_engine_t* engine) {
+    delete engine;
+}
+
+void spectrogram_engine_push(spectrogram_engine_t* engine, const float* samples, size_t count) {
+    if (engine) engine->engine->pushSamples(samples, count);
+}
+
+void spectrogram_engine_push_interleaved(spectrogram_engine_t* engine, const float* frames,
+                                         size_t count, int channels) {
+    if (engine) engine->engine->pushInterleaved(frames, count, channels);
+}
+
+void spectrogram_engine_flush(spectrogram_engine_t* engine) {
+    if (engine) engine->engine->flush();
+}
+
+void spectrogram_engine_reset(spectrogram_engine_t* engine) {
+    if (engine) engine->engine->reset();
+}
+
+int spectrogram_engine_pop_line(spectrogram_engine_t* engine, float* out, uint64_t* position) {
+    return (engine && engine->engine->popLine(out, position)) ? 1 : 0;
+}
+
+int spectrogram_engine_history_row(const spectrogram_engine_t* engine, int age, float* out) {
+    return (engine && engine->engine->historyRow(age, out)) ? 1 : 0;
+}
+
+int spectrogram_engine_history_count(const spectrogram_engine_t* engine) {
+    return engine ? engine->engine->historyCount() : 0;
+}
+
+uint64_t spectrogram_engine_dropped_lines(const spectrogram_engine_t* engine) {
+    return engine ? engine->engine->droppedLines() : 0;
+}
+
+int spectrogram_engine_num_bars(const spectrogram_engine_t* engine) {
+    return engine ? engine->engine->numBars() : 0;
+}
+
+float spectrogram_engine_bar_frequency(const spectrogram_engine_t* engine, int bar) {
+    return engine ? engine->engine->barFrequency(bar) : 0.0f;
+}
+
+}  // extern "C"
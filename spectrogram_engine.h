@@ -0,0 +1,243 @@
+// SpectrogramEngine: the viewer's FFT -> bar mapping -> history pipeline as a
+// reusable library (depends only on FFTW3f).
+//
+// Every engine owns its window table, aligned FFT buffers, bar tables, input
+// FIFO, output line queue and history ring, so any number of streams can be
+// analysed in one process. Engines share one work-stealing thread pool and a
+// refcounted FFTW plan cache: two engines at the same FFT size execute the same
+// plan on their own buffers (new-array execute), and the pool never runs more
+// than one task per engine at a time, so lines come out in order.
+//
+// Lines are NUM_BARS display values in 0..1, log-spaced from minFreq to
+// Nyquist and compressed exactly like the GUI's spectrogram: the viewer links
+// this library and runs its window tables, bar mapping and kernels (see
+// Shared DSP below), and its compare streams are SpectrogramEngines.
+#ifndef SPECTROGRAM_ENGINE_H
+#define SPECTROGRAM_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ===================== C API =====================
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spectrogram_engine spectrogram_engine_t;
+
+enum {
+    SPECTROGRAM_WINDOW_HANN = 0,
+    SPECTROGRAM_WINDOW_BLACKMAN_HARRIS = 1,
+    SPECTROGRAM_WINDOW_KAISER = 2
+};
+
+typedef struct spectrogram_engine_config {
+    int sample_rate;     // Hz
+    int fft_size;        // Power of two, 64..65536
+    int hop;             // Samples between lines
+    int num_bars;        // Values per line
+    int history_lines;   // Rows kept for history_row()
+    int line_capacity;   // Lines queued for pop_line() before the oldest are dropped
+    int window;          // SPECTROGRAM_WINDOW_*
+    int plan_measure;    // Non-zero: plan with FFTW_MEASURE instead of FFTW_ESTIMATE
+    float min_freq;      // Lowest bar frequency (Hz)
+    float mag_gain;      // Log compression gain (140 in the viewer)
+} spectrogram_engine_config_t;
+
+void spectrogram_engine_default_config(spectrogram_engine_config_t* config);
+
+// Returns NULL (and prints the reason) when the config is invalid
+spectrogram_engine_t* spectrogram_engine_create(const spectrogram_engine_config_t* config);
+void spectrogram_engine_destroy(spectrogram_engine_t* engine);
+
+// Queue mono samples; analysis runs on the shared pool
+void spectrogram_engine_push(spectrogram_engine_t* engine, const float* samples, size_t count);
+// Queue interleaved frames, downmixed to mono
+void spectrogram_engine_push_interleaved(spectrogram_engine_t* engine, const float* frames,
+                                         size_t count, int channels);
+// Block until every complete window pushed so far has been analysed
+void spectrogram_engine_flush(spectrogram_engine_t* engine);
+// Drop queued input, lines and history
+void spectrogram_engine_reset(spectrogram_engine_t* engine);
+
+// Oldest unread line into 'out' (num_bars floats); 'position' receives the
+// sample index the window started at. Returns 0 when no line is queued.
+int spectrogram_engine_pop_line(spectrogram_engine_t* engine, float* out, uint64_t* position);
+// History row 'age' lines back (0 = newest). Returns 0 when out of range.
+int spectrogram_engine_history_row(const spectrogram_engine_t* engine, int age, float* out);
+int spectrogram_engine_history_count(const spectrogram_engine_t* engine);
+uint64_t spectrogram_engine_dropped_lines(const spectrogram_engine_t* engine);
+
+int spectrogram_engine_num_bars(const spectrogram_engine_t* engine);
+float spectrogram_engine_bar_frequency(const spectrogram_engine_t* engine, int bar);
+
+#ifdef __cplusplus
+}  // extern "C"
+
+// ===================== C++ API =====================
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ---- Shared DSP ----
+// The pieces every engine runs, exported so the viewer's own streams use the
+// same code instead of a copy.
+
+// FFTW's planner is not thread-safe: whatever in the process plans or destroys
+// FFTW plans holds this (the engines' plan cache and the viewer alike)
+std::mutex& spectrogramPlannerMutex();
+
+double spectrogramBesselI0(double x);
+
+// n coefficients of window 'type' (SPECTROGRAM_WINDOW_*) into 'w'; returns their sum
+double spectrogramTabulateWindow(int type, int n, std::vector<float>& w);
+
+// Magnitude scale for a window summing to 'sum' (its coherent gain), so a
+// sinusoid reads the same level whichever window is selected
+inline float spectrogramWindowScale(double sum) {
+    return sum > 0.0 ? (float)(1.0 / (2.0 * sum)) : 0.0f;
+}
+
+// Tables for 'bars' log-spaced bars from minFreq to Nyquist over a
+// fftSize-point FFT. Bars below the returned split interpolate between bin0
+// and bin0 + 1 by frac; the others take the peak of bins bin0..bin1.
+int spectrogramBuildBarTables(int bars, float sampleRate, int fftSize, float minFreq,
+                              int32_t* bin0, int32_t* bin1, float* frac);
+float spectrogramBarFrequency(int bar, int bars, float sampleRate, float minFreq);
+
+// Bars [begin, end) of one magnitude spectrum through those tables, uncompressed
+void spectrogramMapBars(const float* mag, float* out, const int32_t* bin0, const int32_t* bin1,
+                        const float* frac, int begin, int split, int end);
+
+// Per-frame kernels for the detected CPU (SSE2 / NEON, AVX2, AVX-512;
+// SPECTROGRAM_ISA=base|avx2|avx512 overrides), specialised for the given FFT
+// size and bar count when those have fixed-count instances
+struct SpectrogramKernels {
+    void (*window)(float* x, const float* w, int n) = nullptr;                      // x[i] *= w[i]
+    void (*magnitudes)(const float* spectrum, float* out, int n, float s) = nullptr;  // |X| * s, X = re, im pairs
+    void (*compress)(float* v, int n, float gain) = nullptr;  // clamp01(log(1 + v * gain) / log(1 + gain))
+    const char* isa = "";
+    bool specialized = false;  // Both the size and the bar count have fixed-count instances
+};
+SpectrogramKernels spectrogramSelectKernels(int fftSize, int bars);
+
+// Work-stealing pool: each worker pops its own deque LIFO and steals FIFO from
+// the others when it runs dry. Tasks submitted from a worker go to that
+// worker's deque; others are spread round-robin.
+class SpectrogramThreadPool {
+public:
+    explicit SpectrogramThreadPool(int threads = 0);  // 0 = hardware concurrency
+    ~SpectrogramThreadPool();                         // Runs what is queued, then joins
+
+    void submit(std::function<void()> task);
+    int size() const { return (int)threads.size(); }
+
+    // Process-wide pool used by engines created without one
+    static SpectrogramThreadPool& shared();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool popTask(int self, std::function<void()>& task);
+    void workerLoop(int self);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> queued{0};          // Tasks sitting in any deque
+    std::atomic<unsigned> nextWorker{0};
+    bool stopping = false;               // Guarded by sleepMutex
+};
+
+struct SpectrogramEngineConfig {
+    int sampleRate = 44100;
+    int fftSize = 4096;
+    int hop = 512;
+    int numBars = 1000;
+    int historyLines = 2048;
+    int lineCapacity = 256;
+    int window = SPECTROGRAM_WINDOW_HANN;
+    bool planMeasure = false;
+    float minFreq = 20.0f;
+    float magGain = 140.0f;
+};
+
+class SpectrogramEngine {
+public:
+    // nullptr (with the reason on std::cerr) when the config is invalid.
+    // 'pool' defaults to SpectrogramThreadPool::shared() and must outlive the engine.
+    static std::unique_ptr<SpectrogramEngine> create(const SpectrogramEngineConfig& config,
+                                                     SpectrogramThreadPool* pool = nullptr);
+    ~SpectrogramEngine();  // Waits for an in-flight task
+
+    void pushSamples(const float* samples, size_t count);
+    void pushInterleaved(const float* frames, size_t count, int channels);
+    void flush();
+    void reset();
+
+    bool popLine(float* out, uint64_t* position = nullptr);
+    bool historyRow(int age, float* out) const;
+    int historyCount() const;
+    uint64_t droppedLines() const { return dropped.load(std::memory_order_relaxed); }
+
+    const SpectrogramEngineConfig& config() const { return cfg; }
+    int numBars() const { return cfg.numBars; }
+    float barFrequency(int bar) const;
+
+    struct Plan;  // Entry in the shared plan cache
+
+private:
+    SpectrogramEngine(const SpectrogramEngineConfig& config, SpectrogramThreadPool* pool);
+    bool init();
+    void buildWindow();
+    void buildMapping();
+    void scheduleLocked();
+    void run();
+    void analyseFrame(uint64_t start);
+
+    SpectrogramEngineConfig cfg;
+    SpectrogramThreadPool* pool;
+    Plan* plan = nullptr;  // Shared, refcounted
+    SpectrogramKernels kernels;
+
+    // Analysis state (touched only by the running task)
+    std::vector<float> windowTable;
+    float windowScale = 0.0f;
+    float* fftIn = nullptr;      // fftwf_malloc'd, fftSize
+    void* fftOut = nullptr;      // fftwf_complex[fftSize / 2 + 1]
+    std::vector<float> mags;
+    std::vector<float> line;
+    std::vector<int32_t> barBin0, barBin1;
+    std::vector<float> barFrac;
+    int barSplit = 0;
+
+    // Input FIFO: inputBuf[inputRead] is sample #inputBase
+    mutable std::mutex inputMutex;
+    std::condition_variable idle;
+    std::vector<float> inputBuf;
+    size_t inputRead = 0;
+    uint64_t inputBase = 0;
+    uint64_t nextFrame = 0;  // Sample index of the next window's start
+    bool scheduled = false;  // A task is queued or running
+
+    // Output: line queue and history ring
+    mutable std::mutex outputMutex;
+    std::vector<float> queue;
+    std::vector<uint64_t> queueStamps;
+    size_t queueHead = 0, queueCount = 0;
+    std::vector<float> history;
+    int historyHead = -1, historyFill = 0;
+    std::atomic<uint64_t> dropped{0};
+};
+
+#endif  // __cplusplus
+#endif  // SPECTROGRAM_ENGINE_H
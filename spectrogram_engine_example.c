@@ -0,0 +1,84 @@
+// Example and self-test of the SpectrogramEngine C API: analyses one second of
+// a 1 kHz sine and checks every line peaks at the bar nearest 1 kHz.
+//
+// Build and run with: make example
+// (or: gcc -std=c99 spectrogram_engine_example.c -L. -lspectrogram_engine -lfftw3f -lpthread -lstdc++ -lm)
+
+#include "spectrogram_engine.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TONE_HZ 1000.0
+
+int main(void) {
+    spectrogram_engine_config_t cfg;
+    spectrogram_engine_default_config(&cfg);  // 44.1 kHz, FFT 4096, hop 512, 1000 bars
+
+    spectrogram_engine_t* engine = spectrogram_engine_create(&cfg);
+    if (!engine) {
+        fprintf(stderr, "Error: Could not create the engine\n");
+        return 1;
+    }
+
+    // Expected peak: the bar whose centre frequency is closest to the tone
+    const int bars = spectrogram_engine_num_bars(engine);
+    int expected = 0;
+    for (int b = 1; b < bars; b++) {
+        if (fabs(spectrogram_engine_bar_frequency(engine, b) - TONE_HZ) <
+            fabs(spectrogram_engine_bar_frequency(engine, expected) - TONE_HZ)) {
+            expected = b;
+        }
+    }
+
+    const size_t count = (size_t)cfg.sample_rate;
+    float* samples = (float*)malloc(sizeof(float) * count);
+    float* line = (float*)malloc(sizeof(float) * (size_t)bars);
+    if (!samples || !line) {
+        fprintf(stderr, "Error: Out of memory\n");
+        spectrogram_engine_destroy(engine);
+        return 1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = 0.5f * (float)sin(2.0 * M_PI * TONE_HZ * (double)i / (double)cfg.sample_rate);
+    }
+
+    // Push in blocks, the way a capture callback would
+    for (size_t i = 0; i < count; i += 1024) {
+        spectrogram_engine_push(engine, samples + i, count - i < 1024 ? count - i : 1024);
+    }
+    spectrogram_engine_flush(engine);
+
+    int lines = 0, failures = 0;
+    uint64_t position = 0;
+    while (spectrogram_engine_pop_line(engine, line, &position)) {
+        int peak = 0;
+        for (int b = 1; b < bars; b++) {
+            if (line[b] > line[peak]) peak = b;
+        }
+        if (abs(peak - expected) > 2 || position != (uint64_t)lines * (uint64_t)cfg.hop) {
+            fprintf(stderr, "Error: Line at sample %llu peaks at bar %d (%.1f Hz), expected bar %d\n",
+                    (unsigned long long)position, peak, spectrogram_engine_bar_frequency(engine, peak), expected);
+            failures++;
+        }
+        lines++;
+    }
+
+    const int wantLines = (int)((count - (size_t)cfg.fft_size) / (size_t)cfg.hop) + 1;
+    if (lines != wantLines) {
+        fprintf(stderr, "Error: Got %d lines, expected %d\n", lines, wantLines);
+        failures++;
+    }
+    printf("%d lines, peak at bar %d (%.1f Hz): %s\n", lines, expected,
+           spectrogram_engine_bar_frequency(engine, expected), failures ? "FAILED" : "ok");
+
+    free(line);
+    free(samples);
+    spectrogram_engine_destroy(engine);
+    return failures ? 1 : 0;
+}
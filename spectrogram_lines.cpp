@@ -9,12 +9,12 @@
 // Compile (Windows/MSYS2):
 // First download ImGui: git clone https://github.com/ocornut/imgui.git
 // Then compile:
-// g++ -o spectrogram_gui.exe spectrogram_lines.cpp ^
+// g++ -o spectrogram_gui.exe spectrogram_lines.cpp spectrogram_engine.cpp ^
 // app.o imgui/imgui.cpp imgui/imgui_draw.cpp imgui/imgui_tables.cpp imgui/imgui_widgets.cpp ^
 // imgui/backends/imgui_impl_glfw.cpp imgui/backends/imgui_impl_opengl3.cpp -I./imgui -I./imgui/backends ^
 // -DGLEW_STATIC -mwindows -static -static-libgcc -static-libstdc++ -lglew32 -lglfw3 -lopengl32 -lportaudio ^
-// -lfftw3 -lsndfile -lvorbisenc -lvorbisfile -lvorbis -lFLAC -lmp3lame -lmpg123 -lopus -logg -lgdi32 ^
-// -lwinmm -lole32 -lcomdlg32 -lsetupapi -lksuser -lpsapi -lshlwapi -std=c++11 -O2
+// -lfftw3f -lsndfile -lvorbisenc -lvorbisfile -lvorbis -lFLAC -lmp3lame -lmpg123 -lopus -logg -lgdi32 ^
+// -lwinmm -lole32 -lcomdlg32 -lsetupapi -lksuser -lpsapi -lshlwapi -lws2_32 -std=c++11 -O2
 
 
 
@@ -31,6 +31,8 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 
+#include "spectrogram_engine.h"
+
 #include <iostream>
 #include <cmath>
 #include <vector>
@@ -43,8 +45,42 @@
 #include <string>
 #include <thread>
 #include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <streambuf>
+#include <ctime>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define SPECTROGRAM_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SPECTROGRAM_NEON 1
+#endif
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
 
 #ifdef _WIN32
+#include <winsock2.h>  // Before windows.h
+#include <ws2tcpip.h>
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
 #include <windows.h>
@@ -94,6 +130,13 @@ double getCurrentCPUUsage() {
     return percent * 100.0;
 }
 
+// Resident set size (working set) in bytes
+size_t getProcessRSS() {
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return (size_t)pmc.WorkingSetSize;
+}
+
 std::string openFileDialog(GLFWwindow* window) {
     OPENFILENAMEA ofn;
     char szFile[512] = {0};
@@ -103,7 +146,7 @@ std::string openFileDialog(GLFWwindow* window) {
     ofn.hwndOwner = glfwGetWin32Window(window);
     ofn.lpstrFile = szFile;
     ofn.nMaxFile = sizeof(szFile);
-    ofn.lpstrFilter = "Audio Files\0*.WAV;*.wav;*.mp3;*.MP3;*.flac;*.FLAC;*.ogg;*.OGG;*.aiff;*.AIFF;*.m4a;*.M4A\0All Files\0*.*\0";
+    ofn.lpstrFilter = "Audio Files\0*.WAV;*.wav;*.mp3;*.MP3;*.flac;*.FLAC;*.ogg;*.OGG;*.aiff;*.AIFF;*.m4a;*.M4A\0Session Logs\0*.speclog\0All Files\0*.*\0";
     ofn.nFilterIndex = 1;
     ofn.Flags = OFN_PATHMUSTEXIST | OFN_FILEMUSTEXIST;
 
@@ -113,8 +156,54 @@ std::string openFileDialog(GLFWwindow* window) {
     return "";
 }
 #else
-void initCPUUsage() {}
-double getCurrentCPUUsage() { return 0.0; }
+// CPU usage tracking from getrusage: process CPU time over wall time, per core
+static double lastWallSeconds = 0.0;
+static double lastProcessSeconds = 0.0;
+static int numProcessors = 1;
+
+static double processCPUSeconds() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return (double)usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+           (double)usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+static double wallSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void initCPUUsage() {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    numProcessors = n > 0 ? (int)n : 1;
+    lastWallSeconds = wallSeconds();
+    lastProcessSeconds = processCPUSeconds();
+}
+
+double getCurrentCPUUsage() {
+    double wall = wallSeconds();
+    double cpu = processCPUSeconds();
+    double elapsed = wall - lastWallSeconds;
+    double percent = elapsed > 0.0 ? (cpu - lastProcessSeconds) / elapsed / numProcessors : 0.0;
+    lastWallSeconds = wall;
+    lastProcessSeconds = cpu;
+
+    return percent * 100.0;
+}
+
+// Resident set size in bytes
+size_t getProcessRSS() {
+#ifdef __APPLE__
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+    return (size_t)info.resident_size;
+#else
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
 
 std::string openFileDialog(GLFWwindow* window) {
     std::string path;
@@ -129,16 +218,670 @@ std::string openFileDialog(GLFWwindow* window) {
 #endif
 
 // ===================== Audio file reading (supports WAV, MP3, FLAC, OGG, etc.) =====================
-// IMPORTANT: audioData is stored as MONO (one float per frame).
+// Files are never decoded into memory as a whole. Uncompressed WAV/AIFF PCM is
+// memory-mapped and deinterleaved on read; everything else is decoded by a
+// background thread into a bounded ring of PLANAR frames (one plane per channel)
+// that follows the playback position. All sample access goes through
+// AudioSource::read() (mono downmix) or readChannel(), which never lock or
+// allocate (safe from the audio callback) and zero-fill frames that are not
+// available yet.
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) { close(); return false; }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) { close(); return false; }
+        bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        length = (size_t)size.QuadPart;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) { close(); return false; }
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) { close(); return false; }
+        bytes = (const unsigned char*)p;
+        length = (size_t)st.st_size;
+#endif
+        if (!bytes) { close(); return false; }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap((void*)bytes, length);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+class AudioSource {
+public:
+    virtual ~AudioSource() {}
+
+    // Copy 'count' MONO frames starting at 'pos' into dst (missing frames are zero)
+    virtual void read(uint64_t pos, float* dst, size_t count) const = 0;
+
+    // Same for a single channel of the file (0 <= ch < channelCount())
+    virtual void readChannel(int ch, uint64_t pos, float* dst, size_t count) const = 0;
+
+    virtual int channelCount() const = 0;
+
+    // Playback is currently at 'pos' (lets streaming sources decode ahead / seek)
+    virtual void prefetch(uint64_t pos) { (void)pos; }
+
+    virtual const char* kind() const = 0;
+};
+
+// ---- Memory-mapped uncompressed PCM ----
+enum PCMEncoding { PCM_U8, PCM_S8, PCM_S16, PCM_S24, PCM_S32, PCM_F32 };
+
+static inline float decodePCMSample(const unsigned char* p, PCMEncoding enc, bool bigEndian) {
+    switch (enc) {
+        case PCM_U8:
+            return ((float)p[0] - 128.0f) * (1.0f / 128.0f);
+        case PCM_S8:
+            return (float)(int8_t)p[0] * (1.0f / 128.0f);
+        case PCM_S16: {
+            int16_t v = bigEndian ? (int16_t)((p[0] << 8) | p[1]) : (int16_t)((p[1] << 8) | p[0]);
+            return (float)v * (1.0f / 32768.0f);
+        }
+        case PCM_S24: {
+            int32_t v = bigEndian ? ((p[0] << 24) | (p[1] << 16) | (p[2] << 8))
+                                  : ((p[2] << 24) | (p[1] << 16) | (p[0] << 8));
+            return (float)(v >> 8) * (1.0f / 8388608.0f);
+        }
+        case PCM_S32: {
+            uint32_t u = bigEndian ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]
+                                   : ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+            return (float)(int32_t)u * (1.0f / 2147483648.0f);
+        }
+        case PCM_F32: {
+            uint32_t u = bigEndian ? ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]
+                                   : ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+            float f;
+            std::memcpy(&f, &u, sizeof(f));
+            return f;
+        }
+    }
+    return 0.0f;
+}
+
+static inline uint32_t readLE32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t readBE32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+class MappedPCMSource : public AudioSource {
+public:
+    // Succeeds only for plain RIFF/WAVE or AIFF files with a PCM/float encoding
+    // libsndfile already identified; anything else falls back to streaming decode.
+    bool open(const std::string& path, const SF_INFO& info) {
+        const int type = info.format & SF_FORMAT_TYPEMASK;
+        const int subtype = info.format & SF_FORMAT_SUBMASK;
+        if (type != SF_FORMAT_WAV && type != SF_FORMAT_AIFF) return false;
+
+        switch (subtype) {
+            case SF_FORMAT_PCM_U8: encoding = PCM_U8; bytesPerSample = 1; break;
+            case SF_FORMAT_PCM_S8: encoding = PCM_S8; bytesPerSample = 1; break;
+            case SF_FORMAT_PCM_16: encoding = PCM_S16; bytesPerSample = 2; break;
+            case SF_FORMAT_PCM_24: encoding = PCM_S24; bytesPerSample = 3; break;
+            case SF_FORMAT_PCM_32: encoding = PCM_S32; bytesPerSample = 4; break;
+            case SF_FORMAT_FLOAT:  encoding = PCM_F32; bytesPerSample = 4; break;
+            default: return false;
+        }
+
+        if (!file.open(path)) return false;
+        const unsigned char* d = file.data();
+        const size_t size = file.size();
+        if (size < 12) return false;
+
+        channels = std::max(1, info.channels);
+        uint64_t dataOffset = 0, dataBytes = 0;
+
+        if (type == SF_FORMAT_WAV) {
+            if (std::memcmp(d, "RIFF", 4) != 0 || std::memcmp(d + 8, "WAVE", 4) != 0) return false;
+            bigEndian = false;
+            size_t pos = 12;
+            while (pos + 8 <= size) {
+                uint32_t chunkSize = readLE32(d + pos + 4);
+                if (std::memcmp(d + pos, "data", 4) == 0) {
+                    dataOffset = pos + 8;
+                    dataBytes = chunkSize;
+                    break;
+                }
+                pos += 8 + (size_t)chunkSize + (chunkSize & 1);
+            }
+        } else {
+            if (std::memcmp(d, "FORM", 4) != 0 || std::memcmp(d + 8, "AIFF", 4) != 0) return false;
+            bigEndian = true;
+            size_t pos = 12;
+            while (pos + 16 <= size) {
+                uint32_t chunkSize = readBE32(d + pos + 4);
+                if (std::memcmp(d + pos, "SSND", 4) == 0) {
+                    uint32_t ssndOffset = readBE32(d + pos + 8);
+                    dataOffset = pos + 16 + ssndOffset;
+                    dataBytes = chunkSize >= 8 + ssndOffset ? chunkSize - 8 - ssndOffset : 0;
+                    break;
+                }
+                pos += 8 + (size_t)chunkSize + (chunkSize & 1);
+            }
+        }
+
+        if (dataOffset == 0 || dataOffset >= size) return false;
+        dataBytes = std::min<uint64_t>(dataBytes, size - dataOffset);
+
+        frameBytes = (size_t)bytesPerSample * (size_t)channels;
+        frames = std::min<uint64_t>(dataBytes / frameBytes, (uint64_t)std::max<sf_count_t>(0, info.frames));
+        pcm = d + dataOffset;
+        return frames > 0;
+    }
+
+    uint64_t frameCount() const { return frames; }
+
+    void read(uint64_t pos, float* dst, size_t count) const override {
+        mix(pos, dst, count, 0, channels);
+    }
+
+    void readChannel(int ch, uint64_t pos, float* dst, size_t count) const override {
+        mix(pos, dst, count, ch, ch + 1);
+    }
+
+    int channelCount() const override { return channels; }
+
+    const char* kind() const override { return "memory-mapped"; }
+
+private:
+    // Average of channels [c0, c1) for each frame
+    void mix(uint64_t pos, float* dst, size_t count, int c0, int c1) const {
+        const float scale = 1.0f / (float)(c1 - c0);
+        const size_t avail = pos < frames ? (size_t)std::min<uint64_t>(count, frames - pos) : 0;
+        const unsigned char* p = pcm + (size_t)c0 * (size_t)bytesPerSample + (avail ? (size_t)pos * frameBytes : 0);
+        for (size_t i = 0; i < avail; i++, p += frameBytes) {
+            float sum = 0.0f;
+            for (int ch = 0; ch < c1 - c0; ch++) {
+                sum += decodePCMSample(p + (size_t)ch * (size_t)bytesPerSample, encoding, bigEndian);
+            }
+            dst[i] = sum * scale;
+        }
+        std::fill(dst + avail, dst + count, 0.0f);
+    }
+
+    MappedFile file;
+    const unsigned char* pcm = nullptr;
+    uint64_t frames = 0;
+    size_t frameBytes = 0;
+    int channels = 1;
+    int bytesPerSample = 2;
+    PCMEncoding encoding = PCM_S16;
+    bool bigEndian = false;
+};
+
+// ---- Streaming decode into a bounded ring ----
+static constexpr uint64_t STREAM_RING_FRAMES = 1u << 20;  // ~22 s at 48 kHz (power of two)
+static constexpr uint64_t STREAM_HEAD_FRAMES = 1u << 16;  // Decoded up front: instant start, gapless loop
+static constexpr uint64_t STREAM_PREROLL = 1u << 15;      // Decoded behind a seek target for FFT windows
+static constexpr uint64_t STREAM_BACKLOG = 1u << 16;      // Never overwritten behind the playback position
+static constexpr uint64_t STREAM_SEEK_SLACK = 1u << 17;   // Jumps further ahead than this seek instead of decode
+static constexpr size_t STREAM_BLOCK_FRAMES = 4096;
+
+class StreamingDecodeSource : public AudioSource {
+public:
+    ~StreamingDecodeSource() {
+        running.store(false, std::memory_order_release);
+        if (thread.joinable()) thread.join();
+        if (sndfile) sf_close(sndfile);
+    }
+
+    bool open(const std::string& filePath, const SF_INFO& openedInfo) {
+        path = filePath;
+        info = openedInfo;
+        sndfile = sf_open(path.c_str(), SFM_READ, &info);
+        if (!sndfile) return false;
+
+        channels = std::max(1, info.channels);
+        frames = (uint64_t)std::max<sf_count_t>(0, info.frames);
+        interleaved.resize(STREAM_BLOCK_FRAMES * (size_t)channels);
+        planar.resize(STREAM_BLOCK_FRAMES * (size_t)channels);
+        ring.assign((size_t)STREAM_RING_FRAMES * (size_t)channels, 0.0f);
+
+        // Decode the first frames synchronously so playback can start immediately
+        uint64_t headTarget = std::min(frames.load(), STREAM_HEAD_FRAMES);
+        headStride = (size_t)headTarget;
+        head.assign(headStride * (size_t)channels, 0.0f);
+        uint64_t got = 0;
+        while (got < headTarget) {
+            size_t n = decodeBlock((size_t)std::min<uint64_t>(STREAM_BLOCK_FRAMES, headTarget - got));
+            if (n == 0) break;
+            for (int ch = 0; ch < channels; ch++) {
+                const float* src = &planar[(size_t)ch * STREAM_BLOCK_FRAMES];
+                std::memcpy(&head[(size_t)ch * headStride + (size_t)got], src, n * sizeof(float));
+                std::memcpy(&ring[(size_t)ch * STREAM_RING_FRAMES + (size_t)got], src, n * sizeof(float));
+            }
+            got += n;
+        }
+        headFrames = got;
+        decodePos = got;
+        ringStart.store(0, std::memory_order_relaxed);
+        ringEnd.store(got, std::memory_order_release);
+
+        if (got == 0) return false;
+        if (got < headTarget) frames = got;  // Shorter than the header claimed
+
+        running.store(true, std::memory_order_release);
+        thread = std::thread(&StreamingDecodeSource::decodeLoop, this);
+        return true;
+    }
+
+    uint64_t frameCount() const { return frames.load(); }
+
+    void read(uint64_t pos, float* dst, size_t count) const override {
+        mix(pos, dst, count, 0, channels);
+    }
+
+    void readChannel(int ch, uint64_t pos, float* dst, size_t count) const override {
+        mix(pos, dst, count, ch, ch + 1);
+    }
+
+    int channelCount() const override { return channels; }
+
+    void prefetch(uint64_t pos) override {
+        hint.store(pos, std::memory_order_relaxed);
+    }
+
+    const char* kind() const override { return "streaming"; }
+
+private:
+    // Average of channels [c0, c1): every plane is contiguous, so this is a
+    // unit-stride accumulate per channel instead of an interleaved gather
+    void mix(uint64_t pos, float* dst, size_t count, int c0, int c1) const {
+        std::fill(dst, dst + count, 0.0f);
+        const float scale = 1.0f / (float)(c1 - c0);
+        const uint64_t end = pos + count;
+
+        // Ring first (seqlock-style: discard anything the decoder replaced meanwhile)
+        uint64_t gen0 = generation.load(std::memory_order_acquire);
+        uint64_t s0 = ringStart.load(std::memory_order_acquire);
+        uint64_t e0 = ringEnd.load(std::memory_order_acquire);
+        uint64_t lo = std::max(pos, s0);
+        uint64_t hi = std::min(end, e0);
+        if (lo < hi) {
+            for (int ch = c0; ch < c1; ch++) {
+                const float* plane = &ring[(size_t)ch * STREAM_RING_FRAMES];
+                for (uint64_t f = lo; f < hi; f++) {
+                    dst[(size_t)(f - pos)] += plane[(size_t)(f & (STREAM_RING_FRAMES - 1))] * scale;
+                }
+            }
+            uint64_t s1 = ringStart.load(std::memory_order_acquire);
+            if (generation.load(std::memory_order_acquire) != gen0) {
+                std::fill(dst + (lo - pos), dst + (hi - pos), 0.0f);
+            } else if (s1 > lo) {
+                std::fill(dst + (lo - pos), dst + (std::min(s1, hi) - pos), 0.0f);
+            }
+        }
+
+        // The decoded head is immutable and always wins
+        if (pos < headFrames) {
+            const size_t n = (size_t)(std::min(end, headFrames) - pos);
+            for (int ch = c0; ch < c1; ch++) {
+                const float* plane = &head[(size_t)ch * headStride + (size_t)pos];
+                if (ch == c0) {
+                    for (size_t i = 0; i < n; i++) dst[i] = plane[i] * scale;
+                } else {
+                    for (size_t i = 0; i < n; i++) dst[i] += plane[i] * scale;
+                }
+            }
+        }
+    }
+
+    // Decode up to n frames at decodePos into 'planar'; returns frames decoded
+    size_t decodeBlock(size_t n) {
+        sf_count_t got = sf_readf_float(sndfile, interleaved.data(), (sf_count_t)n);
+        if (got <= 0) return 0;
+        // Deinterleave once here so every later read is unit-stride
+        for (int ch = 0; ch < channels; ch++) {
+            float* plane = &planar[(size_t)ch * STREAM_BLOCK_FRAMES];
+            const float* src = &interleaved[(size_t)ch];
+            for (sf_count_t i = 0; i < got; i++) plane[i] = src[(size_t)i * (size_t)channels];
+        }
+        return (size_t)got;
+    }
+
+    bool seekDecoder(uint64_t target) {
+        if (sf_seek(sndfile, (sf_count_t)target, SEEK_SET) >= 0) {
+            decodePos = target;
+            return true;
+        }
+        // Not seekable: reopen and decode forward
+        sf_close(sndfile);
+        SF_INFO reopenInfo;
+        memset(&reopenInfo, 0, sizeof(reopenInfo));
+        sndfile = sf_open(path.c_str(), SFM_READ, &reopenInfo);
+        decodePos = 0;
+        if (!sndfile) return false;
+        while (decodePos < target) {
+            size_t n = decodeBlock((size_t)std::min<uint64_t>(STREAM_BLOCK_FRAMES, target - decodePos));
+            if (n == 0) break;
+            decodePos += n;
+        }
+        return true;
+    }
+
+    void decodeLoop() {
+        while (running.load(std::memory_order_acquire)) {
+            const uint64_t total = frames.load(std::memory_order_relaxed);
+            const uint64_t h = std::min(hint.load(std::memory_order_relaxed), total);
+            const uint64_t s = ringStart.load(std::memory_order_relaxed);
+            const uint64_t e = ringEnd.load(std::memory_order_relaxed);
+
+            // Seek: playback jumped outside what the ring holds or will soon hold.
+            // While the head buffer covers playback (e.g. after a loop), refill
+            // the ring from the end of the head so the hand-over is gapless.
+            const bool inHead = h < headFrames;
+            if ((!inHead && h < s) || (inHead && s > headFrames) || h > e + STREAM_SEEK_SLACK) {
+                uint64_t from = std::max(h, headFrames);
+                uint64_t target = from > STREAM_PREROLL ? from - STREAM_PREROLL : 0;
+                generation.fetch_add(1, std::memory_order_acq_rel);
+                ringStart.store(target, std::memory_order_release);
+                ringEnd.store(target, std::memory_order_release);
+                if (!sndfile || !seekDecoder(target)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                continue;
+            }
+
+            // Far enough ahead (or at EOF): idle
+            const uint64_t limit = std::min(total, h + STREAM_RING_FRAMES - STREAM_BACKLOG);
+            if (!sndfile || e >= limit) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                continue;
+            }
+
+            size_t n = decodeBlock((size_t)std::min<uint64_t>(STREAM_BLOCK_FRAMES, limit - e));
+            if (n == 0) {
+                frames = e;  // Decoder hit EOF before the header's frame count
+                continue;
+            }
+
+            // Invalidate the frames about to be overwritten before writing them
+            const uint64_t newEnd = e + n;
+            if (newEnd > STREAM_RING_FRAMES) {
+                ringStart.store(std::max(s, newEnd - STREAM_RING_FRAMES), std::memory_order_release);
+            }
+            for (int ch = 0; ch < channels; ch++) {
+                float* plane = &ring[(size_t)ch * STREAM_RING_FRAMES];
+                const float* src = &planar[(size_t)ch * STREAM_BLOCK_FRAMES];
+                for (size_t i = 0; i < n; i++) plane[(size_t)((e + i) & (STREAM_RING_FRAMES - 1))] = src[i];
+            }
+            ringEnd.store(newEnd, std::memory_order_release);
+            decodePos += n;
+        }
+    }
+
+    std::string path;
+    SF_INFO info;
+    SNDFILE* sndfile = nullptr;
+    int channels = 1;
+    std::atomic<uint64_t> frames{0};
+    uint64_t decodePos = 0;
+    uint64_t headFrames = 0;
+
+    std::vector<float> head;         // First STREAM_HEAD_FRAMES frames, one plane per channel
+    size_t headStride = 0;           // Frames per head plane
+    std::vector<float> ring;         // STREAM_RING_FRAMES per channel, indexed by frame & mask
+    std::vector<float> interleaved;  // Decoder scratch
+    std::vector<float> planar;       // STREAM_BLOCK_FRAMES per channel
+
+    std::atomic<uint64_t> ringStart{0};   // First valid frame in ring
+    std::atomic<uint64_t> ringEnd{0};     // One past the last valid frame
+    std::atomic<uint64_t> generation{0};  // Bumped on every seek
+    std::atomic<uint64_t> hint{0};
+    std::atomic<bool> running{false};
+    std::thread thread;
+};
+
+// ---- Whole file decoded up front (offline rendering needs random access everywhere) ----
+class DecodedSource : public AudioSource {
+public:
+    bool open(const std::string& path) {
+        SF_INFO info;
+        memset(&info, 0, sizeof(info));
+        SNDFILE* sndfile = sf_open(path.c_str(), SFM_READ, &info);
+        if (!sndfile) return false;
+
+        const int channels = std::max(1, info.channels);
+        std::vector<float> buffer(STREAM_BLOCK_FRAMES * (size_t)channels);
+        planes.assign((size_t)channels, std::vector<float>());
+        for (int ch = 0; ch < channels; ch++) planes[(size_t)ch].reserve((size_t)std::max<sf_count_t>(0, info.frames));
+        for (;;) {
+            sf_count_t got = sf_readf_float(sndfile, buffer.data(), (sf_count_t)STREAM_BLOCK_FRAMES);
+            if (got <= 0) break;
+            for (int ch = 0; ch < channels; ch++) {
+                std::vector<float>& plane = planes[(size_t)ch];
+                for (sf_count_t i = 0; i < got; i++) plane.push_back(buffer[(size_t)i * (size_t)channels + (size_t)ch]);
+            }
+        }
+        sf_close(sndfile);
+        return !planes[0].empty();
+    }
+
+    uint64_t frameCount() const { return planes.empty() ? 0 : planes[0].size(); }
+
+    void read(uint64_t pos, float* dst, size_t count) const override {
+        mix(pos, dst, count, 0, (int)planes.size());
+    }
+
+    void readChannel(int ch, uint64_t pos, float* dst, size_t count) const override {
+        mix(pos, dst, count, ch, ch + 1);
+    }
+
+    int channelCount() const override { return (int)planes.size(); }
+
+    const char* kind() const override { return "decoded"; }
+
+private:
+    void mix(uint64_t pos, float* dst, size_t count, int c0, int c1) const {
+        const uint64_t total = frameCount();
+        const size_t avail = pos < total ? (size_t)std::min<uint64_t>(count, total - pos) : 0;
+        if (avail) std::memcpy(dst, &planes[(size_t)c0][(size_t)pos], avail * sizeof(float));
+        if (c1 - c0 > 1) {
+            const float scale = 1.0f / (float)(c1 - c0);
+            for (int ch = c0 + 1; ch < c1; ch++) {
+                const float* plane = &planes[(size_t)ch][(size_t)pos];
+                for (size_t i = 0; i < avail; i++) dst[i] += plane[i];
+            }
+            for (size_t i = 0; i < avail; i++) dst[i] *= scale;
+        }
+        std::fill(dst + avail, dst + count, 0.0f);
+    }
+
+    std::vector<std::vector<float>> planes;  // One per channel
+};
+
+// read() exposes the MONO downmix (one float per frame); readChannel() gives
+// each of the file's channels separately for multichannel analysis.
 // sourceChannels stores the original channel count from the file.
+static constexpr uint64_t OVERVIEW_BLOCK = 1024;  // Frames per min/max pair in the overview
+
+// Min/max envelope of the mono downmix as a mip pyramid: level 0 holds one pair
+// per OVERVIEW_BLOCK frames and each level above halves the count. The file is
+// scanned in parallel over power-of-two segments of level-0 blocks, each worker
+// on its own decoder handle. A segment's levels never cross into the next one,
+// so a worker builds them as it goes and publishes its progress after writing;
+// readers only touch pairs whose blocks are all published. Wide ranges combine
+// at most one top-level pair per segment.
+struct WaveformPyramid {
+    std::vector<std::vector<float>> levelMin;  // [level][pair]
+    std::vector<std::vector<float>> levelMax;
+    uint64_t blocks = 0;          // Level 0 pairs
+    uint64_t segmentBlocks = 1;   // Level 0 pairs per scan segment (power of two)
+    int levels = 1;               // log2(segmentBlocks) + 1
+    size_t segments = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> segmentDone;  // Level 0 pairs published per segment
+    std::atomic<size_t> segmentsFinished{0};
+    std::atomic<uint64_t> published{0};  // Total pairs published (change detection)
+
+    void reset(uint64_t blockCount, size_t workers) {
+        blocks = blockCount;
+        // About four segments per worker so the front of the file streams in first
+        const uint64_t target = std::max<uint64_t>(16, (blocks + workers * 4 - 1) / (workers * 4));
+        segmentBlocks = 1;
+        levels = 1;
+        while (segmentBlocks < target) {
+            segmentBlocks *= 2;
+            levels++;
+        }
+        segments = (size_t)((blocks + segmentBlocks - 1) / segmentBlocks);
+        levelMin.assign((size_t)levels, std::vector<float>());
+        levelMax.assign((size_t)levels, std::vector<float>());
+        for (int L = 0; L < levels; L++) {
+            const size_t n = (size_t)((blocks + (1ull << L) - 1) >> L);
+            levelMin[(size_t)L].assign(n, 0.0f);
+            levelMax[(size_t)L].assign(n, 0.0f);
+        }
+        segmentDone.reset(new std::atomic<uint64_t>[segments > 0 ? segments : 1]);
+        for (size_t sgm = 0; sgm < std::max<size_t>(segments, 1); sgm++) segmentDone[sgm].store(0);
+        segmentsFinished.store(0);
+        published.store(0);
+    }
+
+    void clear() {
+        levelMin.clear();
+        levelMax.clear();
+        blocks = 0;
+        segments = 0;
+        segmentsFinished.store(0);
+        published.store(0);
+    }
+
+    bool complete() const {
+        return segmentsFinished.load(std::memory_order_acquire) >= segments;
+    }
+
+    // Pair j of level L covers level-0 blocks [j << L, (j + 1) << L)
+    bool pairReady(int L, uint64_t j) const {
+        const uint64_t first = j << L;
+        const uint64_t last = std::min<uint64_t>((j + 1) << L, blocks);
+        const size_t sgm = (size_t)(first / segmentBlocks);
+        if (sgm >= segments) return false;
+        return last - (uint64_t)sgm * segmentBlocks <= segmentDone[sgm].load(std::memory_order_acquire);
+    }
+
+    // Write level-0 pair b and every ancestor it completes (scan workers only)
+    void store(uint64_t b, float mn, float mx) {
+        levelMin[0][(size_t)b] = mn;
+        levelMax[0][(size_t)b] = mx;
+        uint64_t idx = b;
+        for (int L = 1; L < levels; L++) {
+            const size_t below = levelMin[(size_t)L - 1].size();
+            if (!(idx & 1) && idx + 1 != below) break;  // Sibling still to come
+            const uint64_t parent = idx >> 1;
+            const size_t c0 = (size_t)(parent * 2), c1 = std::min(c0 + 1, below - 1);
+            levelMin[(size_t)L][(size_t)parent] = std::min(levelMin[(size_t)L - 1][c0], levelMin[(size_t)L - 1][c1]);
+            levelMax[(size_t)L][(size_t)parent] = std::max(levelMax[(size_t)L - 1][c0], levelMax[(size_t)L - 1][c1]);
+            idx = parent;
+        }
+    }
+
+    // Envelope of level-0 blocks [b0, b1) from the coarsest published pairs that
+    // tile it. Returns false when none of the range is available yet.
+    bool range(uint64_t b0, uint64_t b1, float& mn, float& mx) const {
+        b1 = std::min(b1, blocks);
+        bool any = false;
+        mn = 0.0f;
+        mx = 0.0f;
+        while (b0 < b1) {
+            int L = 0;
+            while (L + 1 < levels && (b0 & ((2ull << L) - 1)) == 0 && b0 + (2ull << L) <= b1) L++;
+            const uint64_t j = b0 >> L;
+            if (pairReady(L, j)) {
+                mn = std::min(mn, levelMin[(size_t)L][(size_t)j]);
+                mx = std::max(mx, levelMax[(size_t)L][(size_t)j]);
+                any = true;
+            }
+            b0 += 1ull << L;
+        }
+        return any;
+    }
+};
+
 struct WAVFile {
-    std::vector<float> audioData;     // MONO samples (one float per frame)
     uint32_t sampleRate = 0;
+    uint64_t totalFrames = 0;         // MONO frames (one per file frame)
+    uint64_t fileBytes = 0;
 
     uint16_t sourceChannels = 0;      // channels in the original file
-    uint16_t numChannels = 1;         // channels in audioData (ALWAYS 1 here)
+    uint16_t numChannels = 1;         // channels available through readChannel()
     uint16_t bitsPerSample = 16;
 
+    std::unique_ptr<AudioSource> source;
+
+    // Min/max waveform pyramid filled by a parallel background scan
+    WaveformPyramid overview;
+    std::atomic<bool> overviewCancel{false};
+    std::thread overviewThread;
+
+    ~WAVFile() { close(); }
+
+    bool empty() const { return totalFrames == 0; }
+
+    void read(uint64_t pos, float* dst, size_t count) const {
+        if (source) source->read(pos, dst, count);
+        else std::fill(dst, dst + count, 0.0f);
+    }
+
+    void readChannel(int ch, uint64_t pos, float* dst, size_t count) const {
+        if (source && ch < numChannels) source->readChannel(ch, pos, dst, count);
+        else std::fill(dst, dst + count, 0.0f);
+    }
+
+    void prefetch(uint64_t pos) {
+        if (source) source->prefetch(pos);
+    }
+
+    void close() {
+        overviewCancel.store(true, std::memory_order_release);
+        if (overviewThread.joinable()) overviewThread.join();
+        source.reset();
+        totalFrames = 0;
+        overview.clear();
+    }
+
     std::string getFormatName(const std::string& filename) {
         size_t dotPos = filename.find_last_of('.');
         if (dotPos == std::string::npos) return "Unknown";
@@ -147,7 +890,9 @@ struct WAVFile {
         return ext;
     }
 
-    bool load(const std::string& filename) {
+    // fullyDecode: compressed formats are decoded into memory instead of streamed,
+    // so read() is valid at any position (used by the headless renderer)
+    bool load(const std::string& filename, bool fullyDecode = false) {
         SF_INFO sfinfo;
         memset(&sfinfo, 0, sizeof(sfinfo));
 
@@ -157,40 +902,134 @@ struct WAVFile {
             std::cerr << "libsndfile error: " << sf_strerror(NULL) << "\n";
             return false;
         }
-
-        sampleRate = (uint32_t)sfinfo.samplerate;
-        sourceChannels = (uint16_t)sfinfo.channels;
-        numChannels = 1; // store mono
-
-        size_t totalFrames = (size_t)sfinfo.frames;
-        std::vector<float> buffer(totalFrames * (size_t)sourceChannels);
-
-        sf_count_t framesRead = sf_readf_float(sndfile, buffer.data(), (sf_count_t)totalFrames);
         sf_close(sndfile);
 
-        if (framesRead <= 0) {
-            std::cerr << "Error: No audio data read\n";
-            return false;
+        close();
+
+        // Uncompressed PCM reads straight from the page cache; everything else streams
+        uint64_t frames = 0;
+        MappedPCMSource* mapped = new MappedPCMSource();
+        if (mapped->open(filename, sfinfo)) {
+            frames = mapped->frameCount();
+            source.reset(mapped);
+        } else if (fullyDecode) {
+            delete mapped;
+            DecodedSource* decoded = new DecodedSource();
+            if (!decoded->open(filename)) {
+                delete decoded;
+                std::cerr << "Error: No audio data read\n";
+                return false;
+            }
+            frames = decoded->frameCount();
+            source.reset(decoded);
+        } else {
+            delete mapped;
+            StreamingDecodeSource* streaming = new StreamingDecodeSource();
+            if (!streaming->open(filename, sfinfo)) {
+                delete streaming;
+                std::cerr << "Error: No audio data read\n";
+                return false;
+            }
+            frames = streaming->frameCount();
+            source.reset(streaming);
         }
 
-        // Convert to mono by averaging channels
-        audioData.resize((size_t)framesRead);
-        for (size_t i = 0; i < (size_t)framesRead; i++) {
-            float sum = 0.0f;
-            for (int ch = 0; ch < (int)sourceChannels; ch++) {
-                sum += buffer[i * (size_t)sourceChannels + (size_t)ch];
-            }
-            audioData[i] = sum / (float)sourceChannels;
+        sampleRate = (uint32_t)sfinfo.samplerate;
+        sourceChannels = (uint16_t)sfinfo.channels;
+        numChannels = (uint16_t)source->channelCount();
+        totalFrames = frames;
+
+        switch (sfinfo.format & SF_FORMAT_SUBMASK) {
+            case SF_FORMAT_PCM_S8: case SF_FORMAT_PCM_U8: bitsPerSample = 8; break;
+            case SF_FORMAT_PCM_24: bitsPerSample = 24; break;
+            case SF_FORMAT_PCM_32: case SF_FORMAT_FLOAT: bitsPerSample = 32; break;
+            case SF_FORMAT_DOUBLE: bitsPerSample = 64; break;
+            default: bitsPerSample = 16; break;
         }
 
+        std::ifstream sizeProbe(filename, std::ios::binary | std::ios::ate);
+        fileBytes = sizeProbe ? (uint64_t)sizeProbe.tellg() : 0;
+
+        startOverviewScan(filename);
+
         std::cout << "Audio File Info:\n";
-        std::cout << "  Format: " << getFormatName(filename) << "\n";
+        std::cout << "  Format: " << getFormatName(filename) << " (" << source->kind() << ")\n";
         std::cout << "  Sample Rate: " << sampleRate << " Hz\n";
-        std::cout << "  Channels: " << sourceChannels << " (downmixed to mono)\n";
-        std::cout << "  Duration: " << (float)audioData.size() / (float)sampleRate << " seconds\n";
+        std::cout << "  Channels: " << sourceChannels << "\n";
+        std::cout << "  Duration: " << (float)totalFrames / (float)sampleRate << " seconds\n";
 
         return true;
     }
+
+private:
+    // Scan the whole file once into the overview pyramid. Workers pull segments
+    // in file order; unseekable formats are scanned by a single worker.
+    void startOverviewScan(const std::string& filename) {
+        SF_INFO probe;
+        memset(&probe, 0, sizeof(probe));
+        SNDFILE* snd = sf_open(filename.c_str(), SFM_READ, &probe);
+        const bool seekable = snd && probe.seekable;
+        if (snd) sf_close(snd);
+
+        const size_t workers = seekable ? (size_t)std::max(1, (int)std::thread::hardware_concurrency() - 1) : 1;
+        overview.reset((totalFrames + OVERVIEW_BLOCK - 1) / OVERVIEW_BLOCK, workers);
+        overviewCancel.store(false, std::memory_order_release);
+
+        overviewThread = std::thread([this, filename, workers]() {
+            std::atomic<size_t> nextSegment{0};
+            std::vector<std::thread> pool;
+            for (size_t w = 0; w < workers; w++) {
+                pool.push_back(std::thread(&WAVFile::overviewWorker, this, filename, std::ref(nextSegment)));
+            }
+            for (size_t w = 0; w < pool.size(); w++) pool[w].join();
+        });
+    }
+
+    void overviewWorker(std::string filename, std::atomic<size_t>& nextSegment) {
+        SF_INFO scanInfo;
+        memset(&scanInfo, 0, sizeof(scanInfo));
+        SNDFILE* scan = sf_open(filename.c_str(), SFM_READ, &scanInfo);
+
+        const int ch = std::max(1, scanInfo.channels);
+        const float invCh = 1.0f / (float)ch;
+        std::vector<float> buffer((size_t)OVERVIEW_BLOCK * (size_t)ch);
+        uint64_t position = 0;  // Decoder position in frames
+
+        for (;;) {
+            if (overviewCancel.load(std::memory_order_acquire)) break;
+            const size_t sgm = nextSegment.fetch_add(1);
+            if (sgm >= overview.segments) break;
+            const uint64_t b0 = (uint64_t)sgm * overview.segmentBlocks;
+            const uint64_t b1 = std::min(b0 + overview.segmentBlocks, overview.blocks);
+
+            bool ok = scan != nullptr;
+            if (ok && position != b0 * OVERVIEW_BLOCK) {
+                ok = sf_seek(scan, (sf_count_t)(b0 * OVERVIEW_BLOCK), SEEK_SET) >= 0;
+                position = b0 * OVERVIEW_BLOCK;
+            }
+            for (uint64_t b = b0; b < b1; b++) {
+                float mn = 0.0f, mx = 0.0f;
+                sf_count_t got = 0;
+                if (ok) {
+                    got = sf_readf_float(scan, buffer.data(), (sf_count_t)OVERVIEW_BLOCK);
+                    position += (uint64_t)std::max<sf_count_t>(got, 0);
+                }
+                if (got <= 0) ok = false;  // Read error or short file: publish silence
+                for (sf_count_t i = 0; i < got; i++) {
+                    float sum = 0.0f;
+                    for (int c = 0; c < ch; c++) sum += buffer[(size_t)i * (size_t)ch + (size_t)c];
+                    float s = sum * invCh;
+                    mn = std::min(mn, s);
+                    mx = std::max(mx, s);
+                }
+                overview.store(b, mn, mx);
+                overview.segmentDone[sgm].store(b - b0 + 1, std::memory_order_release);
+                overview.published.fetch_add(1, std::memory_order_relaxed);
+            }
+            overview.segmentsFinished.fetch_add(1, std::memory_order_acq_rel);
+        }
+        if (scan) sf_close(scan);
+    }
 };
 
 // ===================== CONFIG  =====================
@@ -206,17 +1045,37 @@ static constexpr float Y_SCALE = 1.20f;
 static constexpr float COLOR_BRIGHTNESS = 2.1f;
 static constexpr float COLOR_GAMMA = 0.45f;
 static constexpr float COLOR_SAT = 1.0f*2;
+static constexpr float WATERFALL_SATURATION = 1.0f;  // Colormap saturation boost in the 3D view
+static constexpr float HEATMAP_SATURATION = 1.5f;    // 50% more saturated in the 2D view
 static constexpr int FRAMES_PER_BUFFER = 256;
+static std::atomic<int> ANALYSIS_HOP{512};  // Samples between analysed lines (read by the analysis thread)
 
 // ===================== Globals =====================
-WAVFile wavFile;
+// The current track. Owned by the UI thread; swapped under gAnalysisMutex so the
+// analysis thread always sees a complete file. The audio callback never touches
+// this pointer - it follows gPlaybackTrack instead (see Audio Callback).
+static std::shared_ptr<WAVFile> wavFile = std::make_shared<WAVFile>();
 std::vector<float> magnitudes;  // Dynamic size based on FFT_SIZE
 std::atomic<uint64_t> playbackPosition{0};  // MONO sample index (one per frame)
 std::atomic<bool> isPaused{false};
 
-fftw_plan fftPlan = nullptr;
-double* fftInput = nullptr;
-fftw_complex* fftOutput = nullptr;
+fftwf_plan fftPlan = nullptr;
+float* fftInput = nullptr;
+fftwf_complex* fftOutput = nullptr;
+static int fftPlanSize = 0;  // Size the current plan/buffers were built for (may lag FFT_SIZE)
+
+// Guards the FFT plan, frequency mapping and the audio source against the analysis thread
+static std::mutex gAnalysisMutex;
+
+// Live input capture (see Live Input); while active the analysis follows the
+// capture ring instead of file playback
+static std::atomic<bool> gCaptureActive{false};
+static uint32_t gCaptureSampleRate = 48000;
+
+// Sample rate of whatever is being analysed
+static uint32_t analysisSampleRate() {
+    return gCaptureActive.load(std::memory_order_relaxed) ? gCaptureSampleRate : wavFile->sampleRate;
+}
 
 // Texture-based spectrogram rendering (OPTIMIZATION)
 static GLuint spectrogramTexture = 0;
@@ -229,62 +1088,606 @@ int getNumFrequencies() {
     return FFT_SIZE / 2;
 }
 
-// Forward declaration
-static void buildFrequencyMapping();
-
-// Reinitialize FFT when size changes
-void reinitializeFFT() {
-    // Clean up old FFTW plan
-    if (fftPlan) {
-        fftw_destroy_plan(fftPlan);
-        fftw_free(fftInput);
-        fftw_free(fftOutput);
+// ===================== Profiling =====================
+// Scoped timers around the hot stages feed lock-free log-scale histograms
+// (quarter-octave buckets from 1 ns) that the stats overlay folds into p50/p99
+// once a second. While a trace is being recorded each timed scope is also kept
+// as a Chrome trace event, viewable in chrome://tracing or Perfetto.
+enum ProfileStage {
+    STAGE_FFT = 0,
+    STAGE_LINE_BUILD,
+    STAGE_HISTORY_PUSH,
+    STAGE_VIEW_DRAW,
+    STAGE_TEXTURE_UPLOAD,
+    STAGE_IMGUI,
+    STAGE_SWAP,
+    STAGE_FRAME,
+    STAGE_GPU_VIEW,
+    STAGE_COUNT
+};
+static const char* profileStageNames[STAGE_COUNT] = {
+    "FFT", "Line build", "History push", "View draw", "Texture upload",
+    "ImGui", "Swap", "Frame", "GPU view"
+};
+// Trace thread each stage runs on (0 = UI, 1 = analysis)
+static const uint8_t profileStageThread[STAGE_COUNT] = { 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static constexpr int PROFILE_BUCKETS = 4 * 40;  // 1 ns .. ~18 minutes
+static constexpr size_t PROFILE_TRACE_MAX_EVENTS = 1u << 20;  // ~24 MB before recording stops growing
+static constexpr uint8_t PROFILE_EVENT_XRUN = 0xFF;  // Instant event, not a stage
+
+struct StageHistogram {
+    std::atomic<uint32_t> counts[PROFILE_BUCKETS];
+    StageHistogram() {
+        for (int i = 0; i < PROFILE_BUCKETS; ++i) counts[i].store(0, std::memory_order_relaxed);
     }
+};
+static StageHistogram gStageHistograms[STAGE_COUNT];
 
-    // Allocate new buffers
-    fftInput = (double*)fftw_malloc(sizeof(double) * FFT_SIZE);
-    fftOutput = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (FFT_SIZE / 2 + 1));
-    fftPlan = fftw_plan_dft_r2c_1d(FFT_SIZE, fftInput, fftOutput, FFTW_ESTIMATE);
+struct StageStats {
+    float p50Ms = 0.0f;
+    float p99Ms = 0.0f;
+    uint32_t samples = 0;  // Samples in the last window
+};
+static StageStats gStageStats[STAGE_COUNT];  // UI thread, refreshed by updateProfileStats()
 
-    // Resize magnitudes vector
-    magnitudes.resize(getNumFrequencies(), 0.0f);
+static std::atomic<uint32_t> gAudioUnderruns{0};    // paOutputUnderflow seen by the audio callback
+static std::atomic<uint32_t> gCaptureOverflows{0};  // paInputOverflow seen by the capture callback
 
-    // Rebuild frequency mapping if audio is loaded
-    if (!wavFile.audioData.empty()) {
-        buildFrequencyMapping();
+struct TraceEvent {
+    uint8_t stage;  // ProfileStage or PROFILE_EVENT_XRUN
+    uint64_t startNs;
+    uint64_t durNs;
+};
+static std::atomic<bool> gTraceRecording{false};
+static std::mutex gTraceMutex;
+static std::vector<TraceEvent> gTraceEvents;  // Guarded by gTraceMutex
+static std::string gLastTracePath;            // UI thread
+
+static uint64_t profileNowNs() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+static void profileHistogramAdd(ProfileStage stage, uint64_t durNs) {
+    int bucket = durNs > 1 ? (int)(std::log2((double)durNs) * 4.0) : 0;
+    bucket = std::min(bucket, PROFILE_BUCKETS - 1);
+    gStageHistograms[stage].counts[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+static void profileTrace(uint8_t stage, uint64_t startNs, uint64_t durNs) {
+    if (!gTraceRecording.load(std::memory_order_relaxed)) return;
+    std::lock_guard<std::mutex> lock(gTraceMutex);
+    if (gTraceEvents.size() < PROFILE_TRACE_MAX_EVENTS) {
+        gTraceEvents.push_back({ stage, startNs, durNs });
     }
 }
 
-// Load and set window icon from PNG file
-void setWindowIcon(GLFWwindow* window, const char* iconPath) {
-    int width, height, channels;
-    unsigned char* pixels = stbi_load(iconPath, &width, &height, &channels, 4);
+static void profileRecord(ProfileStage stage, uint64_t startNs, uint64_t endNs) {
+    uint64_t durNs = endNs > startNs ? endNs - startNs : 0;
+    profileHistogramAdd(stage, durNs);
+    profileTrace((uint8_t)stage, startNs, durNs);
+}
 
-    if (pixels) {
-        GLFWimage icon;
-        icon.width = width;
-        icon.height = height;
-        icon.pixels = pixels;
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(ProfileStage stage) : stage(stage), start(profileNowNs()) {}
+    ~ScopedStageTimer() { profileRecord(stage, start, profileNowNs()); }
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+private:
+    ProfileStage stage;
+    uint64_t start;
+};
 
-        glfwSetWindowIcon(window, 1, &icon);
+// Drain every histogram and turn the last window into percentiles. Each bucket
+// reports its geometric centre, so values are within ~9% of the true figure.
+static void updateProfileStats() {
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        uint32_t counts[PROFILE_BUCKETS];
+        uint64_t total = 0;
+        for (int b = 0; b < PROFILE_BUCKETS; ++b) {
+            counts[b] = gStageHistograms[s].counts[b].exchange(0, std::memory_order_relaxed);
+            total += counts[b];
+        }
+        StageStats& stats = gStageStats[s];
+        stats.samples = (uint32_t)total;
+        if (total == 0) continue;  // Keep the last figures for idle stages
+
+        const uint64_t p50Rank = (total + 1) / 2;
+        const uint64_t p99Rank = std::max<uint64_t>(1, (total * 99 + 99) / 100);
+        uint64_t seen = 0;
+        bool have50 = false;
+        for (int b = 0; b < PROFILE_BUCKETS; ++b) {
+            seen += counts[b];
+            float ms = (float)(std::exp2((b + 0.5) / 4.0) * 1e-6);
+            if (!have50 && seen >= p50Rank) {
+                stats.p50Ms = ms;
+                have50 = true;
+            }
+            if (seen >= p99Rank) {
+                stats.p99Ms = ms;
+                break;
+            }
+        }
+    }
+}
 
-        stbi_image_free(pixels);
-        std::cout << "Window icon loaded successfully: " << iconPath << "\n";
-    } else {
-        std::cerr << "Failed to load window icon: " << iconPath << "\n";
+// Write the recorded events as Chrome trace JSON ("X" complete events, microseconds)
+static bool writeChromeTrace(const std::string& path, const std::vector<TraceEvent>& events) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error: could not write trace to " << path << "\n";
+        return false;
+    }
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"UI\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Analysis\"}}";
+    char buf[192];
+    for (const TraceEvent& e : events) {
+        if (e.stage == PROFILE_EVENT_XRUN) {
+            snprintf(buf, sizeof(buf),
+                     ",\n{\"name\":\"Audio xrun\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}",
+                     e.startNs * 1e-3);
+        } else {
+            snprintf(buf, sizeof(buf),
+                     ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+                     profileStageNames[e.stage], e.startNs * 1e-3, e.durNs * 1e-3,
+                     (int)profileStageThread[e.stage]);
+        }
+        out << buf;
     }
+    out << "\n]}\n";
+    return (bool)out;
 }
 
-static constexpr int MAX_HISTORY_LINES = 560;  // Maximum allowed lines
-std::vector<float> lineHistory(MAX_HISTORY_LINES * NUM_BARS, 0.0f);
-std::vector<float> currentLine(NUM_BARS, 0.0f);
-static int historyFillCount = 0;  // Track how many lines have been pushed to history
+// Mark any new playback underruns or capture overflows in the trace (UI thread, once a frame)
+static void noteAudioXruns() {
+    static uint32_t seen = 0;
+    uint32_t xruns = gAudioUnderruns.load(std::memory_order_relaxed) +
+                     gCaptureOverflows.load(std::memory_order_relaxed);
+    if (xruns != seen) {
+        profileTrace(PROFILE_EVENT_XRUN, profileNowNs(), 0);
+        seen = xruns;
+    }
+}
 
-static std::vector<float> gBarBinF(NUM_BARS, 0.0f);
+static void startTraceRecording() {
+    {
+        std::lock_guard<std::mutex> lock(gTraceMutex);
+        gTraceEvents.clear();
+        gTraceEvents.reserve(1u << 16);
+    }
+    gTraceRecording.store(true, std::memory_order_relaxed);
+}
+
+static void stopTraceRecording() {
+    gTraceRecording.store(false, std::memory_order_relaxed);
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(gTraceMutex);
+        events.swap(gTraceEvents);
+    }
+    std::string path = "spectrogram_trace_" + std::to_string((long long)std::time(nullptr)) + ".json";
+    if (writeChromeTrace(path, events)) {
+        gLastTracePath = path;
+        std::cout << "Wrote " << events.size() << " trace events to " << path << "\n";
+    }
+}
+
+// GL_TIME_ELAPSED queries around the view draw. Results are collected from a
+// small ring a few frames later so the CPU never waits on the GPU.
+static constexpr int GPU_TIMER_QUERIES = 4;
+static GLuint gGpuTimerQueries[GPU_TIMER_QUERIES] = {};
+static bool gGpuTimerPending[GPU_TIMER_QUERIES] = {};
+static int gGpuTimerIndex = 0;
+static bool gGpuTimerActive = false;
+static bool gGpuTimerSupported = false;  // Set after glewInit()
+
+static void beginGpuTimer() {
+    if (!gGpuTimerSupported) return;
+    if (!gGpuTimerQueries[0]) glGenQueries(GPU_TIMER_QUERIES, gGpuTimerQueries);
+    GLuint query = gGpuTimerQueries[gGpuTimerIndex];
+    if (gGpuTimerPending[gGpuTimerIndex]) {
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) return;  // GPU more than a ring behind; skip this frame
+        GLuint64 elapsedNs = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsedNs);
+        profileHistogramAdd(STAGE_GPU_VIEW, (uint64_t)elapsedNs);
+        gGpuTimerPending[gGpuTimerIndex] = false;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    gGpuTimerActive = true;
+}
+
+static void endGpuTimer() {
+    if (!gGpuTimerActive) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    gGpuTimerPending[gGpuTimerIndex] = true;
+    gGpuTimerIndex = (gGpuTimerIndex + 1) % GPU_TIMER_QUERIES;
+    gGpuTimerActive = false;
+}
+
+static void destroyGpuTimers() {
+    if (gGpuTimerQueries[0]) glDeleteQueries(GPU_TIMER_QUERIES, gGpuTimerQueries);
+    for (int i = 0; i < GPU_TIMER_QUERIES; ++i) {
+        gGpuTimerQueries[i] = 0;
+        gGpuTimerPending[i] = false;
+    }
+}
+
+// ===================== Analysis Window =====================
+// The window is tabulated once per (FFT size, window type) instead of being
+// evaluated with std::cos for every sample of every frame. The tables come from
+// the engine library, so engines and the viewer window identically.
+enum WindowType {
+    WINDOW_HANN = SPECTROGRAM_WINDOW_HANN,
+    WINDOW_BLACKMAN_HARRIS = SPECTROGRAM_WINDOW_BLACKMAN_HARRIS,
+    WINDOW_KAISER = SPECTROGRAM_WINDOW_KAISER,
+    WINDOW_COUNT
+};
+static const char* windowTypeNames[WINDOW_COUNT] = { "Hann", "Blackman-Harris", "Kaiser (beta 8)" };
+
+static int windowType = WINDOW_HANN;    // Selected in the GUI; table rebuilt on change
+static std::vector<float> fftWindow;    // fftPlanSize coefficients
+static float fftWindowScale = 0.0f;     // Magnitude normalisation for the current window
+
+// Caller must hold gAnalysisMutex (or be the only thread running)
+static void buildWindowTable(int n) {
+    // Normalised by the window's coherent gain so a sinusoid reads the same level
+    // whichever window is selected (identical to the old 1/N scaling for Hann)
+    fftWindowScale = spectrogramWindowScale(spectrogramTabulateWindow(windowType, n, fftWindow));
+}
+
+// Switch window type from the GUI thread
+static void setWindowType(int type) {
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+    windowType = type;
+    buildWindowTable(fftPlanSize);
+}
+
+// ===================== FFT Plan Cache =====================
+// One plan (with its own aligned buffers) per supported FFT size. Every size
+// gets a cheap FFTW_ESTIMATE plan at startup so switching is just a pointer
+// swap; a background planner then replaces each with a plan made at the
+// requested effort (fast when fftwf_wisdom.dat already has it) and saves the
+// accumulated wisdom once it is done.
+static const int kFFTSizes[] = { 512, 1024, 2048, 4096, 8192, 16384 };
+static constexpr int NUM_FFT_SIZES = (int)(sizeof(kFFTSizes) / sizeof(kFFTSizes[0]));
+static const char* FFT_WISDOM_FILE = "fftwf_wisdom.dat";
+
+struct FFTPlanEntry {
+    int size = 0;
+    fftwf_plan plan = nullptr;
+    float* input = nullptr;
+    fftwf_complex* output = nullptr;
+    bool optimized = false;  // Planned at planEffortFlags (vs. the startup estimate)
+};
+
+static FFTPlanEntry fftPlanCache[NUM_FFT_SIZES];  // Guarded by gAnalysisMutex
+static unsigned planEffortFlags = FFTW_MEASURE;    // --plan-effort
+static std::mutex& gPlannerMutex = spectrogramPlannerMutex();  // FFTW's planner is not thread-safe; shared with the engines
+static std::thread gPlannerThread;
+static std::atomic<bool> gPlannerCancel{false};
+static std::atomic<int> gPlansOptimized{0};
+
+static int fftSizeSlot(int size) {
+    for (int i = 0; i < NUM_FFT_SIZES; i++) {
+        if (kFFTSizes[i] == size) return i;
+    }
+    return -1;
+}
+
+// Caller must hold gPlannerMutex
+static FFTPlanEntry createFFTPlan(int size, unsigned flags) {
+    FFTPlanEntry e;
+    e.size = size;
+    e.input = (float*)fftwf_malloc(sizeof(float) * size);
+    e.output = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * (size / 2 + 1));
+    e.plan = fftwf_plan_dft_r2c_1d(size, e.input, e.output, flags);
+    return e;
+}
+
+// Caller must hold gPlannerMutex
+static void destroyFFTPlan(FFTPlanEntry& e) {
+    if (e.plan) fftwf_destroy_plan(e.plan);
+    if (e.input) fftwf_free(e.input);
+    if (e.output) fftwf_free(e.output);
+    e = FFTPlanEntry();
+}
+
+// Point the analysis globals at the cached plan for 'size'.
+// Caller must hold gAnalysisMutex.
+static void selectCachedPlan(int size) {
+    int slot = fftSizeSlot(size);
+    if (slot < 0 || !fftPlanCache[slot].plan) return;
+    fftPlan = fftPlanCache[slot].plan;
+    fftInput = fftPlanCache[slot].input;
+    fftOutput = fftPlanCache[slot].output;
+    fftPlanSize = size;
+}
+
+static bool parsePlanEffort(const std::string& name) {
+    if (name == "estimate") planEffortFlags = FFTW_ESTIMATE;
+    else if (name == "measure") planEffortFlags = FFTW_MEASURE;
+    else if (name == "patient") planEffortFlags = FFTW_PATIENT;
+    else if (name == "exhaustive") planEffortFlags = FFTW_EXHAUSTIVE;
+    else return false;
+    return true;
+}
+
+static void plannerThreadMain() {
+    // Current size first so it upgrades soonest
+    int order[NUM_FFT_SIZES];
+    int count = 0;
+    int current = fftSizeSlot(FFT_SIZE);
+    if (current >= 0) order[count++] = current;
+    for (int i = 0; i < NUM_FFT_SIZES; i++) {
+        if (i != current) order[count++] = i;
+    }
+
+    for (int k = 0; k < count && !gPlannerCancel.load(std::memory_order_acquire); k++) {
+        const int slot = order[k];
+        FFTPlanEntry fresh;
+        {
+            std::lock_guard<std::mutex> plannerLock(gPlannerMutex);
+            fresh = createFFTPlan(kFFTSizes[slot], planEffortFlags);
+        }
+        if (!fresh.plan) {
+            std::lock_guard<std::mutex> plannerLock(gPlannerMutex);
+            destroyFFTPlan(fresh);
+            continue;
+        }
+        fresh.optimized = true;
+
+        // Swap in; the analysis thread only touches plans under gAnalysisMutex
+        FFTPlanEntry old;
+        {
+            std::lock_guard<std::mutex> lock(gAnalysisMutex);
+            old = fftPlanCache[slot];
+            fftPlanCache[slot] = fresh;
+            if (fftPlanSize == fresh.size) selectCachedPlan(fresh.size);
+        }
+        {
+            std::lock_guard<std::mutex> plannerLock(gPlannerMutex);
+            destroyFFTPlan(old);
+        }
+        gPlansOptimized.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> plannerLock(gPlannerMutex);
+    if (!fftwf_export_wisdom_to_filename(FFT_WISDOM_FILE)) {
+        std::cerr << "Error: Could not save FFTW wisdom to " << FFT_WISDOM_FILE << "\n";
+    }
+}
+
+// Load wisdom, estimate-plan every size and start the background planner
+static void initFFTPlanCache() {
+    {
+        std::lock_guard<std::mutex> plannerLock(gPlannerMutex);
+        fftwf_import_wisdom_from_filename(FFT_WISDOM_FILE);
+        for (int i = 0; i < NUM_FFT_SIZES; i++) {
+            // Use measured wisdom straight away when it exists for this size
+            FFTPlanEntry e = createFFTPlan(kFFTSizes[i], planEffortFlags | FFTW_WISDOM_ONLY);
+            if (e.plan) {
+                e.optimized = true;
+            } else {
+                destroyFFTPlan(e);
+                e = createFFTPlan(kFFTSizes[i], FFTW_ESTIMATE);
+            }
+            fftPlanCache[i] = e;
+        }
+    }
+
+    int alreadyOptimized = 0;
+    for (int i = 0; i < NUM_FFT_SIZES; i++) {
+        if (fftPlanCache[i].optimized) alreadyOptimized++;
+    }
+    if (alreadyOptimized == NUM_FFT_SIZES || planEffortFlags == FFTW_ESTIMATE) {
+        gPlansOptimized.store(NUM_FFT_SIZES, std::memory_order_relaxed);
+        return;
+    }
+
+    gPlannerCancel.store(false, std::memory_order_release);
+    gPlannerThread = std::thread(plannerThreadMain);
+}
+
+// Block until the background planner is done (offline renders want the final plans)
+static void waitForFFTPlanner() {
+    if (gPlannerThread.joinable()) gPlannerThread.join();
+}
+
+static void destroyFFTPlanCache() {
+    gPlannerCancel.store(true, std::memory_order_release);
+    if (gPlannerThread.joinable()) gPlannerThread.join();
+
+    std::lock_guard<std::mutex> plannerLock(gPlannerMutex);
+    for (int i = 0; i < NUM_FFT_SIZES; i++) destroyFFTPlan(fftPlanCache[i]);
+    fftPlan = nullptr;
+    fftInput = nullptr;
+    fftOutput = nullptr;
+}
+
+// ===================== Channel Analysis =====================
+// Instead of analysing only the mono downmix, every channel of the file (or the
+// mid/side pair of a stereo file) can be analysed. Each hop gathers one window
+// per channel into a planar block and runs a single batched FFTW plan over all
+// of them, so N channels cost N transforms but still one lock, one queue slot
+// and one history push.
+enum ChannelMode { CHANNELS_MONO = 0, CHANNELS_SEPARATE, CHANNELS_MID_SIDE, CHANNEL_MODE_COUNT };
+static const char* channelModeNames[CHANNEL_MODE_COUNT] = { "Mono downmix", "Per channel", "Mid / Side" };
+enum ChannelLayout { LAYOUT_STACKED = 0, LAYOUT_SIDE_BY_SIDE, LAYOUT_COUNT };
+static const char* channelLayoutNames[LAYOUT_COUNT] = { "Stacked", "Side by side" };
+static constexpr int MAX_ANALYSIS_CHANNELS = 8;
+static constexpr int MAX_COMPARE_FILES = 3;  // Files analysed next to the loaded one (see Compare Files)
+static constexpr int MAX_HISTORY_PLANES = MAX_ANALYSIS_CHANNELS + 1 + MAX_COMPARE_FILES;  // Plus zoom and compare
+
+static int channelMode = CHANNELS_MONO;      // Selected in the GUI
+static int channelLayout = LAYOUT_STACKED;   // How the channel views share the viewport
+static int gAnalysisChannels = 1;            // Lines analysed per hop; guarded by gAnalysisMutex
+static bool gAnalysisMidSide = false;        // Channels 0/1 are mid/side; guarded by gAnalysisMutex
+
+// One plan transforming gAnalysisChannels windows of fftPlanSize at once
+struct BatchPlan {
+    int size = 0;
+    int channels = 0;
+    fftwf_plan plan = nullptr;
+    float* input = nullptr;           // 'channels' planes of 'size' samples
+    fftwf_complex* output = nullptr;  // 'channels' planes of size/2+1 bins
+};
+
+static BatchPlan gBatchPlan;                    // Guarded by gAnalysisMutex
+static std::vector<float> gChannelMagnitudes;   // gAnalysisChannels planes of fftPlanSize/2
+static std::vector<float> gChannelScratch;      // Window staging when no batch plan matches
+
+// Caller must hold gPlannerMutex
+static BatchPlan createBatchPlan(int size, int channels, unsigned flags) {
+    BatchPlan b;
+    b.size = size;
+    b.channels = channels;
+    const int bins = size / 2 + 1;
+    b.input = (float*)fftwf_malloc(sizeof(float) * (size_t)size * (size_t)channels);
+    b.output = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * (size_t)bins * (size_t)channels);
+    int n[1] = { size };
+    b.plan = fftwf_plan_many_dft_r2c(1, n, channels, b.input, nullptr, 1, size,
+                                     b.output, nullptr, 1, bins, flags);
+    return b;
+}
+
+// Caller must hold gPlannerMutex (or be the only thread using FFTW)
+static void destroyBatchPlan(BatchPlan& b) {
+    if (b.plan) fftwf_destroy_plan(b.plan);
+    if (b.input) fftwf_free(b.input);
+    if (b.output) fftwf_free(b.output);
+    b = BatchPlan();
+}
+
+// Channels the selected mode analyses for what is loaded (live input is mono)
+static int wantedAnalysisChannels() {
+    if (gCaptureActive.load(std::memory_order_relaxed) || wavFile->empty()) return 1;
+    const int ch = std::max<int>(1, wavFile->numChannels);
+    switch (channelMode) {
+        case CHANNELS_SEPARATE: return std::min(ch, MAX_ANALYSIS_CHANNELS);
+        case CHANNELS_MID_SIDE: return ch == 2 ? 2 : 1;
+        default: return 1;
+    }
+}
+
+static std::string channelLabel(int ch, int channels, bool midSide) {
+    if (midSide) return ch == 0 ? "Mid" : "Side";
+    if (channels == 2) return ch == 0 ? "L" : "R";
+    return "Ch " + std::to_string(ch + 1);
+}
+
+// Make gBatchPlan match the current FFT size and channel count. Called from the
+// UI thread every frame; while the background planner holds FFTW it just
+// retries next frame, and the analysis transforms channels one at a time.
+static void updateBatchPlan() {
+    int size = 0, channels = 0;
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        size = fftPlanSize;
+        channels = gAnalysisChannels;
+        if (channels < 2 || (gBatchPlan.size == size && gBatchPlan.channels == channels)) return;
+    }
+
+    std::unique_lock<std::mutex> plannerLock(gPlannerMutex, std::try_to_lock);
+    if (!plannerLock.owns_lock()) return;
+
+    BatchPlan fresh = createBatchPlan(size, channels, planEffortFlags | FFTW_WISDOM_ONLY);
+    if (!fresh.plan) {
+        destroyBatchPlan(fresh);
+        fresh = createBatchPlan(size, channels, FFTW_ESTIMATE);
+    }
+    if (!fresh.plan) {
+        destroyBatchPlan(fresh);
+        return;
+    }
+
+    BatchPlan old;
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        old = gBatchPlan;
+        gBatchPlan = fresh;
+    }
+    destroyBatchPlan(old);
+}
+
+// Forward declarations
+static void buildFrequencyMapping();
+static void selectAnalysisKernels(int fftSize, int bars);
+
+// Reinitialize FFT when size changes. Plans come from the cache, so this
+// never runs the FFTW planner.
+void reinitializeFFT() {
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+
+    selectCachedPlan(FFT_SIZE);
+    buildWindowTable(fftPlanSize);
+    selectAnalysisKernels(fftPlanSize, NUM_BARS);
+
+    // Resize magnitudes vector
+    magnitudes.resize(getNumFrequencies(), 0.0f);
+
+    // Rebuild frequency mapping if audio is loaded (or being captured)
+    if (!wavFile->empty() || gCaptureActive.load(std::memory_order_relaxed)) {
+        buildFrequencyMapping();
+    }
+}
+
+// Load and set window icon from PNG file
+void setWindowIcon(GLFWwindow* window, const char* iconPath) {
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(iconPath, &width, &height, &channels, 4);
+
+    if (pixels) {
+        GLFWimage icon;
+        icon.width = width;
+        icon.height = height;
+        icon.pixels = pixels;
+
+        glfwSetWindowIcon(window, 1, &icon);
+
+        stbi_image_free(pixels);
+        std::cout << "Window icon loaded successfully: " << iconPath << "\n";
+    } else {
+        std::cerr << "Failed to load window icon: " << iconPath << "\n";
+    }
+}
+
+static constexpr int MAX_HISTORY_LINES = 2048;  // Maximum allowed lines (ring capacity)
+// lineHistory is a circular buffer of MAX_HISTORY_LINES rows; historyHead is the
+// physical row holding the newest line. Use historyRow(age) to read it. With
+// multichannel analysis it holds one such ring per channel, one after another
+// (plane 0 first), all sharing historyHead.
+std::vector<float> lineHistory(MAX_HISTORY_LINES * NUM_BARS, 0.0f);
+std::vector<float> currentLine(NUM_BARS, 0.0f);  // Newest line of channel 0
+static int historyFillCount = 0;  // Track how many lines have been pushed to history
+static int historyHead = 0;
+static uint64_t historyPushCount = 0;  // Total lines pushed (lets the GPU mirror catch up)
+static int gHistoryChannels = 1;       // Planes in lineHistory (UI thread)
+
+// Row 'age' lines back from the newest (age 0 = newest) of channel 'ch'
+static inline const float* historyRow(int age, int ch = 0) {
+    int idx = historyHead - age;
+    if (idx < 0) idx += MAX_HISTORY_LINES;
+    return &lineHistory[((size_t)ch * MAX_HISTORY_LINES + (size_t)idx) * (size_t)NUM_BARS];
+}
+
+// Bar -> FFT bin lookup, precomputed by buildFrequencyMapping(). Bars below
+// gBarSplit are narrower than one bin and interpolate between two bins; bars
+// from gBarSplit up cover several bins and take the peak of their range.
+static std::vector<int32_t> gBarBin0(NUM_BARS, 0);    // Interpolated: lower bin / Aggregated: first bin
+static std::vector<int32_t> gBarBin1(NUM_BARS, 0);    // Aggregated: last bin (inclusive)
+static std::vector<float> gBarFrac(NUM_BARS, 0.0f);   // Interpolated: weight of bin0 + 1
+static int gBarSplit = 0;
+static int gMappingBins = 0;  // magnitudes.size() the tables were built for
 static std::vector<float> gBarX(NUM_BARS, 0.0f);
 static std::vector<float> gBarHue(NUM_BARS, 0.0f);
+static uint32_t gMappingVersion = 0;  // Bumped whenever buildFrequencyMapping() runs
 
-static int gLatencySamplesBase = 0;
+static std::atomic<int> gLatencySamplesBase{0};
 static int gLatencyAdjust = 0;
 
 // Camera
@@ -324,7 +1727,7 @@ enum ColormapType {
 
 static ColormapType currentColormap = COLORMAP_INFERNO;  // Default to Inferno
 
-static bool isPlaying = false;
+static std::atomic<bool> isPlaying{false};
 static bool isFullscreen = false;
 static char filePathBuffer[512] = "";
 static std::string loadedFileName = "";
@@ -335,6 +1738,7 @@ static bool showFPS = true;  // FPS counter visibility
 static bool loopAudio = true;  // Loop audio playback
 static float lineWidth = 1.0f;  // Line width control, default 1.0
 // Color controls - using pure colormaps with optimal distribution
+static float colormapGamma = 0.2f;  // Power curve before colormap lookup (0.2 pushes 50% signals to 87%)
 static float yScale = 1.20f;  // Y-axis height scale
 static float yOffset = 0.0f;  // Y-axis offset (raise/lower entire visualization), default 0.0
 static float volume = 1.0f;  // Volume control (0.0 to 1.0)
@@ -372,6 +1776,9 @@ static int frameCount = 0;
 static float currentFPS = 0.0f;
 static float currentCPU = 0.0f;
 static bool showCPU = true;  // Show CPU usage
+static float currentRSSMB = 0.0f;  // Resident memory, refreshed with the CPU figure
+static bool showProfiler = false;  // Per-stage p50/p99 timings in the stats overlay
+static double lastProfileTime = 0.0;
 static bool showMetadata = true;  // Show metadata overlay
 static bool showWaveform = true;  // Show waveform display
 static bool needsRedraw = true;  // Track if need to redraw
@@ -754,38 +2161,102 @@ static void loadRecentFiles() {
     }
 }
 
-static void setPerspective(float fovyDeg, float aspect, float zNear, float zFar) {
+// Column-major 4x4 matrix (OpenGL convention), used to feed both the fixed-function
+// pipeline (glLoadMatrixf) and shader uniforms with the same transform
+struct Mat4 {
+    float m[16];
+};
+
+static Mat4 mat4Identity() {
+    Mat4 r;
+    for (int i = 0; i < 16; i++) r.m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    return r;
+}
+
+static Mat4 mat4Multiply(const Mat4& a, const Mat4& b) {
+    Mat4 r;
+    for (int col = 0; col < 4; col++) {
+        for (int row = 0; row < 4; row++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) sum += a.m[k * 4 + row] * b.m[col * 4 + k];
+            r.m[col * 4 + row] = sum;
+        }
+    }
+    return r;
+}
+
+static Mat4 mat4Translate(float x, float y, float z) {
+    Mat4 r = mat4Identity();
+    r.m[12] = x; r.m[13] = y; r.m[14] = z;
+    return r;
+}
+
+// Same as glRotatef: angle in degrees around a unit axis
+static Mat4 mat4Rotate(float angleDeg, float x, float y, float z) {
+    float a = angleDeg * (float)M_PI / 180.0f;
+    float c = std::cos(a), s = std::sin(a), ic = 1.0f - c;
+    Mat4 r = mat4Identity();
+    r.m[0] = x * x * ic + c;     r.m[4] = x * y * ic - z * s; r.m[8]  = x * z * ic + y * s;
+    r.m[1] = y * x * ic + z * s; r.m[5] = y * y * ic + c;     r.m[9]  = y * z * ic - x * s;
+    r.m[2] = x * z * ic - y * s; r.m[6] = y * z * ic + x * s; r.m[10] = z * z * ic + c;
+    return r;
+}
+
+// Same as glFrustum with a symmetric field of view
+static Mat4 perspectiveMatrix(float fovyDeg, float aspect, float zNear, float zFar) {
     float fovyRad = fovyDeg * (float)M_PI / 180.0f;
     float top = zNear * std::tan(fovyRad * 0.5f);
-    float bottom = -top;
     float right = top * aspect;
-    float left = -right;
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glFrustum(left, right, bottom, top, zNear, zFar);
+    Mat4 r;
+    for (int i = 0; i < 16; i++) r.m[i] = 0.0f;
+    r.m[0] = zNear / right;
+    r.m[5] = zNear / top;
+    r.m[10] = -(zFar + zNear) / (zFar - zNear);
+    r.m[11] = -1.0f;
+    r.m[14] = -2.0f * zFar * zNear / (zFar - zNear);
+    return r;
 }
 
 static void buildFrequencyMapping() {
-    const float sr = (float)wavFile.sampleRate;
-    const float maxFreq = sr * 0.5f;
-    const float minF = std::max(MIN_FREQ, 1.0f);
-    const float maxF = std::max(minF * 1.001f, maxFreq);
-    const float ratio = maxF / minF;
-
+    gBarSplit = spectrogramBuildBarTables(NUM_BARS, (float)analysisSampleRate(), fftPlanSize, MIN_FREQ,
+                                          gBarBin0.data(), gBarBin1.data(), gBarFrac.data());
     for (int i = 0; i < NUM_BARS; i++) {
-        float t = (NUM_BARS == 1) ? 0.0f : (float)i / (float)(NUM_BARS - 1);
-        float freq = minF * std::pow(ratio, t);
-        float binF = freq * (float)FFT_SIZE / sr;
-        binF = std::max(1.0f, std::min(binF, (float)(getNumFrequencies() - 2)));
-
-        gBarBinF[i] = binF;
+        const float t = (NUM_BARS == 1) ? 0.0f : (float)i / (float)(NUM_BARS - 1);
         gBarX[i] = (-X_SPAN * 0.5f) + t * X_SPAN;
         gBarHue[i] = t * 0.66f;
     }
+    gMappingBins = fftPlanSize / 2;
+    gMappingVersion++;
 }
 
 // ===================== Audio Callback =====================
+// File changes reach the callback through one atomic pointer. The callback
+// publishes the tracks it may still be reading in two hazard slots (current and
+// fading-out), and the UI thread only frees a replaced track once neither slot
+// holds it, so the callback never locks, allocates or sees a half-built file.
+// A switch while playing crossfades from the old track into the new one.
+static constexpr int CROSSFADE_FRAMES = 2048;  // ~45 ms at 44.1 kHz
+
+static std::atomic<WAVFile*> gPlaybackTrack{nullptr};  // Published by the UI thread
+static std::atomic<WAVFile*> gHazardCurrent{nullptr};  // Track the callback plays
+static std::atomic<WAVFile*> gHazardFading{nullptr};   // Track the callback fades out
+
+// Callback-owned state; the UI thread touches it only while the stream is stopped
+static WAVFile* cbTrack = nullptr;
+static WAVFile* cbFading = nullptr;
+static uint64_t cbFadingPos = 0;
+static int cbFadeRemaining = 0;
+
+// Adopt the published track without a crossfade (stream must not be running)
+static void syncCallbackTrack() {
+    cbTrack = gPlaybackTrack.load();
+    cbFading = nullptr;
+    cbFadeRemaining = 0;
+    gHazardCurrent.store(cbTrack);
+    gHazardFading.store(nullptr);
+}
+
 static int audioCallback(const void* inputBuffer, void* outputBuffer,
                          unsigned long framesPerBuffer,
                          const PaStreamCallbackTimeInfo* timeInfo,
@@ -793,627 +2264,6512 @@ static int audioCallback(const void* inputBuffer, void* outputBuffer,
                          void* userData) {
 
     float* out = (float*)outputBuffer;
+    if (statusFlags & paOutputUnderflow) gAudioUnderruns.fetch_add(1, std::memory_order_relaxed);
     const bool paused = isPaused.load(std::memory_order_relaxed);
 
     uint64_t pos = playbackPosition.load(std::memory_order_relaxed);
-    const size_t N = wavFile.audioData.size();
     const int outCh = std::max(1, gOutputChannels);
 
-    for (unsigned long i = 0; i < framesPerBuffer; i++) {
-        if (paused || N == 0) {
-            for (int ch = 0; ch < outCh; ch++) out[i * outCh + ch] = 0.0f;
-            continue;
+    // New track published: keep the outgoing one alive for the fade, then
+    // protect the new one (re-check so it cannot have been retired meanwhile)
+    if (gPlaybackTrack.load() != cbTrack) {
+        cbFading = cbTrack;
+        gHazardFading.store(cbFading);
+        cbFadingPos = pos;
+        cbFadeRemaining = cbFading ? CROSSFADE_FRAMES : 0;
+
+        WAVFile* latest;
+        do {
+            latest = gPlaybackTrack.load();
+            gHazardCurrent.store(latest);
+        } while (gPlaybackTrack.load() != latest);
+        cbTrack = latest;
+        pos = 0;
+    }
+
+    const uint64_t N = cbTrack ? cbTrack->totalFrames : 0;
+    if (paused || N == 0) {
+        std::fill(out, out + framesPerBuffer * (unsigned long)outCh, 0.0f);
+        playbackPosition.store(pos, std::memory_order_relaxed);
+        return paContinue;
+    }
+
+    // Pull contiguous runs from the source; a run ends at EOF (loop or silence)
+    float block[FRAMES_PER_BUFFER];
+    float fadeBlock[FRAMES_PER_BUFFER];
+    unsigned long i = 0;
+    while (i < framesPerBuffer) {
+        if (pos >= N) {
+            if (!loopAudio) {
+                std::fill(out + i * (unsigned long)outCh, out + framesPerBuffer * (unsigned long)outCh, 0.0f);
+                break;
+            }
+            pos = 0;
         }
 
-        if (pos < N) {
-            float s = wavFile.audioData[(size_t)pos] * volume; // ONE mono sample
-            for (int ch = 0; ch < outCh; ch++) out[i * outCh + ch] = s;
-            pos += 1; // IMPORTANT: advance by 1 sample per frame
-        } else {
-            if (loopAudio) {
-                pos = 0;
-                float s = wavFile.audioData[0] * volume;
-                for (int ch = 0; ch < outCh; ch++) out[i * outCh + ch] = s;
-                pos += 1;
-            } else {
-                for (int ch = 0; ch < outCh; ch++) out[i * outCh + ch] = 0.0f;
+        unsigned long run = std::min<unsigned long>(framesPerBuffer - i, FRAMES_PER_BUFFER);
+        run = (unsigned long)std::min<uint64_t>(run, N - pos);
+        cbTrack->read(pos, block, run); // MONO samples
+
+        // Equal-gain crossfade from the previous track
+        if (cbFadeRemaining > 0) {
+            const unsigned long fadeRun = std::min<unsigned long>(run, (unsigned long)cbFadeRemaining);
+            cbFading->read(cbFadingPos, fadeBlock, fadeRun);
+            for (unsigned long k = 0; k < fadeRun; k++) {
+                float g = 1.0f - (float)(cbFadeRemaining - (int)k) / (float)CROSSFADE_FRAMES;
+                block[k] = block[k] * g + fadeBlock[k] * (1.0f - g);
             }
+            cbFadingPos += fadeRun;
+            cbFadeRemaining -= (int)fadeRun;
+            if (cbFadeRemaining == 0) {
+                cbFading = nullptr;
+                gHazardFading.store(nullptr);
+            }
+        }
+
+        for (unsigned long k = 0; k < run; k++) {
+            float s = block[k] * volume;
+            for (int ch = 0; ch < outCh; ch++) out[(i + k) * outCh + ch] = s;
         }
+        pos += run; // IMPORTANT: advance by 1 sample per frame
+        i += run;
     }
 
     playbackPosition.store(pos, std::memory_order_relaxed);
+    cbTrack->prefetch(pos);
     return paContinue;
 }
 
-// ===================== FFT Processing =====================
-static void processAudioFrameSynced() {
-    if (wavFile.audioData.empty()) return;
-
-    int64_t writeHead = (int64_t)playbackPosition.load(std::memory_order_relaxed);
-    int64_t latencySamples = (int64_t)(gLatencySamplesBase + gLatencyAdjust);
+// ===================== Live Input =====================
+// An input-only PortAudio stream downmixes each buffer into a lock-free SPSC
+// ring indexed by absolute frame number; the analysis thread reads windows that
+// end at the newest captured frame. Capture-to-display latency is measured
+// from the device's ADC timestamps and the frame each displayed line ends at.
+class CaptureRing {
+public:
+    void init(size_t capacityPow2) {
+        buffer.assign(capacityPow2, 0.0f);
+        mask = capacityPow2 - 1;
+        writePos.store(0, std::memory_order_relaxed);
+    }
 
-    // CRITICAL FIX: The FFT window analyzes audio from playHead to playHead+FFT_SIZE
-    // The frequency content represents the CENTER of this window, not the end
-    // So it needs to shift back by half the FFT window to sync with audio
-    int64_t fftWindowCenter = FFT_SIZE / 2;
-    int64_t playHeadEstimate = writeHead - latencySamples - fftWindowCenter;
+    // Producer (input callback): append 'frames' interleaved frames as mono
+    void write(const float* in, unsigned long frames, int channels) {
+        uint64_t w = writePos.load(std::memory_order_relaxed);
+        const float invCh = 1.0f / (float)channels;
+        for (unsigned long i = 0; i < frames; i++) {
+            float sum = 0.0f;
+            if (in) {
+                for (int ch = 0; ch < channels; ch++) sum += in[i * (unsigned long)channels + (unsigned long)ch];
+            }
+            buffer[(size_t)((w + i) & mask)] = sum * invCh;
+        }
+        writePos.store(w + frames, std::memory_order_release);
+    }
 
-    const size_t N = wavFile.audioData.size();
+    uint64_t written() const { return writePos.load(std::memory_order_acquire); }
 
-    if (N < (size_t)FFT_SIZE) {
-        for (int i = 0; i < FFT_SIZE; i++) fftInput[i] = 0.0;
-        for (size_t i = 0; i < N; i++) {
-            double w = 0.5 * (1.0 - std::cos(2.0 * M_PI * (double)i / (FFT_SIZE - 1)));
-            fftInput[i] = (double)wavFile.audioData[i] * w;
-        }
-    } else {
-        size_t start = wrapIndex(playHeadEstimate, N);
-        for (int i = 0; i < FFT_SIZE; i++) {
-            double w = 0.5 * (1.0 - std::cos(2.0 * M_PI * i / (FFT_SIZE - 1)));
-            size_t idx = (start + (size_t)i) % N;
-            fftInput[i] = (double)wavFile.audioData[idx] * w;
+    // Consumer: frames [pos, pos + count); zero where not captured yet or overwritten
+    void read(int64_t pos, float* dst, size_t count) const {
+        const int64_t w0 = (int64_t)written();
+        const int64_t cap = (int64_t)buffer.size();
+        for (size_t i = 0; i < count; i++) {
+            const int64_t f = pos + (int64_t)i;
+            dst[i] = (f >= 0 && f < w0 && f >= w0 - cap) ? buffer[(size_t)((uint64_t)f & mask)] : 0.0f;
         }
+        // Anything the producer lapped while copying is stale
+        const int64_t oldest = (int64_t)written() - cap;
+        for (size_t i = 0; i < count && pos + (int64_t)i < oldest; i++) dst[i] = 0.0f;
     }
 
-    fftw_execute(fftPlan);
+private:
+    std::vector<float> buffer;
+    uint64_t mask = 0;
+    std::atomic<uint64_t> writePos{0};
+};
 
-    for (int i = 0; i < getNumFrequencies(); i++) {
-        double re = fftOutput[i][0];
-        double im = fftOutput[i][1];
-        magnitudes[i] = (float)(std::sqrt(re * re + im * im) / FFT_SIZE);
+static constexpr size_t CAPTURE_RING_FRAMES = 1u << 17;  // ~2.7 s at 48 kHz
+
+static CaptureRing gCaptureRing;
+static PaStream* captureStream = nullptr;
+static int gCaptureChannels = 1;
+static int captureDevice = -1;             // PortAudio device index, -1 = default input
+static int captureBufferFrames = 256;
+static std::atomic<double> gCaptureAdcTime{0.0};    // ADC time of frame gCaptureAdcFrame
+static std::atomic<uint64_t> gCaptureAdcFrame{0};
+static float measuredCaptureLatencyMs = 0.0f;       // Smoothed capture -> display latency
+
+static int captureCallback(const void* inputBuffer, void* outputBuffer,
+                           unsigned long framesPerBuffer,
+                           const PaStreamCallbackTimeInfo* timeInfo,
+                           PaStreamCallbackFlags statusFlags,
+                           void* userData) {
+    const uint64_t first = gCaptureRing.written();
+    if (statusFlags & paInputOverflow) gCaptureOverflows.fetch_add(1, std::memory_order_relaxed);
+    if (timeInfo) {
+        gCaptureAdcFrame.store(first, std::memory_order_relaxed);
+        gCaptureAdcTime.store(timeInfo->inputBufferAdcTime, std::memory_order_relaxed);
     }
+    // A null buffer (dropout) still advances time with silence
+    gCaptureRing.write((const float*)inputBuffer, framesPerBuffer, gCaptureChannels);
+    return paContinue;
 }
 
-static void buildCurrentLine() {
-    const float logDen = std::log10(1.0f + MAG_GAIN);
+// Record how long ago the newest frame of the line just shown was captured
+static void noteCaptureLineDisplayed(uint64_t lastFrame) {
+    if (!captureStream) return;
+    const double adcFrameTime = gCaptureAdcTime.load(std::memory_order_relaxed) +
+        ((double)lastFrame - (double)gCaptureAdcFrame.load(std::memory_order_relaxed)) / (double)gCaptureSampleRate;
+    const float ms = (float)((Pa_GetStreamTime(captureStream) - adcFrameTime) * 1000.0);
+    if (ms < 0.0f || ms > 5000.0f) return;  // Clock not settled yet
+    measuredCaptureLatencyMs = measuredCaptureLatencyMs > 0.0f ? measuredCaptureLatencyMs * 0.9f + ms * 0.1f : ms;
+}
 
-    for (int i = 0; i < NUM_BARS; i++) {
-        float binF = gBarBinF[i];
-        int bin0 = (int)std::floor(binF);
-        float frac = binF - (float)bin0;
+// ===================== FFT Processing =====================
+// ---- Kernels ----
+// The passes around the FFT (window, magnitudes, log compression) come from
+// the engine library: one set per instruction set, specialised for every FFT
+// size the UI offers and the common bar counts (see spectrogram_engine.cpp).
+// selectAnalysisKernels() picks the set once per reinitializeFFT() and the
+// callers below go through the chosen pointers.
+typedef void (*WindowKernel)(float*, const float*, int);
+typedef void (*MagnitudeKernel)(const float*, float*, int, float);
+typedef void (*CompressKernel)(float*, int, float);
+
+static const SpectrogramKernels kAnySizeKernels = spectrogramSelectKernels(0, 0);  // Until the first selection
+static std::atomic<WindowKernel> gWindowKernel{kAnySizeKernels.window};
+static std::atomic<MagnitudeKernel> gMagnitudeKernel{kAnySizeKernels.magnitudes};
+static std::atomic<CompressKernel> gCompressKernel{kAnySizeKernels.compress};
+static const char* gKernelIsaName = kAnySizeKernels.isa;  // For the profiler overlay and bench JSON
+static bool gKernelsSpecialized = false;                   // Both size and bar count have fixed-count instances
+
+static inline void applyWindow(float* x, const float* w, int n) {
+    gWindowKernel.load(std::memory_order_relaxed)(x, w, n);
+}
 
-        bin0 = std::max(0, std::min(getNumFrequencies() - 2, bin0));
-        int bin1 = bin0 + 1;
+static inline void computeMagnitudes(const fftwf_complex* in, float* out, int count, float scale) {
+    gMagnitudeKernel.load(std::memory_order_relaxed)((const float*)in, out, count, scale);
+}
 
-        float m = magnitudes[bin0] * (1.0f - frac) + magnitudes[bin1] * frac;
-        float v = std::log10(1.0f + m * MAG_GAIN) / logDen;
-        currentLine[i] = clamp01(v);
-    }
+static inline void compressMagnitudes(float* v, int count, float gain) {
+    gCompressKernel.load(std::memory_order_relaxed)(v, count, gain);
+}
+
+// Point the kernels at the instances for this FFT size and bar count
+static void selectAnalysisKernels(int fftSize, int bars) {
+    const SpectrogramKernels k = spectrogramSelectKernels(fftSize, bars);
+    gWindowKernel.store(k.window, std::memory_order_relaxed);
+    gMagnitudeKernel.store(k.magnitudes, std::memory_order_relaxed);
+    gCompressKernel.store(k.compress, std::memory_order_relaxed);
+    gKernelIsaName = k.isa;
+    gKernelsSpecialized = k.specialized;
 }
 
-static void pushLineToHistory() {
-    std::memmove(&lineHistory[NUM_BARS], &lineHistory[0],
-                 sizeof(float) * (HISTORY_LINES - 1) * NUM_BARS);
-    std::memcpy(&lineHistory[0], &currentLine[0], sizeof(float) * NUM_BARS);
+// Window 'in' (fftPlanSize samples, fftwf_malloc-aligned) and write fftPlanSize/2
+// magnitudes. Uses the current plan with caller-owned buffers (new-array execute
+// is thread-safe), so concurrent workers can share it.
+static void transformWindow(float* in, fftwf_complex* out, float* mags) {
+    const int n = fftPlanSize;
+    applyWindow(in, fftWindow.data(), n);
+    fftwf_execute_dft_r2c(fftPlan, in, out);
+    computeMagnitudes(out, mags, n / 2, fftWindowScale);
+}
 
-    // Track how many lines have been filled (up to HISTORY_LINES)
-    if (historyFillCount < HISTORY_LINES) {
-        historyFillCount++;
+// Copy the n-frame window starting at 'start' (wrapping at the loop point) from
+// channel 'ch' of the file, or from the mono downmix when ch < 0
+static void readLoopedWindow(int ch, int64_t start, float* dst, int n) {
+    const uint64_t N = wavFile->totalFrames;
+    if (N < (uint64_t)n) {
+        std::fill(dst, dst + n, 0.0f);
+        if (ch < 0) wavFile->read(0, dst, (size_t)N);
+        else wavFile->readChannel(ch, 0, dst, (size_t)N);
+        return;
+    }
+
+    // One contiguous read, or two when the window wraps around the loop point
+    uint64_t first0 = wrapIndex(start, (size_t)N);
+    size_t first = (size_t)std::min<uint64_t>((uint64_t)n, N - first0);
+    if (ch < 0) {
+        wavFile->read(first0, dst, first);
+        if (first < (size_t)n) wavFile->read(0, dst + first, (size_t)n - first);
+    } else {
+        wavFile->readChannel(ch, first0, dst, first);
+        if (first < (size_t)n) wavFile->readChannel(ch, 0, dst + first, (size_t)n - first);
     }
 }
 
-// ===================== Rendering =====================
-static void render3DWaterfall(int vpX, int vpY, int vpW, int vpH) {
-    // CRITICAL: Disable blend first, ImGui might leave it on
-    glDisable(GL_BLEND);
-    glDisable(GL_SCISSOR_TEST);
+// Analyse gAnalysisChannels windows starting at 'start' into gChannelMagnitudes:
+// gathered straight into the batch plan's planar input and transformed with one
+// fftwf_execute, or one at a time through the single plan until a batch plan for
+// this size exists. Caller must hold gAnalysisMutex.
+static void transformChannels(int64_t start) {
+    const int n = fftPlanSize;
+    const int bins = n / 2;
+    const int channels = gAnalysisChannels;
+    const bool batched = gBatchPlan.plan && gBatchPlan.size == n && gBatchPlan.channels == channels;
+
+    if (!batched && gChannelScratch.size() < (size_t)n * (size_t)channels) {
+        gChannelScratch.resize((size_t)n * (size_t)channels);
+    }
+    if (gChannelMagnitudes.size() < (size_t)bins * (size_t)channels) {
+        gChannelMagnitudes.resize((size_t)bins * (size_t)channels);
+    }
+    float* planes = batched ? gBatchPlan.input : gChannelScratch.data();
+
+    for (int ch = 0; ch < channels; ch++) readLoopedWindow(ch, start, planes + (size_t)ch * (size_t)n, n);
+
+    if (gAnalysisMidSide) {
+        float* l = planes;
+        float* r = planes + n;
+        for (int i = 0; i < n; i++) {
+            const float mid = (l[i] + r[i]) * 0.5f;
+            const float side = (l[i] - r[i]) * 0.5f;
+            l[i] = mid;
+            r[i] = side;
+        }
+    }
 
-    // Viewport is already set and scissor enabled from main loop
-    glViewport(vpX, vpY, vpW, vpH);
+    if (batched) {
+        for (int ch = 0; ch < channels; ch++) applyWindow(planes + (size_t)ch * (size_t)n, fftWindow.data(), n);
+        fftwf_execute(gBatchPlan.plan);
+        for (int ch = 0; ch < channels; ch++) {
+            computeMagnitudes(gBatchPlan.output + (size_t)ch * (size_t)(bins + 1),
+                              &gChannelMagnitudes[(size_t)ch * (size_t)bins], bins, fftWindowScale);
+        }
+    } else {
+        for (int ch = 0; ch < channels; ch++) {
+            std::memcpy(fftInput, planes + (size_t)ch * (size_t)n, sizeof(float) * (size_t)n);
+            transformWindow(fftInput, fftOutput, &gChannelMagnitudes[(size_t)ch * (size_t)bins]);
+        }
+    }
+}
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LEQUAL);
-    glDisable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+// Forward declarations (see Multi-Rate Analysis and Sliding DFT)
+static bool processMultiRateFrame(int64_t writeHead);
+static bool buildMultiRateLine(float* out);
+static bool processSlidingFrame(int64_t start, bool capturing);
+static void noteFullTransform(uint64_t ns);
+
+// Full FFT of the mono window already in fftInput, timed for the Auto transform choice
+static void transformMonoWindow() {
+    const uint64_t t0 = profileNowNs();
+    transformWindow(fftInput, fftOutput, magnitudes.data());
+    noteFullTransform(profileNowNs() - t0);
+}
 
-    float aspect = (float)vpW / (float)vpH;
-    setPerspective(55.0f, aspect, 0.05f, 100.0f);
+// Analyse the window that is audible when the callback has written up to writeHead.
+// Returns how many channels were analysed (see buildCurrentLine).
+// Caller must hold gAnalysisMutex.
+static int processAudioFrameSynced(int64_t writeHead) {
+    if (!fftPlan) return 1;
+    const int n = fftPlanSize;
+
+    // Octave-band analysis of the mono signal replaces the single FFT
+    if (processMultiRateFrame(writeHead)) return 1;
+
+    // Live input: captured audio is already in the past, so the window simply
+    // ends at the newest captured frame
+    if (gCaptureActive.load(std::memory_order_relaxed)) {
+        if (processSlidingFrame(writeHead - n, true)) return 1;
+        gCaptureRing.read(writeHead - n, fftInput, (size_t)n);
+        transformMonoWindow();
+        return 1;
+    }
 
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    if (wavFile->empty()) return 1;
 
-    glTranslatef(0.0f, 0.0f, -gDist);
-    glRotatef(gPitch, 1.0f, 0.0f, 0.0f);
-    glRotatef(gYaw, 0.0f, 1.0f, 0.0f);
-    glTranslatef(0.0f, yOffset, 0.0f);  // Use variable Y offset
+    int64_t latencySamples = (int64_t)(gLatencySamplesBase + gLatencyAdjust);
 
-    // Draw grid if enabled
-    if (showGrid) {
-        const float gridSpanMul = 1.75f;
-        const int gridDivs = 12;
+    // CRITICAL FIX: The FFT window analyzes audio from playHead to playHead+FFT_SIZE
+    // The frequency content represents the CENTER of this window, not the end
+    // So it needs to shift back by half the FFT window to sync with audio
+    int64_t fftWindowCenter = n / 2;
+    int64_t playHeadEstimate = writeHead - latencySamples - fftWindowCenter;
 
-        const float gridX = X_SPAN * gridSpanMul;
-        const float gridZ = Z_SPAN * gridSpanMul;
+    if (gAnalysisChannels > 1) {
+        transformChannels(playHeadEstimate);
+        return gAnalysisChannels;
+    }
 
-        const float gridY = -0.5f;   // <--- LOWER the grid (more negative = lower)
+    // Small hops: slide the previous line's spectrum forward instead
+    if (processSlidingFrame(playHeadEstimate, false)) return 1;
 
-        glColor4f(0.10f, 0.10f, 0.12f, 1.0f);
-        glBegin(GL_LINES);
+    // Gather straight into the FFT input
+    readLoopedWindow(-1, playHeadEstimate, fftInput, n);
+    transformMonoWindow();
+    return 1;
+}
 
-        for (int i = 0; i <= gridDivs; i++) {
-            float t = (float)i / (float)gridDivs;
+// Map one spectrum to NUM_BARS display values
+static void mapSpectrumToLine(const float* mag, float* out, const int32_t* bin0,
+                              const int32_t* bin1, const float* frac, int split) {
+    spectrogramMapBars(mag, out, bin0, bin1, frac, 0, split, NUM_BARS);
+    compressMagnitudes(out, NUM_BARS, MAG_GAIN);
+}
 
-            float x = -gridX * 0.5f + t * gridX;
-            glVertex3f(x, gridY, -gridZ * 0.5f);
-            glVertex3f(x, gridY,  gridZ * 0.5f);
+// Same, with the current global tables. Read-only on shared state, so it may
+// run on several threads at once.
+static void buildLineFromMagnitudes(const float* mag, float* out) {
+    mapSpectrumToLine(mag, out, gBarBin0.data(), gBarBin1.data(), gBarFrac.data(), gBarSplit);
+}
 
-            float z = -gridZ * 0.5f + t * gridZ;
-            glVertex3f(-gridX * 0.5f, gridY, z);
-            glVertex3f( gridX * 0.5f, gridY, z);
-        }
+// Build 'channels' lines (one NUM_BARS row each) from what
+// processAudioFrameSynced() left behind. Caller must hold gAnalysisMutex.
+static void updateRunningStats(const float* line);
 
-        glEnd();
+static void buildCurrentLine(float* out, int channels = 1) {
+    if (gMappingBins != (int)magnitudes.size()) buildFrequencyMapping();
+    if (channels <= 1) {
+        if (!buildMultiRateLine(out)) buildLineFromMagnitudes(magnitudes.data(), out);
+    } else {
+        const size_t bins = magnitudes.size();
+        if (gChannelMagnitudes.size() < bins * (size_t)channels) gChannelMagnitudes.resize(bins * (size_t)channels, 0.0f);
+        for (int ch = 0; ch < channels; ch++) {
+            buildLineFromMagnitudes(&gChannelMagnitudes[bins * (size_t)ch], out + (size_t)ch * (size_t)NUM_BARS);
+        }
     }
+    updateRunningStats(out);  // Overlay traces follow channel 0
+}
 
-    glLineWidth(lineWidth);  // Use variable line width
+// 'line' holds one NUM_BARS row per history channel
+static void pushLineToHistory(const float* line) {
+    // Advance the head instead of shifting the whole history
+    historyHead = (historyHead + 1) % MAX_HISTORY_LINES;
+    for (int ch = 0; ch < gHistoryChannels; ch++) {
+        std::memcpy(&lineHistory[((size_t)ch * MAX_HISTORY_LINES + (size_t)historyHead) * (size_t)NUM_BARS],
+                    line + (size_t)ch * (size_t)NUM_BARS, sizeof(float) * NUM_BARS);
+    }
+    historyPushCount++;
 
-    // Waterfall lines
-    for (int row = 0; row < HISTORY_LINES; row++) {
-        float tRow = (HISTORY_LINES == 1) ? 0.0f : (float)row / (float)(HISTORY_LINES - 1);
-        float z = (Z_SPAN * 0.5f) - tRow * Z_SPAN;
-        float ageFade = 1.0f - 0.75f * tRow;
+    // Track how many lines have been filled (up to HISTORY_LINES)
+    if (historyFillCount < HISTORY_LINES) {
+        historyFillCount++;
+    }
+}
 
-        glBegin(GL_LINE_STRIP);
-        for (int i = 0; i < NUM_BARS; i++) {
-            float v = lineHistory[row * NUM_BARS + i];
-            float x = gBarX[i];
-            float y = v * yScale;  // Use variable Y scale instead of constant
+// ===================== Multi-Rate Analysis =====================
+// Fine detail at the MIN_FREQ end of a log axis used to need a 16384-point FFT,
+// which is costly per hop and smears transients across the whole spectrum.
+// Multi-rate mode instead runs the mono signal through a cascade of half-band
+// decimators (one octave per stage) and gives every level an FFT of the
+// selected size: level k runs at sr / 2^k, so its bins are 2^k times narrower
+// and its window 2^k times longer. Each level supplies the octave where its
+// filters are flat and alias free, [0.2, 0.4) of its own rate (level 0 up to
+// Nyquist, the last level down to MIN_FREQ), and the bar tables are stitched
+// level by level. The cascade streams: a hop only pushes the new samples
+// through the filters, and only a seek or a source change re-primes it.
+static constexpr int MULTIRATE_MAX_LEVELS = 7;
+static constexpr int HALFBAND_TAPS = 47;       // 4m + 3 taps; ~70 dB stopband above 0.3 fs
+static constexpr int HALFBAND_DELAY = 22;      // (HALFBAND_TAPS - 3) / 2, in input samples
+static constexpr int MULTIRATE_FEED_CHUNK = 4096;
+static constexpr float MULTIRATE_BAND_LO = 0.2f;  // Level k serves [0.2, 0.4) * sr / 2^k
+
+static bool multiRateEnabled = false;  // Settings toggle; guarded by gAnalysisMutex
+static int multiRateLevels = 5;        // Octave levels incl. full rate; guarded by gAnalysisMutex
+
+struct MultiRateLevel {
+    std::vector<float> ring;  // Power-of-two ring, indexed by this level's sample number
+    int64_t end = 0;          // One past the newest sample
+};
 
-            float r, g, b;
-            
-            if (useCustomLineColor) {
-                // Use custom solid color
-                r = lineColor[0];
-                g = lineColor[1];
-                b = lineColor[2];
-            } else {
-                // Use colormap
-                // Apply extremely aggressive power curve to absolutely reach end of colormap
-                float vGamma = std::pow(v, 0.2f);
+struct MultiRateState {
+    // What the state was built for
+    int fftSize = 0;
+    int levels = 0;
+    int bars = 0;
+    uint32_t mappingVersion = 0;
+
+    MultiRateLevel level[MULTIRATE_MAX_LEVELS];
+    bool primed = false;
+    std::vector<float> halfband;  // HALFBAND_TAPS coefficients, unity DC gain
+    std::vector<float> feed;      // Level 0 staging for one source read
+
+    std::vector<float> mags;          // 'levels' planes of fftSize/2 magnitudes
+    std::vector<int32_t> bin0, bin1;  // Per bar, into its level's plane
+    std::vector<float> frac;
+    int segBegin[MULTIRATE_MAX_LEVELS] = {};  // Bars [segBegin, segEnd) come from level k;
+    int segSplit[MULTIRATE_MAX_LEVELS] = {};  // those below segSplit interpolate
+    int segEnd[MULTIRATE_MAX_LEVELS] = {};
+    bool frameReady = false;  // mags hold the frame processAudioFrameSynced() just analysed
+};
 
-                // Get pure color from colormap
-                getCurrentColormapColor(vGamma, r, g, b);
+static MultiRateState gMultiRate;  // Guarded by gAnalysisMutex
 
-                // Apply strong saturation boost for vibrant colors
-                float saturationBoost = 1.0f;  // 1.5 = 50% more saturated
+static inline int64_t floorDiv(int64_t a, int64_t b) {
+    const int64_t q = a / b;
+    return (a % b != 0 && (a < 0) != (b < 0)) ? q - 1 : q;
+}
 
-                float maxC = std::max(r, std::max(g, b));
-                float minC = std::min(r, std::min(g, b));
-                float delta = maxC - minC;
-
-                if (delta > 0.001f) {
-                    float chroma = delta * saturationBoost;
-                    chroma = std::min(chroma, maxC);
-                    float scale = chroma / delta;
-                    r = minC + (r - minC) * scale;
-                    g = minC + (g - minC) * scale;
-                    b = minC + (b - minC) * scale;
-                }
+// Kaiser-windowed half-band lowpass: every other tap is zero except the centre
+static void designHalfband(std::vector<float>& h) {
+    const int c = HALFBAND_TAPS / 2;
+    const double beta = 7.0;
+    const double norm = 1.0 / spectrogramBesselI0(beta);
+    std::vector<double> taps((size_t)HALFBAND_TAPS);
+    double sum = 0.0;
+    for (int i = 0; i < HALFBAND_TAPS; i++) {
+        const int d = i - c;
+        const double sinc = d == 0 ? 0.5 : std::sin(0.5 * M_PI * (double)d) / (M_PI * (double)d);
+        const double t = (double)d / (double)c;
+        taps[(size_t)i] = sinc * spectrogramBesselI0(beta * std::sqrt(std::max(0.0, 1.0 - t * t))) * norm;
+        sum += taps[(size_t)i];
+    }
+    h.resize((size_t)HALFBAND_TAPS);
+    for (int i = 0; i < HALFBAND_TAPS; i++) h[(size_t)i] = (float)(taps[(size_t)i] / sum);
+}
 
-                // Apply color fade for depth perception
-                float colorFade = 1.0f - 0.75f * tRow;
-                r *= colorFade;
-                g *= colorFade;
-                b *= colorFade;
-            }
+// Bar tables per level: same log axis and interpolate/peak rule as
+// buildFrequencyMapping(), in the bin space of the level serving each bar
+static void buildMultiRateMapping() {
+    MultiRateState& mr = gMultiRate;
+    const float sr = (float)analysisSampleRate();
+    const float minF = std::max(MIN_FREQ, 1.0f);
+    const float maxF = std::max(minF * 1.001f, sr * 0.5f);
+    const float ratio = maxF / minF;
+    const int numFreqs = mr.fftSize / 2;
+    const float step = (NUM_BARS == 1) ? 1.0f : 1.0f / (float)(NUM_BARS - 1);
 
-            // Opacity fades from full (1.0) at front to more transparent at back
-            float a = 1.0f - 0.8f * tRow;
+    mr.bin0.assign((size_t)NUM_BARS, 0);
+    mr.bin1.assign((size_t)NUM_BARS, 0);
+    mr.frac.assign((size_t)NUM_BARS, 0.0f);
+    for (int k = 0; k < MULTIRATE_MAX_LEVELS; k++) mr.segBegin[k] = mr.segSplit[k] = mr.segEnd[k] = 0;
 
-            glColor4f(r, g, b, a);
-            glVertex3f(x, y, z);
+    int prevLevel = -1;
+    for (int i = 0; i < NUM_BARS; i++) {
+        const float t = (NUM_BARS == 1) ? 0.0f : (float)i / (float)(NUM_BARS - 1);
+        const float f = minF * std::pow(ratio, t);
+
+        // Bars ascend in frequency, so levels descend and each one's bars are contiguous
+        int k = 0;
+        while (k < mr.levels - 1 && f < MULTIRATE_BAND_LO * sr / (float)(1 << k)) k++;
+        if (k != prevLevel) {
+            mr.segBegin[k] = i;
+            mr.segSplit[k] = -1;
+            prevLevel = k;
+        }
+        mr.segEnd[k] = i + 1;
+
+        const float binsPerHz = (float)mr.fftSize * (float)(1 << k) / sr;
+        float binF = f * binsPerHz;
+        const float edgeLo = minF * std::pow(ratio, t - 0.5f * step) * binsPerHz;
+        const float edgeHi = minF * std::pow(ratio, t + 0.5f * step) * binsPerHz;
+        if (mr.segSplit[k] < 0 && edgeHi - edgeLo >= 1.0f) mr.segSplit[k] = i;
+
+        if (mr.segSplit[k] < 0) {
+            binF = std::max(1.0f, std::min(binF, (float)(numFreqs - 2)));
+            const int b = (int)binF;
+            mr.bin0[(size_t)i] = b;
+            mr.bin1[(size_t)i] = b + 1;
+            mr.frac[(size_t)i] = binF - (float)b;
+        } else {
+            const int lo = std::max(1, std::min((int)std::ceil(edgeLo), numFreqs - 1));
+            const int hi = std::max(lo, std::min((int)std::floor(edgeHi), numFreqs - 1));
+            mr.bin0[(size_t)i] = lo;
+            mr.bin1[(size_t)i] = hi;
         }
-        glEnd();
     }
-
-    glDisable(GL_BLEND);
+    for (int k = 0; k < mr.levels; k++) {
+        if (mr.segSplit[k] < 0) mr.segSplit[k] = mr.segEnd[k];
+    }
 }
 
-// Pre-compute color lookup table
-void updateColorLUT() {
-    if (!colorLUTDirty) return;
-
-    colorLUT.resize(COLOR_LUT_SIZE);
-    for (int i = 0; i < COLOR_LUT_SIZE; i++) {
-        float v = (float)i / (float)(COLOR_LUT_SIZE - 1);
-
-        // Apply extremely aggressive power curve to absolutely reach end of colormap
-        // 0.2 pushes even 50% signals to 87% through the colormap
-        v = std::pow(v, 0.2f);
+// (Re)build rings and tables when the FFT size, level count, bar count or
+// source (via gMappingVersion) changed. Caller must hold gAnalysisMutex.
+static void prepareMultiRate() {
+    MultiRateState& mr = gMultiRate;
+    const int n = fftPlanSize;
+    const int levels = std::max(2, std::min(multiRateLevels, MULTIRATE_MAX_LEVELS));
+    if (mr.fftSize == n && mr.levels == levels && mr.bars == NUM_BARS && mr.mappingVersion == gMappingVersion) return;
+
+    mr.fftSize = n;
+    mr.levels = levels;
+    mr.bars = NUM_BARS;
+    mr.mappingVersion = gMappingVersion;
+    mr.primed = false;
+    if (mr.halfband.empty()) designHalfband(mr.halfband);
+    mr.feed.resize(MULTIRATE_FEED_CHUNK);
+    mr.mags.assign((size_t)levels * (size_t)(n / 2), 0.0f);
+
+    // Level k keeps its window plus the look-ahead the levels below it need
+    // (centred windows), one feed chunk and the filter history
+    for (int k = 0; k < MULTIRATE_MAX_LEVELS; k++) {
+        if (k >= levels) {
+            std::vector<float>().swap(mr.level[k].ring);
+            continue;
+        }
+        const size_t span = ((size_t)1 << (levels - 1 - k)) * (size_t)(n / 2 + HALFBAND_TAPS) +
+                            (size_t)n + MULTIRATE_FEED_CHUNK + 2 * HALFBAND_TAPS;
+        size_t size = 1;
+        while (size < span) size <<= 1;
+        mr.level[k].ring.assign(size, 0.0f);
+    }
+    buildMultiRateMapping();
+}
 
-        // Get pure color from colormap
-        float r, g, b;
-        getCurrentColormapColor(v, r, g, b);
+// Produce every level-k sample whose inputs level k-1 now holds
+static void decimateLevel(int k) {
+    MultiRateState& mr = gMultiRate;
+    const MultiRateLevel& src = mr.level[k - 1];
+    MultiRateLevel& dst = mr.level[k];
+    const size_t srcMask = src.ring.size() - 1;
+    const size_t dstMask = dst.ring.size() - 1;
+    const float* h = mr.halfband.data();
+    const int c = HALFBAND_TAPS / 2;
+
+    for (; 2 * dst.end + 2 <= src.end; dst.end++) {
+        const int64_t top = 2 * dst.end + 1;  // Newest input of this output
+        float acc = h[c] * src.ring[(size_t)(top - c) & srcMask];
+        // Symmetric taps, nonzero only at even offsets from the ends
+        for (int t = 0; t < c; t += 2) {
+            acc += h[t] * (src.ring[(size_t)(top - t) & srcMask] +
+                           src.ring[(size_t)(top - (HALFBAND_TAPS - 1) + t) & srcMask]);
+        }
+        dst.ring[(size_t)dst.end & dstMask] = acc;
+    }
+}
 
-        // Apply strong saturation boost to maintain vibrancy despite aggressive gamma
-        float saturationBoost = 1.5f;  // 50% more saturated for vibrant colors
+// Feed the source up to original-rate sample 'need'. Anything but a short step
+// forward from the last feed re-primes the cascade from 'primeFrom'.
+static void feedMultiRate(int64_t need, int64_t primeFrom, bool capturing) {
+    MultiRateState& mr = gMultiRate;
+    MultiRateLevel& l0 = mr.level[0];
+    if (!mr.primed || need < l0.end || need - l0.end > (int64_t)(l0.ring.size() / 2)) {
+        for (int k = 0; k < mr.levels; k++) {
+            std::fill(mr.level[k].ring.begin(), mr.level[k].ring.end(), 0.0f);
+            mr.level[k].end = floorDiv(primeFrom, (int64_t)1 << k);
+        }
+        mr.primed = true;
+    }
 
-        // Convert to HSV-like saturation adjustment
-        float maxC = std::max(r, std::max(g, b));
-        float minC = std::min(r, std::min(g, b));
-        float delta = maxC - minC;
+    const size_t mask0 = l0.ring.size() - 1;
+    while (l0.end < need) {
+        const int count = (int)std::min<int64_t>(need - l0.end, (int64_t)mr.feed.size());
+        if (capturing) gCaptureRing.read(l0.end, mr.feed.data(), (size_t)count);
+        else readLoopedWindow(-1, l0.end, mr.feed.data(), count);
+        for (int i = 0; i < count; i++) l0.ring[(size_t)(l0.end + i) & mask0] = mr.feed[(size_t)i];
+        l0.end += count;
+        for (int k = 1; k < mr.levels; k++) decimateLevel(k);
+    }
+}
 
-        if (delta > 0.001f) {
-            // Boost saturation
-            float chroma = delta * saturationBoost;
-            chroma = std::min(chroma, maxC);  // Clamp to prevent overflow
+// Analyse one frame per level into gMultiRate.mags. Returns false (nothing
+// done) unless multi-rate mode applies to what is being analysed.
+// Caller must hold gAnalysisMutex.
+static bool processMultiRateFrame(int64_t writeHead) {
+    MultiRateState& mr = gMultiRate;
+    mr.frameReady = false;
+    if (!multiRateEnabled || gAnalysisChannels > 1) return false;
+    const bool capturing = gCaptureActive.load(std::memory_order_relaxed);
+    if (!capturing && wavFile->empty()) return false;
+
+    prepareMultiRate();
+    const int n = fftPlanSize;
+    const int levels = mr.levels;
+
+    // Window start per level (in that level's samples). Live input ends every
+    // window at the newest frame; file playback centres them all on the
+    // audible sample, compensating each level's accumulated filter delay.
+    int64_t start[MULTIRATE_MAX_LEVELS] = {};
+    const int64_t centre = writeHead - (int64_t)(gLatencySamplesBase + gLatencyAdjust);
+    for (int k = 0; k < levels; k++) {
+        const int64_t scale = (int64_t)1 << k;
+        start[k] = capturing ? floorDiv(writeHead, scale) - n
+                             : floorDiv(centre + (int64_t)HALFBAND_DELAY * (scale - 1), scale) - n / 2;
+    }
 
-            // Reconstruct RGB with boosted saturation
-            float scale = chroma / delta;
-            r = minC + (r - minC) * scale;
-            g = minC + (g - minC) * scale;
-            b = minC + (b - minC) * scale;
-        }
+    // Level k-1 must reach twice what level k needs; the earliest input any
+    // window depends on is where a re-prime starts
+    int64_t need = start[levels - 1] + n;
+    int64_t primeFrom = need;
+    for (int k = levels - 1; k >= 0; k--) {
+        const int64_t scale = (int64_t)1 << k;
+        if (k < levels - 1) need = std::max(start[k] + n, 2 * need);
+        primeFrom = std::min(primeFrom, start[k] * scale - (int64_t)(HALFBAND_TAPS - 2) * (scale - 1));
+    }
+    feedMultiRate(need, primeFrom, capturing);
+
+    const int bins = n / 2;
+    for (int k = 0; k < levels; k++) {
+        const MultiRateLevel& l = mr.level[k];
+        const size_t mask = l.ring.size() - 1;
+        for (int i = 0; i < n; i++) fftInput[i] = l.ring[(size_t)(start[k] + i) & mask];
+        transformWindow(fftInput, fftOutput, &mr.mags[(size_t)k * (size_t)bins]);
+    }
+    mr.frameReady = true;
+    return true;
+}
 
-        // Convert directly to unsigned char
-        colorLUT[i][0] = (unsigned char)(clamp01(r) * 255.0f);
-        colorLUT[i][1] = (unsigned char)(clamp01(g) * 255.0f);
-        colorLUT[i][2] = (unsigned char)(clamp01(b) * 255.0f);
+// Stitch the levels of the last processMultiRateFrame() into one line.
+// Returns false when the last frame was not a multi-rate one.
+static bool buildMultiRateLine(float* out) {
+    const MultiRateState& mr = gMultiRate;
+    if (!mr.frameReady || mr.bars != NUM_BARS) return false;
+    const size_t bins = (size_t)(mr.fftSize / 2);
+    for (int k = 0; k < mr.levels; k++) {
+        if (mr.segEnd[k] <= mr.segBegin[k]) continue;
+        spectrogramMapBars(&mr.mags[(size_t)k * bins], out, mr.bin0.data(), mr.bin1.data(), mr.frac.data(),
+                           mr.segBegin[k], mr.segSplit[k], mr.segEnd[k]);
     }
-    colorLUTDirty = false;
+    compressMagnitudes(out, NUM_BARS, MAG_GAIN);
+    return true;
 }
 
-// Waveform data cache
-static std::vector<float> waveformMinCache;
-static std::vector<float> waveformMaxCache;
-static int waveformCacheWidth = 0;
-static bool waveformCacheDirty = true;
+// Switch multi-rate mode from the GUI thread
+static void setMultiRate(bool enabled, int levels) {
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+    multiRateEnabled = enabled;
+    multiRateLevels = std::max(2, std::min(levels, MULTIRATE_MAX_LEVELS));
+}
 
-// Pre-compute waveform min/max values for efficient rendering
-static void updateWaveformCache(int width) {
-    if (wavFile.audioData.empty()) return;
+// ===================== Sliding DFT =====================
+// At very small hops a full FFT per line mostly recomputes what the previous
+// line already knew. The sliding DFT keeps the rectangular-window DFT of the
+// current window for just the bins the bar tables read (plus the neighbours the
+// window needs) and advances it one sample at a time,
+//     X_k <- (X_k + x[s + N] - x[s]) * e^(j 2 pi k / N),
+// which costs O(bins) per sample. Hann and Blackman-Harris are sums of cosines,
+// so they are applied afterwards as a 3- or 7-tap convolution across bins (the
+// periodic form of the window, normalised by its coherent gain like the FFT
+// path). Kaiser has no such form and always uses the FFT. The state is primed
+// from one unwindowed FFT after any discontinuity and again once per window
+// length, which also flushes accumulated rounding error. In Auto mode both
+// paths are timed as they run and each line takes whichever is predicted to be
+// cheaper for the current hop and bin count.
+enum TransformMode { TRANSFORM_AUTO = 0, TRANSFORM_FFT, TRANSFORM_SLIDING, TRANSFORM_MODE_COUNT };
+static const char* transformModeNames[TRANSFORM_MODE_COUNT] = { "Auto", "FFT", "Sliding DFT" };
+
+static int transformMode = TRANSFORM_AUTO;  // Settings; guarded by gAnalysisMutex
+
+struct SlidingDFT {
+    // What the tables were built for
+    int fftSize = 0;
+    int window = -1;
+    uint32_t mappingVersion = 0;
+
+    std::vector<int32_t> bins;       // Tracked bins, ascending
+    std::vector<int32_t> usedBins;   // Bins the bar tables read (subset of bins)
+    std::vector<int32_t> slotOfBin;  // fftSize/2 + 1 entries; index into bins, -1 = untracked
+    std::vector<float> re, im;       // DFT state per tracked bin
+    std::vector<float> rotRe, rotIm; // e^(j 2 pi k / N) per tracked bin
+    std::vector<float> oldSamples, newSamples;
+    float coef[4] = {};              // Window = c0 - c1 cos(x) + c2 cos(2x) - c3 cos(3x)
+    int taps = 0;                    // Highest cosine term in use
+    float scale = 0.0f;
+
+    bool primed = false;
+    int64_t start = 0;       // Window start the state describes
+    int64_t sincePrime = 0;  // Samples slid since the last prime
+
+    double nsPerBinSample = 0.0;  // Measured update cost (0 = not measured yet)
+    double fftNs = 0.0;           // Measured full transform at fftSize (0 = not measured yet)
+    bool active = false;          // The last line came from the sliding path
+};
 
-    // Only rebuild if width changed or data changed
-    if (waveformCacheWidth == width && !waveformCacheDirty) return;
+static SlidingDFT gSliding;  // Guarded by gAnalysisMutex
 
-    waveformCacheWidth = width;
-    waveformCacheDirty = false;
+static inline void smoothCost(double& estimate, double sample) {
+    estimate = estimate > 0.0 ? estimate * 0.9 + sample * 0.1 : sample;
+}
 
-    waveformMinCache.resize(width + 1);
-    waveformMaxCache.resize(width + 1);
+// Timing of the regular FFT path, for the Auto decision
+static void noteFullTransform(uint64_t ns) {
+    if (transformMode == TRANSFORM_AUTO) smoothCost(gSliding.fftNs, (double)ns);
+}
 
-    const size_t totalSamples = wavFile.audioData.size();
-    const int downsample = std::max(1, (int)(totalSamples / (size_t)std::max(1, width)));
+// Rebuild the bin tables for the current size, window and bar mapping.
+// Returns false when the window has no cosine-sum form. Caller holds gAnalysisMutex.
+static bool prepareSliding() {
+    SlidingDFT& sd = gSliding;
+    const int n = fftPlanSize;
+    if (windowType == WINDOW_KAISER) return false;
+    if (gMappingBins != n / 2) buildFrequencyMapping();
+    if (sd.fftSize == n && sd.window == windowType && sd.mappingVersion == gMappingVersion) return true;
+
+    if (sd.fftSize != n) sd.fftNs = 0.0;
+    sd.fftSize = n;
+    sd.window = windowType;
+    sd.mappingVersion = gMappingVersion;
+    sd.primed = false;
+
+    if (windowType == WINDOW_BLACKMAN_HARRIS) {
+        sd.coef[0] = 0.35875f; sd.coef[1] = 0.48829f; sd.coef[2] = 0.14128f; sd.coef[3] = 0.01168f;
+        sd.taps = 3;
+    } else {
+        sd.coef[0] = 0.5f; sd.coef[1] = 0.5f; sd.coef[2] = 0.0f; sd.coef[3] = 0.0f;
+        sd.taps = 1;
+    }
+    sd.scale = 1.0f / (2.0f * sd.coef[0] * (float)n);
 
-    // Pre-compute min/max for each pixel column
-    for (int x = 0; x <= width; x++) {
-        size_t sampleIdx = (size_t)(((float)x / (float)std::max(1, width)) * (float)totalSamples);
-        if (sampleIdx >= totalSamples) sampleIdx = totalSamples - 1;
+    const int half = n / 2;
+    std::vector<char> used((size_t)half + 1, 0), tracked((size_t)half + 1, 0);
+    for (int i = 0; i < gBarSplit; i++) {
+        used[(size_t)gBarBin0[i]] = 1;
+        used[(size_t)gBarBin0[i] + 1] = 1;
+    }
+    for (int i = gBarSplit; i < NUM_BARS; i++) {
+        for (int b = gBarBin0[i]; b <= gBarBin1[i]; b++) used[(size_t)b] = 1;
+    }
 
-        float minVal = 0.0f, maxVal = 0.0f;
-        for (int i = 0; i < downsample && sampleIdx + (size_t)i < totalSamples; i++) {
-            float sample = wavFile.audioData[sampleIdx + (size_t)i];
-            minVal = std::min(minVal, sample);
-            maxVal = std::max(maxVal, sample);
+    // Window neighbours, reflected into 0..N/2 (real input: X[-m] = X[N-m] = conj X[m])
+    sd.usedBins.clear();
+    for (int b = 0; b <= half; b++) {
+        if (!used[(size_t)b]) continue;
+        sd.usedBins.push_back(b);
+        for (int c = -sd.taps; c <= sd.taps; c++) {
+            int m = b + c;
+            if (m < 0) m = -m;
+            if (m > half) m = n - m;
+            tracked[(size_t)m] = 1;
         }
+    }
 
-        waveformMinCache[x] = minVal;
-        waveformMaxCache[x] = maxVal;
+    sd.bins.clear();
+    sd.slotOfBin.assign((size_t)half + 1, -1);
+    for (int b = 0; b <= half; b++) {
+        if (!tracked[(size_t)b]) continue;
+        sd.slotOfBin[(size_t)b] = (int32_t)sd.bins.size();
+        sd.bins.push_back(b);
+    }
+    const size_t count = sd.bins.size();
+    sd.re.assign(count, 0.0f);
+    sd.im.assign(count, 0.0f);
+    sd.rotRe.resize(count);
+    sd.rotIm.resize(count);
+    for (size_t s = 0; s < count; s++) {
+        const double a = 2.0 * M_PI * (double)sd.bins[s] / (double)n;
+        sd.rotRe[s] = (float)std::cos(a);
+        sd.rotIm[s] = (float)std::sin(a);
     }
+    return true;
 }
 
-// Render waveform display centered at bottom of viewport
-static void renderWaveform(int vpX, int vpY, int vpW, int vpH) {
-    if (wavFile.audioData.empty()) return;
+// Mono samples [pos, pos + count) of whatever is being analysed
+static void readMonoSamples(bool capturing, int64_t pos, float* dst, int count) {
+    if (capturing) gCaptureRing.read(pos, dst, (size_t)count);
+    else readLoopedWindow(-1, pos, dst, count);
+}
 
-    const int waveformHeight = 80;  // Height of waveform strip
-    const int waveformMaxWidth = 800;  // Maximum width for waveform
-    const int bottomMargin = 10;  // Distance from bottom edge
+// State = unwindowed DFT of the window starting at 'start'
+static void primeSliding(int64_t start, bool capturing) {
+    SlidingDFT& sd = gSliding;
+    const int n = fftPlanSize;
+    readMonoSamples(capturing, start, fftInput, n);
+    const uint64_t t0 = profileNowNs();
+    fftwf_execute_dft_r2c(fftPlan, fftInput, fftOutput);
+    smoothCost(sd.fftNs, (double)(profileNowNs() - t0));
+    for (size_t s = 0; s < sd.bins.size(); s++) {
+        sd.re[s] = fftOutput[sd.bins[s]][0];
+        sd.im[s] = fftOutput[sd.bins[s]][1];
+    }
+    sd.start = start;
+    sd.sincePrime = 0;
+    sd.primed = true;
+}
 
-    // Calculate actual waveform width (cap at max width)
-    int waveformWidth = std::min(waveformMaxWidth, vpW - 40);
+// Slide the window forward by 'step' samples
+static void slideSliding(int step, bool capturing) {
+    SlidingDFT& sd = gSliding;
+    const int n = fftPlanSize;
+    if (sd.oldSamples.size() < (size_t)step) {
+        sd.oldSamples.resize((size_t)step);
+        sd.newSamples.resize((size_t)step);
+    }
+    readMonoSamples(capturing, sd.start, sd.oldSamples.data(), step);
+    readMonoSamples(capturing, sd.start + n, sd.newSamples.data(), step);
+
+    const uint64_t t0 = profileNowNs();
+    const int count = (int)sd.bins.size();
+    float* re = sd.re.data();
+    float* im = sd.im.data();
+    const float* wr = sd.rotRe.data();
+    const float* wi = sd.rotIm.data();
+    for (int i = 0; i < step; i++) {
+        const float d = sd.newSamples[(size_t)i] - sd.oldSamples[(size_t)i];
+        int b = 0;
+#if defined(SPECTROGRAM_SSE2)
+        const __m128 vd = _mm_set1_ps(d);
+        for (; b + 4 <= count; b += 4) {
+            const __m128 r = _mm_add_ps(_mm_loadu_ps(re + b), vd);
+            const __m128 q = _mm_loadu_ps(im + b);
+            const __m128 cr = _mm_loadu_ps(wr + b), ci = _mm_loadu_ps(wi + b);
+            _mm_storeu_ps(re + b, _mm_sub_ps(_mm_mul_ps(r, cr), _mm_mul_ps(q, ci)));
+            _mm_storeu_ps(im + b, _mm_add_ps(_mm_mul_ps(r, ci), _mm_mul_ps(q, cr)));
+        }
+#elif defined(SPECTROGRAM_NEON)
+        const float32x4_t vd = vdupq_n_f32(d);
+        for (; b + 4 <= count; b += 4) {
+            const float32x4_t r = vaddq_f32(vld1q_f32(re + b), vd);
+            const float32x4_t q = vld1q_f32(im + b);
+            const float32x4_t cr = vld1q_f32(wr + b), ci = vld1q_f32(wi + b);
+            vst1q_f32(re + b, vmlsq_f32(vmulq_f32(r, cr), q, ci));
+            vst1q_f32(im + b, vmlaq_f32(vmulq_f32(r, ci), q, cr));
+        }
+#endif
+        for (; b < count; b++) {
+            const float r = re[b] + d, q = im[b];
+            re[b] = r * wr[b] - q * wi[b];
+            im[b] = r * wi[b] + q * wr[b];
+        }
+    }
+    if (count > 0) smoothCost(sd.nsPerBinSample, (double)(profileNowNs() - t0) / ((double)step * (double)count));
+    sd.start += step;
+    sd.sincePrime += step;
+}
 
-    // Center horizontally in viewport using the viewport's center point
-    const int viewportCenterX = vpX + vpW / 2;
-    const int waveformX = viewportCenterX - waveformWidth / 2;
+// Tracked bin m of the full spectrum, reflecting outside 0..N/2
+static inline void slidingBin(const SlidingDFT& sd, int m, float& re, float& im) {
+    const int n = sd.fftSize;
+    bool conj = false;
+    if (m < 0) { m = -m; conj = true; }
+    if (m > n / 2) { m = n - m; conj = !conj; }
+    const int32_t s = sd.slotOfBin[(size_t)m];
+    re = sd.re[(size_t)s];
+    im = conj ? -sd.im[(size_t)s] : sd.im[(size_t)s];
+}
 
-    // Position at bottom of viewport with margin
-    const int waveformY = vpY + bottomMargin;
+// Window in the frequency domain and write the bins the mapping reads
+static void slidingMagnitudes(float* mags) {
+    const SlidingDFT& sd = gSliding;
+    for (size_t u = 0; u < sd.usedBins.size(); u++) {
+        const int k = sd.usedBins[u];
+        float r, i;
+        slidingBin(sd, k, r, i);
+        float wr = sd.coef[0] * r, wi = sd.coef[0] * i;
+        for (int c = 1; c <= sd.taps; c++) {
+            float r0, i0, r1, i1;
+            slidingBin(sd, k - c, r0, i0);
+            slidingBin(sd, k + c, r1, i1);
+            const float g = ((c & 1) ? -0.5f : 0.5f) * sd.coef[c];
+            wr += g * (r0 + r1);
+            wi += g * (i0 + i1);
+        }
+        if (k < (int)magnitudes.size()) mags[k] = std::sqrt(wr * wr + wi * wi) * sd.scale;
+    }
+}
 
-    // Update waveform cache if needed
-    updateWaveformCache(waveformWidth);
+// Auto: predicted sliding cost (updates plus the amortised re-prime) vs one FFT.
+// Either path that has not been timed yet is tried first.
+static bool slidingPreferred(int hop) {
+    const SlidingDFT& sd = gSliding;
+    if (transformMode == TRANSFORM_SLIDING) return true;
+    if (sd.nsPerBinSample <= 0.0 || sd.fftNs <= 0.0) return true;
+    const double sliding = (double)hop * (double)sd.bins.size() * sd.nsPerBinSample +
+                           sd.fftNs * (double)hop / (double)sd.fftSize;
+    return sliding < sd.fftNs;
+}
 
-    // Use framebuffer coordinates consistently: viewport must be full framebuffer
-    GLFWwindow* ctx = glfwGetCurrentContext();
-    int fbW, fbH;
-    glfwGetFramebufferSize(ctx, &fbW, &fbH);
+// Analyse the mono window starting at 'start' into 'magnitudes' with the
+// sliding DFT. Returns false when the FFT path should run instead.
+// Caller must hold gAnalysisMutex.
+static bool processSlidingFrame(int64_t start, bool capturing) {
+    SlidingDFT& sd = gSliding;
+    sd.active = false;
+    if (transformMode == TRANSFORM_FFT || gAnalysisChannels > 1) return false;
+    const int n = fftPlanSize;
+    const int hop = std::max(1, ANALYSIS_HOP.load(std::memory_order_relaxed));
+    if (hop >= n / 2) return false;
+    if (!capturing && wavFile->totalFrames < (uint64_t)n * 2) return false;
+    if (!prepareSliding()) return false;
+    if (!slidingPreferred(hop)) {
+        sd.primed = false;
+        return false;
+    }
 
-    // Save current viewport and scissor state so it can restore after
-    GLint oldViewport[4];
-    glGetIntegerv(GL_VIEWPORT, oldViewport);
+    const int64_t step = start - sd.start;
+    if (!sd.primed || step < 0 || step >= n / 2 || sd.sincePrime + step > n) {
+        primeSliding(start, capturing);
+    } else if (step > 0) {
+        slideSliding((int)step, capturing);
+    }
+    slidingMagnitudes(magnitudes.data());
+    sd.active = true;
+    return true;
+}
 
-    GLboolean scissorWasEnabled = glIsEnabled(GL_SCISSOR_TEST);
-    GLint oldScissor[4];
-    glGetIntegerv(GL_SCISSOR_BOX, oldScissor);
+// Switch transform mode from the GUI thread
+static void setTransformMode(int mode) {
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+    transformMode = mode;
+    gSliding.primed = false;
+}
 
-    // IMPORTANT: disable scissor so the overlay isn't clipped to the spectrogram area
-    // and set viewport to full framebuffer
-    glDisable(GL_SCISSOR_TEST);
-    glViewport(0, 0, fbW, fbH);
+// ===================== Zoom Band =====================
+// Looking at a narrow band (say 900-1100 Hz hum harmonics) used to mean a
+// 16384-point FFT with nearly every bin thrown away by the bar mapping. The
+// zoom band instead mixes the mono signal down so the band centre sits at DC,
+// lowpasses and decimates it to just above the band width, and runs a small
+// complex FFT over what is left: a 1024-point zoom of 200 Hz at 44.1 kHz
+// resolves 0.3 Hz, which the full band would need ~150k points for. Like
+// multi-rate mode it streams, so a hop only filters the new samples. The zoom
+// line is one extra history plane after the channel planes, so it is drawn
+// next to the full-band view through the channel layouts.
+static constexpr int ZOOM_MAX_TAPS = 8191;       // Decimation filter cap; sets the narrowest transition
+static constexpr int ZOOM_FEED_CHUNK = 4096;
+static constexpr float ZOOM_KAISER_BETA = 7.0f;  // ~70 dB stopband
+static const int kZoomSizes[] = { 256, 512, 1024, 2048, 4096 };
+static constexpr int NUM_ZOOM_SIZES = (int)(sizeof(kZoomSizes) / sizeof(kZoomSizes[0]));
+
+static bool zoomEnabled = false;  // Settings toggle; guarded by gAnalysisMutex
+static float zoomLoHz = 900.0f;   // Band edges; guarded by gAnalysisMutex
+static float zoomHiHz = 1100.0f;
+static int zoomFFTSize = 1024;    // Complex FFT over the decimated band; guarded by gAnalysisMutex
+
+// Complex plan for the zoom FFT, made on the UI thread like gBatchPlan
+struct ZoomPlan {
+    int size = 0;
+    fftwf_plan plan = nullptr;
+    fftwf_complex* input = nullptr;
+    fftwf_complex* output = nullptr;
+};
 
-    // Switch to 2D orthographic projection for waveform (matches viewport)
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    glOrtho(0, fbW, 0, fbH, -1, 1);
+struct ZoomState {
+    // What the state was built for
+    float lo = 0.0f, hi = 0.0f;
+    int fftSize = 0;
+    int bars = 0;
+    int windowKind = -1;
+    uint32_t mappingVersion = 0;
+
+    int decimation = 1;     // Source samples per zoom sample
+    double centreHz = 0.0;  // Mixed down to DC
+    double rate = 0.0;      // Zoom sample rate
+    std::vector<float> taps;    // Lowpass at rate / 2, unity DC gain
+    std::vector<float> mixed;   // Power-of-two ring of mixed source samples (re, im)
+    int64_t mixedEnd = 0;       // One past the newest mixed source sample
+    std::vector<float> zoomed;  // Power-of-two ring of zoom samples (re, im)
+    int64_t zoomedEnd = 0;      // One past the newest zoom sample
+    bool primed = false;
+    std::vector<float> feed;    // Source staging for one read
+
+    std::vector<float> window;  // fftSize coefficients of the selected window
+    float windowScale = 0.0f;
+    std::vector<float> mags;    // fftSize magnitudes, DC in the middle
+    std::vector<int32_t> bin0, bin1;
+    std::vector<float> frac;
+    int split = 0;
+    bool frameReady = false;    // mags hold the frame processZoomFrame() just analysed
+};
 
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
+static ZoomPlan gZoomPlan;  // Guarded by gAnalysisMutex
+static ZoomState gZoom;     // Guarded by gAnalysisMutex
+
+// Caller must hold gPlannerMutex
+static ZoomPlan createZoomPlan(int size, unsigned flags) {
+    ZoomPlan p;
+    p.size = size;
+    p.input = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * (size_t)size);
+    p.output = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * (size_t)size);
+    p.plan = fftwf_plan_dft_1d(size, p.input, p.output, FFTW_FORWARD, flags);
+    return p;
+}
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+// Caller must hold gPlannerMutex (or be the only thread using FFTW)
+static void destroyZoomPlan(ZoomPlan& p) {
+    if (p.plan) fftwf_destroy_plan(p.plan);
+    if (p.input) fftwf_free(p.input);
+    if (p.output) fftwf_free(p.output);
+    p = ZoomPlan();
+}
 
-    // Draw semi-transparent background
-    glColor4f(0.0f, 0.0f, 0.0f, 0.6f);
-    glBegin(GL_QUADS);
-    glVertex2f((float)waveformX, (float)waveformY);
-    glVertex2f((float)waveformX + waveformWidth, (float)waveformY);
-    glVertex2f((float)waveformX + waveformWidth, (float)waveformY + waveformHeight);
-    glVertex2f((float)waveformX, (float)waveformY + waveformHeight);
-    glEnd();
+// Make gZoomPlan match the zoom FFT size. Called from the UI thread every
+// frame; retries next frame while the background planner holds FFTW.
+static void updateZoomPlan() {
+    int size = 0;
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        size = zoomFFTSize;
+        if (!zoomEnabled || gZoomPlan.size == size) return;
+    }
 
-    // Draw centerline
-    float centerY = waveformY + waveformHeight * 0.5f;
-    glColor4f(0.3f, 0.3f, 0.3f, 0.5f);
-    glBegin(GL_LINES);
-    glVertex2f((float)waveformX, centerY);
-    glVertex2f((float)waveformX + waveformWidth, centerY);
-    glEnd();
+    std::unique_lock<std::mutex> plannerLock(gPlannerMutex, std::try_to_lock);
+    if (!plannerLock.owns_lock()) return;
 
-    // Draw filled waveform using cached data (OPTIMIZED)
-    const float scale = 0.45f;
+    ZoomPlan fresh = createZoomPlan(size, planEffortFlags | FFTW_WISDOM_ONLY);
+    if (!fresh.plan) {
+        destroyZoomPlan(fresh);
+        fresh = createZoomPlan(size, FFTW_ESTIMATE);
+    }
+    if (!fresh.plan) {
+        destroyZoomPlan(fresh);
+        return;
+    }
 
-    glColor4f(0.2f, 0.6f, 1.0f, 0.7f);  // Brighter blue, more opaque
-    glBegin(GL_QUAD_STRIP);
-    for (int x = 0; x <= waveformWidth; x++) {
-        float yTop = centerY + waveformMaxCache[x] * waveformHeight * scale;
-        float yBottom = centerY + waveformMinCache[x] * waveformHeight * scale;
+    ZoomPlan old;
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        old = gZoomPlan;
+        gZoomPlan = fresh;
+    }
+    destroyZoomPlan(old);
+}
 
-        glVertex2f((float)waveformX + x, yTop);
-        glVertex2f((float)waveformX + x, yBottom);
+// Decimate as far as the band allows: the zoom rate must exceed the band by
+// a transition the capped Kaiser lowpass can make, and by half the band so
+// nothing folds back into it (the filter cuts off at rate / 2)
+static void designZoomFilter(ZoomState& z, float sr) {
+    const double band = (double)(z.hi - z.lo);
+    const double minRate = std::max(1.5 * band, band + 4.32 * (double)sr / (double)ZOOM_MAX_TAPS);
+    z.decimation = std::max(1, (int)std::floor((double)sr / minRate));
+    z.rate = (double)sr / (double)z.decimation;
+    if (z.decimation == 1) {
+        z.taps.assign(1, 1.0f);
+        return;
     }
-    glEnd();
 
-    // Draw top outline using cached data (OPTIMIZED)
-    glColor4f(0.3f, 0.8f, 1.0f, 0.9f);
-    glLineWidth(1.5f);
-    glBegin(GL_LINE_STRIP);
-    for (int x = 0; x <= waveformWidth; x++) {
-        float yTop = centerY + waveformMaxCache[x] * waveformHeight * scale;
-        glVertex2f((float)waveformX + x, yTop);
+    // Kaiser estimate for ~70 dB: N - 1 = (A - 8) / (2.285 * 2 pi * transition / sr)
+    const double transition = z.rate - band;
+    int taps = std::min(ZOOM_MAX_TAPS, (int)std::ceil(4.32 * (double)sr / transition) + 1);
+    taps |= 1;
+    const int c = taps / 2;
+    const double fc = 0.5 / (double)z.decimation;  // Cutoff in cycles per source sample
+    const double norm = 1.0 / spectrogramBesselI0(ZOOM_KAISER_BETA);
+    std::vector<double> h((size_t)taps);
+    double sum = 0.0;
+    for (int i = 0; i < taps; i++) {
+        const int d = i - c;
+        const double sinc = d == 0 ? 2.0 * fc : std::sin(2.0 * M_PI * fc * (double)d) / (M_PI * (double)d);
+        const double t = (double)d / (double)c;
+        h[(size_t)i] = sinc * spectrogramBesselI0(ZOOM_KAISER_BETA * std::sqrt(std::max(0.0, 1.0 - t * t))) * norm;
+        sum += h[(size_t)i];
     }
-    glEnd();
+    z.taps.resize((size_t)taps);
+    for (int i = 0; i < taps; i++) z.taps[(size_t)i] = (float)(h[(size_t)i] / sum);
+}
 
-    // Draw bottom outline using cached data (OPTIMIZED)
-    glBegin(GL_LINE_STRIP);
-    for (int x = 0; x <= waveformWidth; x++) {
-        float yBottom = centerY + waveformMinCache[x] * waveformHeight * scale;
-        glVertex2f((float)waveformX + x, yBottom);
+// Bar tables across [lo, hi]: same log axis and interpolate/peak rule as
+// buildFrequencyMapping(), in the bin space of the centred zoom spectrum
+static void buildZoomMapping(ZoomState& z) {
+    const float ratio = z.hi / z.lo;
+    const float binsPerHz = (float)z.fftSize / (float)z.rate;
+    const float dcBin = (float)(z.fftSize / 2);
+    const float centre = (float)z.centreHz;
+    const float step = (NUM_BARS == 1) ? 1.0f : 1.0f / (float)(NUM_BARS - 1);
+    auto binOf = [&](float t) { return (z.lo * std::pow(ratio, t) - centre) * binsPerHz + dcBin; };
+
+    z.bin0.assign((size_t)NUM_BARS, 0);
+    z.bin1.assign((size_t)NUM_BARS, 0);
+    z.frac.assign((size_t)NUM_BARS, 0.0f);
+    z.split = NUM_BARS;
+    for (int i = 0; i < NUM_BARS; i++) {
+        const float t = (NUM_BARS == 1) ? 0.5f : (float)i / (float)(NUM_BARS - 1);
+        float binF = binOf(t);
+        const float edgeLo = binOf(t - 0.5f * step);
+        const float edgeHi = binOf(t + 0.5f * step);
+        if (z.split == NUM_BARS && edgeHi - edgeLo >= 1.0f) z.split = i;
+
+        if (i < z.split) {
+            binF = std::max(1.0f, std::min(binF, (float)(z.fftSize - 2)));
+            const int b = (int)binF;
+            z.bin0[(size_t)i] = b;
+            z.bin1[(size_t)i] = b + 1;
+            z.frac[(size_t)i] = binF - (float)b;
+        } else {
+            const int lo = std::max(1, std::min((int)std::ceil(edgeLo), z.fftSize - 1));
+            const int hi = std::max(lo, std::min((int)std::floor(edgeHi), z.fftSize - 1));
+            z.bin0[(size_t)i] = lo;
+            z.bin1[(size_t)i] = hi;
+        }
     }
-    glEnd();
-    glLineWidth(1.0f);
+}
 
-    // Draw playback position line
-    if (isPlaying || isPaused.load()) {
-        uint64_t pos = playbackPosition.load(std::memory_order_relaxed);
+// Band edges as the analysis uses them: inside (0, Nyquist], at least a few
+// zoom bins wide
+static void clampZoomBand(float sr, float& lo, float& hi) {
+    const float nyquist = sr * 0.5f;
+    lo = std::max(1.0f, std::min(lo, nyquist * 0.99f));
+    hi = std::max(lo * 1.0005f + 0.5f, std::min(hi, nyquist));
+}
 
-        // Account for audio latency to sync with what is heard
-        int64_t adjustedPos = (int64_t)pos - (int64_t)(gLatencySamplesBase + gLatencyAdjust);
-        if (adjustedPos < 0) adjustedPos = 0;
+// (Re)build filter, rings and tables when the band, zoom size, window, bar
+// count or source changed. Caller must hold gAnalysisMutex.
+static void prepareZoom() {
+    ZoomState& z = gZoom;
+    const float sr = (float)analysisSampleRate();
+    float lo = zoomLoHz, hi = zoomHiHz;
+    clampZoomBand(sr, lo, hi);
+    if (z.lo == lo && z.hi == hi && z.fftSize == zoomFFTSize && z.bars == NUM_BARS && z.windowKind == windowType &&
+        z.mappingVersion == gMappingVersion) {
+        return;
+    }
 
-        const size_t totalSamples = wavFile.audioData.size(); // MONO samples
-        float progress = (totalSamples > 0) ? (float)adjustedPos / (float)totalSamples : 0.0f;
-        float posX = waveformX + progress * waveformWidth;
+    z.lo = lo;
+    z.hi = hi;
+    z.fftSize = zoomFFTSize;
+    z.bars = NUM_BARS;
+    z.windowKind = windowType;
+    z.mappingVersion = gMappingVersion;
+    z.centreHz = 0.5 * ((double)lo + (double)hi);
+    z.primed = false;
+    designZoomFilter(z, sr);
+
+    size_t size = 1;
+    while (size < z.taps.size() + ZOOM_FEED_CHUNK + (size_t)z.decimation) size <<= 1;
+    z.mixed.assign(2 * size, 0.0f);
+    size = 1;
+    while (size < 2 * (size_t)z.fftSize) size <<= 1;
+    z.zoomed.assign(2 * size, 0.0f);
+    z.feed.resize(ZOOM_FEED_CHUNK);
+
+    // Same levels as the full band
+    z.windowScale = spectrogramWindowScale(spectrogramTabulateWindow(windowType, z.fftSize, z.window));
+    z.mags.assign((size_t)z.fftSize, 0.0f);
+    buildZoomMapping(z);
+}
 
-        glLineWidth(3.0f);
-        glColor4f(1.0f, 0.2f, 0.2f, 0.95f);  // Bright red position line
-        glBegin(GL_LINES);
-        glVertex2f(posX, (float)waveformY);
-        glVertex2f(posX, (float)waveformY + waveformHeight);
-        glEnd();
-        glLineWidth(1.0f);
+// Mix, filter and decimate the source until zoom samples [start, start +
+// fftSize) exist. Anything but a step forward from the last call re-primes
+// the rings at the window.
+static void feedZoom(int64_t start, bool capturing) {
+    ZoomState& z = gZoom;
+    const int64_t D = z.decimation;
+    const int taps = (int)z.taps.size();
+    const int64_t need = (start + z.fftSize - 1) * D + 1;  // One past the newest source sample used
+    const int64_t first = start * D - (taps - 1);           // Oldest source sample used
+    if (!z.primed || need < z.mixedEnd || first > z.mixedEnd) {
+        z.mixedEnd = first;
+        z.zoomedEnd = start;
+        z.primed = true;
     }
 
-    // Draw border
-    glColor4f(0.5f, 0.5f, 0.5f, 0.7f);
-    glLineWidth(2.0f);
-    glBegin(GL_LINE_LOOP);
-    glVertex2f((float)waveformX, (float)waveformY);
-    glVertex2f((float)waveformX + waveformWidth, (float)waveformY);
-    glVertex2f((float)waveformX + waveformWidth, (float)waveformY + waveformHeight);
-    glVertex2f((float)waveformX, (float)waveformY + waveformHeight);
-    glEnd();
-    glLineWidth(1.0f);
+    const size_t mixMask = z.mixed.size() / 2 - 1;
+    const size_t outMask = z.zoomed.size() / 2 - 1;
+    const double cycles = z.centreHz / (double)analysisSampleRate();
+    const double stepRe = std::cos(2.0 * M_PI * cycles), stepIm = -std::sin(2.0 * M_PI * cycles);
+    const float* h = z.taps.data();
+
+    while (z.mixedEnd < need) {
+        const int count = (int)std::min<int64_t>(need - z.mixedEnd, (int64_t)z.feed.size());
+        if (capturing) gCaptureRing.read(z.mixedEnd, z.feed.data(), (size_t)count);
+        else readLoopedWindow(-1, z.mixedEnd, z.feed.data(), count);
+
+        // e^(-2 pi i f s / sr) from the exact phase at the chunk start, rotated per sample
+        double turns = cycles * (double)z.mixedEnd;
+        turns -= std::floor(turns);
+        double re = std::cos(2.0 * M_PI * turns), im = -std::sin(2.0 * M_PI * turns);
+        for (int i = 0; i < count; i++) {
+            const size_t k = (size_t)(z.mixedEnd + i) & mixMask;
+            z.mixed[2 * k] = z.feed[(size_t)i] * (float)re;
+            z.mixed[2 * k + 1] = z.feed[(size_t)i] * (float)im;
+            const double r = re * stepRe - im * stepIm;
+            im = re * stepIm + im * stepRe;
+            re = r;
+        }
+        z.mixedEnd += count;
+
+        // Every zoom sample whose newest input has arrived
+        for (; z.zoomedEnd * D < z.mixedEnd; z.zoomedEnd++) {
+            const int64_t top = z.zoomedEnd * D;
+            float accRe = 0.0f, accIm = 0.0f;
+            for (int t = 0; t < taps; t++) {
+                const size_t k = (size_t)(top - t) & mixMask;
+                accRe += h[t] * z.mixed[2 * k];
+                accIm += h[t] * z.mixed[2 * k + 1];
+            }
+            const size_t o = (size_t)z.zoomedEnd & outMask;
+            z.zoomed[2 * o] = accRe;
+            z.zoomed[2 * o + 1] = accIm;
+        }
+    }
+}
 
-    glDisable(GL_BLEND);
-    glEnable(GL_DEPTH_TEST);
+// Analyse the zoom band of the frame at writeHead into gZoom.mags. Returns
+// whether the line carries a zoom plane (it stays silent until the plan and a
+// source exist). Caller must hold gAnalysisMutex.
+static bool processZoomFrame(int64_t writeHead) {
+    ZoomState& z = gZoom;
+    z.frameReady = false;
+    if (!zoomEnabled) return false;
+    const bool capturing = gCaptureActive.load(std::memory_order_relaxed);
+    if (!capturing && wavFile->empty()) return true;
+    if (!gZoomPlan.plan || gZoomPlan.size != zoomFFTSize) return true;  // Made next UI frame
+
+    prepareZoom();
+    const int m = z.fftSize;
+    const int64_t D = z.decimation;
+
+    // Zoom sample j is the filter output at source sample j * D, which lags
+    // the input by half the filter. Live input ends the window at the newest
+    // frame; file playback centres it on the audible sample.
+    int64_t start;
+    if (capturing) {
+        start = floorDiv(writeHead - 1, D) - m + 1;
+    } else {
+        const int64_t centre = writeHead - (int64_t)(gLatencySamplesBase + gLatencyAdjust);
+        start = floorDiv(centre + (int64_t)(z.taps.size() / 2), D) - m / 2;
+    }
+    feedZoom(start, capturing);
 
-    // Restore projection matrices
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
+    const size_t mask = z.zoomed.size() / 2 - 1;
+    for (int i = 0; i < m; i++) {
+        const size_t k = (size_t)(start + i) & mask;
+        gZoomPlan.input[i][0] = z.zoomed[2 * k] * z.window[(size_t)i];
+        gZoomPlan.input[i][1] = z.zoomed[2 * k + 1] * z.window[(size_t)i];
+    }
+    fftwf_execute(gZoomPlan.plan);
 
-    // Restore viewport and scissor state
-    glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
+    // Negative offsets first, so mags ascend in frequency with DC at m / 2
+    computeMagnitudes(gZoomPlan.output + m / 2, z.mags.data(), m / 2, z.windowScale);
+    computeMagnitudes(gZoomPlan.output, z.mags.data() + m / 2, m / 2, z.windowScale);
+    z.frameReady = true;
+    return true;
+}
 
-    if (scissorWasEnabled) {
-        glEnable(GL_SCISSOR_TEST);
-        glScissor(oldScissor[0], oldScissor[1], oldScissor[2], oldScissor[3]);
-    } else {
-        glDisable(GL_SCISSOR_TEST);
+// The zoom plane of the last processZoomFrame(), silent when it had no frame
+static void buildZoomLine(float* out) {
+    const ZoomState& z = gZoom;
+    if (!z.frameReady || z.bars != NUM_BARS) {
+        std::fill(out, out + NUM_BARS, 0.0f);
+        return;
     }
+    mapSpectrumToLine(z.mags.data(), out, z.bin0.data(), z.bin1.data(), z.frac.data(), z.split);
 }
 
-// ===================== OPTIMIZED: Traditional 2D Spectrogram Rendering =====================
-// Initialize or resize texture
-void initSpectrogramTexture(int width, int height) {
-    if (spectrogramTexture == 0) {
-        glGenTextures(1, &spectrogramTexture);
+// Change the zoom band from the GUI thread
+static void setZoomBand(bool enabled, float loHz, float hiHz, int fftSize) {
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+    zoomEnabled = enabled;
+    zoomLoHz = std::min(loHz, hiHz);
+    zoomHiHz = std::max(loHz, hiHz);
+    zoomFFTSize = fftSize;
+}
+
+// ===================== Compare Files =====================
+// Other files can be analysed next to the loaded one, each in its own history
+// plane after the channel and zoom planes, at the same playback position. Each
+// compare file is a SpectrogramEngine at the current FFT size, hop, bar count
+// and window. The engines share the library's work-stealing pool and plan
+// cache, so three compare files add no threads and one FFT plan per size.
+//
+// Each hop the analysis thread first decodes every compare file a few hops
+// ahead of playback and pushes the samples into its engine, holding only
+// gCompareMutex (stageCompareInput). The pool analyses them meanwhile. Under
+// gAnalysisMutex the thread then only pops the finished line
+// (buildCompareLines), so no file I/O or pool wait holds up the UI thread.
+static constexpr int COMPARE_LOOKAHEAD_HOPS = 8;  // Lines the pool may analyse ahead of playback
+static constexpr int COMPARE_FEED_CHUNK = 4096;   // Frames per decode
+
+struct CompareStream {
+    std::string path;
+    SNDFILE* snd = nullptr;
+    int channels = 1;
+    int sampleRate = 0;
+    int64_t frames = 0;
+    std::unique_ptr<SpectrogramEngine> engine;  // Null while the file cannot follow the loaded one
+
+    // Analysis thread only
+    int64_t base = 0;         // File frame of the engine's sample 0
+    int64_t fed = 0;          // One past the last frame pushed
+    int64_t decoderAt = -1;   // Frame the decoder reads next, -1 = unusable
+    bool following = false;   // 'expected' is valid; false = restart the engine
+    int64_t expected = 0;     // Window start of the next line
+    bool staged = false;      // The engine was fed for the window at 'stagedStart'
+    int64_t stagedStart = 0;
+    std::vector<float> feed;  // Interleaved decode staging
+};
+
+// Analysis settings the engines were made for
+struct CompareSettings {
+    int fftSize = 0;
+    int hop = 0;
+    int bars = 0;
+    int window = -1;
+    uint32_t sampleRate = 0;
+
+    bool operator==(const CompareSettings& o) const {
+        return fftSize == o.fftSize && hop == o.hop && bars == o.bars && window == o.window &&
+               sampleRate == o.sampleRate;
     }
+};
 
-    if (texWidth != width || texHeight != height) {
-        texWidth = width;
-        texHeight = height;
-        textureData.resize((size_t)width * (size_t)height * 3); // RGB format
+// Window placement of the last line, for staging the next one before
+// gAnalysisMutex is taken. Written under it; analysis thread only.
+struct CompareFeed {
+    bool playing = false;
+    int64_t offset = 0;  // Window start = writeHead - offset
+    int fftSize = 0;
+    int64_t hop = 0;
+};
 
-        glBindTexture(GL_TEXTURE_2D, spectrogramTexture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+// gCompare membership and the engine pointers change only on the UI thread,
+// holding gCompareMutex and then gAnalysisMutex, so the UI may read them with
+// neither and the analysis thread with either. The analysis thread never
+// holds both. The UI takes gCompareMutex only to add, remove or swap engines.
+static std::mutex gCompareMutex;
+static std::vector<std::unique_ptr<CompareStream>> gCompare;
+static uint64_t gCompareGeneration = 0;   // Bumped when gCompare membership changes (UI thread)
+static CompareSettings gCompareSettings;  // What the engines in gCompare were made for (UI thread)
+static CompareFeed gCompareFeed;
+
+// SpectrogramEngine::create() and the engine destructor take the planner
+// lock, which the background planner can hold for a whole FFTW_MEASURE plan.
+// So the UI thread neither makes nor destroys compare engines: one builder
+// thread at a time makes the engines for the wanted settings and destroys the
+// ones retired since the last build.
+struct CompareBuild {
+    std::thread thread;
+    std::atomic<bool> done{false};
+    bool make = false;             // false = only destroy 'retired'
+    uint64_t generation = 0;       // gCompareGeneration the engines were made for
+    CompareSettings settings;
+    std::vector<int> rates;        // Sample rate per compare file, in gCompare order
+    std::vector<std::unique_ptr<SpectrogramEngine>> engines;  // Made by the thread
+    std::vector<std::unique_ptr<SpectrogramEngine>> retired;  // Destroyed by the thread
+};
+static CompareBuild gCompareBuild;                                       // UI thread
+static std::vector<std::unique_ptr<SpectrogramEngine>> gCompareRetired;  // For the next build (UI thread)
+
+static void compareBuildMain(CompareBuild* build, SpectrogramEngineConfig config) {
+    build->retired.clear();
+    if (build->make) {
+        for (size_t i = 0; i < build->rates.size(); i++) {
+            if (build->rates[i] == config.sampleRate) build->engines[i] = SpectrogramEngine::create(config);
+        }
     }
+    build->done.store(true, std::memory_order_release);
 }
 
-// OPTIMIZED: Texture-based rendering (10-50x faster than the old quad-based method)
-static void renderTraditionalSpectrogram(int vpX, int vpY, int vpW, int vpH) {
-    // Limit texture width for performance (optional but recommended for very wide viewports)
-    const int maxTexWidth = 2048;
-    int texW = std::min(vpW, maxTexWidth);
-    int texH = NUM_BARS;
+// Open 'path' as a compare file (UI thread). Its engine is made by a later
+// updateCompareEngines().
+static bool addCompareFile(const std::string& path) {
+    if ((int)gCompare.size() >= MAX_COMPARE_FILES) {
+        std::cerr << "Error: At most " << MAX_COMPARE_FILES << " compare files can be open\n";
+        return false;
+    }
+    SF_INFO info;
+    memset(&info, 0, sizeof(info));
+    SNDFILE* snd = sf_open(path.c_str(), SFM_READ, &info);
+    if (!snd) {
+        std::cerr << "Error: Could not open compare file " << path << ": " << sf_strerror(nullptr) << "\n";
+        return false;
+    }
 
-    // Initialize texture if needed
-    initSpectrogramTexture(texW, texH);
+    std::unique_ptr<CompareStream> c(new CompareStream());
+    c->path = path;
+    c->snd = snd;
+    c->channels = std::max(1, info.channels);
+    c->sampleRate = info.samplerate;
+    c->frames = (int64_t)info.frames;
+    c->feed.resize((size_t)COMPARE_FEED_CHUNK * (size_t)c->channels);
+    {
+        std::lock_guard<std::mutex> compareLock(gCompareMutex);
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        gCompare.push_back(std::move(c));
+    }
+    gCompareGeneration++;
+    gCompareSettings = CompareSettings();  // Make the new file's engine
+    return true;
+}
 
-    // Update color LUT if color settings changed
-    updateColorLUT();
+static void removeCompareFile(size_t index) {
+    if (index >= gCompare.size()) return;
+    std::unique_ptr<CompareStream> gone;
+    {
+        std::lock_guard<std::mutex> compareLock(gCompareMutex);
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        gone = std::move(gCompare[index]);
+        gCompare.erase(gCompare.begin() + (std::ptrdiff_t)index);
+    }
+    gCompareGeneration++;
+    if (gone->engine) gCompareRetired.push_back(std::move(gone->engine));
+    if (gone->snd) sf_close(gone->snd);
+}
 
-    int effectiveHistory = historyFillCount;
-    if (effectiveHistory <= 0) effectiveHistory = 1;
-    if (effectiveHistory > HISTORY_LINES) effectiveHistory = HISTORY_LINES;
-    const int historyToUse = HISTORY_LINES;
+// Shutdown: waits for the builder and destroys everything here
+static void closeCompareFiles() {
+    if (gCompareBuild.thread.joinable()) gCompareBuild.thread.join();
+    std::vector<std::unique_ptr<CompareStream>> gone;
+    {
+        std::lock_guard<std::mutex> compareLock(gCompareMutex);
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        gone.swap(gCompare);
+    }
+    for (size_t i = 0; i < gone.size(); i++) {
+        gone[i]->engine.reset();  // Waits for its pool task
+        if (gone[i]->snd) sf_close(gone[i]->snd);
+    }
+    gCompareBuild.engines.clear();
+    gCompareRetired.clear();
+}
 
-    // Build texture data on CPU using color LUT (OPTIMIZED)
-    // Map time so newest data (histIdx=0) appears on the RIGHT edge (matching audio playback)
-    for (int px = 0; px < texW; px++) {
-        // Reverse mapping: px=0 is oldest (left), px=texW-1 is newest (right)
-        float t = (texW <= 1) ? 0.0f : (float)px / (float)(texW - 1);
-        int histIdx = (historyToUse <= 1) ? 0 : (int)std::lround(t * (float)(historyToUse - 1));
-        histIdx = std::max(0, std::min(histIdx, HISTORY_LINES - 1));
+// Collect a finished build and start the next one when the analysis
+// settings changed or engines wait to be destroyed. Called from the UI thread
+// every frame; never waits for the planner.
+static void updateCompareEngines() {
+    if (gCompareBuild.thread.joinable()) {
+        if (!gCompareBuild.done.load(std::memory_order_acquire)) return;
+        gCompareBuild.thread.join();
+        // Files added or removed meanwhile: the settings stay stale and the
+        // next build makes engines for the new list
+        if (gCompareBuild.make && gCompareBuild.generation == gCompareGeneration) {
+            {
+                std::lock_guard<std::mutex> compareLock(gCompareMutex);
+                std::lock_guard<std::mutex> lock(gAnalysisMutex);
+                for (size_t i = 0; i < gCompare.size(); i++) {
+                    std::swap(gCompare[i]->engine, gCompareBuild.engines[i]);
+                    gCompare[i]->following = false;
+                    gCompare[i]->staged = false;
+                }
+            }
+            gCompareSettings = gCompareBuild.settings;
+        }
+        for (size_t i = 0; i < gCompareBuild.engines.size(); i++) {
+            if (gCompareBuild.engines[i]) gCompareRetired.push_back(std::move(gCompareBuild.engines[i]));
+        }
+        gCompareBuild.engines.clear();
+    }
 
-        for (int i = 0; i < NUM_BARS; i++) {
-            float v = lineHistory[histIdx * NUM_BARS + i];
+    CompareSettings want;
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        want.fftSize = fftPlanSize;
+        want.bars = NUM_BARS;
+        want.window = windowType;
+    }
+    want.hop = std::max(1, ANALYSIS_HOP.load(std::memory_order_relaxed));
+    want.sampleRate = analysisSampleRate();
+    const bool make = !gCompare.empty() && !(want == gCompareSettings);
+    if (!make && gCompareRetired.empty()) return;
+
+    SpectrogramEngineConfig config;
+    config.sampleRate = (int)want.sampleRate;
+    config.fftSize = want.fftSize;
+    config.hop = want.hop;
+    config.numBars = want.bars;
+    config.historyLines = 1;  // Lines go to the viewer's history
+    config.lineCapacity = 4 * COMPARE_LOOKAHEAD_HOPS;
+    config.window = want.window;
+    config.minFreq = MIN_FREQ;
+    config.magGain = MAG_GAIN;
+
+    gCompareBuild.done.store(false, std::memory_order_relaxed);
+    gCompareBuild.make = make;
+    gCompareBuild.generation = gCompareGeneration;
+    gCompareBuild.settings = want;
+    gCompareBuild.rates.clear();
+    for (size_t i = 0; i < gCompare.size(); i++) gCompareBuild.rates.push_back(gCompare[i]->sampleRate);
+    gCompareBuild.engines.clear();
+    gCompareBuild.engines.resize(make ? gCompare.size() : 0);
+    gCompareBuild.retired.swap(gCompareRetired);
+    gCompareBuild.thread = std::thread(compareBuildMain, &gCompareBuild, config);
+}
 
-            // Use color LUT instead of calculating (FAST)
-            int lutIdx = (int)(v * (COLOR_LUT_SIZE - 1));
-            lutIdx = std::max(0, std::min(lutIdx, COLOR_LUT_SIZE - 1));
+// Push frames up to 'until': zeros before the file start and past its end
+static void feedCompare(CompareStream& c, int64_t until) {
+    while (c.fed < until) {
+        int64_t count = std::min<int64_t>(until - c.fed, COMPARE_FEED_CHUNK);
+        int64_t got = 0;
+        if (c.fed < 0) {
+            count = std::min<int64_t>(count, -c.fed);
+        } else if (c.fed < c.frames && c.decoderAt == c.fed) {
+            got = (int64_t)sf_readf_float(c.snd, c.feed.data(), (sf_count_t)count);
+            c.decoderAt = got > 0 ? c.decoderAt + got : -1;
+        }
+        std::fill(c.feed.begin() + (std::ptrdiff_t)(got * c.channels),
+                  c.feed.begin() + (std::ptrdiff_t)(count * c.channels), 0.0f);
+        c.engine->pushInterleaved(c.feed.data(), (size_t)count, c.channels);
+        c.fed += count;
+    }
+}
 
-            // Store in texture data
-            int texIdx = (i * texW + px) * 3;
-            textureData[(size_t)texIdx + 0] = colorLUT[(size_t)lutIdx][0];
-            textureData[(size_t)texIdx + 1] = colorLUT[(size_t)lutIdx][1];
-            textureData[(size_t)texIdx + 2] = colorLUT[(size_t)lutIdx][2];
+// Feed every compare engine for the line at writeHead, placed like the last
+// line. Playback moves one hop per line; anything else (seek, loop wrap,
+// resync, new settings) restarts the engine at the new window. Analysis
+// thread, before it takes gAnalysisMutex.
+static void stageCompareInput(int64_t writeHead) {
+    const CompareFeed f = gCompareFeed;
+    const int64_t start = writeHead - f.offset;
+    std::lock_guard<std::mutex> compareLock(gCompareMutex);
+    for (size_t i = 0; i < gCompare.size(); i++) {
+        CompareStream& c = *gCompare[i];
+        c.staged = f.playing && c.engine && c.engine->config().fftSize == f.fftSize &&
+                   c.engine->config().hop == f.hop;
+        if (!c.staged) {
+            c.following = false;
+            continue;
         }
+        if (!c.following || start != c.expected) {
+            c.engine->reset();
+            c.base = c.fed = start;
+            const int64_t seekTo = std::max<int64_t>(0, start);
+            c.decoderAt = (seekTo < c.frames && sf_seek(c.snd, (sf_count_t)seekTo, SEEK_SET) == seekTo) ? seekTo : -1;
+        }
+        c.following = true;
+        c.expected = start + f.hop;
+        c.stagedStart = start;
+        feedCompare(c, start + f.fftSize + COMPARE_LOOKAHEAD_HOPS * f.hop);
     }
+}
 
-    // Upload texture to GPU (single fast DMA transfer instead of millions of vertices)
-    glBindTexture(GL_TEXTURE_2D, spectrogramTexture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texW, texH, GL_RGB, GL_UNSIGNED_BYTE, textureData.data());
+// The finished line of window 'start', or silence while the pool is behind
+static void popCompareLine(CompareStream& c, int64_t start, float* out) {
+    uint64_t stamp = 0;
+    while (c.engine->popLine(out, &stamp)) {
+        if (c.base + (int64_t)stamp >= start) return;  // Older lines are ones the thread skipped
+    }
+    std::fill(out, out + NUM_BARS, 0.0f);
+}
 
-    // Set up rendering state
-    int windowWidth = 0, windowHeight = 0;
-    GLFWwindow* ctx = glfwGetCurrentContext();
-    glfwGetWindowSize(ctx, &windowWidth, &windowHeight);
+// One plane per compare file for the line the loaded file gets at writeHead,
+// silent while a file has no engine for the current settings or its line was
+// staged for another window. Returns how many planes were written. Caller
+// must hold gAnalysisMutex.
+static int buildCompareLines(float* out, int64_t writeHead) {
+    CompareFeed& f = gCompareFeed;
+    f.playing = !gCaptureActive.load(std::memory_order_relaxed) && !wavFile->empty();
+    f.hop = std::max(1, ANALYSIS_HOP.load(std::memory_order_relaxed));
+    f.fftSize = fftPlanSize;
+    // Window placement of processAudioFrameSynced()
+    f.offset = (int64_t)(gLatencySamplesBase + gLatencyAdjust) + fftPlanSize / 2;
+    const int64_t start = writeHead - f.offset;
+
+    for (size_t i = 0; i < gCompare.size(); i++) {
+        CompareStream& c = *gCompare[i];
+        float* line = out + i * (size_t)NUM_BARS;
+        if (f.playing && c.staged && c.stagedStart == start && c.engine && c.engine->numBars() == NUM_BARS) {
+            popCompareLine(c, start, line);
+        } else {
+            std::fill(line, line + NUM_BARS, 0.0f);
+        }
+    }
+    return (int)gCompare.size();
+}
 
-    glViewport(0, 0, windowWidth, windowHeight);
-    glEnable(GL_SCISSOR_TEST);
-    glScissor(vpX, vpY, vpW, vpH);
+// ===================== Running Statistics =====================
+// Peak-hold, average and noise-floor traces for channel 0, drawn over both
+// views. buildCurrentLine() updates one accumulator per bar per line, so the
+// cost is O(NUM_BARS) per line whatever the history depth:
+//   peak   max(v, peak - decay)          linear decay in display units
+//   mean   mean + alpha * (v - mean)     EMA with time constant statsTime
+//   floor  floor + (v < floor ? -(1 - p) : p) * rate
+// 'floor' is a stochastic-approximation quantile. It settles where a
+// fraction p of lines fall below it, and it keeps tracking as the floor
+// moves. P^2 markers never forget and branch per bin, so they are not used.
+struct RunningStats {
+    bool enabled = false;        // Any overlay shown (gAnalysisMutex)
+    float peakDecay = 0.25f;     // Display units per second (0 = hold forever)
+    float statsTime = 2.0f;      // Seconds, EMA and floor tracking speed
+    float floorPercentile = 0.10f;
+    bool resetPending = true;
+    int bars = 0;
+    uint32_t mappingVersion = 0;
+    std::vector<float> peak, mean, floor;
+};
 
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
+static RunningStats gStats;             // Analysis thread, under gAnalysisMutex
+static std::mutex gStatsMutex;
+static std::vector<float> gStatsPublished;  // peak | mean | floor rows, guarded by gStatsMutex
+static uint64_t gStatsPublishedVersion = 0;
+
+// UI side
+static bool showPeakHold = false;
+static bool showAverage = false;
+static bool showNoiseFloor = false;
+static float statsPeakDecay = 0.25f;        // Slider copies of the RunningStats settings
+static float statsTime = 2.0f;
+static float statsFloorPercent = 10.0f;
+static std::vector<float> gStatsView;       // Copy of gStatsPublished drawn by the views
+static uint64_t gStatsViewVersion = 0;
+
+static void runningStatsKernel(const float* v, float* peak, float* mean, float* floor, int count,
+                               float decay, float alpha, float up, float down) {
+    int i = 0;
+#if defined(SPECTROGRAM_SSE2)
+    const __m128 vdecay = _mm_set1_ps(decay), valpha = _mm_set1_ps(alpha);
+    const __m128 vup = _mm_set1_ps(up), vdown = _mm_set1_ps(-down);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        const __m128 x = _mm_loadu_ps(v + i);
+        _mm_storeu_ps(peak + i, _mm_max_ps(x, _mm_sub_ps(_mm_loadu_ps(peak + i), vdecay)));
+        const __m128 m = _mm_loadu_ps(mean + i);
+        _mm_storeu_ps(mean + i, _mm_add_ps(m, _mm_mul_ps(valpha, _mm_sub_ps(x, m))));
+        const __m128 f = _mm_loadu_ps(floor + i);
+        const __m128 below = _mm_cmplt_ps(x, f);
+        const __m128 step = _mm_or_ps(_mm_and_ps(below, vdown), _mm_andnot_ps(below, vup));
+        _mm_storeu_ps(floor + i, _mm_min_ps(_mm_max_ps(_mm_add_ps(f, step), zero), one));
+    }
+#elif defined(SPECTROGRAM_NEON)
+    const float32x4_t vdecay = vdupq_n_f32(decay), valpha = vdupq_n_f32(alpha);
+    const float32x4_t vup = vdupq_n_f32(up), vdown = vdupq_n_f32(-down);
+    const float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        const float32x4_t x = vld1q_f32(v + i);
+        vst1q_f32(peak + i, vmaxq_f32(x, vsubq_f32(vld1q_f32(peak + i), vdecay)));
+        const float32x4_t m = vld1q_f32(mean + i);
+        vst1q_f32(mean + i, vmlaq_f32(m, valpha, vsubq_f32(x, m)));
+        const float32x4_t f = vld1q_f32(floor + i);
+        const float32x4_t step = vbslq_f32(vcltq_f32(x, f), vdown, vup);
+        vst1q_f32(floor + i, vminq_f32(vmaxq_f32(vaddq_f32(f, step), zero), one));
+    }
+#endif
+    for (; i < count; i++) {
+        const float x = v[i];
+        peak[i] = std::max(x, peak[i] - decay);
+        mean[i] += alpha * (x - mean[i]);
+        floor[i] = clampf(floor[i] + (x < floor[i] ? -down : up), 0.0f, 1.0f);
+    }
+}
+
+// Analysis thread (gAnalysisMutex held): fold channel 0's new line in
+static void updateRunningStats(const float* line) {
+    RunningStats& s = gStats;
+    if (!s.enabled) return;
+    if (s.resetPending || s.bars != NUM_BARS || s.mappingVersion != gMappingVersion) {
+        s.peak.assign(line, line + NUM_BARS);
+        s.mean.assign(line, line + NUM_BARS);
+        s.floor.assign(line, line + NUM_BARS);
+        s.bars = NUM_BARS;
+        s.mappingVersion = gMappingVersion;
+        s.resetPending = false;
+    } else {
+        const float period = (float)std::max(1, ANALYSIS_HOP.load(std::memory_order_relaxed)) /
+                             (float)std::max<uint32_t>(1, analysisSampleRate());
+        const float alpha = 1.0f - std::exp(-period / std::max(0.05f, s.statsTime));
+        const float rate = 0.5f * period / std::max(0.05f, s.statsTime);
+        runningStatsKernel(line, s.peak.data(), s.mean.data(), s.floor.data(), NUM_BARS,
+                           s.peakDecay * period, alpha, rate * s.floorPercentile, rate * (1.0f - s.floorPercentile));
+    }
+
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    gStatsPublished.resize((size_t)NUM_BARS * 3);
+    std::memcpy(&gStatsPublished[0], s.peak.data(), sizeof(float) * NUM_BARS);
+    std::memcpy(&gStatsPublished[(size_t)NUM_BARS], s.mean.data(), sizeof(float) * NUM_BARS);
+    std::memcpy(&gStatsPublished[(size_t)NUM_BARS * 2], s.floor.data(), sizeof(float) * NUM_BARS);
+    gStatsPublishedVersion++;
+}
+
+static void setRunningStats(bool enabled, float peakDecay, float statsTime, float floorPercentile) {
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+    if (enabled && !gStats.enabled) gStats.resetPending = true;
+    gStats.enabled = enabled;
+    gStats.peakDecay = peakDecay;
+    gStats.statsTime = statsTime;
+    gStats.floorPercentile = floorPercentile;
+}
+
+static void resetRunningStats() {
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+    gStats.resetPending = true;
+}
+
+// UI thread: pick up the newest traces (skips the copy when nothing changed)
+static bool refreshStatsView() {
+    if (!showPeakHold && !showAverage && !showNoiseFloor) return false;
+    std::lock_guard<std::mutex> lock(gStatsMutex);
+    if (gStatsPublishedVersion == gStatsViewVersion || gStatsPublished.size() != (size_t)NUM_BARS * 3) return false;
+    gStatsView = gStatsPublished;
+    gStatsViewVersion = gStatsPublishedVersion;
+    return true;
+}
+
+static const float kStatsColors[3][4] = {
+    { 1.00f, 0.35f, 0.25f, 0.95f },  // Peak hold
+    { 1.00f, 1.00f, 1.00f, 0.85f },  // Average
+    { 0.30f, 0.85f, 1.00f, 0.85f },  // Noise floor
+};
 
+static bool statsTraceShown(int trace) {
+    return trace == 0 ? showPeakHold : (trace == 1 ? showAverage : showNoiseFloor);
+}
+
+// 3D: traces stand on the front row of the waterfall (current modelview)
+static void drawStatsOverlay3D() {
+    if (gStatsView.size() != (size_t)NUM_BARS * 3) return;
+    const float z = Z_SPAN * 0.5f;
+    for (int t = 0; t < 3; t++) {
+        if (!statsTraceShown(t)) continue;
+        const float* trace = &gStatsView[(size_t)t * (size_t)NUM_BARS];
+        glColor4fv(kStatsColors[t]);
+        glBegin(GL_LINE_STRIP);
+        for (int i = 0; i < NUM_BARS; i++) glVertex3f(gBarX[(size_t)i], trace[i] * yScale, z);
+        glEnd();
+    }
+}
+
+// 2D: a spectrum strip along the newest (right) edge, frequency on the
+// vertical axis like the heat map, level growing to the left
+static void drawStatsOverlay2D(int vpX, int vpY, int vpW, int vpH) {
+    if (gStatsView.size() != (size_t)NUM_BARS * 3) return;
+    if (!showPeakHold && !showAverage && !showNoiseFloor) return;
+    int windowWidth = 0, windowHeight = 0;
+    glfwGetWindowSize(glfwGetCurrentContext(), &windowWidth, &windowHeight);
+    glViewport(0, 0, windowWidth, windowHeight);
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
     glLoadIdentity();
     glOrtho(0, windowWidth, 0, windowHeight, -1, 1);
-
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
     glLoadIdentity();
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Draw SINGLE textured quad (instead of millions of quads!)
-    // Standard texture coordinates: low freq (row 0) at bottom, high freq at top
-    glColor3f(1.0f, 1.0f, 1.0f);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0.0f, 0.0f); glVertex2f((float)vpX, (float)vpY);                    // bottom-left
-    glTexCoord2f(1.0f, 0.0f); glVertex2f((float)vpX + vpW, (float)vpY);              // bottom-right
-    glTexCoord2f(1.0f, 1.0f); glVertex2f((float)vpX + vpW, (float)vpY + vpH);        // top-right
-    glTexCoord2f(0.0f, 1.0f); glVertex2f((float)vpX, (float)vpY + vpH);              // top-left
-    glEnd();
-
-    glDisable(GL_TEXTURE_2D);
+    const float right = (float)(vpX + vpW);
+    const float width = (float)vpW * 0.25f;
+    for (int t = 0; t < 3; t++) {
+        if (!statsTraceShown(t)) continue;
+        const float* trace = &gStatsView[(size_t)t * (size_t)NUM_BARS];
+        glColor4fv(kStatsColors[t]);
+        glBegin(GL_LINE_STRIP);
+        for (int i = 0; i < NUM_BARS; i++) {
+            glVertex2f(right - trace[i] * width, (float)vpY + ((float)i + 0.5f) / (float)NUM_BARS * (float)vpH);
+        }
+        glEnd();
+    }
 
+    glDisable(GL_BLEND);
     glPopMatrix();
     glMatrixMode(GL_PROJECTION);
     glPopMatrix();
     glMatrixMode(GL_MODELVIEW);
+}
+
+// ===================== Analysis Thread =====================
+// Spectrum lines are produced by a dedicated worker every ANALYSIS_HOP samples of
+// playback, independent of the render loop's frame rate. Finished lines are handed
+// to the render thread through a lock-free single-producer/single-consumer ring.
+class LineQueue {
+public:
+    void init(int capacity, int lineSize) {
+        slots = (size_t)capacity + 1;  // One slot stays empty to tell full from empty
+        stride = (size_t)lineSize;
+        data.assign(slots * stride, 0.0f);
+        stamps.assign(slots, 0);
+        lineCounts.assign(slots, 1);
+        writeIndex.store(0, std::memory_order_relaxed);
+        readIndex.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return slots - 1; }
+
+    // Producer: slot to fill, or nullptr when the ring is full
+    float* beginWrite() {
+        size_t head = writeIndex.load(std::memory_order_relaxed);
+        if ((head + 1) % slots == readIndex.load(std::memory_order_acquire)) return nullptr;
+        return &data[head * stride];
+    }
+
+    // 'stamp' travels with the line (the write head it was analysed at), and
+    // 'lines' says how many channel rows the slot holds
+    void commitWrite(uint64_t stamp = 0, int lines = 1) {
+        size_t head = writeIndex.load(std::memory_order_relaxed);
+        stamps[head] = stamp;
+        lineCounts[head] = lines;
+        writeIndex.store((head + 1) % slots, std::memory_order_release);
+    }
+
+    // Consumer: oldest unread line, or nullptr when empty
+    const float* front() const {
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        if (tail == writeIndex.load(std::memory_order_acquire)) return nullptr;
+        return &data[tail * stride];
+    }
+
+    uint64_t frontStamp() const {
+        return stamps[readIndex.load(std::memory_order_relaxed)];
+    }
+
+    int frontLines() const {
+        return lineCounts[readIndex.load(std::memory_order_relaxed)];
+    }
+
+    void pop() {
+        size_t tail = readIndex.load(std::memory_order_relaxed);
+        readIndex.store((tail + 1) % slots, std::memory_order_release);
+    }
+
+    // Consumer: discard everything published so far
+    void clear() {
+        readIndex.store(writeIndex.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    std::vector<float> data;
+    std::vector<uint64_t> stamps;
+    std::vector<int> lineCounts;
+    size_t slots = 1;
+    size_t stride = 0;
+    std::atomic<size_t> writeIndex{0};
+    std::atomic<size_t> readIndex{0};
+};
+
+static constexpr int LINE_QUEUE_CAPACITY = 256;  // Lines buffered between analysis and render
+static LineQueue gLineQueue;
+static std::thread gAnalysisThread;
+static std::atomic<bool> gAnalysisRunning{false};
+static std::atomic<bool> gLineWakePending{false};  // A wake-up was posted and the UI has not drained since
+
+static void publishNetworkLine(const float* line, int numBars, uint32_t sampleRate, uint64_t position);
+static void analysisThreadMain() {
+    int64_t nextPos = -1;  // Write-head position of the next line, -1 = resync
+
+    while (gAnalysisRunning.load(std::memory_order_acquire)) {
+        const bool capturing = gCaptureActive.load(std::memory_order_acquire);
+        if (!capturing && (!isPlaying || isPaused.load(std::memory_order_relaxed))) {
+            nextPos = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+
+        const int64_t hop = std::max(1, ANALYSIS_HOP.load(std::memory_order_relaxed));
+        const int64_t target = capturing ? (int64_t)gCaptureRing.written()
+                                         : (int64_t)playbackPosition.load(std::memory_order_relaxed);
+
+        // Resync after start, seek, loop wrap, or when the renderer fell too far behind
+        if (nextPos < 0 || nextPos > target + hop ||
+            target - nextPos > hop * (int64_t)gLineQueue.capacity()) {
+            nextPos = target;
+        }
+
+        bool produced = false;
+        while (nextPos <= target) {
+            float* slot = gLineQueue.beginWrite();
+            if (!slot) break;  // Renderer is behind - retry next pass
+
+            stageCompareInput(nextPos);  // File I/O stays outside gAnalysisMutex
+            int lines = 1;
+            int bars = 0;             // Read under the lock: the UI thread swaps wavFile and NUM_BARS
+            uint32_t sampleRate = 0;
+            {
+                std::lock_guard<std::mutex> lock(gAnalysisMutex);
+                bars = NUM_BARS;
+                sampleRate = analysisSampleRate();
+                bool zoomed = false;
+                {
+                    ScopedStageTimer timer(STAGE_FFT);
+                    lines = processAudioFrameSynced(nextPos);
+                    zoomed = processZoomFrame(nextPos);
+                }
+                ScopedStageTimer timer(STAGE_LINE_BUILD);
+                buildCurrentLine(slot, lines);
+                if (zoomed) buildZoomLine(slot + (size_t)lines++ * (size_t)NUM_BARS);
+                lines += buildCompareLines(slot + (size_t)lines * (size_t)NUM_BARS, nextPos);
+            }
+            publishNetworkLine(slot, bars, sampleRate, (uint64_t)std::max<int64_t>(0, nextPos));
+            gLineQueue.commitWrite((uint64_t)std::max<int64_t>(0, nextPos), lines);
+            nextPos += hop;
+            produced = true;
+        }
+        // Wake the UI out of glfwWaitEvents at most once per drain
+        if (produced && !gLineWakePending.exchange(true)) glfwPostEmptyEvent();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+static void startAnalysisThread() {
+    gLineQueue.init(LINE_QUEUE_CAPACITY, NUM_BARS * MAX_HISTORY_PLANES);
+    gAnalysisRunning.store(true, std::memory_order_release);
+    gAnalysisThread = std::thread(analysisThreadMain);
+}
+
+static void stopAnalysisThread() {
+    gAnalysisRunning.store(false, std::memory_order_release);
+    if (gAnalysisThread.joinable()) gAnalysisThread.join();
+}
+
+// ===================== Network Streaming =====================
+// Publisher: every finished line (channel 0) goes out as UDP datagrams, to a
+// multicast group or a unicast host. Subscriber: a receiver thread takes the
+// place of the analysis thread and feeds gLineQueue straight from the network,
+// so the viewer needs no audio and runs no FFT.
+//
+// Datagram (little endian):
+//   0  "SPL1"          magic
+//   4  u8  version     1
+//   5  u8  bits        8 or 16 (quantisation of the 0..1 line values)
+//   6  u8  chunk       index of this datagram within the line
+//   7  u8  chunks      datagrams carrying the line
+//   8  u32 stream      random per publisher run
+//   12 u32 sequence    line number
+//   16 u64 position    playbackPosition the line was analysed at
+//   24 u32 sampleRate
+//   28 u16 bars        bars in the whole line
+//   30 u16 firstBar    first bar in this datagram
+//   32 u16 barCount
+//   34 ..  payload     nibble-coded deltas between neighbouring bars
+// Each datagram restarts the delta chain, so a lost datagram costs only its
+// own bars (shown from the previous line) and nothing waits for a resend.
+// Deltas are zigzagged; nibbles 0-12 are literal, 13 + n is a run of n + 2
+// zeros, 14 + two nibbles and 15 + five nibbles are escapes.
+static constexpr int NET_HEADER_BYTES = 34;
+static constexpr int NET_MAX_DATAGRAM = 1200;        // Stays below common MTUs, tunnels included
+static constexpr int NET_ASSEMBLY_TIMEOUT_MS = 30;   // Publish a partial line after this long
+static constexpr int NET_RECV_TIMEOUT_MS = 10;
+static constexpr uint8_t NET_VERSION = 1;
+
+static std::string netPublishAddress;   // --publish host:port (empty = off)
+static std::string netSubscribeAddress; // --subscribe host:port (empty = off)
+static int netPublishBits = 8;          // --publish-bits 8|16
+static int netPublishTtl = 1;           // --publish-ttl, multicast hops
+
+#ifdef _WIN32
+typedef SOCKET NetSocket;
+static const NetSocket NET_INVALID_SOCKET = INVALID_SOCKET;
+static void closeNetSocket(NetSocket s) { closesocket(s); }
+#else
+typedef int NetSocket;
+static const NetSocket NET_INVALID_SOCKET = -1;
+static void closeNetSocket(NetSocket s) { close(s); }
+#endif
+
+struct NetStats {
+    std::atomic<uint64_t> lines{0};    // Published / received lines
+    std::atomic<uint64_t> bytes{0};    // Payload + header bytes sent / received
+    std::atomic<uint64_t> lost{0};     // Subscriber: sequence gaps
+    std::atomic<uint64_t> partial{0};  // Subscriber: lines shown with missing datagrams
+    std::atomic<uint64_t> dropped{0};  // Publisher: send failures / subscriber: queue full
+};
+
+struct NetPublisher {
+    NetSocket socket = NET_INVALID_SOCKET;
+    sockaddr_in target;
+    uint32_t stream = 0;
+    uint32_t sequence = 0;
+    std::vector<uint16_t> quantized;
+    std::vector<uint8_t> nibbles;
+    std::vector<uint8_t> datagram;
+};
+
+static std::atomic<bool> gNetPublishing{false};
+static NetPublisher gNetPublisher;  // Analysis thread once started
+static NetStats gNetPublishStats;
+
+static std::atomic<bool> gNetSubscribing{false};
+static std::thread gNetSubscriberThread;
+static NetStats gNetSubscribeStats;
+
+static bool netStartup() {
+#ifdef _WIN32
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) return false;
+        started = true;
+    }
+#endif
+    return true;
+}
+
+// "host:port" -> IPv4 address
+static bool parseNetAddress(const std::string& text, sockaddr_in& out) {
+    const size_t colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0) return false;
+    const std::string host = text.substr(0, colon);
+    const int port = std::atoi(text.c_str() + colon + 1);
+    if (port <= 0 || port > 65535) return false;
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result) return false;
+    memset(&out, 0, sizeof(out));
+    out = *(const sockaddr_in*)result->ai_addr;
+    out.sin_port = htons((uint16_t)port);
+    freeaddrinfo(result);
+    return true;
+}
+
+static bool isMulticast(const sockaddr_in& addr) {
+    return (ntohl(addr.sin_addr.s_addr) & 0xF0000000u) == 0xE0000000u;
+}
+
+static void putLE(uint8_t* p, uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t getLE(const uint8_t* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; i++) v |= (uint64_t)p[i] << (8 * i);
+    return v;
+}
+
+// Nibbles for one zigzagged delta
+static void appendDeltaNibbles(std::vector<uint8_t>& nibbles, uint32_t z) {
+    if (z <= 12) {
+        nibbles.push_back((uint8_t)z);
+    } else if (z <= 0xFF) {
+        nibbles.push_back(14);
+        nibbles.push_back((uint8_t)(z >> 4));
+        nibbles.push_back((uint8_t)(z & 15));
+    } else {
+        nibbles.push_back(15);
+        for (int shift = 16; shift >= 0; shift -= 4) nibbles.push_back((uint8_t)((z >> shift) & 15));
+    }
+}
+
+static inline uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+static inline int32_t unzigzag(uint32_t z) { return (int32_t)(z >> 1) ^ -(int32_t)(z & 1); }
+
+static bool startNetPublisher(const std::string& address) {
+    NetPublisher& p = gNetPublisher;
+    if (!netStartup() || !parseNetAddress(address, p.target)) {
+        std::cerr << "Error: Invalid --publish address: " << address << " (expected host:port)\n";
+        return false;
+    }
+    p.socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (p.socket == NET_INVALID_SOCKET) {
+        std::cerr << "Error: Cannot create UDP socket\n";
+        return false;
+    }
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(p.socket, FIONBIO, &nonBlocking);
+#else
+    fcntl(p.socket, F_SETFL, fcntl(p.socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    if (isMulticast(p.target)) {
+        const unsigned char ttl = (unsigned char)std::max(1, std::min(netPublishTtl, 255));
+        setsockopt(p.socket, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl, sizeof(ttl));
+    }
+    p.stream = (uint32_t)std::chrono::steady_clock::now().time_since_epoch().count() ^ (uint32_t)std::rand();
+    p.sequence = 0;
+    gNetPublishing.store(true, std::memory_order_release);
+    std::cout << "Publishing spectrum lines to " << address << " (" << netPublishBits << "-bit)\n";
+    return true;
+}
+
+static void stopNetPublisher() {
+    gNetPublishing.store(false, std::memory_order_release);
+    if (gNetPublisher.socket != NET_INVALID_SOCKET) closeNetSocket(gNetPublisher.socket);
+    gNetPublisher.socket = NET_INVALID_SOCKET;
+}
+
+static void sendNetChunk(NetPublisher& p, uint64_t position, uint32_t sampleRate, int bars, int firstBar,
+                         int barCount, int chunk, int chunks, size_t nibbleBegin, size_t nibbleEnd) {
+    const size_t payload = (nibbleEnd - nibbleBegin + 1) / 2;
+    p.datagram.assign(NET_HEADER_BYTES + payload, 0);
+    uint8_t* d = p.datagram.data();
+    memcpy(d, "SPL1", 4);
+    d[4] = NET_VERSION;
+    d[5] = (uint8_t)netPublishBits;
+    d[6] = (uint8_t)chunk;
+    d[7] = (uint8_t)chunks;
+    putLE(d + 8, p.stream, 4);
+    putLE(d + 12, p.sequence, 4);
+    putLE(d + 16, position, 8);
+    putLE(d + 24, sampleRate, 4);
+    putLE(d + 28, (uint32_t)bars, 2);
+    putLE(d + 30, (uint32_t)firstBar, 2);
+    putLE(d + 32, (uint32_t)barCount, 2);
+    for (size_t i = nibbleBegin; i < nibbleEnd; i++) {
+        const size_t k = i - nibbleBegin;
+        d[NET_HEADER_BYTES + k / 2] |= (uint8_t)(p.nibbles[i] << ((k & 1) ? 0 : 4));
+    }
+    const int sent = (int)sendto(p.socket, (const char*)d, (int)p.datagram.size(), 0,
+                                 (const sockaddr*)&p.target, sizeof(p.target));
+    if (sent == (int)p.datagram.size()) gNetPublishStats.bytes.fetch_add((uint64_t)sent, std::memory_order_relaxed);
+    else gNetPublishStats.dropped.fetch_add(1, std::memory_order_relaxed);  // Never wait on the network
+}
+
+// Analysis thread, after gAnalysisMutex is released: encode and send one
+// finished line ('numBars' values, analysed at 'sampleRate')
+static void publishNetworkLine(const float* line, int numBars, uint32_t sampleRate, uint64_t position) {
+    if (!gNetPublishing.load(std::memory_order_acquire)) return;
+    NetPublisher& p = gNetPublisher;
+    const int bars = std::min(numBars, 0xFFFF);
+    const float scale = netPublishBits == 16 ? 65535.0f : 255.0f;
+    p.quantized.resize((size_t)bars);
+    for (int i = 0; i < bars; i++) {
+        p.quantized[(size_t)i] = (uint16_t)(std::max(0.0f, std::min(line[i], 1.0f)) * scale + 0.5f);
+    }
+
+    // Nibbles for the whole line, chunk boundaries wherever a datagram fills
+    const size_t budget = (size_t)(NET_MAX_DATAGRAM - NET_HEADER_BYTES) * 2;
+    p.nibbles.clear();
+    struct Chunk { int firstBar, barCount; size_t begin, end; };
+    Chunk chunks[256];
+    int chunkCount = 0;
+    Chunk cur = { 0, 0, 0, 0 };
+    int prev = 0;
+    for (int i = 0; i < bars;) {
+        const size_t before = p.nibbles.size();
+        int consumed = 1;
+        const int value = p.quantized[(size_t)i];
+        if (value == prev && i + 1 < bars && p.quantized[(size_t)i + 1] == value) {
+            int run = 2;
+            while (run < 17 && i + run < bars && p.quantized[(size_t)(i + run)] == value) run++;
+            p.nibbles.push_back(13);
+            p.nibbles.push_back((uint8_t)(run - 2));
+            consumed = run;
+        } else {
+            appendDeltaNibbles(p.nibbles, zigzag(value - prev));
+        }
+        if (p.nibbles.size() - cur.begin > budget && cur.barCount > 0) {
+            // Close the datagram before this symbol and restart the delta chain
+            p.nibbles.resize(before);
+            cur.end = before;
+            if (chunkCount == 256) break;
+            chunks[chunkCount++] = cur;
+            cur.firstBar = i;
+            cur.barCount = 0;
+            cur.begin = before;
+            prev = 0;
+            continue;
+        }
+        cur.barCount += consumed;
+        prev = p.quantized[(size_t)(i + consumed - 1)];
+        i += consumed;
+    }
+    cur.end = p.nibbles.size();
+    if (chunkCount < 256 && cur.barCount > 0) chunks[chunkCount++] = cur;
+
+    for (int c = 0; c < chunkCount; c++) {
+        sendNetChunk(p, position, sampleRate, bars, chunks[c].firstBar, chunks[c].barCount, c, chunkCount,
+                     chunks[c].begin, chunks[c].end);
+    }
+    p.sequence++;
+    gNetPublishStats.lines.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Decode one datagram's bars into 'line' (values 0..1). False when malformed.
+static bool decodeNetChunk(const uint8_t* payload, size_t bytes, int bits, int barCount, float* line) {
+    const float scale = bits == 16 ? 1.0f / 65535.0f : 1.0f / 255.0f;
+    const size_t total = bytes * 2;
+    size_t pos = 0;
+    auto next = [&](uint32_t& out) -> bool {
+        if (pos >= total) return false;
+        out = (payload[pos / 2] >> ((pos & 1) ? 0 : 4)) & 15;
+        pos++;
+        return true;
+    };
+    int32_t value = 0;
+    for (int i = 0; i < barCount;) {
+        uint32_t n = 0;
+        if (!next(n)) return false;
+        if (n == 13) {
+            uint32_t run = 0;
+            if (!next(run)) return false;
+            for (uint32_t r = 0; r < run + 2 && i < barCount; r++) line[i++] = (float)value * scale;
+            continue;
+        }
+        uint32_t z = n;
+        const int extra = n == 14 ? 2 : (n == 15 ? 5 : 0);
+        if (extra) {
+            z = 0;
+            for (int k = 0; k < extra; k++) {
+                uint32_t digit = 0;
+                if (!next(digit)) return false;
+                z = (z << 4) | digit;
+            }
+        }
+        value += unzigzag(z);
+        if (value < 0 || value > (bits == 16 ? 65535 : 255)) return false;
+        line[i++] = (float)value * scale;
+    }
+    return true;
+}
+
+// Line being reassembled from its datagrams
+struct NetAssembly {
+    bool active = false;
+    uint32_t stream = 0;
+    uint32_t sequence = 0;
+    uint64_t position = 0;
+    int chunksSeen = 0, chunks = 0;
+    std::vector<float> line;  // Stream bars; keeps the previous line where datagrams are missing
+    std::chrono::steady_clock::time_point started;
+};
+
+// Resample the stream's bars onto NUM_BARS and hand the line to the render thread
+static void commitNetLine(NetAssembly& a) {
+    if (a.chunksSeen < a.chunks) gNetSubscribeStats.partial.fetch_add(1, std::memory_order_relaxed);
+    a.active = false;
+    float* slot = gLineQueue.beginWrite();
+    if (!slot) {
+        gNetSubscribeStats.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const int src = (int)a.line.size();
+    for (int i = 0; i < NUM_BARS; i++) {
+        const int j = NUM_BARS == src ? i : (int)((int64_t)i * src / NUM_BARS);
+        slot[i] = a.line[(size_t)std::min(j, src - 1)];
+    }
+    gLineQueue.commitWrite(a.position, 1);
+    gNetSubscribeStats.lines.fetch_add(1, std::memory_order_relaxed);
+    if (!gLineWakePending.exchange(true)) glfwPostEmptyEvent();
+}
+
+static void netSubscriberMain(NetSocket sock) {
+    std::vector<uint8_t> buffer(65536);
+    NetAssembly a;
+    bool haveLast = false;
+    uint32_t lastStream = 0, lastSequence = 0;
+
+    while (gNetSubscribing.load(std::memory_order_acquire)) {
+        const int got = (int)recv(sock, (char*)buffer.data(), (int)buffer.size(), 0);
+        const auto now = std::chrono::steady_clock::now();
+        if (a.active && now - a.started > std::chrono::milliseconds(NET_ASSEMBLY_TIMEOUT_MS)) commitNetLine(a);
+        if (got < NET_HEADER_BYTES || memcmp(buffer.data(), "SPL1", 4) != 0 || buffer[4] != NET_VERSION) continue;
+        gNetSubscribeStats.bytes.fetch_add((uint64_t)got, std::memory_order_relaxed);
+
+        const uint8_t* d = buffer.data();
+        const int bits = d[5];
+        const int chunk = d[6], chunks = d[7];
+        const uint32_t stream = (uint32_t)getLE(d + 8, 4);
+        const uint32_t sequence = (uint32_t)getLE(d + 12, 4);
+        const int bars = (int)getLE(d + 28, 2);
+        const int firstBar = (int)getLE(d + 30, 2);
+        const int barCount = (int)getLE(d + 32, 2);
+        if ((bits != 8 && bits != 16) || chunk >= chunks || bars == 0 || firstBar + barCount > bars) continue;
+
+        // New publisher run: start over instead of counting a huge gap
+        if (haveLast && stream != lastStream) {
+            haveLast = false;
+            a.active = false;
+        }
+        if (haveLast && (int32_t)(sequence - lastSequence) <= 0 && !(a.active && a.sequence == sequence)) {
+            continue;  // Late datagram of a line already shown
+        }
+        if (a.active && a.sequence != sequence) commitNetLine(a);
+        if (!a.active) {
+            if (haveLast && sequence - lastSequence > 1) {
+                gNetSubscribeStats.lost.fetch_add(sequence - lastSequence - 1, std::memory_order_relaxed);
+            }
+            a.active = true;
+            a.stream = stream;
+            a.sequence = sequence;
+            a.position = getLE(d + 16, 8);
+            a.chunks = chunks;
+            a.chunksSeen = 0;
+            a.started = now;
+            if ((int)a.line.size() != bars) a.line.assign((size_t)bars, 0.0f);
+            haveLast = true;
+            lastStream = stream;
+            lastSequence = sequence;
+        }
+        if (decodeNetChunk(d + NET_HEADER_BYTES, (size_t)got - NET_HEADER_BYTES, bits, barCount,
+                           &a.line[(size_t)firstBar])) {
+            a.chunksSeen++;
+        }
+        if (a.chunksSeen >= a.chunks) commitNetLine(a);
+    }
+    closeNetSocket(sock);
+}
+
+static bool startNetSubscriber(const std::string& address) {
+    sockaddr_in addr;
+    if (!netStartup() || !parseNetAddress(address, addr)) {
+        std::cerr << "Error: Invalid --subscribe address: " << address << " (expected host:port)\n";
+        return false;
+    }
+    NetSocket sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == NET_INVALID_SOCKET) {
+        std::cerr << "Error: Cannot create UDP socket\n";
+        return false;
+    }
+    const int yes = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    const int receiveBuffer = 1 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char*)&receiveBuffer, sizeof(receiveBuffer));
+#ifdef _WIN32
+    const DWORD timeout = NET_RECV_TIMEOUT_MS;
+#else
+    timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = NET_RECV_TIMEOUT_MS * 1000;
+#endif
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+
+    sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = addr.sin_port;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (const sockaddr*)&local, sizeof(local)) != 0) {
+        std::cerr << "Error: Cannot bind UDP port " << ntohs(addr.sin_port) << "\n";
+        closeNetSocket(sock);
+        return false;
+    }
+    if (isMulticast(addr)) {
+        ip_mreq group;
+        group.imr_multiaddr = addr.sin_addr;
+        group.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char*)&group, sizeof(group)) != 0) {
+            std::cerr << "Error: Cannot join multicast group " << address << "\n";
+            closeNetSocket(sock);
+            return false;
+        }
+    }
+    gLineQueue.init(LINE_QUEUE_CAPACITY, NUM_BARS * MAX_HISTORY_PLANES);
+    gNetSubscribing.store(true, std::memory_order_release);
+    gNetSubscriberThread = std::thread(netSubscriberMain, sock);
+    std::cout << "Receiving spectrum lines from " << address << "\n";
+    return true;
+}
+
+static void stopNetSubscriber() {
+    gNetSubscribing.store(false, std::memory_order_release);
+    if (gNetSubscriberThread.joinable()) gNetSubscriberThread.join();
+}
+
+// Sidebar status; rates are averaged over the last second
+static void drawNetworkStatus() {
+    const bool publishing = gNetPublishing.load(std::memory_order_relaxed);
+    const bool subscribing = gNetSubscribing.load(std::memory_order_relaxed);
+    if (!publishing && !subscribing) return;
+    NetStats& s = publishing ? gNetPublishStats : gNetSubscribeStats;
+
+    static double lastTime = 0.0;
+    static uint64_t lastBytes = 0, lastLines = 0;
+    static float kbPerSec = 0.0f, linesPerSec = 0.0f;
+    const double now = glfwGetTime();
+    if (now - lastTime >= 1.0) {
+        const uint64_t bytes = s.bytes.load(std::memory_order_relaxed);
+        const uint64_t lines = s.lines.load(std::memory_order_relaxed);
+        if (lastTime > 0.0) {
+            kbPerSec = (float)((double)(bytes - lastBytes) / 1024.0 / (now - lastTime));
+            linesPerSec = (float)((double)(lines - lastLines) / (now - lastTime));
+        }
+        lastTime = now;
+        lastBytes = bytes;
+        lastLines = lines;
+    }
+
+    ImGui::Text("Network:");
+    if (publishing) {
+        ImGui::TextDisabled("Publishing %s (%d-bit)", netPublishAddress.c_str(), netPublishBits);
+        ImGui::TextDisabled("%.0f lines/s, %.1f KB/s, %llu send failures", linesPerSec, kbPerSec,
+                            (unsigned long long)s.dropped.load(std::memory_order_relaxed));
+    } else {
+        ImGui::TextDisabled("Subscribed to %s", netSubscribeAddress.c_str());
+        ImGui::TextDisabled("%.0f lines/s, %.1f KB/s", linesPerSec, kbPerSec);
+        ImGui::TextDisabled("Lost %llu, partial %llu, dropped %llu",
+                            (unsigned long long)s.lost.load(std::memory_order_relaxed),
+                            (unsigned long long)s.partial.load(std::memory_order_relaxed),
+                            (unsigned long long)s.dropped.load(std::memory_order_relaxed));
+    }
+    ImGui::Spacing();
+    ImGui::Separator();
+    ImGui::Spacing();
+}
+
+// ===================== Streaming Uploads =====================
+// Texture updates are staged in a ring of UPLOAD_RING_REGIONS regions of one GL
+// buffer: new rows are written straight into mapped memory and uploaded from the
+// bound GL_PIXEL_UNPACK_BUFFER, so glTexSubImage* only queues a GPU-side copy
+// instead of copying (or waiting on) client memory before it returns. Each frame
+// fills one region and fences it; the region comes round again three frames
+// later, normally long after its fence signalled. With ARB_buffer_storage the
+// buffer is mapped once (persistent, coherent); otherwise each staging write
+// maps its range unsynchronized, which the fences make equally safe. Whatever
+// does not fit in a region (full re-uploads) goes the direct way.
+static constexpr int UPLOAD_RING_REGIONS = 3;
+static constexpr size_t UPLOAD_RING_REGION_BYTES = 4u << 20;
+
+struct UploadRing {
+    GLuint buffer = 0;
+    bool persistent = false;
+    unsigned char* mapped = nullptr;  // Whole-buffer mapping (persistent mode)
+    GLsync fences[UPLOAD_RING_REGIONS] = {};
+    int region = 0;
+    size_t used = 0;      // Bytes staged in the current region
+    bool active = false;  // Between beginUploadFrame() and endUploadFrame()
+};
+
+static UploadRing gUploadRing;
+static bool streamUploads = true;    // Settings toggle, to compare against direct uploads
+static uint32_t gUploadStalls = 0;   // Frames that had to wait for a region's fence
+
+static void initUploadRing(bool persistentSupported) {
+    const GLsizeiptr total = (GLsizeiptr)(UPLOAD_RING_REGION_BYTES * UPLOAD_RING_REGIONS);
+    glGenBuffers(1, &gUploadRing.buffer);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gUploadRing.buffer);
+    if (persistentSupported) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, total, nullptr, flags);
+        gUploadRing.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total, flags);
+        gUploadRing.persistent = gUploadRing.mapped != nullptr;
+    }
+    if (!gUploadRing.persistent) {
+        // Immutable storage cannot be respecified, so start over with a plain buffer
+        if (persistentSupported) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers(1, &gUploadRing.buffer);
+            glGenBuffers(1, &gUploadRing.buffer);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gUploadRing.buffer);
+        }
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, total, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+static void destroyUploadRing() {
+    for (int i = 0; i < UPLOAD_RING_REGIONS; i++) {
+        if (gUploadRing.fences[i]) glDeleteSync(gUploadRing.fences[i]);
+    }
+    if (gUploadRing.mapped) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gUploadRing.buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    if (gUploadRing.buffer) glDeleteBuffers(1, &gUploadRing.buffer);
+    gUploadRing = UploadRing();
+}
+
+// Move to the next region, waiting for the GPU to finish reading it if it is
+// still busy (counted in gUploadStalls)
+static void beginUploadFrame() {
+    gUploadRing.active = false;
+    if (!gUploadRing.buffer || !streamUploads) return;
+
+    gUploadRing.region = (gUploadRing.region + 1) % UPLOAD_RING_REGIONS;
+    GLsync& fence = gUploadRing.fences[gUploadRing.region];
+    if (fence) {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            gUploadStalls++;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);  // 1 s
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    gUploadRing.used = 0;
+    gUploadRing.active = true;
+}
+
+static void endUploadFrame() {
+    if (gUploadRing.active && gUploadRing.used > 0) {
+        gUploadRing.fences[gUploadRing.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    gUploadRing.active = false;
+}
+
+// Reserve 'bytes' of this frame's region and return where to write them, or
+// nullptr (upload directly) when streaming is off or the region is full.
+// 'offset' is the byte offset to pass to glTexSubImage* after endStaging().
+static unsigned char* beginStaging(size_t bytes, size_t& offset) {
+    if (!gUploadRing.active) return nullptr;
+    const size_t start = (gUploadRing.used + 15) & ~(size_t)15;
+    if (start + bytes > UPLOAD_RING_REGION_BYTES) return nullptr;
+
+    gUploadRing.used = start + bytes;
+    offset = (size_t)gUploadRing.region * UPLOAD_RING_REGION_BYTES + start;
+    if (gUploadRing.persistent) return gUploadRing.mapped + offset;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gUploadRing.buffer);
+    void* p = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes,
+                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return (unsigned char*)p;
+}
+
+// Publish the staged bytes and leave the ring bound as GL_PIXEL_UNPACK_BUFFER
+// for the upload calls; unbind it afterwards
+static void endStaging() {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, gUploadRing.buffer);
+    if (!gUploadRing.persistent) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+}
+
+// ===================== GPU History & Colormap =====================
+// historyTexture mirrors the lineHistory ring as single-channel R16F (one row per
+// line, one array layer per channel) and is sampled by both views. Colormaps are
+// uploaded untouched as a 1D texture; gamma and saturation are applied in the
+// shader, so changing the colormap, gamma or saturation never touches the history.
+static GLuint historyTexture = 0;       // R16F 2D array ring mirror of lineHistory
+static int historyTextureLayers = 0;    // gHistoryChannels historyTexture was created for
+static uint64_t historyUploadCount = 0; // historyPushCount already mirrored to historyTexture
+static bool historyFullUpload = true;   // Re-upload the whole ring (after clear/init)
+
+static GLuint colormapTexture = 0;      // Pure colormap, COLOR_LUT_SIZE RGB texels
+static int colormapTextureMap = -1;     // ColormapType held by colormapTexture
+
+// Shared colormapping for the view shaders (uColormap is bound to texture unit 1)
+static const char* kColormapGLSL = R"(
+uniform sampler1D uColormap;
+uniform float uGamma;
+uniform float uSaturation;
+
+vec3 applyColormap(float v) {
+    float lutSize = float(textureSize(uColormap, 0));
+    float u = pow(clamp(v, 0.0, 1.0), uGamma);
+    vec3 c = texture(uColormap, (u * (lutSize - 1.0) + 0.5) / lutSize).rgb;
+
+    // Saturation boost around the min channel, same as the CPU LUT
+    float maxC = max(c.r, max(c.g, c.b));
+    float minC = min(c.r, min(c.g, c.b));
+    float delta = maxC - minC;
+    if (delta > 0.001) {
+        float chroma = min(delta * uSaturation, maxC);
+        c = minC + (c - minC) * (chroma / delta);
+    }
+    return c;
+}
+)";
+
+static GLuint compileShader(GLenum type, const char* src) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << "Error: Shader compile failed:\n" << log << "\n";
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static GLuint linkProgram(const std::string& vsSrc, const std::string& fsSrc) {
+    GLuint vs = compileShader(GL_VERTEX_SHADER, vsSrc.c_str());
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, fsSrc.c_str());
+    if (!vs || !fs) {
+        if (vs) glDeleteShader(vs);
+        if (fs) glDeleteShader(fs);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::cerr << "Error: Shader link failed:\n" << log << "\n";
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Mirror lines pushed since the last call into historyTexture (one row per line
+// and channel). The planes of lineHistory are laid out exactly like the layers.
+static void uploadHistoryTexture() {
+    ScopedStageTimer timer(STAGE_TEXTURE_UPLOAD);
+    if (historyTexture != 0 && historyTextureLayers != gHistoryChannels) {
+        glDeleteTextures(1, &historyTexture);
+        historyTexture = 0;
+    }
+    if (historyTexture == 0) {
+        glGenTextures(1, &historyTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, historyTexture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);  // Time wraps with the ring
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16F, NUM_BARS, MAX_HISTORY_LINES, gHistoryChannels,
+                     0, GL_RED, GL_FLOAT, nullptr);
+        historyTextureLayers = gHistoryChannels;
+        historyFullUpload = true;
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, historyTexture);
+    uint64_t pending = historyPushCount - historyUploadCount;
+
+    if (historyFullUpload || pending >= (uint64_t)MAX_HISTORY_LINES) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, NUM_BARS, MAX_HISTORY_LINES, gHistoryChannels,
+                        GL_RED, GL_FLOAT, lineHistory.data());
+        historyFullUpload = false;
+    } else if (pending > 0) {
+        // Stage each layer's new rows in ring order: one or two runs (split at the wrap)
+        const size_t rowBytes = sizeof(float) * (size_t)NUM_BARS;
+        const size_t layerBytes = rowBytes * (size_t)pending;
+        const int first = (historyHead - (int)pending + 1 + MAX_HISTORY_LINES) % MAX_HISTORY_LINES;
+        const int run0 = std::min((int)pending, MAX_HISTORY_LINES - first);
+        size_t offset = 0;
+        unsigned char* staged = beginStaging(layerBytes * (size_t)gHistoryChannels, offset);
+        if (staged) {
+            for (int ch = 0; ch < gHistoryChannels; ch++) {
+                const float* plane = &lineHistory[(size_t)ch * MAX_HISTORY_LINES * (size_t)NUM_BARS];
+                unsigned char* dst = staged + (size_t)ch * layerBytes;
+                std::memcpy(dst, plane + (size_t)first * (size_t)NUM_BARS, (size_t)run0 * rowBytes);
+                std::memcpy(dst + (size_t)run0 * rowBytes, plane, ((size_t)pending - (size_t)run0) * rowBytes);
+            }
+            endStaging();
+            for (int ch = 0; ch < gHistoryChannels; ch++) {
+                const size_t base = offset + (size_t)ch * layerBytes;
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, first, ch, NUM_BARS, run0, 1,
+                                GL_RED, GL_FLOAT, (void*)base);
+                if ((int)pending > run0) {
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, ch, NUM_BARS, (int)pending - run0, 1,
+                                    GL_RED, GL_FLOAT, (void*)(base + (size_t)run0 * rowBytes));
+                }
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        } else {
+            for (int age = (int)pending - 1; age >= 0; age--) {
+                int phys = historyHead - age;
+                if (phys < 0) phys += MAX_HISTORY_LINES;
+                for (int ch = 0; ch < gHistoryChannels; ch++) {
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, phys, ch, NUM_BARS, 1, 1,
+                                    GL_RED, GL_FLOAT, historyRow(age, ch));
+                }
+            }
+        }
+    }
+    historyUploadCount = historyPushCount;
+}
+
+// Upload the current colormap without gamma or saturation (they are shader uniforms)
+static void updateColormapTexture() {
+    if (colormapTexture == 0) {
+        glGenTextures(1, &colormapTexture);
+        glBindTexture(GL_TEXTURE_1D, colormapTexture);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        colormapTextureMap = -1;
+    }
+    if (colormapTextureMap == (int)currentColormap) return;
+    colormapTextureMap = (int)currentColormap;
+
+    std::vector<unsigned char> rgb((size_t)COLOR_LUT_SIZE * 3);
+    for (int i = 0; i < COLOR_LUT_SIZE; i++) {
+        float r, g, b;
+        getCurrentColormapColor((float)i / (float)(COLOR_LUT_SIZE - 1), r, g, b);
+        rgb[(size_t)i * 3 + 0] = (unsigned char)(clamp01(r) * 255.0f);
+        rgb[(size_t)i * 3 + 1] = (unsigned char)(clamp01(g) * 255.0f);
+        rgb[(size_t)i * 3 + 2] = (unsigned char)(clamp01(b) * 255.0f);
+    }
+
+    glBindTexture(GL_TEXTURE_1D, colormapTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB8, COLOR_LUT_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_1D, 0);
+}
+
+// Bind history to unit 0 and the colormap to unit 1 (both brought up to date)
+static void bindHistoryAndColormap() {
+    uploadHistoryTexture();
+    updateColormapTexture();
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, historyTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, colormapTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+static void unbindHistoryAndColormap() {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+static void destroyHistoryAndColormap() {
+    if (historyTexture) glDeleteTextures(1, &historyTexture);
+    if (colormapTexture) glDeleteTextures(1, &colormapTexture);
+    historyTexture = 0;
+    colormapTexture = 0;
+}
+
+// ===================== GPU Waterfall =====================
+// The waterfall is a few instanced draws, one per level-of-detail band: each
+// instance is one history row drawn as a GL_LINE_STRIP. Bar X positions live in a
+// static VBO, magnitudes come from historyTexture, and the vertex shader computes
+// Z, age fade and the colormap lookup. Far or small rows fold groups of bars into
+// one vertex and overlapping rows into one line, both by max so peaks survive.
+static const char* kWaterfallVertexShader = R"(
+layout(location = 0) in float aX;
+
+uniform mat4 uMVP;
+uniform sampler2DArray uHistory;  // R16F, NUM_BARS x capacity ring, one layer per channel
+uniform int uLayer;
+uniform int uHead;
+uniform int uCapacity;
+uniform int uRows;
+uniform int uRowStart;  // First row of this LOD band
+uniform int uRowStep;   // Rows merged into each instance
+uniform int uDecimate;  // Bars folded into each vertex
+uniform int uBars;
+uniform float uYScale;
+uniform float uZSpan;
+uniform int uUseColormap;
+uniform vec3 uLineColor;
+
+out vec4 vColor;
+
+void main() {
+    int row = uRowStart + gl_InstanceID * uRowStep;
+    float tRow = (uRows <= 1) ? 0.0 : float(row) / float(uRows - 1);
+
+    int rowLast = min(row + uRowStep, uRows);
+    int bar0 = gl_VertexID * uDecimate;
+    int bar1 = min(bar0 + uDecimate, uBars);
+    float v = 0.0;
+    for (int r = row; r < rowLast; r++) {
+        int phys = uHead - r;
+        if (phys < 0) phys += uCapacity;
+        for (int b = bar0; b < bar1; b++) {
+            v = max(v, texelFetch(uHistory, ivec3(b, phys, uLayer), 0).r);
+        }
+    }
+
+    vec3 rgb = uLineColor;
+    if (uUseColormap != 0) {
+        rgb = applyColormap(v) * (1.0 - 0.75 * tRow);  // Color fade for depth
+    }
+
+    // Opacity fades from full (1.0) at front to more transparent at back
+    vColor = vec4(rgb, 1.0 - 0.8 * tRow);
+    gl_Position = uMVP * vec4(aX, v * uYScale, uZSpan * 0.5 - tRow * uZSpan, 1.0);
+}
+)";
+
+static const char* kWaterfallFragmentShader = R"(
+in vec4 vColor;
+out vec4 fragColor;
+
+void main() {
+    fragColor = vColor;
+}
+)";
+
+struct WaterfallGPU {
+    bool initialized = false;   // init attempted
+    bool available = false;     // shaders compiled; otherwise use immediate mode
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint xVbo = 0;
+    GLint uMVP = -1, uLayer = -1, uHead = -1, uCapacity = -1, uRows = -1;
+    GLint uRowStart = -1, uRowStep = -1, uDecimate = -1, uBars = -1;
+    GLint uYScale = -1, uZSpan = -1, uUseColormap = -1, uLineColor = -1;
+    GLint uGamma = -1, uSaturation = -1;
+    uint32_t mappingVersion = 0xFFFFFFFFu;  // gBarX version held by xVbo
+};
+
+static WaterfallGPU gWaterfall;
+
+// ---- Level of detail ----
+// Planned per view from the projection: bars per vertex so a row keeps about
+// one vertex per LOD_PIXELS_PER_VERTEX pixels of its on-screen width, and rows
+// per line so drawn rows stay at least a line width apart. Runs of rows with the
+// same factors form one band (one draw call).
+struct WaterfallLodBand {
+    int rowStart;  // First history row (0 = newest)
+    int rowEnd;    // One past the last row
+    int rowStep;   // Rows merged into each drawn line
+    int decimate;  // Bars folded into each vertex
+};
+
+static constexpr float LOD_PIXELS_PER_VERTEX = 2.0f;
+static constexpr int LOD_MAX_DECIMATE = 32;
+static constexpr int LOD_MAX_ROW_MERGE = 16;
+static bool waterfallLOD = true;
+static std::vector<WaterfallLodBand> gWaterfallLod;
+static uint64_t gWaterfallVertices = 0;  // Vertices submitted this frame (profiler overlay)
+
+static bool projectToPixels(const Mat4& mvp, float x, float y, float z, int vpW, int vpH, float& px, float& py) {
+    const float* m = mvp.m;
+    const float cx = m[0] * x + m[4] * y + m[8] * z + m[12];
+    const float cy = m[1] * x + m[5] * y + m[9] * z + m[13];
+    const float cw = m[3] * x + m[7] * y + m[11] * z + m[15];
+    if (cw <= 1e-4f) return false;  // Behind the camera
+    px = (cx / cw * 0.5f + 0.5f) * (float)vpW;
+    py = (cy / cw * 0.5f + 0.5f) * (float)vpH;
+    return true;
+}
+
+// Largest power of two <= v, within [1, cap]
+static int lodFactor(float v, int cap) {
+    int f = 1;
+    while (f * 2 <= cap && (float)(f * 2) <= v) f *= 2;
+    return f;
+}
+
+static float waterfallRowZ(int row) {
+    const float tRow = (HISTORY_LINES <= 1) ? 0.0f : (float)row / (float)(HISTORY_LINES - 1);
+    return Z_SPAN * 0.5f - tRow * Z_SPAN;
+}
+
+static void planWaterfallLod(const Mat4& mvp, int vpW, int vpH) {
+    gWaterfallLod.clear();
+    const int rows = HISTORY_LINES;
+    const float minSpacing = std::max(1.0f, lineWidth);
+
+    for (int row = 0; row < rows;) {
+        int decimate = 1, step = 1;
+        if (waterfallLOD) {
+            const float z = waterfallRowZ(row);
+            float lx, ly, rx, ry;
+            if (projectToPixels(mvp, -X_SPAN * 0.5f, 0.0f, z, vpW, vpH, lx, ly) &&
+                projectToPixels(mvp, X_SPAN * 0.5f, 0.0f, z, vpW, vpH, rx, ry)) {
+                const float widthPx = std::max(1.0f, std::hypot(rx - lx, ry - ly));
+                decimate = lodFactor((float)NUM_BARS * LOD_PIXELS_PER_VERTEX / widthPx, LOD_MAX_DECIMATE);
+            }
+            float ax, ay, bx, by;
+            if (row + 1 < rows &&
+                projectToPixels(mvp, 0.0f, 0.0f, z, vpW, vpH, ax, ay) &&
+                projectToPixels(mvp, 0.0f, 0.0f, waterfallRowZ(row + 1), vpW, vpH, bx, by)) {
+                const float spacing = std::max(1e-3f, std::hypot(bx - ax, by - ay));
+                step = lodFactor(minSpacing / spacing, LOD_MAX_ROW_MERGE);
+            }
+        }
+        step = std::min(step, rows - row);
+
+        if (!gWaterfallLod.empty() && gWaterfallLod.back().decimate == decimate &&
+            gWaterfallLod.back().rowStep == step) {
+            gWaterfallLod.back().rowEnd = row + step;
+        } else {
+            gWaterfallLod.push_back({ row, row + step, step, decimate });
+        }
+        row += step;
+    }
+}
+
+// Vertices per row at a decimation factor: vertex k sits on bar k*d + d/2
+static int lodVertexCount(int decimate) {
+    return (NUM_BARS - decimate / 2 + decimate - 1) / decimate;
+}
+
+static void initWaterfallGPU() {
+    gWaterfall.initialized = true;
+
+    gWaterfall.program = linkProgram(std::string("#version 330\n") + kColormapGLSL + kWaterfallVertexShader,
+                                     std::string("#version 330\n") + kWaterfallFragmentShader);
+    if (!gWaterfall.program) {
+        std::cerr << "GPU waterfall unavailable, using immediate mode\n";
+        return;
+    }
+
+    GLuint p = gWaterfall.program;
+    gWaterfall.uMVP = glGetUniformLocation(p, "uMVP");
+    gWaterfall.uLayer = glGetUniformLocation(p, "uLayer");
+    gWaterfall.uHead = glGetUniformLocation(p, "uHead");
+    gWaterfall.uCapacity = glGetUniformLocation(p, "uCapacity");
+    gWaterfall.uRows = glGetUniformLocation(p, "uRows");
+    gWaterfall.uRowStart = glGetUniformLocation(p, "uRowStart");
+    gWaterfall.uRowStep = glGetUniformLocation(p, "uRowStep");
+    gWaterfall.uDecimate = glGetUniformLocation(p, "uDecimate");
+    gWaterfall.uBars = glGetUniformLocation(p, "uBars");
+    gWaterfall.uYScale = glGetUniformLocation(p, "uYScale");
+    gWaterfall.uZSpan = glGetUniformLocation(p, "uZSpan");
+    gWaterfall.uUseColormap = glGetUniformLocation(p, "uUseColormap");
+    gWaterfall.uLineColor = glGetUniformLocation(p, "uLineColor");
+    gWaterfall.uGamma = glGetUniformLocation(p, "uGamma");
+    gWaterfall.uSaturation = glGetUniformLocation(p, "uSaturation");
+
+    glUseProgram(p);
+    glUniform1i(glGetUniformLocation(p, "uHistory"), 0);
+    glUniform1i(glGetUniformLocation(p, "uColormap"), 1);
+    glUseProgram(0);
+
+    glGenVertexArrays(1, &gWaterfall.vao);
+    glGenBuffers(1, &gWaterfall.xVbo);
+    glBindVertexArray(gWaterfall.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, gWaterfall.xVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * NUM_BARS, nullptr, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    gWaterfall.available = true;
+}
+
+// Draw all history rows of channel 'ch', one instanced call per band of the LOD
+// plan. Returns false if the GPU path is unavailable so the caller can fall back
+// to immediate mode.
+static bool drawWaterfallGPU(const Mat4& mvp, int ch) {
+    if (!gWaterfall.initialized) initWaterfallGPU();
+    if (!gWaterfall.available) return false;
+
+    if (gWaterfall.mappingVersion != gMappingVersion) {
+        glBindBuffer(GL_ARRAY_BUFFER, gWaterfall.xVbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * NUM_BARS, gBarX.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gWaterfall.mappingVersion = gMappingVersion;
+    }
+
+    bindHistoryAndColormap();
+
+    glUseProgram(gWaterfall.program);
+    glUniformMatrix4fv(gWaterfall.uMVP, 1, GL_FALSE, mvp.m);
+    glUniform1i(gWaterfall.uLayer, ch);
+    glUniform1i(gWaterfall.uHead, historyHead);
+    glUniform1i(gWaterfall.uCapacity, MAX_HISTORY_LINES);
+    glUniform1i(gWaterfall.uRows, HISTORY_LINES);
+    glUniform1i(gWaterfall.uBars, NUM_BARS);
+    glUniform1f(gWaterfall.uYScale, yScale);
+    glUniform1f(gWaterfall.uZSpan, Z_SPAN);
+    glUniform1i(gWaterfall.uUseColormap, useCustomLineColor ? 0 : 1);
+    glUniform3f(gWaterfall.uLineColor, lineColor[0], lineColor[1], lineColor[2]);
+    glUniform1f(gWaterfall.uGamma, colormapGamma);
+    glUniform1f(gWaterfall.uSaturation, WATERFALL_SATURATION);
+
+    glBindVertexArray(gWaterfall.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, gWaterfall.xVbo);
+    for (const WaterfallLodBand& band : gWaterfallLod) {
+        // Stride/offset pick the X of each group's centre bar
+        const int d = band.decimate;
+        glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, (GLsizei)(sizeof(float) * d),
+                              (void*)(sizeof(float) * (size_t)(d / 2)));
+        glUniform1i(gWaterfall.uRowStart, band.rowStart);
+        glUniform1i(gWaterfall.uRowStep, band.rowStep);
+        glUniform1i(gWaterfall.uDecimate, d);
+
+        const int verts = lodVertexCount(d);
+        const int instances = (band.rowEnd - band.rowStart + band.rowStep - 1) / band.rowStep;
+        glDrawArraysInstanced(GL_LINE_STRIP, 0, verts, instances);
+        gWaterfallVertices += (uint64_t)verts * (uint64_t)instances;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    glUseProgram(0);
+    unbindHistoryAndColormap();
+    return true;
+}
+
+static void destroyWaterfallGPU() {
+    if (gWaterfall.program) glDeleteProgram(gWaterfall.program);
+    if (gWaterfall.vao) glDeleteVertexArrays(1, &gWaterfall.vao);
+    if (gWaterfall.xVbo) glDeleteBuffers(1, &gWaterfall.xVbo);
+    gWaterfall = WaterfallGPU();
+}
+
+// ===================== Rendering =====================
+// Legacy per-vertex waterfall, used when the shader path is unavailable. Follows
+// the same LOD plan as the GPU path.
+static void drawWaterfallImmediate(int ch) {
+    static std::vector<float> merged;
+    for (const WaterfallLodBand& band : gWaterfallLod) {
+        const int d = band.decimate;
+        const int verts = lodVertexCount(d);
+        for (int row = band.rowStart; row < band.rowEnd; row += band.rowStep) {
+            float tRow = (HISTORY_LINES == 1) ? 0.0f : (float)row / (float)(HISTORY_LINES - 1);
+            float z = (Z_SPAN * 0.5f) - tRow * Z_SPAN;
+
+            const float* rowData = historyRow(row, ch);
+            const int rowLast = std::min(row + band.rowStep, HISTORY_LINES);
+            if (rowLast - row > 1) {
+                merged.assign(rowData, rowData + NUM_BARS);
+                for (int r = row + 1; r < rowLast; r++) {
+                    const float* other = historyRow(r, ch);
+                    for (int i = 0; i < NUM_BARS; i++) merged[(size_t)i] = std::max(merged[(size_t)i], other[i]);
+                }
+                rowData = merged.data();
+            }
+
+            glBegin(GL_LINE_STRIP);
+            for (int k = 0; k < verts; k++) {
+                const int bar0 = k * d;
+                const int bar1 = std::min(bar0 + d, NUM_BARS);
+                float v = rowData[bar0];
+                for (int i = bar0 + 1; i < bar1; i++) v = std::max(v, rowData[i]);
+                float x = gBarX[bar0 + d / 2];
+                float y = v * yScale;  // Use variable Y scale instead of constant
+
+                float r, g, b;
+            
+                if (useCustomLineColor) {
+                    // Use custom solid color
+                    r = lineColor[0];
+                    g = lineColor[1];
+                    b = lineColor[2];
+                } else {
+                    // Use colormap
+                    // Apply extremely aggressive power curve to absolutely reach end of colormap
+                    float vGamma = std::pow(v, colormapGamma);
+
+                    // Get pure color from colormap
+                    getCurrentColormapColor(vGamma, r, g, b);
+
+                    // Apply strong saturation boost for vibrant colors
+                    float saturationBoost = WATERFALL_SATURATION;
+
+                    float maxC = std::max(r, std::max(g, b));
+                    float minC = std::min(r, std::min(g, b));
+                    float delta = maxC - minC;
+
+                    if (delta > 0.001f) {
+                        float chroma = delta * saturationBoost;
+                        chroma = std::min(chroma, maxC);
+                        float scale = chroma / delta;
+                        r = minC + (r - minC) * scale;
+                        g = minC + (g - minC) * scale;
+                        b = minC + (b - minC) * scale;
+                    }
+
+                    // Apply color fade for depth perception
+                    float colorFade = 1.0f - 0.75f * tRow;
+                    r *= colorFade;
+                    g *= colorFade;
+                    b *= colorFade;
+                }
+
+                // Opacity fades from full (1.0) at front to more transparent at back
+                float a = 1.0f - 0.8f * tRow;
+
+                glColor4f(r, g, b, a);
+                glVertex3f(x, y, z);
+            }
+            glEnd();
+            gWaterfallVertices += (uint64_t)verts;
+        }
+    }
+}
+
+static void render3DWaterfall(int vpX, int vpY, int vpW, int vpH, int ch = 0) {
+    // CRITICAL: Disable blend first, ImGui might leave it on
+    glDisable(GL_BLEND);
+    glDisable(GL_SCISSOR_TEST);
+
+    // Viewport is already set and scissor enabled from main loop
+    glViewport(vpX, vpY, vpW, vpH);
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    float aspect = (float)vpW / (float)vpH;
+    Mat4 proj = perspectiveMatrix(55.0f, aspect, 0.05f, 100.0f);
+
+    Mat4 view = mat4Translate(0.0f, 0.0f, -gDist);
+    view = mat4Multiply(view, mat4Rotate(gPitch, 1.0f, 0.0f, 0.0f));
+    view = mat4Multiply(view, mat4Rotate(gYaw, 0.0f, 1.0f, 0.0f));
+    view = mat4Multiply(view, mat4Translate(0.0f, yOffset, 0.0f));  // Use variable Y offset
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(proj.m);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(view.m);
+
+    // Draw grid if enabled
+    if (showGrid) {
+        const float gridSpanMul = 1.75f;
+        const int gridDivs = 12;
+
+        const float gridX = X_SPAN * gridSpanMul;
+        const float gridZ = Z_SPAN * gridSpanMul;
+
+        const float gridY = -0.5f;   // <--- LOWER the grid (more negative = lower)
+
+        glColor4f(0.10f, 0.10f, 0.12f, 1.0f);
+        glBegin(GL_LINES);
+
+        for (int i = 0; i <= gridDivs; i++) {
+            float t = (float)i / (float)gridDivs;
+
+            float x = -gridX * 0.5f + t * gridX;
+            glVertex3f(x, gridY, -gridZ * 0.5f);
+            glVertex3f(x, gridY,  gridZ * 0.5f);
+
+            float z = -gridZ * 0.5f + t * gridZ;
+            glVertex3f(-gridX * 0.5f, gridY, z);
+            glVertex3f( gridX * 0.5f, gridY, z);
+        }
+
+        glEnd();
+    }
+
+    glLineWidth(lineWidth);  // Use variable line width
+
+    // Waterfall lines: instanced draws per LOD band, or per-vertex submission as a fallback
+    const Mat4 mvp = mat4Multiply(proj, view);
+    planWaterfallLod(mvp, vpW, vpH);
+    if (!drawWaterfallGPU(mvp, ch)) {
+        drawWaterfallImmediate(ch);
+    }
+    if (ch == 0) drawStatsOverlay3D();
+
+    glDisable(GL_BLEND);
+}
+
+// Pre-compute color lookup table
+void updateColorLUT() {
+    if (!colorLUTDirty) return;
+
+    colorLUT.resize(COLOR_LUT_SIZE);
+    for (int i = 0; i < COLOR_LUT_SIZE; i++) {
+        float v = (float)i / (float)(COLOR_LUT_SIZE - 1);
+
+        // Apply extremely aggressive power curve to absolutely reach end of colormap
+        // 0.2 pushes even 50% signals to 87% through the colormap
+        v = std::pow(v, colormapGamma);
+
+        // Get pure color from colormap
+        float r, g, b;
+        getCurrentColormapColor(v, r, g, b);
+
+        // Apply strong saturation boost to maintain vibrancy despite aggressive gamma
+        float saturationBoost = HEATMAP_SATURATION;
+
+        // Convert to HSV-like saturation adjustment
+        float maxC = std::max(r, std::max(g, b));
+        float minC = std::min(r, std::min(g, b));
+        float delta = maxC - minC;
+
+        if (delta > 0.001f) {
+            // Boost saturation
+            float chroma = delta * saturationBoost;
+            chroma = std::min(chroma, maxC);  // Clamp to prevent overflow
+
+            // Reconstruct RGB with boosted saturation
+            float scale = chroma / delta;
+            r = minC + (r - minC) * scale;
+            g = minC + (g - minC) * scale;
+            b = minC + (b - minC) * scale;
+        }
+
+        // Convert directly to unsigned char
+        colorLUT[i][0] = (unsigned char)(clamp01(r) * 255.0f);
+        colorLUT[i][1] = (unsigned char)(clamp01(g) * 255.0f);
+        colorLUT[i][2] = (unsigned char)(clamp01(b) * 255.0f);
+    }
+    colorLUTDirty = false;
+}
+
+// ---- Waveform navigator ----
+// The overlay shows frames [view0, view1) of the file. Each pixel column is
+// looked up in the overview pyramid only when the view, width or scan progress
+// changes; the fill (a triangle strip of top/bottom pairs) and both outlines
+// are then drawn from one VBO, so steady frames submit no vertices. Wheel
+// zooms around the cursor, drag pans, click seeks, right click shows the whole
+// file; while zoomed the view pages along with playback.
+static void seekTo(uint64_t pos);
+
+static uint64_t gWaveView0 = 0;               // View start in frames
+static uint64_t gWaveView1 = 0;               // View end in frames (0 = whole file)
+static std::vector<float> waveformVertices;   // Per column: x, top, x, bottom (amplitude -1..1)
+static bool waveformVerticesDirty = true;
+static int waveformVertexWidth = 0;           // Build inputs, to skip unchanged rebuilds
+static uint64_t waveformVertexView0 = 0;
+static uint64_t waveformVertexView1 = 0;
+static uint64_t waveformVertexPublished = 0;
+static GLuint waveformVbo = 0;
+static bool waveformVboStale = true;          // Vertices changed since the last upload
+static int gWaveRect[4] = {0, 0, 0, 0};       // Last drawn x, y (bottom-up), w, h for hit testing
+static bool gWaveDragging = false;
+static double gWavePressX = 0.0;
+static uint64_t gWavePressView0 = 0;
+
+static void waveformViewRange(uint64_t& v0, uint64_t& v1) {
+    const uint64_t total = wavFile->totalFrames;
+    v0 = std::min(gWaveView0, total);
+    v1 = gWaveView1 == 0 ? total : std::min(gWaveView1, total);
+    if (v1 <= v0) {
+        v0 = 0;
+        v1 = total;
+    }
+}
+
+static bool waveformZoomed() {
+    uint64_t v0, v1;
+    waveformViewRange(v0, v1);
+    return v0 > 0 || v1 < wavFile->totalFrames;
+}
+
+static void resetWaveformView() {
+    gWaveView0 = 0;
+    gWaveView1 = 0;
+    waveformVerticesDirty = true;
+}
+
+// Move the view to start at 'start' frames, keeping its span
+static void setWaveformViewStart(int64_t start) {
+    uint64_t v0, v1;
+    waveformViewRange(v0, v1);
+    const int64_t span = (int64_t)(v1 - v0);
+    const int64_t total = (int64_t)wavFile->totalFrames;
+    start = std::max<int64_t>(0, std::min(start, total - span));
+    gWaveView0 = (uint64_t)start;
+    gWaveView1 = (uint64_t)(start + span);
+    waveformVerticesDirty = true;
+}
+
+// Scale the view span by 'factor' (< 1 zooms in) around frame 'anchor', down to
+// one level-0 pair per column
+static void zoomWaveformView(double factor, uint64_t anchor, int width) {
+    uint64_t v0, v1;
+    waveformViewRange(v0, v1);
+    const double total = (double)wavFile->totalFrames;
+    const double minSpan = std::min(total, (double)OVERVIEW_BLOCK * (double)std::max(1, width));
+    const double span = std::max(minSpan, std::min(total, (double)(v1 - v0) * factor));
+    const double rel = (double)(anchor - std::min(anchor, v0)) / (double)std::max<uint64_t>(1, v1 - v0);
+    const double start = std::max(0.0, std::min(total - span, (double)anchor - rel * span));
+    if (span >= total) {
+        resetWaveformView();
+        return;
+    }
+    gWaveView0 = (uint64_t)start;
+    gWaveView1 = (uint64_t)(start + span);
+    waveformVerticesDirty = true;
+}
+
+// Rebuild the column envelope if anything it depends on changed. CPU only (the
+// benchmarks call it directly); renderWaveform uploads the result.
+static bool buildWaveformVertices(int width) {
+    if (wavFile->empty() || width <= 0) return false;
+
+    uint64_t v0, v1;
+    waveformViewRange(v0, v1);
+    const uint64_t published = wavFile->overview.published.load(std::memory_order_relaxed);
+    if (!waveformVerticesDirty && width == waveformVertexWidth && v0 == waveformVertexView0 &&
+        v1 == waveformVertexView1 && published == waveformVertexPublished) {
+        return false;
+    }
+    waveformVerticesDirty = false;
+    waveformVertexWidth = width;
+    waveformVertexView0 = v0;
+    waveformVertexView1 = v1;
+    waveformVertexPublished = published;
+
+    waveformVertices.resize((size_t)(width + 1) * 4);
+    const double framesPerColumn = (double)(v1 - v0) / (double)width;
+    for (int x = 0; x <= width; x++) {
+        const uint64_t f0 = v0 + (uint64_t)((double)x * framesPerColumn);
+        const uint64_t f1 = std::max(f0 + 1, v0 + (uint64_t)((double)(x + 1) * framesPerColumn));
+
+        float minVal = 0.0f, maxVal = 0.0f;
+        wavFile->overview.range(f0 / OVERVIEW_BLOCK, (f1 + OVERVIEW_BLOCK - 1) / OVERVIEW_BLOCK, minVal, maxVal);
+
+        float* v = &waveformVertices[(size_t)x * 4];
+        v[0] = (float)x;
+        v[1] = maxVal;
+        v[2] = (float)x;
+        v[3] = minVal;
+    }
+    waveformVboStale = true;
+    return true;
+}
+
+// Zoomed view pages forward (or back) when playback leaves it
+static void followPlayheadInWaveform(uint64_t pos) {
+    if (gWaveDragging || !isPlaying || isPaused.load(std::memory_order_relaxed) || !waveformZoomed()) return;
+    uint64_t v0, v1;
+    waveformViewRange(v0, v1);
+    if (pos < v0 || pos >= v1) setWaveformViewStart((int64_t)pos - (int64_t)(v1 - v0) / 10);
+}
+
+// Mouse over the waveform: returns true when it handled the mouse this frame,
+// so the 3D camera ignores it
+static bool handleWaveformMouse(GLFWwindow* window, double mx, double my, int windowHeight) {
+    ImGuiIO& io = ImGui::GetIO();
+    if (!showWaveform || wavFile->empty() || gWaveRect[2] <= 0) {
+        gWaveDragging = false;
+        return false;
+    }
+    const double yUp = (double)windowHeight - my;
+    const bool inside = mx >= gWaveRect[0] && mx < gWaveRect[0] + gWaveRect[2] &&
+                        yUp >= gWaveRect[1] && yUp < gWaveRect[1] + gWaveRect[3];
+    if (!gWaveDragging && (!inside || io.WantCaptureMouse)) return false;
+
+    uint64_t v0, v1;
+    waveformViewRange(v0, v1);
+    const double framesPerPixel = (double)(v1 - v0) / (double)gWaveRect[2];
+    const double cursorFrame = (double)v0 + std::max(0.0, mx - gWaveRect[0]) * framesPerPixel;
+    const uint64_t cursor = std::min<uint64_t>((uint64_t)cursorFrame, wavFile->totalFrames - 1);
+
+    if (io.MouseWheel != 0.0f) {
+        zoomWaveformView(std::pow(0.8, (double)io.MouseWheel), cursor, gWaveRect[2]);
+        io.MouseWheel = 0.0f;
+        needsRedraw = true;
+    }
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS && waveformZoomed()) {
+        resetWaveformView();
+        needsRedraw = true;
+    }
+
+    const bool down = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+    if (down && !gWaveDragging) {
+        gWaveDragging = true;
+        gWavePressX = mx;
+        gWavePressView0 = v0;
+    } else if (down) {
+        if (std::fabs(mx - gWavePressX) > 3.0) {
+            setWaveformViewStart((int64_t)gWavePressView0 + (int64_t)((gWavePressX - mx) * framesPerPixel));
+            needsRedraw = true;
+        }
+    } else if (gWaveDragging) {
+        gWaveDragging = false;
+        if (std::fabs(mx - gWavePressX) <= 3.0) {
+            // The playhead is drawn latency-compensated, so land it under the cursor
+            const int64_t target = (int64_t)cursor + (int64_t)(gLatencySamplesBase + gLatencyAdjust);
+            seekTo((uint64_t)std::max<int64_t>(0, std::min<int64_t>(target, (int64_t)wavFile->totalFrames - 1)));
+            needsRedraw = true;
+        }
+    }
+    return true;
+}
+
+static void destroyWaveformGPU() {
+    if (waveformVbo) glDeleteBuffers(1, &waveformVbo);
+    waveformVbo = 0;
+    waveformVboStale = true;
+}
+
+// Render waveform display centered at bottom of viewport
+static void renderWaveform(int vpX, int vpY, int vpW, int vpH) {
+    if (wavFile->empty()) return;
+
+    const int waveformHeight = 80;  // Height of waveform strip
+    const int waveformMaxWidth = 800;  // Maximum width for waveform
+    const int bottomMargin = 10;  // Distance from bottom edge
+
+    // Calculate actual waveform width (cap at max width)
+    int waveformWidth = std::min(waveformMaxWidth, vpW - 40);
+
+    // Center horizontally in viewport using the viewport's center point
+    const int viewportCenterX = vpX + vpW / 2;
+    const int waveformX = viewportCenterX - waveformWidth / 2;
+
+    // Position at bottom of viewport with margin
+    const int waveformY = vpY + bottomMargin;
+
+    gWaveRect[0] = waveformX;
+    gWaveRect[1] = waveformY;
+    gWaveRect[2] = waveformWidth;
+    gWaveRect[3] = waveformHeight;
+    if (waveformWidth <= 0) return;
+
+    // Account for audio latency to sync with what is heard
+    const uint64_t pos = playbackPosition.load(std::memory_order_relaxed);
+    const uint64_t heardPos = (uint64_t)std::max<int64_t>(0, (int64_t)pos - (int64_t)(gLatencySamplesBase + gLatencyAdjust));
+    followPlayheadInWaveform(heardPos);
+    buildWaveformVertices(waveformWidth);
+
+    // Use framebuffer coordinates consistently: viewport must be full framebuffer
+    GLFWwindow* ctx = glfwGetCurrentContext();
+    int fbW, fbH;
+    glfwGetFramebufferSize(ctx, &fbW, &fbH);
+
+    // Save current viewport and scissor state so it can restore after
+    GLint oldViewport[4];
+    glGetIntegerv(GL_VIEWPORT, oldViewport);
+
+    GLboolean scissorWasEnabled = glIsEnabled(GL_SCISSOR_TEST);
+    GLint oldScissor[4];
+    glGetIntegerv(GL_SCISSOR_BOX, oldScissor);
+
+    // IMPORTANT: disable scissor so the overlay isn't clipped to the spectrogram area
+    // and set viewport to full framebuffer
+    glDisable(GL_SCISSOR_TEST);
+    glViewport(0, 0, fbW, fbH);
+
+    // Switch to 2D orthographic projection for waveform (matches viewport)
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, fbW, 0, fbH, -1, 1);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    // Draw semi-transparent background
+    glColor4f(0.0f, 0.0f, 0.0f, 0.6f);
+    glBegin(GL_QUADS);
+    glVertex2f((float)waveformX, (float)waveformY);
+    glVertex2f((float)waveformX + waveformWidth, (float)waveformY);
+    glVertex2f((float)waveformX + waveformWidth, (float)waveformY + waveformHeight);
+    glVertex2f((float)waveformX, (float)waveformY + waveformHeight);
+    glEnd();
+
+    // Draw centerline
+    float centerY = waveformY + waveformHeight * 0.5f;
+    glColor4f(0.3f, 0.3f, 0.3f, 0.5f);
+    glBegin(GL_LINES);
+    glVertex2f((float)waveformX, centerY);
+    glVertex2f((float)waveformX + waveformWidth, centerY);
+    glEnd();
+
+    // Filled waveform and outlines from the VBO (re-uploaded only when rebuilt)
+    const float scale = 0.45f;
+    if (!waveformVbo) glGenBuffers(1, &waveformVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, waveformVbo);
+    if (waveformVboStale) {
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(sizeof(float) * waveformVertices.size()),
+                     waveformVertices.data(), GL_DYNAMIC_DRAW);
+        waveformVboStale = false;
+    }
+    const GLsizei columns = (GLsizei)(waveformVertices.size() / 4);
+
+    glPushMatrix();
+    glTranslatef((float)waveformX, centerY, 0.0f);
+    glScalef(1.0f, waveformHeight * scale, 1.0f);
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    glColor4f(0.2f, 0.6f, 1.0f, 0.7f);  // Brighter blue, more opaque
+    glVertexPointer(2, GL_FLOAT, 0, (void*)0);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, columns * 2);
+
+    // Top and bottom outlines: every other vertex of the strip
+    glColor4f(0.3f, 0.8f, 1.0f, 0.9f);
+    glLineWidth(1.5f);
+    glVertexPointer(2, GL_FLOAT, sizeof(float) * 4, (void*)0);
+    glDrawArrays(GL_LINE_STRIP, 0, columns);
+    glVertexPointer(2, GL_FLOAT, sizeof(float) * 4, (void*)(sizeof(float) * 2));
+    glDrawArrays(GL_LINE_STRIP, 0, columns);
+    glLineWidth(1.0f);
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glPopMatrix();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    uint64_t view0, view1;
+    waveformViewRange(view0, view1);
+
+    // While zoomed, a strip along the top shows where the view sits in the file
+    if (view0 > 0 || view1 < wavFile->totalFrames) {
+        const float total = (float)wavFile->totalFrames;
+        const float top = (float)waveformY + waveformHeight;
+        const float x0 = waveformX + (float)view0 / total * waveformWidth;
+        const float x1 = waveformX + std::max((float)view1 / total * waveformWidth, x0 - waveformX + 2.0f);
+        glColor4f(1.0f, 1.0f, 1.0f, 0.15f);
+        glRectf((float)waveformX, top - 4.0f, (float)waveformX + waveformWidth, top);
+        glColor4f(1.0f, 1.0f, 1.0f, 0.6f);
+        glRectf(x0, top - 4.0f, x1, top);
+    }
+
+    // Draw playback position line (when it is inside the view)
+    if ((isPlaying || isPaused.load()) && heardPos >= view0 && heardPos < view1) {
+        float progress = (float)(heardPos - view0) / (float)(view1 - view0);
+        float posX = waveformX + progress * waveformWidth;
+
+        glLineWidth(3.0f);
+        glColor4f(1.0f, 0.2f, 0.2f, 0.95f);  // Bright red position line
+        glBegin(GL_LINES);
+        glVertex2f(posX, (float)waveformY);
+        glVertex2f(posX, (float)waveformY + waveformHeight);
+        glEnd();
+        glLineWidth(1.0f);
+    }
+
+    // Draw border
+    glColor4f(0.5f, 0.5f, 0.5f, 0.7f);
+    glLineWidth(2.0f);
+    glBegin(GL_LINE_LOOP);
+    glVertex2f((float)waveformX, (float)waveformY);
+    glVertex2f((float)waveformX + waveformWidth, (float)waveformY);
+    glVertex2f((float)waveformX + waveformWidth, (float)waveformY + waveformHeight);
+    glVertex2f((float)waveformX, (float)waveformY + waveformHeight);
+    glEnd();
+    glLineWidth(1.0f);
+
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+
+    // Restore projection matrices
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+
+    // Restore viewport and scissor state
+    glViewport(oldViewport[0], oldViewport[1], oldViewport[2], oldViewport[3]);
+
+    if (scissorWasEnabled) {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(oldScissor[0], oldScissor[1], oldScissor[2], oldScissor[3]);
+    } else {
+        glDisable(GL_SCISSOR_TEST);
+    }
+}
+
+// ===================== OPTIMIZED: Traditional 2D Spectrogram Rendering =====================
+// The spectrogram texture is a circular buffer with one column per history line:
+// column c holds physical lineHistory row c, so each new line is colorized and
+// uploaded as a single column, and scrolling is done by offsetting the texture
+// coordinates of the quad (GL_REPEAT wraps across the ring seam). With several
+// channels each one owns a band of NUM_BARS texture rows (channel 0 at the bottom).
+static uint64_t spectrogramUploadCount = 0;  // historyPushCount already in spectrogramTexture
+static int spectrogramTextureChannels = 0;   // gHistoryChannels the texture was created for
+static bool spectrogramFullRebuild = true;   // Recolor every column (colormap change/clear)
+
+static inline void colorizeValue(float v, unsigned char* rgb) {
+    int lutIdx = (int)(v * (COLOR_LUT_SIZE - 1));
+    lutIdx = std::max(0, std::min(lutIdx, COLOR_LUT_SIZE - 1));
+    rgb[0] = colorLUT[(size_t)lutIdx][0];
+    rgb[1] = colorLUT[(size_t)lutIdx][1];
+    rgb[2] = colorLUT[(size_t)lutIdx][2];
+}
+
+// Initialize texture (MAX_HISTORY_LINES columns x NUM_BARS rows per channel)
+void initSpectrogramTexture() {
+    if (spectrogramTexture != 0 && spectrogramTextureChannels != gHistoryChannels) {
+        glDeleteTextures(1, &spectrogramTexture);
+        spectrogramTexture = 0;
+    }
+    if (spectrogramTexture != 0) return;
+
+    texWidth = MAX_HISTORY_LINES;
+    texHeight = NUM_BARS * gHistoryChannels;
+    spectrogramTextureChannels = gHistoryChannels;
+    textureData.resize((size_t)texWidth * (size_t)texHeight * 3); // RGB format
+
+    glGenTextures(1, &spectrogramTexture);
+    glBindTexture(GL_TEXTURE_2D, spectrogramTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    spectrogramFullRebuild = true;
+}
+
+// Colorize the whole history ring into textureData (texWidth x texHeight RGB)
+static void colorizeSpectrogramTexture() {
+    for (int texRow = 0; texRow < texHeight; texRow++) {
+        const int ch = texRow / NUM_BARS;
+        const int bar = texRow % NUM_BARS;
+        const float* plane = &lineHistory[(size_t)ch * MAX_HISTORY_LINES * (size_t)NUM_BARS];
+        unsigned char* dst = &textureData[(size_t)texRow * (size_t)texWidth * 3];
+        for (int col = 0; col < texWidth; col++) {
+            colorizeValue(plane[(size_t)col * (size_t)NUM_BARS + (size_t)bar], dst + (size_t)col * 3);
+        }
+    }
+}
+
+// Colorize the line 'age' back (every channel band) into one texture column
+static void colorizeSpectrogramColumn(int age, unsigned char* column) {
+    for (int ch = 0; ch < gHistoryChannels; ch++) {
+        const float* rowData = historyRow(age, ch);
+        unsigned char* band = column + (size_t)ch * (size_t)NUM_BARS * 3;
+        for (int i = 0; i < NUM_BARS; i++) colorizeValue(rowData[i], band + (size_t)i * 3);
+    }
+}
+
+// Bring spectrogramTexture up to date: O(NUM_BARS) per new line, full rebuild only
+// when the colormap changed or the history was cleared
+static void updateSpectrogramTexture() {
+    ScopedStageTimer timer(STAGE_TEXTURE_UPLOAD);
+    initSpectrogramTexture();
+
+    // Update color LUT if color settings changed (invalidates every column)
+    if (colorLUTDirty) spectrogramFullRebuild = true;
+    updateColorLUT();
+
+    glBindTexture(GL_TEXTURE_2D, spectrogramTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // RGB columns are not 4-byte aligned
+
+    uint64_t pending = historyPushCount - spectrogramUploadCount;
+    if (spectrogramFullRebuild || pending >= (uint64_t)MAX_HISTORY_LINES) {
+        colorizeSpectrogramTexture();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texWidth, texHeight, GL_RGB, GL_UNSIGNED_BYTE, textureData.data());
+        spectrogramFullRebuild = false;
+    } else if (pending > 0) {
+        // One contiguous column per new line, colorized straight into the upload ring
+        const size_t columnBytes = (size_t)texHeight * 3;
+        size_t offset = 0;
+        unsigned char* staged = beginStaging(columnBytes * (size_t)pending, offset);
+        if (staged) {
+            for (int age = (int)pending - 1; age >= 0; age--) {
+                colorizeSpectrogramColumn(age, staged + (size_t)((int)pending - 1 - age) * columnBytes);
+            }
+            endStaging();
+            for (int age = (int)pending - 1; age >= 0; age--) {
+                int phys = historyHead - age;
+                if (phys < 0) phys += MAX_HISTORY_LINES;
+                glTexSubImage2D(GL_TEXTURE_2D, 0, phys, 0, 1, texHeight, GL_RGB, GL_UNSIGNED_BYTE,
+                                (void*)(offset + (size_t)((int)pending - 1 - age) * columnBytes));
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        } else {
+            static std::vector<unsigned char> columnData;
+            columnData.resize(columnBytes);
+            unsigned char* column = columnData.data();
+            for (int age = (int)pending - 1; age >= 0; age--) {
+                colorizeSpectrogramColumn(age, column);
+
+                int phys = historyHead - age;
+                if (phys < 0) phys += MAX_HISTORY_LINES;
+                glTexSubImage2D(GL_TEXTURE_2D, 0, phys, 0, 1, texHeight, GL_RGB, GL_UNSIGNED_BYTE, column);
+            }
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    spectrogramUploadCount = historyPushCount;
+}
+
+// Shader path: a single quad samples historyTexture directly, colormapped in the
+// fragment shader. x runs oldest (left) to newest (right), y low to high frequency.
+static const char* kSpectrogramVertexShader = R"(
+out vec2 vUV;
+
+void main() {
+    vec2 p = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1));
+    vUV = p;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char* kSpectrogramFragmentShader = R"(
+in vec2 vUV;
+out vec4 fragColor;
+
+uniform sampler2DArray uHistory;
+uniform int uLayer;
+uniform int uHead;
+uniform int uCapacity;
+uniform int uRows;
+
+void main() {
+    float age = (1.0 - vUV.x) * float(max(uRows - 1, 0));
+    float t = (float(uHead) - age + 0.5) / float(uCapacity);  // GL_REPEAT wraps the ring
+    float v = texture(uHistory, vec3(vUV.y, t, float(uLayer))).r;
+    fragColor = vec4(applyColormap(v), 1.0);
+}
+)";
+
+struct SpectrogramGPU {
+    bool initialized = false;
+    bool available = false;
+    GLuint program = 0;
+    GLuint vao = 0;  // Empty; positions come from gl_VertexID
+    GLint uLayer = -1, uHead = -1, uCapacity = -1, uRows = -1, uGamma = -1, uSaturation = -1;
+};
+
+static SpectrogramGPU gSpectrogram;
+
+static void initSpectrogramGPU() {
+    gSpectrogram.initialized = true;
+
+    gSpectrogram.program = linkProgram(std::string("#version 330\n") + kSpectrogramVertexShader,
+                                       std::string("#version 330\n") + kColormapGLSL + kSpectrogramFragmentShader);
+    if (!gSpectrogram.program) {
+        std::cerr << "GPU spectrogram unavailable, using CPU colormapping\n";
+        return;
+    }
+
+    GLuint p = gSpectrogram.program;
+    gSpectrogram.uLayer = glGetUniformLocation(p, "uLayer");
+    gSpectrogram.uHead = glGetUniformLocation(p, "uHead");
+    gSpectrogram.uCapacity = glGetUniformLocation(p, "uCapacity");
+    gSpectrogram.uRows = glGetUniformLocation(p, "uRows");
+    gSpectrogram.uGamma = glGetUniformLocation(p, "uGamma");
+    gSpectrogram.uSaturation = glGetUniformLocation(p, "uSaturation");
+
+    glUseProgram(p);
+    glUniform1i(glGetUniformLocation(p, "uHistory"), 0);
+    glUniform1i(glGetUniformLocation(p, "uColormap"), 1);
+    glUseProgram(0);
+
+    glGenVertexArrays(1, &gSpectrogram.vao);
+    gSpectrogram.available = true;
+}
+
+static bool drawSpectrogramGPU(int vpX, int vpY, int vpW, int vpH, int ch) {
+    if (!gSpectrogram.initialized) initSpectrogramGPU();
+    if (!gSpectrogram.available) return false;
+
+    bindHistoryAndColormap();
+
+    glViewport(vpX, vpY, vpW, vpH);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+
+    glUseProgram(gSpectrogram.program);
+    glUniform1i(gSpectrogram.uLayer, ch);
+    glUniform1i(gSpectrogram.uHead, historyHead);
+    glUniform1i(gSpectrogram.uCapacity, MAX_HISTORY_LINES);
+    glUniform1i(gSpectrogram.uRows, HISTORY_LINES);
+    glUniform1f(gSpectrogram.uGamma, colormapGamma);
+    glUniform1f(gSpectrogram.uSaturation, HEATMAP_SATURATION);
+
+    glBindVertexArray(gSpectrogram.vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+
+    glUseProgram(0);
+    unbindHistoryAndColormap();
+
+    // Leave the full-window viewport the fixed-function path leaves behind
+    int windowWidth = 0, windowHeight = 0;
+    glfwGetWindowSize(glfwGetCurrentContext(), &windowWidth, &windowHeight);
+    glViewport(0, 0, windowWidth, windowHeight);
+    return true;
+}
+
+static void destroySpectrogramGPU() {
+    if (gSpectrogram.program) glDeleteProgram(gSpectrogram.program);
+    if (gSpectrogram.vao) glDeleteVertexArrays(1, &gSpectrogram.vao);
+    gSpectrogram = SpectrogramGPU();
+}
+
+// CPU colormapping fallback: texture-based rendering (10-50x faster than the old quad-based method)
+static void renderTraditionalSpectrogramCPU(int vpX, int vpY, int vpW, int vpH, int ch) {
+    updateSpectrogramTexture();
+
+    // Visible window: the HISTORY_LINES columns ending at the newest line.
+    // Oldest on the LEFT, newest on the RIGHT edge (matching audio playback).
+    const float u1 = (float)(historyHead + 1) / (float)texWidth;
+    const float u0 = u1 - (float)HISTORY_LINES / (float)texWidth;
+    const float v0 = (float)ch / (float)spectrogramTextureChannels;  // This channel's band
+    const float v1 = (float)(ch + 1) / (float)spectrogramTextureChannels;
+
+    glBindTexture(GL_TEXTURE_2D, spectrogramTexture);
+
+    // Set up rendering state
+    int windowWidth = 0, windowHeight = 0;
+    GLFWwindow* ctx = glfwGetCurrentContext();
+    glfwGetWindowSize(ctx, &windowWidth, &windowHeight);
+
+    glViewport(0, 0, windowWidth, windowHeight);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(vpX, vpY, vpW, vpH);
+
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, windowWidth, 0, windowHeight, -1, 1);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    // Draw SINGLE textured quad (instead of millions of quads!)
+    // Standard texture coordinates: low freq (row 0) at bottom, high freq at top
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(u0, v0); glVertex2f((float)vpX, (float)vpY);                     // bottom-left
+    glTexCoord2f(u1, v0); glVertex2f((float)vpX + vpW, (float)vpY);               // bottom-right
+    glTexCoord2f(u1, v1); glVertex2f((float)vpX + vpW, (float)vpY + vpH);         // top-right
+    glTexCoord2f(u0, v1); glVertex2f((float)vpX, (float)vpY + vpH);               // top-left
+    glEnd();
+
+    glDisable(GL_TEXTURE_2D);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+
+    glDisable(GL_SCISSOR_TEST);
+}
+
+static void renderTraditionalSpectrogram(int vpX, int vpY, int vpW, int vpH, int ch = 0) {
+    if (!drawSpectrogramGPU(vpX, vpY, vpW, vpH, ch)) {
+        renderTraditionalSpectrogramCPU(vpX, vpY, vpW, vpH, ch);
+    }
+    if (ch == 0) drawStatsOverlay2D(vpX, vpY, vpW, vpH);
+}
+
+// ===================== Spectrum Pyramid =====================
+// When a file is loaded, every STFT line of the whole file is computed in the
+// background by a pool of workers (one FFTW plan, decoder and buffer set each)
+// and kept as 8-bit rows: level 0 holds one row per hop, each further level
+// the per-bar peak of two rows of the level below. Level 0 is cached next to
+// the audio file as <file>.specpyr, keyed on a content hash and the analysis
+// settings, so a reopened file is ready immediately. Seeks refill the history
+// from level 0 and the whole-file overview reads the coarsest level that still
+// has enough rows, instead of re-running the FFT.
+static constexpr uint32_t PYRAMID_MAGIC = 0x52595053;  // "SPYR"
+static constexpr uint32_t PYRAMID_VERSION = 1;
+static constexpr int PYRAMID_CHUNK_HOPS = 64;          // Hops a worker analyses per seek
+
+struct PyramidKey {
+    uint64_t fileHash = 0;
+    uint32_t sampleRate = 0;
+    int32_t fftSize = 0;
+    int32_t numBars = 0;
+    int32_t hop = 0;
+    int32_t windowType = 0;
+
+    // Everything except the hash, which is only known once the file has been read
+    bool sameSettings(const PyramidKey& o) const {
+        return sampleRate == o.sampleRate && fftSize == o.fftSize && numBars == o.numBars &&
+               hop == o.hop && windowType == o.windowType;
+    }
+};
+
+struct SpectrumPyramid {
+    PyramidKey key;
+    uint64_t rows = 0;                          // Level 0 rows (one per hop)
+    std::vector<std::vector<uint8_t>> levels;  // levels[L]: ceil(rows / 2^L) rows of numBars
+
+    uint64_t levelRows(int level) const { return levels[(size_t)level].size() / (size_t)key.numBars; }
+};
+
+static SpectrumPyramid gPyramid;                  // Owned by the build thread until gPyramidReady
+static std::atomic<bool> gPyramidReady{false};
+static std::atomic<bool> gPyramidCancel{false};
+static std::atomic<uint64_t> gPyramidRowsDone{0};
+static std::atomic<uint64_t> gPyramidRowsTotal{0};
+static std::thread gPyramidThread;
+static std::string gPyramidPath;                  // File the current job is for (main thread)
+static PyramidKey gPyramidJobKey;                 // Settings the current job uses (main thread)
+static bool showWholeFile = false;                // Overview of the whole file instead of live lines
+static int wholeFileLines = 0;                    // HISTORY_LINES the overview was laid out for (0 = not shown)
+
+// FNV-1a over the file size and its first and last MiB: cheap even for huge
+// files, and any re-encode or edit changes it
+static bool hashAudioFile(const std::string& path, uint64_t& hash) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f) return false;
+    const uint64_t size = (uint64_t)f.tellg();
+    const uint64_t span = std::min<uint64_t>(size, 1u << 20);
+
+    hash = 1469598103934665603ull;
+    auto mix = [&hash](const unsigned char* p, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            hash ^= p[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    mix((const unsigned char*)&size, sizeof(size));
+
+    std::vector<char> buffer((size_t)span);
+    const uint64_t offsets[2] = { 0, size - span };
+    for (int i = 0; i < 2; i++) {
+        f.seekg((std::streamoff)offsets[i]);
+        if (!f.read(buffer.data(), (std::streamsize)span)) return false;
+        mix((const unsigned char*)buffer.data(), buffer.size());
+    }
+    return true;
+}
+
+static std::string pyramidCachePath(const std::string& audioPath) {
+    return audioPath + ".specpyr";
+}
+
+// Level 0 of a cache written for 'key' with 'expectedRows' rows. The header
+// is checked against the settings and the file size before anything is
+// allocated, so a truncated or foreign file just means a rebuild.
+static bool loadPyramidCache(const std::string& path, const PyramidKey& key, uint64_t expectedRows,
+                             SpectrumPyramid& pyr) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f) return false;
+    const uint64_t fileSize = (uint64_t)f.tellg();
+    f.seekg(0);
+
+    uint32_t magic = 0, version = 0;
+    PyramidKey stored;
+    uint64_t rows = 0;
+    f.read((char*)&magic, sizeof(magic));
+    f.read((char*)&version, sizeof(version));
+    f.read((char*)&stored, sizeof(stored));
+    f.read((char*)&rows, sizeof(rows));
+    if (!f || magic != PYRAMID_MAGIC || version != PYRAMID_VERSION ||
+        stored.fileHash != key.fileHash || !stored.sameSettings(key) || key.numBars <= 0) {
+        return false;
+    }
+
+    const uint64_t header = sizeof(magic) + sizeof(version) + sizeof(stored) + sizeof(rows);
+    if (rows != expectedRows || fileSize < header ||
+        rows > (fileSize - header) / (uint64_t)key.numBars ||
+        rows * (uint64_t)key.numBars != fileSize - header) {
+        return false;
+    }
+
+    pyr.key = key;
+    pyr.rows = rows;
+    pyr.levels.assign(1, std::vector<uint8_t>((size_t)rows * (size_t)key.numBars));
+    f.read((char*)pyr.levels[0].data(), (std::streamsize)pyr.levels[0].size());
+    return (bool)f;
+}
+
+static void savePyramidCache(const std::string& path, const SpectrumPyramid& pyr) {
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (f) {
+        const uint32_t magic = PYRAMID_MAGIC, version = PYRAMID_VERSION;
+        f.write((const char*)&magic, sizeof(magic));
+        f.write((const char*)&version, sizeof(version));
+        f.write((const char*)&pyr.key, sizeof(pyr.key));
+        f.write((const char*)&pyr.rows, sizeof(pyr.rows));
+        f.write((const char*)pyr.levels[0].data(), (std::streamsize)pyr.levels[0].size());
+    }
+    if (!f) std::cerr << "Error: Could not write spectrogram cache " << path << "\n";
+}
+
+// Derive levels 1.. from level 0 (per-bar peak of row pairs)
+static void buildPyramidLevels(SpectrumPyramid& pyr) {
+    const size_t bars = (size_t)pyr.key.numBars;
+    pyr.levels.resize(1);
+    while (pyr.levelRows((int)pyr.levels.size() - 1) > 1) {
+        const std::vector<uint8_t>& src = pyr.levels.back();
+        const size_t srcRows = src.size() / bars;
+        std::vector<uint8_t> dst(((srcRows + 1) / 2) * bars);
+        for (size_t r = 0; r < srcRows; r++) {
+            const uint8_t* a = &src[r * bars];
+            uint8_t* d = &dst[(r / 2) * bars];
+            for (size_t b = 0; b < bars; b++) d[b] = std::max(d[b], a[b]);
+        }
+        pyr.levels.push_back(std::move(dst));
+    }
+}
+
+// Mono frames [start, start + count) of an open file; frames before 0 or past
+// the end are zero. Returns false if the decoder cannot seek.
+static bool decodeMonoSpan(SNDFILE* snd, int channels, int64_t start, float* dst, size_t count,
+                           std::vector<float>& scratch) {
+    size_t lead = 0;
+    if (start < 0) {
+        lead = (size_t)std::min<int64_t>(-start, (int64_t)count);
+        std::fill(dst, dst + lead, 0.0f);
+        start = 0;
+    }
+    if (lead == count) return true;
+    if (sf_seek(snd, (sf_count_t)start, SEEK_SET) < 0) return false;
+
+    const float invCh = 1.0f / (float)channels;
+    size_t filled = lead;
+    while (filled < count) {
+        const size_t want = std::min<size_t>(count - filled, STREAM_BLOCK_FRAMES);
+        scratch.resize(want * (size_t)channels);
+        sf_count_t got = sf_readf_float(snd, scratch.data(), (sf_count_t)want);
+        if (got <= 0) break;
+        for (sf_count_t i = 0; i < got; i++) {
+            float sum = 0.0f;
+            for (int ch = 0; ch < channels; ch++) sum += scratch[(size_t)i * (size_t)channels + (size_t)ch];
+            dst[filled + (size_t)i] = sum * invCh;
+        }
+        filled += (size_t)got;
+    }
+    std::fill(dst + filled, dst + count, 0.0f);
+    return true;
+}
+
+// Copy of everything a worker needs, so GUI changes mid-build cannot race it
+struct PyramidAnalysis {
+    int fftSize = 0;
+    std::vector<float> window;
+    float windowScale = 0.0f;
+    std::vector<int32_t> bin0, bin1;
+    std::vector<float> frac;
+    int split = 0;
+};
+
+static void pyramidWorker(const std::string& path, const PyramidAnalysis& a, const PyramidKey& key,
+                          std::vector<uint8_t>& level0, uint64_t rows, std::atomic<uint64_t>& nextChunk,
+                          std::atomic<bool>& failed) {
+    SF_INFO info;
+    memset(&info, 0, sizeof(info));
+    SNDFILE* snd = sf_open(path.c_str(), SFM_READ, &info);
+    if (!snd) {
+        failed.store(true);
+        return;
+    }
+    const int channels = std::max(1, info.channels);
+    const int n = a.fftSize;
+
+    FFTPlanEntry plan;
+    {
+        std::lock_guard<std::mutex> plannerLock(gPlannerMutex);
+        plan = createFFTPlan(n, planEffortFlags | FFTW_WISDOM_ONLY);
+        if (!plan.plan) {
+            destroyFFTPlan(plan);
+            plan = createFFTPlan(n, FFTW_ESTIMATE);
+        }
+    }
+    if (!plan.plan) failed.store(true);
+
+    const size_t spanFrames = (size_t)(PYRAMID_CHUNK_HOPS - 1) * (size_t)key.hop + (size_t)n;
+    std::vector<float> span(spanFrames);
+    std::vector<float> scratch;
+    std::vector<float> mags((size_t)(n / 2));
+    std::vector<float> line((size_t)key.numBars);
+
+    for (;;) {
+        if (gPyramidCancel.load(std::memory_order_acquire) || failed.load()) break;
+        const uint64_t k0 = nextChunk.fetch_add(PYRAMID_CHUNK_HOPS);
+        if (k0 >= rows) break;
+        const uint64_t k1 = std::min<uint64_t>(rows, k0 + PYRAMID_CHUNK_HOPS);
+
+        // One decode covers every window of the chunk (row k is centred on k * hop)
+        const int64_t spanStart = (int64_t)(k0 * (uint64_t)key.hop) - n / 2;
+        if (!decodeMonoSpan(snd, channels, spanStart, span.data(), span.size(), scratch)) {
+            std::cerr << "Error: Cannot seek in " << path << ", spectrogram precompute disabled\n";
+            failed.store(true);
+            break;
+        }
+
+        for (uint64_t k = k0; k < k1; k++) {
+            std::memcpy(plan.input, &span[(size_t)((k - k0) * (uint64_t)key.hop)], sizeof(float) * (size_t)n);
+            applyWindow(plan.input, a.window.data(), n);
+            fftwf_execute(plan.plan);
+            computeMagnitudes(plan.output, mags.data(), n / 2, a.windowScale);
+            mapSpectrumToLine(mags.data(), line.data(), a.bin0.data(), a.bin1.data(), a.frac.data(), a.split);
+
+            uint8_t* row = &level0[(size_t)k * (size_t)key.numBars];
+            for (int b = 0; b < key.numBars; b++) row[b] = (uint8_t)(line[(size_t)b] * 255.0f + 0.5f);
+        }
+        gPyramidRowsDone.fetch_add(k1 - k0, std::memory_order_relaxed);
+    }
+
+    sf_close(snd);
+    std::lock_guard<std::mutex> plannerLock(gPlannerMutex);
+    destroyFFTPlan(plan);
+}
+
+// ---- GPU backend ----
+// With OpenGL 4.3 the whole-file precompute can run as compute shaders instead
+// of on the FFTW workers. The build thread still decodes (that is sndfile work)
+// and queues mono spans of up to GPU_BATCH_POINTS / N rows. The render thread,
+// which owns the context, uploads one span at a time and then:
+//   1. windows every row of the batch into a complex buffer,
+//   2. runs log2(N) radix-2 Stockham passes over the whole batch (ping-pong),
+//   3. maps bins to bars with the same interpolate / peak / log rule as
+//      mapSpectrumToLine() and quantises to 8 bits, four bars per word.
+// Only those packed rows come back (fenced, so the read never stalls the
+// frame), because the pyramid keeps them on the CPU for seeks and the disk
+// cache. If the shaders cannot be built or a batch fails, the build falls
+// back to the FFTW workers.
+enum PrecomputeBackend { PRECOMPUTE_FFTW = 0, PRECOMPUTE_GPU, PRECOMPUTE_BACKEND_COUNT };
+static const char* precomputeBackendNames[PRECOMPUTE_BACKEND_COUNT] = { "FFTW (CPU)", "GPU compute" };
+static constexpr size_t GPU_BATCH_POINTS = 1u << 22;  // Complex points per batch (32 MiB per buffer)
+static constexpr size_t GPU_QUEUED_SPANS = 3;         // Decoded spans waiting for the render thread
+static constexpr int GPU_LOCAL_SIZE = 256;
+
+static int precomputeBackend = PRECOMPUTE_FFTW;  // Settings / --precompute; read when a build starts
+static bool gGpuComputeSupported = false;        // Set after glewInit()
+
+struct GpuSpan {
+    uint64_t firstRow = 0;
+    uint64_t rowCount = 0;
+    std::vector<float> samples;  // (rowCount - 1) * hop + N mono frames
+};
+
+// Shared between the build thread and the render thread
+struct GpuPyramidJob {
+    uint64_t id = 0;
+    PyramidAnalysis analysis;
+    PyramidKey key;
+    uint64_t rows = 0;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<GpuSpan> spans;
+    std::vector<uint8_t>* level0 = nullptr;  // Build thread's rows; null once it stopped waiting
+    uint64_t rowsWritten = 0;
+    bool failed = false;
+};
+
+static std::mutex gGpuJobMutex;
+static std::shared_ptr<GpuPyramidJob> gGpuJob;  // Build in progress on the GPU, guarded by gGpuJobMutex
+
+struct GpuFFT {
+    bool initialized = false;
+    bool available = false;
+    GLuint windowProgram = 0, passProgram = 0, mapProgram = 0;
+    GLuint samples = 0, window = 0, barTable = 0, dataA = 0, dataB = 0, rowsOut = 0;
+    size_t samplesCapacity = 0, dataCapacity = 0, rowsCapacity = 0;  // Bytes allocated
+    uint64_t tablesJob = 0;  // Job whose window / bar tables are uploaded
+
+    // Batch in flight
+    GLsync fence = 0;
+    std::shared_ptr<GpuPyramidJob> job;
+    uint64_t firstRow = 0, rowCount = 0;
+    std::vector<uint32_t> readback;
+};
+
+static GpuFFT gGpuFFT;  // Render thread only
+
+static const char* kGpuWindowCS = R"(#version 430
+layout(local_size_x = 256) in;
+layout(std430, binding = 0) readonly buffer Samples { float samples[]; };
+layout(std430, binding = 1) readonly buffer Window { float window[]; };
+layout(std430, binding = 2) writeonly buffer Data { vec2 data[]; };
+uniform int uN;
+uniform int uHop;
+uniform int uCount;
+void main() {
+    int gid = int(gl_GlobalInvocationID.x);
+    if (gid >= uCount) return;
+    int row = gid / uN;
+    int i = gid - row * uN;
+    data[gid] = vec2(samples[row * uHop + i] * window[i], 0.0);
+}
+)";
+
+// One radix-2 Stockham pass; natural order comes out after log2(N) passes
+static const char* kGpuPassCS = R"(#version 430
+layout(local_size_x = 256) in;
+layout(std430, binding = 2) readonly buffer Src { vec2 src[]; };
+layout(std430, binding = 3) writeonly buffer Dst { vec2 dst[]; };
+uniform int uN;
+uniform int uNs;
+uniform int uCount;
+void main() {
+    int gid = int(gl_GlobalInvocationID.x);
+    if (gid >= uCount) return;
+    int halfN = uN / 2;
+    int row = gid / halfN;
+    int j = gid - row * halfN;
+    int base = row * uN;
+    int k = j % uNs;
+    vec2 a = src[base + j];
+    vec2 b = src[base + j + halfN];
+    float angle = -3.14159265358979 * float(k) / float(uNs);
+    vec2 w = vec2(cos(angle), sin(angle));
+    b = vec2(b.x * w.x - b.y * w.y, b.x * w.y + b.y * w.x);
+    int d = base + (j / uNs) * uNs * 2 + k;
+    dst[d] = a + b;
+    dst[d + uNs] = a - b;
+}
+)";
+
+static const char* kGpuMapCS = R"(#version 430
+layout(local_size_x = 256) in;
+layout(std430, binding = 2) readonly buffer Spectrum { vec2 spectrum[]; };
+layout(std430, binding = 4) readonly buffer Bars { ivec4 bars[]; };  // bin0, bin1, frac bits, -
+layout(std430, binding = 5) writeonly buffer Rows { uint rows[]; };
+uniform int uN;
+uniform int uBars;
+uniform int uQuads;
+uniform int uSplit;
+uniform int uCount;
+uniform float uScale;
+uniform float uGain;
+
+float mag(int base, int bin) { return length(spectrum[base + bin]) * uScale; }
+
+void main() {
+    int gid = int(gl_GlobalInvocationID.x);
+    if (gid >= uCount) return;
+    int row = gid / uQuads;
+    int quad = gid - row * uQuads;
+    int base = row * uN;
+    float invDen = 1.0 / log2(1.0 + uGain);
+    uint packed = 0u;
+    for (int c = 0; c < 4; c++) {
+        int bar = quad * 4 + c;
+        if (bar >= uBars) break;
+        ivec4 t = bars[bar];
+        float v;
+        if (bar < uSplit) {
+            float a = mag(base, t.x);
+            v = a + (mag(base, t.x + 1) - a) * intBitsToFloat(t.z);
+        } else {
+            v = 0.0;
+            for (int b = t.x; b <= t.y; b++) v = max(v, mag(base, b));
+        }
+        v = clamp(log2(1.0 + max(v, 0.0) * uGain) * invDen, 0.0, 1.0);
+        packed |= uint(v * 255.0 + 0.5) << uint(8 * c);
+    }
+    rows[gid] = packed;
+}
+)";
+
+static GLuint linkComputeProgram(const char* src) {
+    GLuint cs = compileShader(GL_COMPUTE_SHADER, src);
+    if (!cs) return 0;
+    GLuint program = glCreateProgram();
+    glAttachShader(program, cs);
+    glLinkProgram(program);
+    glDeleteShader(cs);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::cerr << "Error: Compute shader link failed:\n" << log << "\n";
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+static void initGpuFFT() {
+    GpuFFT& g = gGpuFFT;
+    g.initialized = true;
+    if (!gGpuComputeSupported) return;
+    g.windowProgram = linkComputeProgram(kGpuWindowCS);
+    g.passProgram = linkComputeProgram(kGpuPassCS);
+    g.mapProgram = linkComputeProgram(kGpuMapCS);
+    if (!g.windowProgram || !g.passProgram || !g.mapProgram) return;
+    GLuint buffers[6];
+    glGenBuffers(6, buffers);
+    g.samples = buffers[0];
+    g.window = buffers[1];
+    g.barTable = buffers[2];
+    g.dataA = buffers[3];
+    g.dataB = buffers[4];
+    g.rowsOut = buffers[5];
+    g.available = true;
+}
+
+static void destroyGpuFFT() {
+    GpuFFT& g = gGpuFFT;
+    if (g.fence) glDeleteSync(g.fence);
+    if (g.windowProgram) glDeleteProgram(g.windowProgram);
+    if (g.passProgram) glDeleteProgram(g.passProgram);
+    if (g.mapProgram) glDeleteProgram(g.mapProgram);
+    if (g.samples) {
+        GLuint buffers[6] = { g.samples, g.window, g.barTable, g.dataA, g.dataB, g.rowsOut };
+        glDeleteBuffers(6, buffers);
+    }
+    g = GpuFFT();
+}
+
+// Grow an SSBO to at least 'bytes' (contents are not kept)
+static void reserveStorageBuffer(GLuint buffer, size_t& capacity, size_t bytes) {
+    if (bytes <= capacity) return;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)bytes, nullptr, GL_DYNAMIC_DRAW);
+    capacity = bytes;
+}
+
+static void dispatchCompute1D(GLuint program, int count) {
+    glUniform1i(glGetUniformLocation(program, "uCount"), count);
+    glDispatchCompute((GLuint)((count + GPU_LOCAL_SIZE - 1) / GPU_LOCAL_SIZE), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Queue the whole pipeline for one span and fence it
+static bool dispatchGpuBatch(const std::shared_ptr<GpuPyramidJob>& job, const GpuSpan& span) {
+    GpuFFT& g = gGpuFFT;
+    if (!g.initialized) initGpuFFT();
+    if (!g.available) return false;
+
+    const PyramidAnalysis& a = job->analysis;
+    const int n = a.fftSize;
+    const int bars = job->key.numBars;
+    const int quads = (bars + 3) / 4;
+    const int rows = (int)span.rowCount;
+
+    if (g.tablesJob != job->id) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.window);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(sizeof(float) * a.window.size()), a.window.data(), GL_STATIC_DRAW);
+        std::vector<int32_t> table((size_t)bars * 4, 0);
+        for (int b = 0; b < bars; b++) {
+            table[(size_t)b * 4 + 0] = a.bin0[(size_t)b];
+            table[(size_t)b * 4 + 1] = a.bin1[(size_t)b];
+            std::memcpy(&table[(size_t)b * 4 + 2], &a.frac[(size_t)b], sizeof(float));
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.barTable);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)(sizeof(int32_t) * table.size()), table.data(), GL_STATIC_DRAW);
+        g.tablesJob = job->id;
+    }
+
+    const size_t dataBytes = sizeof(float) * 2 * (size_t)rows * (size_t)n;
+    reserveStorageBuffer(g.samples, g.samplesCapacity, sizeof(float) * span.samples.size());
+    if (dataBytes > g.dataCapacity) {
+        size_t capacityB = g.dataCapacity;
+        reserveStorageBuffer(g.dataA, g.dataCapacity, dataBytes);
+        reserveStorageBuffer(g.dataB, capacityB, dataBytes);
+    }
+    reserveStorageBuffer(g.rowsOut, g.rowsCapacity, sizeof(uint32_t) * (size_t)rows * (size_t)quads);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.samples);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)(sizeof(float) * span.samples.size()), span.samples.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // 1. Window
+    glUseProgram(g.windowProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, g.samples);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, g.window);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, g.dataA);
+    glUniform1i(glGetUniformLocation(g.windowProgram, "uN"), n);
+    glUniform1i(glGetUniformLocation(g.windowProgram, "uHop"), job->key.hop);
+    dispatchCompute1D(g.windowProgram, rows * n);
+
+    // 2. FFT passes
+    GLuint src = g.dataA, dst = g.dataB;
+    glUseProgram(g.passProgram);
+    glUniform1i(glGetUniformLocation(g.passProgram, "uN"), n);
+    const GLint uNs = glGetUniformLocation(g.passProgram, "uNs");
+    for (int ns = 1; ns < n; ns *= 2) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, src);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, dst);
+        glUniform1i(uNs, ns);
+        dispatchCompute1D(g.passProgram, rows * (n / 2));
+        std::swap(src, dst);
+    }
+
+    // 3. Bars, compression and quantisation
+    glUseProgram(g.mapProgram);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, src);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, g.barTable);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, g.rowsOut);
+    glUniform1i(glGetUniformLocation(g.mapProgram, "uN"), n);
+    glUniform1i(glGetUniformLocation(g.mapProgram, "uBars"), bars);
+    glUniform1i(glGetUniformLocation(g.mapProgram, "uQuads"), quads);
+    glUniform1i(glGetUniformLocation(g.mapProgram, "uSplit"), a.split);
+    glUniform1f(glGetUniformLocation(g.mapProgram, "uScale"), a.windowScale);
+    glUniform1f(glGetUniformLocation(g.mapProgram, "uGain"), MAG_GAIN);
+    glUniform1i(glGetUniformLocation(g.mapProgram, "uCount"), rows * quads);
+    glDispatchCompute((GLuint)((rows * quads + GPU_LOCAL_SIZE - 1) / GPU_LOCAL_SIZE), 1, 1);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glUseProgram(0);
+
+    g.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    g.job = job;
+    g.firstRow = span.firstRow;
+    g.rowCount = span.rowCount;
+    return g.fence != 0;
+}
+
+// Copy a finished batch into the build thread's level 0
+static void collectGpuBatch() {
+    GpuFFT& g = gGpuFFT;
+    GpuPyramidJob& job = *g.job;
+    const int bars = job.key.numBars;
+    const size_t quads = (size_t)(bars + 3) / 4;
+    g.readback.resize((size_t)g.rowCount * quads);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g.rowsOut);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)(sizeof(uint32_t) * g.readback.size()), g.readback.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (job.level0) {
+            for (uint64_t r = 0; r < g.rowCount; r++) {
+                std::memcpy(&(*job.level0)[(size_t)(g.firstRow + r) * (size_t)bars],
+                            &g.readback[(size_t)r * quads], (size_t)bars);  // Bytes in bar order (little endian)
+            }
+            job.rowsWritten += g.rowCount;
+        }
+    }
+    job.changed.notify_all();
+    gPyramidRowsDone.fetch_add(g.rowCount, std::memory_order_relaxed);
+}
+
+// A GPU build is running (keeps frames coming so the render thread can pump it)
+static bool gpuPrecomputeBusy() {
+    std::lock_guard<std::mutex> lock(gGpuJobMutex);
+    return gGpuJob != nullptr || gGpuFFT.fence != 0;
+}
+
+// Render thread, once per loop: retire the batch in flight, then start the next
+static void pumpGpuPrecompute() {
+    GpuFFT& g = gGpuFFT;
+    if (g.fence) {
+        const GLenum state = glClientWaitSync(g.fence, 0, 0);
+        if (state == GL_TIMEOUT_EXPIRED) return;
+        glDeleteSync(g.fence);
+        g.fence = 0;
+        if (state != GL_WAIT_FAILED) collectGpuBatch();
+        g.job.reset();
+    }
+
+    std::shared_ptr<GpuPyramidJob> job;
+    {
+        std::lock_guard<std::mutex> lock(gGpuJobMutex);
+        job = gGpuJob;
+    }
+    if (!job) return;
+
+    GpuSpan span;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        if (job->failed || job->spans.empty()) return;
+        span = std::move(job->spans.front());
+        job->spans.pop_front();
+    }
+    job->changed.notify_all();
+
+    if (!dispatchGpuBatch(job, span)) {
+        std::cerr << "Error: GPU precompute unavailable, falling back to FFTW\n";
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->failed = true;
+        job->changed.notify_all();
+    }
+}
+
+// Build thread: decode spans for the render thread and wait until it has
+// written every row. Returns false when the GPU path failed or was cancelled.
+static bool gpuPyramidBuild(const std::string& path, const PyramidAnalysis& a, const PyramidKey& key,
+                            std::vector<uint8_t>& level0, uint64_t rows) {
+    SF_INFO info;
+    memset(&info, 0, sizeof(info));
+    SNDFILE* snd = sf_open(path.c_str(), SFM_READ, &info);
+    if (!snd) return false;
+    const int channels = std::max(1, info.channels);
+    const int n = a.fftSize;
+
+    static std::atomic<uint64_t> nextJobId{1};
+    std::shared_ptr<GpuPyramidJob> job = std::make_shared<GpuPyramidJob>();
+    job->id = nextJobId.fetch_add(1);
+    job->analysis = a;
+    job->key = key;
+    job->rows = rows;
+    job->level0 = &level0;
+    {
+        std::lock_guard<std::mutex> lock(gGpuJobMutex);
+        gGpuJob = job;
+    }
+
+    const uint64_t batch = std::max<uint64_t>(1, GPU_BATCH_POINTS / (size_t)n);
+    std::vector<float> scratch;
+    bool ok = true;
+    for (uint64_t k0 = 0; k0 < rows && ok; k0 += batch) {
+        GpuSpan span;
+        span.firstRow = k0;
+        span.rowCount = std::min<uint64_t>(batch, rows - k0);
+        span.samples.resize((size_t)((span.rowCount - 1) * (uint64_t)key.hop) + (size_t)n);
+        const int64_t start = (int64_t)(k0 * (uint64_t)key.hop) - n / 2;
+        if (!decodeMonoSpan(snd, channels, start, span.samples.data(), span.samples.size(), scratch)) {
+            std::cerr << "Error: Cannot seek in " << path << ", spectrogram precompute disabled\n";
+            ok = false;
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(job->mutex);
+        while (job->spans.size() >= GPU_QUEUED_SPANS && !job->failed && !gPyramidCancel.load(std::memory_order_acquire)) {
+            job->changed.wait_for(lock, std::chrono::milliseconds(50));
+        }
+        if (job->failed || gPyramidCancel.load(std::memory_order_acquire)) ok = false;
+        else job->spans.push_back(std::move(span));
+    }
+    sf_close(snd);
+
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        while (ok && job->rowsWritten < rows && !job->failed && !gPyramidCancel.load(std::memory_order_acquire)) {
+            job->changed.wait_for(lock, std::chrono::milliseconds(50));
+        }
+        ok = ok && !job->failed && job->rowsWritten >= rows;
+        job->level0 = nullptr;  // The render thread must not touch level 0 from here on
+        job->spans.clear();
+    }
+    {
+        std::lock_guard<std::mutex> lock(gGpuJobMutex);
+        if (gGpuJob == job) gGpuJob.reset();
+    }
+    if (!ok) gPyramidRowsDone.store(0, std::memory_order_relaxed);
+    return ok;
+}
+
+static void pyramidBuildMain(std::string path, PyramidKey key, PyramidAnalysis analysis, uint64_t totalFrames,
+                             bool useGpu) {
+    if (!hashAudioFile(path, key.fileHash)) return;
+
+    const uint64_t rows = (totalFrames + (uint64_t)key.hop - 1) / (uint64_t)key.hop;
+    gPyramidRowsTotal.store(rows, std::memory_order_relaxed);
+
+    SpectrumPyramid pyr;
+    const std::string cachePath = pyramidCachePath(path);
+    if (!loadPyramidCache(cachePath, key, rows, pyr)) {
+        pyr.key = key;
+        pyr.rows = rows;
+        pyr.levels.assign(1, std::vector<uint8_t>((size_t)rows * (size_t)key.numBars, 0));
+
+        const bool gpuDone = useGpu && gpuPyramidBuild(path, analysis, key, pyr.levels[0], rows);
+        if (gPyramidCancel.load(std::memory_order_acquire)) return;
+        if (!gpuDone) {
+            // Leave a core for the render and audio threads
+            const int workers = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+            std::atomic<uint64_t> nextChunk{0};
+            std::atomic<bool> failed{false};
+            std::vector<std::thread> pool;
+            for (int w = 0; w < workers; w++) {
+                pool.push_back(std::thread(pyramidWorker, std::cref(path), std::cref(analysis), std::cref(key),
+                                           std::ref(pyr.levels[0]), rows, std::ref(nextChunk), std::ref(failed)));
+            }
+            for (size_t w = 0; w < pool.size(); w++) pool[w].join();
+            if (failed.load() || gPyramidCancel.load(std::memory_order_acquire)) return;
+        }
+
+        savePyramidCache(cachePath, pyr);
+    }
+    gPyramidRowsDone.store(rows, std::memory_order_relaxed);
+
+    buildPyramidLevels(pyr);
+    gPyramid = std::move(pyr);
+    gPyramidReady.store(true, std::memory_order_release);
+}
+
+static PyramidKey currentPyramidSettings() {
+    PyramidKey key;
+    key.sampleRate = wavFile->sampleRate;
+    key.fftSize = FFT_SIZE;
+    key.numBars = NUM_BARS;
+    key.hop = std::max(1, ANALYSIS_HOP.load(std::memory_order_relaxed));
+    key.windowType = windowType;
+    return key;
+}
+
+static void stopPyramidBuild() {
+    gPyramidCancel.store(true, std::memory_order_release);
+    if (gPyramidThread.joinable()) gPyramidThread.join();
+    gPyramidReady.store(false, std::memory_order_release);
+    gPyramid = SpectrumPyramid();
+    gPyramidRowsDone.store(0, std::memory_order_relaxed);
+    gPyramidRowsTotal.store(0, std::memory_order_relaxed);
+}
+
+// (Re)start the background build for the loaded file with the current settings
+static void startPyramidBuild(const std::string& path) {
+    stopPyramidBuild();
+    gPyramidPath = path;
+    wholeFileLines = 0;  // Re-layout the overview once the new pyramid is ready
+    if (wavFile->empty()) return;
+
+    PyramidAnalysis analysis;
+    PyramidKey key = currentPyramidSettings();
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        if (fftPlanSize != key.fftSize) return;  // Plan not switched yet; retried next frame
+        if (gMappingBins != fftPlanSize / 2) buildFrequencyMapping();
+        analysis.fftSize = fftPlanSize;
+        analysis.window = fftWindow;
+        analysis.windowScale = fftWindowScale;
+        analysis.bin0 = gBarBin0;
+        analysis.bin1 = gBarBin1;
+        analysis.frac = gBarFrac;
+        analysis.split = gBarSplit;
+    }
+
+    gPyramidJobKey = key;
+    gPyramidCancel.store(false, std::memory_order_release);
+    const bool useGpu = precomputeBackend == PRECOMPUTE_GPU && gGpuComputeSupported;
+    gPyramidThread = std::thread(pyramidBuildMain, path, key, analysis, wavFile->totalFrames, useGpu);
+}
+
+// Restart the build if FFT size, hop or window changed since it was started
+static void updatePyramidBuild() {
+    if (gPyramidPath.empty() || wavFile->empty()) return;
+    if (!currentPyramidSettings().sameSettings(gPyramidJobKey)) startPyramidBuild(gPyramidPath);
+}
+
+// The pyramid holds the mono downmix only, so per-channel views never use it
+static bool pyramidUsable() {
+    return gHistoryChannels == 1 && gPyramidReady.load(std::memory_order_acquire) &&
+           gPyramid.key.sameSettings(currentPyramidSettings()) && fftPlanSize == gPyramid.key.fftSize;
+}
+
+static inline void dequantizeRow(const uint8_t* src, float* dst) {
+    for (int b = 0; b < NUM_BARS; b++) dst[b] = (float)src[b] * (1.0f / 255.0f);
+}
+
+static void markHistoryRewritten(int filled) {
+    historyFillCount = std::min(filled, HISTORY_LINES);
+    historyFullUpload = true;
+    spectrogramFullRebuild = true;
+    gLineQueue.clear();
+}
+
+static bool sessionLogOwnsHistory();
+
+// Rebuild the history ring as if playback had run up to 'pos'. Returns false
+// (history untouched) when no matching pyramid is available.
+static bool refillHistoryAt(uint64_t pos) {
+    if (sessionLogOwnsHistory()) return true;  // Refilled from the log next frame
+    if (!pyramidUsable()) return false;
+
+    const int64_t latency = (int64_t)(gLatencySamplesBase + gLatencyAdjust);
+    const int64_t newest = ((int64_t)pos - latency) / (int64_t)gPyramid.key.hop;
+    const std::vector<uint8_t>& level0 = gPyramid.levels[0];
+
+    for (int age = 0; age < MAX_HISTORY_LINES; age++) {
+        int idx = historyHead - age;
+        if (idx < 0) idx += MAX_HISTORY_LINES;
+        float* dst = &lineHistory[(size_t)idx * (size_t)NUM_BARS];
+        const int64_t row = newest - age;
+        if (row < 0 || row >= (int64_t)gPyramid.rows) {
+            std::fill(dst, dst + NUM_BARS, 0.0f);
+        } else {
+            dequantizeRow(&level0[(size_t)row * (size_t)NUM_BARS], dst);
+        }
+    }
+    std::memcpy(currentLine.data(), historyRow(0), sizeof(float) * NUM_BARS);
+    markHistoryRewritten((int)std::max<int64_t>(0, std::min<int64_t>(newest + 1, MAX_HISTORY_LINES)));
+    return true;
+}
+
+// Spread the whole file over the visible HISTORY_LINES lines (newest = end)
+static bool fillHistoryWithWholeFile() {
+    if (!pyramidUsable() || gPyramid.rows == 0) return false;
+
+    const int lines = HISTORY_LINES;
+    const uint64_t rowsPerLine = std::max<uint64_t>(1, gPyramid.rows / (uint64_t)lines);
+    int level = 0;
+    while (level + 1 < (int)gPyramid.levels.size() && (2ull << level) <= rowsPerLine) level++;
+
+    const uint64_t levelRows = gPyramid.levelRows(level);
+    const std::vector<uint8_t>& src = gPyramid.levels[(size_t)level];
+    std::vector<uint8_t> peak((size_t)NUM_BARS);
+
+    for (int age = 0; age < MAX_HISTORY_LINES; age++) {
+        int idx = historyHead - age;
+        if (idx < 0) idx += MAX_HISTORY_LINES;
+        float* dst = &lineHistory[(size_t)idx * (size_t)NUM_BARS];
+        if (age >= lines) {
+            std::fill(dst, dst + NUM_BARS, 0.0f);
+            continue;
+        }
+
+        const uint64_t j = (uint64_t)(lines - 1 - age);  // 0 = oldest line
+        const uint64_t r0 = levelRows * j / (uint64_t)lines;
+        const uint64_t r1 = std::max(r0 + 1, levelRows * (j + 1) / (uint64_t)lines);
+        std::fill(peak.begin(), peak.end(), 0);
+        for (uint64_t r = r0; r < r1 && r < levelRows; r++) {
+            const uint8_t* row = &src[(size_t)r * (size_t)NUM_BARS];
+            for (int b = 0; b < NUM_BARS; b++) peak[(size_t)b] = std::max(peak[(size_t)b], row[b]);
+        }
+        dequantizeRow(peak.data(), dst);
+    }
+    std::memcpy(currentLine.data(), historyRow(0), sizeof(float) * NUM_BARS);
+    markHistoryRewritten(lines);
+    return true;
+}
+
+// Move playback to 'pos'; the history jumps with it when the pyramid is ready
+static void seekTo(uint64_t pos) {
+    playbackPosition.store(pos, std::memory_order_relaxed);
+    if (!showWholeFile) refillHistoryAt(pos);
+}
+
+// ===================== Session Log =====================
+// Long recordings of analysed lines (--record or "Record session"). The log is
+// a header followed by fixed-size chunks, so chunk c lives at a computed
+// offset and any line is one lookup away. The recorder maps one chunk at a
+// time for writing; the viewer maps the whole file read-only and only touches
+// pages for the rows it shows.
+//
+// Chunk (SESSION_LOG_CHUNK_LINES lines, padded to 64 KiB):
+//   SessionChunkHeader
+//   uint32 msOffset[lines]     wall time of each line after chunk.wallStartUs
+//   peak levels 4..1           1, 8, 64, 512 rows, each the max of 8^L lines
+//   level 0                    one 8-bit row per line
+// With peaks stored per chunk, zooming out to hours or days reads about 8
+// rows per screen column instead of every line in the span.
+static constexpr uint32_t SESSION_LOG_CHUNK_LINES = 4096;     // 8^4: level 4 is one row per chunk
+static constexpr int SESSION_LOG_LEVELS = 5;
+static constexpr uint64_t SESSION_LOG_ALIGN = 65536;          // Map granularity on every platform
+static const char SESSION_LOG_MAGIC[8] = { 'S', 'P', 'E', 'C', 'L', 'O', 'G', '1' };
+
+struct SessionLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numBars;
+    uint32_t hop;
+    uint32_t sampleRate;
+    uint32_t fftSize;
+    uint32_t chunkLines;
+    uint64_t chunkBytes;
+    uint64_t dataOffset;  // First chunk
+    int64_t startWallUs;  // Microseconds since the Unix epoch
+};
+
+struct SessionChunkHeader {
+    uint32_t lineCount;   // Lines written; updated after each line, so a crash loses at most one
+    uint32_t index;
+    uint64_t firstPosition;  // Analysis stamp (sample position) of the first line
+    int64_t wallStartUs;
+    uint8_t reserved[40];
+};
+
+static_assert(sizeof(SessionChunkHeader) == 64, "SessionChunkHeader layout");
+
+static inline uint64_t levelFactor(int level) { return 1ull << (3 * level); }
+
+// Byte offset of level 'level' row 'row' inside a chunk
+static uint64_t chunkRowOffset(uint32_t numBars, int level, uint64_t row) {
+    uint64_t offset = sizeof(SessionChunkHeader) + sizeof(uint32_t) * SESSION_LOG_CHUNK_LINES;
+    for (int l = SESSION_LOG_LEVELS - 1; l > level; l--) {
+        offset += (SESSION_LOG_CHUNK_LINES / levelFactor(l)) * numBars;
+    }
+    return offset + row * numBars;
+}
+
+static uint64_t sessionChunkBytes(uint32_t numBars) {
+    const uint64_t used = chunkRowOffset(numBars, 0, SESSION_LOG_CHUNK_LINES);
+    return (used + SESSION_LOG_ALIGN - 1) / SESSION_LOG_ALIGN * SESSION_LOG_ALIGN;
+}
+
+static int64_t wallClockUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Appends lines through a writable mapping of the current chunk
+class SessionLogWriter {
+public:
+    ~SessionLogWriter() { close(); }
+
+    bool create(const std::string& path, uint32_t numBars, uint32_t hop, uint32_t sampleRate, uint32_t fftSize) {
+        close();
+        SessionLogHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, SESSION_LOG_MAGIC, sizeof(h.magic));
+        h.version = 1;
+        h.numBars = numBars;
+        h.hop = hop;
+        h.sampleRate = sampleRate;
+        h.fftSize = fftSize;
+        h.chunkLines = SESSION_LOG_CHUNK_LINES;
+        h.chunkBytes = sessionChunkBytes(numBars);
+        h.dataOffset = SESSION_LOG_ALIGN;
+        h.startWallUs = wallClockUs();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                           CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        DWORD written = 0;
+        if (!WriteFile(file, &h, sizeof(h), &written, nullptr) || written != sizeof(h)) { close(); return false; }
+#else
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        if (::write(fd, &h, sizeof(h)) != (ssize_t)sizeof(h)) { close(); return false; }
+#endif
+        header = h;
+        filePath = path;
+        chunks = 0;
+        lines = 0;
+        return true;
+    }
+
+    bool isOpen() const { return !filePath.empty(); }
+    const std::string& path() const { return filePath; }
+    uint64_t lineCount() const { return lines; }
+    uint64_t bytes() const { return header.dataOffset + chunks * header.chunkBytes; }
+
+    // 'line' holds numBars values in 0..1
+    bool append(const float* line, uint64_t position) {
+        if (!isOpen()) return false;
+        if (!chunk || chunkHeader()->lineCount == header.chunkLines) {
+            if (!mapNextChunk(position)) {
+                std::cerr << "Error: Cannot grow session log " << filePath << ", recording stopped\n";
+                close();
+                return false;
+            }
+        }
+        SessionChunkHeader* ch = chunkHeader();
+        const uint32_t i = ch->lineCount;
+        const uint32_t bars = header.numBars;
+        uint8_t* row = chunk + chunkRowOffset(bars, 0, i);
+        for (uint32_t b = 0; b < bars; b++) {
+            row[b] = (uint8_t)(std::max(0.0f, std::min(line[b], 1.0f)) * 255.0f + 0.5f);
+        }
+        for (int level = 1; level < SESSION_LOG_LEVELS; level++) {
+            uint8_t* peak = chunk + chunkRowOffset(bars, level, i / levelFactor(level));
+            for (uint32_t b = 0; b < bars; b++) peak[b] = std::max(peak[b], row[b]);
+        }
+        const int64_t offsetMs = (wallClockUs() - ch->wallStartUs) / 1000;
+        ((uint32_t*)(chunk + sizeof(SessionChunkHeader)))[i] = (uint32_t)std::max<int64_t>(0, offsetMs);
+        ch->lineCount = i + 1;
+        lines++;
+        return true;
+    }
+
+    void close() {
+        unmapChunk();
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        filePath.clear();
+    }
+
+private:
+    SessionChunkHeader* chunkHeader() { return (SessionChunkHeader*)chunk; }
+
+    // Extend the file by one (zeroed) chunk and map it
+    bool mapNextChunk(uint64_t position) {
+        unmapChunk();
+        const uint64_t offset = header.dataOffset + chunks * header.chunkBytes;
+        const uint64_t end = offset + header.chunkBytes;
+#ifdef _WIN32
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(end >> 32), (DWORD)end, nullptr);
+        if (!mapping) return false;
+        chunk = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset,
+                                        (SIZE_T)header.chunkBytes);
+#else
+        if (ftruncate(fd, (off_t)end) != 0) return false;
+        void* p = mmap(nullptr, (size_t)header.chunkBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)offset);
+        chunk = p == MAP_FAILED ? nullptr : (uint8_t*)p;
+#endif
+        if (!chunk) return false;
+        SessionChunkHeader* ch = chunkHeader();
+        ch->index = (uint32_t)chunks;
+        ch->firstPosition = position;
+        ch->wallStartUs = wallClockUs();
+        chunks++;
+        return true;
+    }
+
+    void unmapChunk() {
+        if (!chunk) return;
+#ifdef _WIN32
+        UnmapViewOfFile(chunk);
+        if (mapping) CloseHandle(mapping);
+        mapping = nullptr;
+#else
+        munmap(chunk, (size_t)header.chunkBytes);  // Dirty pages are written back by the kernel
+#endif
+        chunk = nullptr;
+    }
+
+    SessionLogHeader header;
+    std::string filePath;
+    uint8_t* chunk = nullptr;  // Mapping of the chunk being filled
+    uint64_t chunks = 0;
+    uint64_t lines = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// Viewer: which span of the log fills the visible history
+struct SessionLogView {
+    MappedFile file;
+    SessionLogHeader header;
+    std::string path;
+    uint64_t chunks = 0;
+    uint64_t lines = 0;
+    double viewEnd = 0.0;   // Line just past the newest visible one
+    double viewSpan = 0.0;  // Log lines spread over HISTORY_LINES columns
+    bool dirty = false;     // History needs refilling
+    int filledLines = 0;    // HISTORY_LINES the history was filled for
+};
+
+static SessionLogWriter gSessionRecorder;  // UI thread
+static SessionLogView gSessionView;        // UI thread
+static std::string sessionRecordPath;      // --record <file.speclog>
+
+static bool sessionLogViewing() { return gSessionView.file.data() != nullptr; }
+
+static bool sessionLogOwnsHistory() {
+    if (sessionLogViewing()) gSessionView.dirty = true;
+    return sessionLogViewing();
+}
+
+static bool isSessionLogPath(const std::string& path) {
+    return path.size() > 8 && path.compare(path.size() - 8, 8, ".speclog") == 0;
+}
+
+static const SessionChunkHeader* viewChunk(uint64_t c) {
+    const SessionLogView& v = gSessionView;
+    return (const SessionChunkHeader*)(v.file.data() + v.header.dataOffset + c * v.header.chunkBytes);
+}
+
+static bool startSessionRecording(const std::string& path) {
+    const bool ok = gSessionRecorder.create(path, (uint32_t)NUM_BARS,
+                                            (uint32_t)std::max(1, ANALYSIS_HOP.load(std::memory_order_relaxed)),
+                                            analysisSampleRate(), (uint32_t)FFT_SIZE);
+    if (!ok) std::cerr << "Error: Cannot create session log " << path << "\n";
+    else std::cout << "Recording session to " << path << "\n";
+    return ok;
+}
+
+// session-YYYYMMDD-HHMMSS.speclog in the working directory
+static std::string defaultSessionLogPath() {
+    const std::time_t now = std::time(nullptr);
+    char name[64];
+    std::strftime(name, sizeof(name), "session-%Y%m%d-%H%M%S.speclog", std::localtime(&now));
+    return name;
+}
+
+static void closeSessionLog() {
+    if (!sessionLogViewing()) return;
+    gSessionView.file.close();
+    gSessionView.path.clear();
+    if (!refillHistoryAt(playbackPosition.load(std::memory_order_relaxed))) {
+        std::fill(lineHistory.begin(), lineHistory.end(), 0.0f);
+        markHistoryRewritten(0);
+    }
+}
+
+static bool openSessionLog(const std::string& path) {
+    SessionLogView& v = gSessionView;
+    v.file.close();
+    if (!v.file.open(path) || v.file.size() < sizeof(SessionLogHeader)) {
+        std::cerr << "Error: Cannot open session log " << path << "\n";
+        return false;
+    }
+    memcpy(&v.header, v.file.data(), sizeof(v.header));
+    const SessionLogHeader& h = v.header;
+    if (memcmp(h.magic, SESSION_LOG_MAGIC, sizeof(h.magic)) != 0 || h.version != 1 ||
+        h.chunkLines != SESSION_LOG_CHUNK_LINES || h.numBars == 0 || h.chunkBytes != sessionChunkBytes(h.numBars) ||
+        h.dataOffset < sizeof(SessionLogHeader)) {
+        std::cerr << "Error: " << path << " is not a session log\n";
+        v.file.close();
+        return false;
+    }
+    v.chunks = v.file.size() > h.dataOffset ? (v.file.size() - h.dataOffset) / h.chunkBytes : 0;
+    v.lines = 0;
+    for (uint64_t c = 0; c < v.chunks; c++) v.lines += std::min(viewChunk(c)->lineCount, h.chunkLines);
+    v.path = path;
+    v.viewSpan = std::max<double>((double)v.lines, 1.0);
+    v.viewEnd = (double)v.lines;
+    v.dirty = true;
+    showWholeFile = false;
+    std::cout << "Opened session log " << path << ": " << v.lines << " lines\n";
+    return true;
+}
+
+// Level 'level' row 'row' of the log (row r covers lines r*8^L .. r*8^L+8^L-1)
+static const uint8_t* viewLevelRow(int level, uint64_t row) {
+    const SessionLogView& v = gSessionView;
+    const uint64_t line = row * levelFactor(level);
+    const uint64_t c = line / v.header.chunkLines;
+    if (c >= v.chunks) return nullptr;
+    const uint64_t local = (line % v.header.chunkLines) / levelFactor(level);
+    const uint8_t* base = (const uint8_t*)viewChunk(c);
+    return base + chunkRowOffset(v.header.numBars, level, local);
+}
+
+// Wall time of log line 'line' (microseconds since the epoch)
+static int64_t viewLineWallUs(uint64_t line) {
+    const SessionLogView& v = gSessionView;
+    if (v.lines == 0) return v.header.startWallUs;
+    line = std::min(line, v.lines - 1);
+    const SessionChunkHeader* ch = viewChunk(line / v.header.chunkLines);
+    const uint32_t* ms = (const uint32_t*)((const uint8_t*)ch + sizeof(SessionChunkHeader));
+    return ch->wallStartUs + (int64_t)ms[line % v.header.chunkLines] * 1000;
+}
+
+// Spread [viewEnd - viewSpan, viewEnd) over the visible history columns, each
+// the peak of the coarsest stored level that still resolves one column
+static void fillHistoryFromSessionLog() {
+    SessionLogView& v = gSessionView;
+    const int columns = HISTORY_LINES;
+    const uint32_t srcBars = v.header.numBars;
+    const double perColumn = v.viewSpan / (double)columns;
+    int level = 0;
+    while (level + 1 < SESSION_LOG_LEVELS && (double)levelFactor(level + 1) <= perColumn) level++;
+    const uint64_t factor = levelFactor(level);
+    std::vector<uint8_t> peak(srcBars);
+
+    for (int age = 0; age < MAX_HISTORY_LINES; age++) {
+        int idx = historyHead - age;
+        if (idx < 0) idx += MAX_HISTORY_LINES;
+        float* dst = &lineHistory[(size_t)idx * (size_t)NUM_BARS];
+        const double start = v.viewEnd - v.viewSpan + perColumn * (double)(columns - 1 - age);
+        if (age >= columns || start + perColumn <= 0.0 || start >= (double)v.lines) {
+            std::fill(dst, dst + NUM_BARS, 0.0f);
+            continue;
+        }
+        const uint64_t l0 = (uint64_t)std::max(0.0, std::floor(start));
+        const uint64_t l1 = std::max(l0 + 1, (uint64_t)std::max(0.0, std::ceil(start + perColumn)));
+        std::fill(peak.begin(), peak.end(), 0);
+        for (uint64_t r = l0 / factor; r * factor < std::min(l1, v.lines); r++) {
+            const uint8_t* row = viewLevelRow(level, r);
+            if (!row) break;
+            for (uint32_t b = 0; b < srcBars; b++) peak[b] = std::max(peak[b], row[b]);
+        }
+        for (int b = 0; b < NUM_BARS; b++) {
+            const uint32_t j = (uint32_t)NUM_BARS == srcBars ? (uint32_t)b : (uint32_t)((uint64_t)b * srcBars / (uint64_t)NUM_BARS);
+            dst[b] = (float)peak[std::min(j, srcBars - 1)] * (1.0f / 255.0f);
+        }
+    }
+    // The log is mono: clear any other channel planes
+    if (gHistoryChannels > 1) {
+        std::fill(lineHistory.begin() + (size_t)MAX_HISTORY_LINES * (size_t)NUM_BARS, lineHistory.end(), 0.0f);
+    }
+    std::memcpy(currentLine.data(), historyRow(0), sizeof(float) * NUM_BARS);
+    markHistoryRewritten(columns);
+    v.filledLines = columns;
+    v.dirty = false;
+}
+
+// Zoom by 'factor' around 'anchor' (0 = left edge, 1 = right edge) and pan by
+// 'shift' screen widths; keeps the span inside the log
+static void moveSessionLogView(double factor, double anchor, double shift) {
+    SessionLogView& v = gSessionView;
+    const double total = std::max<double>((double)v.lines, 1.0);
+    const double minSpan = std::min((double)HISTORY_LINES, total);
+    const double pivot = v.viewEnd - v.viewSpan * (1.0 - anchor);
+    const double span = std::max(minSpan, std::min(v.viewSpan * factor, total));
+    double end = pivot + span * (1.0 - anchor) + shift * span;
+    end = std::max(span, std::min(end, total));
+    if (span != v.viewSpan || end != v.viewEnd) v.dirty = true;
+    v.viewSpan = span;
+    v.viewEnd = end;
+}
+
+// Main loop: keep the history in sync with the view
+static void updateSessionLogView() {
+    if (!sessionLogViewing()) return;
+    if (gSessionView.filledLines != HISTORY_LINES) gSessionView.dirty = true;
+    if (gSessionView.dirty) {
+        ScopedStageTimer timer(STAGE_HISTORY_PUSH);
+        fillHistoryFromSessionLog();
+        needsRedraw = true;
+    }
+}
+
+static std::string formatWallTime(int64_t us, const char* format) {
+    const std::time_t seconds = (std::time_t)(us / 1000000);
+    char text[64];
+    std::strftime(text, sizeof(text), format, std::localtime(&seconds));
+    return text;
+}
+
+// Sidebar: recorder and viewer controls
+static void drawSessionLogPanel() {
+    ImGui::Text("Session Log:");
+    bool recording = gSessionRecorder.isOpen();
+    if (ImGui::Checkbox("Record session", &recording)) {
+        if (recording) startSessionRecording(defaultSessionLogPath());
+        else gSessionRecorder.close();
+    }
+    if (gSessionRecorder.isOpen()) {
+        ImGui::TextDisabled("%s", gSessionRecorder.path().c_str());
+        ImGui::TextDisabled("%llu lines, %.1f MB", (unsigned long long)gSessionRecorder.lineCount(),
+                            (double)gSessionRecorder.bytes() / (1024.0 * 1024.0));
+    }
+
+    if (sessionLogViewing()) {
+        SessionLogView& v = gSessionView;
+        const uint64_t first = (uint64_t)std::max(0.0, v.viewEnd - v.viewSpan);
+        const uint64_t last = (uint64_t)std::max(0.0, v.viewEnd - 1.0);
+        ImGui::TextColored(ImVec4(0, 1, 0, 1), "Viewing: %s", v.path.substr(v.path.find_last_of("/\\") + 1).c_str());
+        ImGui::TextDisabled("%s", formatWallTime(viewLineWallUs(first), "%Y-%m-%d %H:%M:%S").c_str());
+        ImGui::TextDisabled("  to %s (%llu lines)", formatWallTime(viewLineWallUs(last), "%Y-%m-%d %H:%M:%S").c_str(),
+                            (unsigned long long)(last + 1 - first));
+        float position = v.lines > 0 ? (float)(v.viewEnd / (double)v.lines) : 1.0f;
+        ImGui::PushItemWidth(280);
+        if (ImGui::SliderFloat("##logpos", &position, 0.0f, 1.0f, "Position %.3f")) {
+            moveSessionLogView(1.0, 1.0, ((double)position * (double)v.lines - v.viewEnd) / v.viewSpan);
+        }
+        ImGui::PopItemWidth();
+        if (ImGui::Button("Zoom In", ImVec2(88, 0))) moveSessionLogView(0.5, 0.5, 0.0);
+        ImGui::SameLine();
+        if (ImGui::Button("Zoom Out", ImVec2(88, 0))) moveSessionLogView(2.0, 0.5, 0.0);
+        ImGui::SameLine();
+        if (ImGui::Button("All", ImVec2(88, 0))) moveSessionLogView(1e30, 1.0, 1e30);
+        if (ImGui::Button("Close Log", ImVec2(280, 0))) closeSessionLog();
+        ImGui::TextDisabled("2D view: scroll to zoom, drag to pan");
+    } else {
+        ImGui::TextDisabled("Open a .speclog with Browse or drag & drop");
+    }
+    ImGui::Spacing();
+    ImGui::Separator();
+    ImGui::Spacing();
+}
+
+// ===================== Channel Views =====================
+// The UI thread follows the selected channel mode: the analysis switches over
+// under gAnalysisMutex, then the history is re-laid out with one plane per
+// channel, plus one for the zoom band and one per compare file. Lines still
+// queued for the old layout
+// are dropped by the drain loop (LineQueue::frontLines() no longer matches
+// gHistoryChannels).
+static bool gHistoryMidSide = false;  // Planes 0/1 of lineHistory are mid/side
+static int gHistoryZoomPlane = -1;    // Plane of lineHistory holding the zoom band, -1 = none
+static int gHistoryComparePlane = -1; // First compare file plane, -1 = none
+
+// Right-drag across a full-band 2D view picks the zoom band
+static bool gZoomSelecting = false;
+static int gZoomSelectPlane = 0;
+static double gZoomSelectY0 = 0.0, gZoomSelectY1 = 0.0;  // Window y, bottom-up
+
+static void updateChannelViews() {
+    const int wanted = wantedAnalysisChannels();
+    const bool midSide = channelMode == CHANNELS_MID_SIDE && wanted == 2;
+    const bool zoom = zoomEnabled && !gNetSubscribing.load(std::memory_order_relaxed);
+    const int compares = gNetSubscribing.load(std::memory_order_relaxed) ? 0 : (int)gCompare.size();
+    const int zoomPlane = zoom ? wanted : -1;
+    const int planes = wanted + (zoom ? 1 : 0) + compares;
+
+    if (planes != gHistoryChannels || midSide != gHistoryMidSide || zoomPlane != gHistoryZoomPlane) {
+        {
+            std::lock_guard<std::mutex> lock(gAnalysisMutex);
+            gAnalysisChannels = wanted;
+            gAnalysisMidSide = midSide;
+        }
+        lineHistory.assign((size_t)MAX_HISTORY_LINES * (size_t)NUM_BARS * (size_t)planes, 0.0f);
+        gHistoryChannels = planes;
+        gHistoryMidSide = midSide;
+        gHistoryZoomPlane = zoomPlane;
+        gHistoryComparePlane = compares > 0 ? planes - compares : -1;
+        if (planes > 1) showWholeFile = false;
+        wholeFileLines = 0;
+        if (!refillHistoryAt(playbackPosition.load(std::memory_order_relaxed))) markHistoryRewritten(0);
+    }
+
+    updateBatchPlan();
+    updateZoomPlan();
+    updateCompareEngines();
+}
+
+// Planes up to the zoom and compare planes follow the loaded file's channels
+static bool isChannelPlane(int ch) {
+    return ch != gHistoryZoomPlane && (gHistoryComparePlane < 0 || ch < gHistoryComparePlane);
+}
+
+// Screen rectangle (bottom-up) of plane 'ch' of 'n' (plane 0 on top / left)
+static void channelViewRect(int ch, int n, int vpX, int vpY, int vpW, int vpH, int& x, int& y, int& w, int& h) {
+    x = vpX;
+    y = vpY;
+    w = vpW;
+    h = vpH;
+    if (channelLayout == LAYOUT_SIDE_BY_SIDE) {
+        x = vpX + vpW * ch / n;
+        w = vpX + vpW * (ch + 1) / n - x;
+    } else {
+        y = vpY + vpH - vpH * (ch + 1) / n;
+        h = vpY + vpH - vpH * ch / n - y;
+    }
+    w = std::max(1, w);
+    h = std::max(1, h);
+}
+
+// Height t (0 = bottom) of a full-band view and its frequency, on the log
+// axis of buildFrequencyMapping()
+static float fullBandFrequency(float t) {
+    const float minF = std::max(MIN_FREQ, 1.0f);
+    const float maxF = std::max(minF * 1.001f, (float)analysisSampleRate() * 0.5f);
+    return minF * std::pow(maxF / minF, clamp01(t));
+}
+
+static float fullBandHeight(float f) {
+    const float minF = std::max(MIN_FREQ, 1.0f);
+    const float maxF = std::max(minF * 1.001f, (float)analysisSampleRate() * 0.5f);
+    return clamp01(std::log(std::max(f, minF) / minF) / std::log(maxF / minF));
+}
+
+// Starts, follows and finishes a right-drag band selection in the 2D view
+// occupying (vpX, vpY, vpW, vpH). Returns true while one is in progress.
+static bool handleZoomSelectMouse(GLFWwindow* window, double mx, double my, int windowHeight,
+                                  int vpX, int vpY, int vpW, int vpH) {
+    const bool down = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+    const double yUp = (double)windowHeight - my;
+    int x, y, w, h;
+    if (!gZoomSelecting) {
+        if (!down || analysisSampleRate() <= 0) return false;
+        for (int ch = 0; ch < gHistoryChannels; ch++) {
+            if (!isChannelPlane(ch)) continue;
+            channelViewRect(ch, gHistoryChannels, vpX, vpY, vpW, vpH, x, y, w, h);
+            if (mx >= x && mx < x + w && yUp >= y && yUp < y + h) {
+                gZoomSelecting = true;
+                gZoomSelectPlane = ch;
+                gZoomSelectY0 = gZoomSelectY1 = yUp;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    gZoomSelectY1 = yUp;
+    needsRedraw = true;
+    if (down) return true;
+
+    gZoomSelecting = false;
+    if (std::fabs(gZoomSelectY1 - gZoomSelectY0) < 4.0) return true;  // A click, not a band
+    channelViewRect(gZoomSelectPlane, gHistoryChannels, vpX, vpY, vpW, vpH, x, y, w, h);
+    const float lo = fullBandFrequency((float)((std::min(gZoomSelectY0, gZoomSelectY1) - y) / h));
+    const float hi = fullBandFrequency((float)((std::max(gZoomSelectY0, gZoomSelectY1) - y) / h));
+    setZoomBand(true, lo, hi, zoomFFTSize);
+    return true;
+}
+
+static std::string planeLabel(int ch) {
+    char text[64];
+    if (ch == gHistoryZoomPlane) {
+        std::snprintf(text, sizeof(text), "Zoom %.1f-%.1f Hz", zoomLoHz, zoomHiHz);
+        return text;
+    }
+    if (gHistoryComparePlane >= 0 && ch >= gHistoryComparePlane) {
+        const size_t index = (size_t)(ch - gHistoryComparePlane);
+        if (index >= gCompare.size()) return "";
+        const CompareStream& c = *gCompare[index];
+        std::string label = "Compare: " + c.path.substr(c.path.find_last_of("/\\") + 1);
+        if (c.sampleRate != (int)analysisSampleRate()) label += " (sample rate differs)";
+        return label;
+    }
+    const int channels = gHistoryChannels - (gHistoryZoomPlane >= 0 ? 1 : 0) -
+                         (gHistoryComparePlane >= 0 ? gHistoryChannels - gHistoryComparePlane : 0);
+    if (channels == 1) return "Full band";
+    return channelLabel(ch, channels, gHistoryMidSide);
+}
+
+// Band edges (or the band being dragged) across a full-band 2D view
+static void drawZoomBandMarks(int ch, int x, int y, int w, int h, int windowHeight) {
+    ImDrawList* draw = ImGui::GetForegroundDrawList();
+    const float left = (float)x, right = (float)(x + w);
+    if (gZoomSelecting && ch == gZoomSelectPlane) {
+        const float y0 = (float)(windowHeight - gZoomSelectY0), y1 = (float)(windowHeight - gZoomSelectY1);
+        draw->AddRectFilled(ImVec2(left, std::min(y0, y1)), ImVec2(right, std::max(y0, y1)), IM_COL32(255, 255, 255, 40));
+        draw->AddRect(ImVec2(left, std::min(y0, y1)), ImVec2(right, std::max(y0, y1)), IM_COL32(255, 255, 255, 160));
+    } else if (gHistoryZoomPlane >= 0 && analysisSampleRate() > 0) {
+        const float edges[2] = { zoomLoHz, zoomHiHz };
+        for (int e = 0; e < 2; e++) {
+            const float yy = (float)windowHeight - ((float)y + fullBandHeight(edges[e]) * (float)h);
+            draw->AddLine(ImVec2(left, yy), ImVec2(right, yy), IM_COL32(255, 255, 255, 110));
+        }
+    }
+}
+
+// Split one view pane between the plane histories
+static void renderChannelViews(int vpX, int vpY, int vpW, int vpH, bool traditional) {
+    const int n = gHistoryChannels;
+    int windowWidth = 0, windowHeight = 0;
+    glfwGetWindowSize(glfwGetCurrentContext(), &windowWidth, &windowHeight);
+
+    for (int ch = 0; ch < n; ch++) {
+        int x, y, w, h;
+        channelViewRect(ch, n, vpX, vpY, vpW, vpH, x, y, w, h);
+
+        if (traditional) {
+            renderTraditionalSpectrogram(x, y, w, h, ch);
+            if (isChannelPlane(ch)) drawZoomBandMarks(ch, x, y, w, h, windowHeight);
+        } else {
+            render3DWaterfall(x, y, w, h, ch);
+        }
+
+        if (n > 1) {
+            // Label in the view's top-right corner (ImGui is top-down)
+            const std::string label = planeLabel(ch);
+            const float width = ImGui::CalcTextSize(label.c_str()).x;
+            ImGui::GetForegroundDrawList()->AddText(ImVec2((float)(x + w) - width - 12.0f, (float)(windowHeight - (y + h) + 8)),
+                                                    IM_COL32(230, 230, 230, 200), label.c_str());
+        }
+    }
+}
+
+// ===================== View Panes =====================
+// The 2D heat map and the 3D waterfall can share the viewport instead of being
+// toggled. Every pane samples the same historyTexture and colormap texture,
+// which are brought up to date once per frame by whichever pane binds them
+// first, so a second pane costs only its draw calls. Split layouts run with
+// the 3D settings; the 2D pane shows the same HISTORY_LINES lines of the ring.
+enum ViewLayout { VIEW_SINGLE = 0, VIEW_SPLIT_SIDE, VIEW_SPLIT_STACKED, VIEW_LAYOUT_COUNT };
+static const char* viewLayoutNames[VIEW_LAYOUT_COUNT] = { "Single view", "2D + 3D side by side", "2D + 3D stacked" };
+static int viewLayout = VIEW_SINGLE;  // Selected in the GUI or with --layout
+static bool gMouseIn2D = false;       // Pane kind under the cursor, held while dragging
+
+struct ViewPane {
+    int x = 0, y = 0, w = 1, h = 1;  // Window pixels, bottom-up
+    bool traditional = false;         // 2D heat map, else 3D waterfall
+};
+
+// Panes of the current layout (3D on the left / top); returns how many
+static int layoutViewPanes(int vpX, int vpY, int vpW, int vpH, ViewPane* panes) {
+    for (int i = 0; i < 2; i++) {
+        panes[i].x = vpX;
+        panes[i].y = vpY;
+        panes[i].w = std::max(1, vpW);
+        panes[i].h = std::max(1, vpH);
+    }
+    if (viewLayout == VIEW_SINGLE) {
+        panes[0].traditional = useTraditionalView;
+        return 1;
+    }
+    panes[0].traditional = false;
+    panes[1].traditional = true;
+    if (viewLayout == VIEW_SPLIT_SIDE) {
+        panes[0].w = std::max(1, vpW / 2);
+        panes[1].x = vpX + panes[0].w;
+        panes[1].w = std::max(1, vpW - panes[0].w);
+    } else {
+        panes[1].h = std::max(1, vpH / 2);
+        panes[0].y = vpY + panes[1].h;
+        panes[0].h = std::max(1, vpH - panes[1].h);
+    }
+    return 2;
+}
+
+// The pane under window point (mx, yUp), if any
+static bool viewPaneAt(double mx, double yUp, ViewPane& out) {
+    ViewPane panes[2];
+    const int n = layoutViewPanes(viewportX, viewportY, viewportW, viewportH, panes);
+    for (int i = 0; i < n; i++) {
+        const ViewPane& p = panes[i];
+        if (mx >= p.x && mx < p.x + p.w && yUp >= p.y && yUp < p.y + p.h) {
+            out = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The 2D pane of the current layout, if one is shown
+static bool traditionalViewPane(ViewPane& out) {
+    ViewPane panes[2];
+    const int n = layoutViewPanes(viewportX, viewportY, viewportW, viewportH, panes);
+    for (int i = 0; i < n; i++) {
+        if (panes[i].traditional) {
+            out = panes[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool waterfallPaneShown() {
+    return viewLayout != VIEW_SINGLE || !useTraditionalView;
+}
+
+// Single-view toggle between the 3D waterfall and the 2D heat map
+static void setTraditionalView(bool traditional) {
+    useTraditionalView = traditional;
+    // When switching to 2D view, save current settings and lock to optimal values
+    if (traditional) {
+        saved3D_FFT_SIZE = FFT_SIZE;
+        saved3D_HISTORY_LINES = HISTORY_LINES;
+        saved3D_lineWidth = lineWidth;
+        saved3D_yScale = yScale;
+        saved3D_yOffset = yOffset;
+        saved3D_showGrid = showGrid;
+        saved3D_autoRotate = autoRotate;
+
+        // Set optimal 2D settings - 32x FFT for good frequency resolution
+        FFT_SIZE = 16384;  // 32x (512 * 32)
+        HISTORY_LINES = 560;  // Maximum history
+        lineWidth = 1.0f;   // Not used in 2D but locked
+        yScale = 1.0f;      // Not used in 2D but locked
+        yOffset = 0.0f;     // Not used in 2D but locked
+        showGrid = false;   // Not used in 2D but locked
+        autoRotate = false; // Not used in 2D but locked
+
+        // Save color settings BEFORE changing them
+        saved3D_useCustomLineColor = useCustomLineColor;
+        saved3D_useColormap = useColormap;
+        saved3D_currentColormap = currentColormap;
+
+        // Enable colormap for heat map
+        useColormap = true;
+        useCustomLineColor = false;
+
+        colorLUTDirty = true;  // Rebuild color LUT
+        reinitializeFFT();
+    } else {
+        // Restore 3D settings
+        FFT_SIZE = saved3D_FFT_SIZE;
+        HISTORY_LINES = saved3D_HISTORY_LINES;
+        lineWidth = saved3D_lineWidth;
+        yScale = saved3D_yScale;
+        yOffset = saved3D_yOffset;
+        showGrid = saved3D_showGrid;
+        autoRotate = saved3D_autoRotate;
+
+        // Restore color settings
+        useCustomLineColor = saved3D_useCustomLineColor;
+        useColormap = saved3D_useColormap;
+        currentColormap = saved3D_currentColormap;
+
+        colorLUTDirty = true;  // Rebuild color LUT
+        reinitializeFFT();
+    }
+}
+
+// Split layouts run with the 3D settings, so leave the locked 2D ones first
+static void setViewLayout(int layout) {
+    if (layout != VIEW_SINGLE && useTraditionalView) setTraditionalView(false);
+    viewLayout = layout;
+    needsRedraw = true;
+}
+
+static void renderViewPanes(int vpX, int vpY, int vpW, int vpH) {
+    ViewPane panes[2];
+    const int n = layoutViewPanes(vpX, vpY, vpW, vpH, panes);
+    int windowWidth = 0, windowHeight = 0;
+    glfwGetWindowSize(glfwGetCurrentContext(), &windowWidth, &windowHeight);
+    gWaterfallVertices = 0;
+
+    for (int i = 0; i < n; i++) {
+        renderChannelViews(panes[i].x, panes[i].y, panes[i].w, panes[i].h, panes[i].traditional);
+    }
+    if (n > 1) {
+        // Divider along the shared edge (ImGui is top-down)
+        const ViewPane& b = panes[1];
+        const ImVec2 from = viewLayout == VIEW_SPLIT_SIDE ? ImVec2((float)b.x, 0.0f)
+                                                          : ImVec2((float)b.x, (float)(windowHeight - (b.y + b.h)));
+        const ImVec2 to = viewLayout == VIEW_SPLIT_SIDE ? ImVec2((float)b.x, (float)windowHeight)
+                                                        : ImVec2((float)(b.x + b.w), (float)(windowHeight - (b.y + b.h)));
+        ImGui::GetForegroundDrawList()->AddLine(from, to, IM_COL32(90, 90, 90, 255), 2.0f);
+    }
+}
+
+// ===================== Audio Control =====================
+static void stopCapture();
+
+void startAudio() {
+    if (wavFile->empty()) return;
+    if (audioStream) return;
+    stopCapture();  // File playback and live input are exclusive
+
+    gPlaybackTrack.store(wavFile.get());
+    syncCallbackTrack();
+
+    // Output mono for mono sources; stereo for anything else (duplicate mono to L/R)
+    gOutputChannels = (wavFile->sourceChannels >= 2) ? 2 : 1;
+
+    PaError err = Pa_OpenDefaultStream(&audioStream,
+                                       0,
+                                       gOutputChannels,
+                                       paFloat32,
+                                       wavFile->sampleRate,
+                                       FRAMES_PER_BUFFER,
+                                       audioCallback,
+                                       nullptr);
+    if (err == paNoError) {
+        err = Pa_StartStream(audioStream);
+        if (err == paNoError) {
+            isPlaying = true;
+            isPaused.store(false, std::memory_order_relaxed);
+
+            const PaStreamInfo* info = Pa_GetStreamInfo(audioStream);
+            double outLatencySec = info ? info->outputLatency : 0.0;
+            int outLatencySamples = (int)std::llround(outLatencySec * (double)wavFile->sampleRate);
+
+            // playbackPosition is mono samples; latency is in frames -> same unit here.
+            gLatencySamplesBase = outLatencySamples + FRAMES_PER_BUFFER;
+        }
+    }
+}
+
+void stopAudio() {
+    if (audioStream) {
+        Pa_StopStream(audioStream);
+        Pa_CloseStream(audioStream);
+        audioStream = nullptr;
+    }
+    isPlaying = false;
+    isPaused.store(false, std::memory_order_relaxed);
+    playbackPosition.store(0, std::memory_order_relaxed);
+}
+
+// ---- Live input ----
+static void stopCapture() {
+    if (!captureStream) return;
+    Pa_StopStream(captureStream);
+    Pa_CloseStream(captureStream);
+    captureStream = nullptr;
+
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+    gCaptureActive.store(false, std::memory_order_release);
+    if (!wavFile->empty()) buildFrequencyMapping();
+}
+
+static bool startCapture() {
+    stopAudio();
+    stopCapture();
+
+    const PaDeviceIndex device = captureDevice >= 0 ? captureDevice : Pa_GetDefaultInputDevice();
+    const PaDeviceInfo* info = device >= 0 ? Pa_GetDeviceInfo(device) : nullptr;
+    if (!info || info->maxInputChannels < 1) {
+        std::cerr << "Error: No input device available\n";
+        return false;
+    }
+
+    PaStreamParameters params;
+    params.device = device;
+    params.channelCount = std::min(2, info->maxInputChannels);
+    params.sampleFormat = paFloat32;
+    params.suggestedLatency = info->defaultLowInputLatency;
+    params.hostApiSpecificStreamInfo = nullptr;
+    if (Pa_IsFormatSupported(&params, nullptr, (double)gCaptureSampleRate) != paFormatIsSupported) {
+        std::cerr << "Error: " << info->name << " does not support " << gCaptureSampleRate << " Hz input\n";
+        return false;
+    }
+
+    gCaptureChannels = params.channelCount;
+    gCaptureRing.init(CAPTURE_RING_FRAMES);
+    PaError err = Pa_OpenStream(&captureStream, &params, nullptr, (double)gCaptureSampleRate,
+                                (unsigned long)captureBufferFrames, paClipOff, captureCallback, nullptr);
+    if (err != paNoError) {
+        std::cerr << "Error: Could not open input stream: " << Pa_GetErrorText(err) << "\n";
+        captureStream = nullptr;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        gCaptureActive.store(true, std::memory_order_release);
+        buildFrequencyMapping();
+    }
+    showWholeFile = false;
+    wholeFileLines = 0;
+    gLineQueue.clear();
+    measuredCaptureLatencyMs = 0.0f;
+
+    err = Pa_StartStream(captureStream);
+    if (err != paNoError) {
+        std::cerr << "Error: Could not start input stream: " << Pa_GetErrorText(err) << "\n";
+        stopCapture();
+        return false;
+    }
+
+    // Reported device latency plus one buffer, as for playback
+    const PaStreamInfo* streamInfo = Pa_GetStreamInfo(captureStream);
+    double inLatencySec = streamInfo ? streamInfo->inputLatency : 0.0;
+    gLatencySamplesBase = (int)std::llround(inLatencySec * (double)gCaptureSampleRate) + captureBufferFrames;
+    return true;
+}
+
+// ---- File loading ----
+// Files are opened on a loader thread into a fresh WAVFile while the current one
+// keeps playing; the main loop installs the result (pollAudioLoad) and keeps
+// replaced tracks in gRetiredTracks until the callback has let go of them.
+static std::thread gLoaderThread;
+static std::atomic<bool> gLoaderDone{false};
+static bool gLoaderBusy = false;
+static std::shared_ptr<WAVFile> gLoaderResult;  // Valid once gLoaderDone (nullptr = failed)
+static std::string gLoaderPath;
+static std::string gPendingLoadPath;            // Requested while the loader was busy
+static std::vector<std::shared_ptr<WAVFile>> gRetiredTracks;
+
+// Free replaced tracks the audio callback can no longer be reading
+static void reclaimRetiredTracks() {
+    for (size_t i = 0; i < gRetiredTracks.size();) {
+        WAVFile* t = gRetiredTracks[i].get();
+        if (t != gPlaybackTrack.load() && t != gHazardCurrent.load() && t != gHazardFading.load()) {
+            gRetiredTracks.erase(gRetiredTracks.begin() + (ptrdiff_t)i);
+        } else {
+            i++;
+        }
+    }
+}
+
+// Make a loaded track current. The pointer is swapped under the analysis lock so
+// the analysis thread never reads a half-opened file; playback crossfades into
+// it when the stream format allows, otherwise the stream is reopened.
+static void installTrack(const std::shared_ptr<WAVFile>& track, const std::string& path) {
+    std::shared_ptr<WAVFile> old;
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        old = wavFile;
+        wavFile = track;
+        buildFrequencyMapping();
+    }
+
+    const bool sameFormat = old->sampleRate == track->sampleRate &&
+                            ((old->sourceChannels >= 2) ? 2 : 1) == ((track->sourceChannels >= 2) ? 2 : 1);
+    if (isPlaying && sameFormat) {
+        gPlaybackTrack.store(track.get());  // The callback crossfades on its next buffer
+    } else if (isPlaying) {
+        const bool wasPaused = isPaused.load(std::memory_order_relaxed);
+        stopAudio();
+        startAudio();
+        isPaused.store(wasPaused, std::memory_order_relaxed);
+    } else {
+        gPlaybackTrack.store(track.get());
+        playbackPosition.store(0, std::memory_order_relaxed);
+    }
+    gRetiredTracks.push_back(old);
+
+    resetWaveformView();  // New file: show all of it
+    startPyramidBuild(path);
+    loadedFileName = path;
+    size_t pos = loadedFileName.find_last_of("/\\");
+    if (pos != std::string::npos) {
+        loadedFileName = loadedFileName.substr(pos + 1);
+    }
+    addToRecentFiles(path);
+}
+
+// Start opening 'path' in the background (the newest request wins if one is running)
+static void loadAudioFile(const std::string& path) {
+    if (isSessionLogPath(path)) {
+        openSessionLog(path);
+        return;
+    }
+    strncpy(filePathBuffer, path.c_str(), sizeof(filePathBuffer)-1);
+    filePathBuffer[sizeof(filePathBuffer)-1] = '\0';
+
+    if (gLoaderBusy) {
+        gPendingLoadPath = path;
+        return;
+    }
+
+    gLoaderBusy = true;
+    gLoaderPath = path;
+    gLoaderDone.store(false, std::memory_order_relaxed);
+    gLoaderThread = std::thread([path]() {
+        std::shared_ptr<WAVFile> track = std::make_shared<WAVFile>();
+        if (!track->load(path)) track.reset();
+        gLoaderResult = track;
+        gLoaderDone.store(true, std::memory_order_release);
+    });
+}
+
+// Main loop: install a finished load and start the next queued one
+static void pollAudioLoad() {
+    reclaimRetiredTracks();
+    if (!gLoaderBusy || !gLoaderDone.load(std::memory_order_acquire)) return;
+
+    gLoaderThread.join();
+    gLoaderBusy = false;
+    std::shared_ptr<WAVFile> track = gLoaderResult;
+    gLoaderResult.reset();
+    if (track) installTrack(track, gLoaderPath);
+
+    if (!gPendingLoadPath.empty()) {
+        std::string next = gPendingLoadPath;
+        gPendingLoadPath.clear();
+        loadAudioFile(next);
+    }
+}
+
+static void stopAudioLoader() {
+    if (gLoaderThread.joinable()) gLoaderThread.join();
+    gLoaderBusy = false;
+    gLoaderResult.reset();
+}
+
+// ===================== Frame Pacing =====================
+// With power saving on, the main loop only draws when something changed: new
+// analysis lines, input, camera animation, or a background job whose progress is
+// on screen. Otherwise it blocks in glfwWaitEventsTimeout and does no GL work.
+// Input callbacks (installed ahead of ImGui's, which chains them) and the
+// analysis thread (glfwPostEmptyEvent) wake it early. The frame cap applies on
+// top of vsync in both modes.
+static constexpr int INPUT_SETTLE_FRAMES = 3;         // ImGui needs a few frames after input for hover/active state
+static constexpr double IDLE_WAIT_SECONDS = 0.5;      // Longest sleep with nothing to draw
+static constexpr double SLOW_REDRAW_SECONDS = 0.1;    // Progress text, tooltips and hovered widgets
+static bool powerSaving = true;   // Event-driven redraw; off = draw every iteration
+static bool vsyncEnabled = true;
+static int frameCapFPS = 0;       // 0 = no cap beyond vsync
+static int inputFramesPending = INPUT_SETTLE_FRAMES;
+static double lastRenderTime = -1.0;
+static bool imguiWantsRefresh = false;  // Last frame had a hovered/active widget or text input
+static bool wasBusy = false;
+
+static void noteInputActivity() {
+    inputFramesPending = INPUT_SETTLE_FRAMES;
+}
+
+// Callbacks run on the main thread inside glfwPollEvents/glfwWaitEvents*
+static void installActivityCallbacks(GLFWwindow* window) {
+    glfwSetCursorPosCallback(window, [](GLFWwindow*, double, double) { noteInputActivity(); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow*, int, int, int) { noteInputActivity(); });
+    glfwSetKeyCallback(window, [](GLFWwindow*, int, int, int, int) { noteInputActivity(); });
+    glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { noteInputActivity(); });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow*, int) { noteInputActivity(); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow*, int) { noteInputActivity(); });
+    glfwSetWindowSizeCallback(window, [](GLFWwindow*, int, int) { noteInputActivity(); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { noteInputActivity(); });
+}
+
+// A file is loading or the pyramid is being built: progress is shown in the panel
+static bool backgroundWorkActive() {
+    if (gLoaderBusy) return true;
+    const uint64_t total = gPyramidRowsTotal.load(std::memory_order_relaxed);
+    return !gPyramidReady.load(std::memory_order_acquire) && total > 0 &&
+           gPyramidRowsDone.load(std::memory_order_relaxed) < total;
+}
+
+// Seconds until the next frame is due (0 = draw now), or < 0 when nothing needs drawing
+static double nextFrameDelay(double now) {
+    double interval = frameCapFPS > 0 ? 1.0 / (double)frameCapFPS : 0.0;
+    bool wanted = !powerSaving || needsRedraw || inputFramesPending > 0 ||
+                  (autoRotate && waterfallPaneShown()) || gLineQueue.front() != nullptr ||
+                  gpuPrecomputeBusy();
+    if (!wanted && (imguiWantsRefresh || backgroundWorkActive())) {
+        wanted = true;
+        interval = std::max(interval, SLOW_REDRAW_SECONDS);
+    }
+    if (!wanted) return -1.0;
+    return std::max(0.0, lastRenderTime + interval - now);
+}
+
+// Pump GLFW events, sleeping until the next frame is due or something wakes us
+static void waitForFrameEvents() {
+    const double delay = nextFrameDelay(glfwGetTime());
+    if (delay < 0.0) {
+        glfwWaitEventsTimeout(IDLE_WAIT_SECONDS);
+    } else if (delay > 0.0) {
+        glfwWaitEventsTimeout(delay);
+    } else {
+        glfwPollEvents();
+    }
+
+    // One last frame once a load or pyramid build finishes, to clear its progress text
+    const bool busy = backgroundWorkActive();
+    if (wasBusy && !busy) needsRedraw = true;
+    wasBusy = busy;
+}
+
+// Call right after deciding to draw
+static void noteFrameRendered(double now) {
+    lastRenderTime = now;
+    if (inputFramesPending > 0) inputFramesPending--;
+}
+
+// ===================== Headless Render =====================
+// `--headless in.flac --out spec.png` renders the whole file as a 2D heat map
+// without a window or audio device, as fast as the cores allow. Output columns
+// are split across worker threads; each column takes the per-bar peak over the
+// hops it covers, so narrowing the image never drops transients.
+struct HeadlessOptions {
+    std::string input;
+    std::string output;
+    int width = 0;        // 0 = one column per hop, capped at HEADLESS_MAX_WIDTH
+    int threads = 0;      // 0 = all hardware threads
+    int fftSize = 16384;  // Matches the Heat Map view
+    int hop = 512;
+    int colormap = COLORMAP_INFERNO;
+};
+
+static constexpr int HEADLESS_MAX_WIDTH = 4096;
+
+static const char* colormapCliNames[] = {
+    "viridis", "plasma", "inferno", "magma", "hot", "cool", "jet", "turbo",
+    "ocean", "rainbow", "grayscale", "ice", "fire", "seismic", "twilight", "cividis"
+};
+
+static uint32_t crc32Update(uint32_t crc, const unsigned char* data, size_t len) {
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void appendBE32(std::vector<unsigned char>& v, uint32_t x) {
+    v.push_back((unsigned char)(x >> 24));
+    v.push_back((unsigned char)(x >> 16));
+    v.push_back((unsigned char)(x >> 8));
+    v.push_back((unsigned char)x);
+}
+
+static void appendPNGChunk(std::ofstream& f, const char* type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    appendBE32(chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    std::vector<unsigned char> crc;
+    appendBE32(crc, crc32Update(0, chunk.data() + 4, chunk.size() - 4));
+    f.write((const char*)chunk.data(), (std::streamsize)chunk.size());
+    f.write((const char*)crc.data(), 4);
+}
+
+// 8-bit RGB PNG with stored (uncompressed) deflate blocks: no zlib dependency
+static bool writePNG(const std::string& path, int w, int h, const std::vector<unsigned char>& rgb) {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) return false;
+    static const unsigned char signature[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+    f.write((const char*)signature, 8);
+
+    std::vector<unsigned char> ihdr;
+    appendBE32(ihdr, (uint32_t)w);
+    appendBE32(ihdr, (uint32_t)h);
+    const unsigned char ihdrTail[5] = { 8, 2, 0, 0, 0 };  // 8-bit, RGB, deflate, no filter, no interlace
+    ihdr.insert(ihdr.end(), ihdrTail, ihdrTail + 5);
+    appendPNGChunk(f, "IHDR", ihdr);
+
+    // Raw scanlines, each prefixed with filter type 0
+    const size_t stride = (size_t)w * 3;
+    std::vector<unsigned char> raw;
+    raw.reserve((stride + 1) * (size_t)h);
+    for (int y = 0; y < h; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + (ptrdiff_t)(y * stride), rgb.begin() + (ptrdiff_t)((y + 1) * stride));
+    }
+
+    std::vector<unsigned char> idat;
+    idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+    uint32_t a = 1, b = 0;
+    for (size_t pos = 0; pos < raw.size() || pos == 0;) {
+        const size_t len = std::min<size_t>(65535, raw.size() - pos);
+        const bool last = pos + len >= raw.size();
+        idat.push_back(last ? 1 : 0);
+        idat.push_back((unsigned char)(len & 0xFF));
+        idat.push_back((unsigned char)(len >> 8));
+        idat.push_back((unsigned char)(~len & 0xFF));
+        idat.push_back((unsigned char)((~len >> 8) & 0xFF));
+        idat.insert(idat.end(), raw.begin() + (ptrdiff_t)pos, raw.begin() + (ptrdiff_t)(pos + len));
+        for (size_t i = pos; i < pos + len; i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        pos += len;
+        if (last) break;
+    }
+    appendBE32(idat, (b << 16) | a);
+    appendPNGChunk(f, "IDAT", idat);
+    appendPNGChunk(f, "IEND", std::vector<unsigned char>());
+    return (bool)f;
+}
+
+static bool writePPM(const std::string& path, int w, int h, const std::vector<unsigned char>& rgb) {
+    std::ofstream f(path, std::ios::binary);
+    if (!f) return false;
+    f << "P6\n" << w << " " << h << "\n255\n";
+    f.write((const char*)rgb.data(), (std::streamsize)rgb.size());
+    return (bool)f;
+}
+
+static bool hasExtension(const std::string& path, const char* ext) {
+    std::string lower = path;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    const size_t n = std::strlen(ext);
+    return lower.size() >= n && lower.compare(lower.size() - n, n, ext) == 0;
+}
+
+static int runHeadless(const HeadlessOptions& opt) {
+    if (!hasExtension(opt.output, ".png") && !hasExtension(opt.output, ".ppm")) {
+        std::cerr << "Error: --out must end in .png or .ppm\n";
+        return 1;
+    }
+    if (fftSizeSlot(opt.fftSize) < 0) {
+        std::cerr << "Error: --fft must be one of 512, 1024, 2048, 4096, 8192, 16384\n";
+        return 1;
+    }
+    if (opt.hop < 1) {
+        std::cerr << "Error: --hop must be positive\n";
+        return 1;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    if (!wavFile->load(opt.input, true)) return 1;
+
+    waitForFFTPlanner();
+    FFT_SIZE = opt.fftSize;
+    reinitializeFFT();
+
+    const int n = fftPlanSize;
+    const uint64_t totalFrames = wavFile->totalFrames;
+    const uint64_t hops = (totalFrames + (uint64_t)opt.hop - 1) / (uint64_t)opt.hop;
+    const int width = (int)std::max<uint64_t>(1, opt.width > 0 ? std::min<uint64_t>((uint64_t)opt.width, hops)
+                                                              : std::min<uint64_t>(hops, HEADLESS_MAX_WIDTH));
+    const int height = NUM_BARS;
+
+    int threadCount = opt.threads > 0 ? opt.threads : (int)std::thread::hardware_concurrency();
+    threadCount = std::max(1, std::min(threadCount, width));
+
+    std::vector<float> grid((size_t)width * (size_t)height, 0.0f);  // Column-major: bars of column x
+
+    auto worker = [&](int x0, int x1) {
+        float* in = (float*)fftwf_malloc(sizeof(float) * n);
+        fftwf_complex* out = (fftwf_complex*)fftwf_malloc(sizeof(fftwf_complex) * (n / 2 + 1));
+        std::vector<float> mags((size_t)(n / 2));
+        std::vector<float> line((size_t)height);
+
+        for (int x = x0; x < x1; x++) {
+            float* column = &grid[(size_t)x * (size_t)height];
+            const uint64_t k0 = hops * (uint64_t)x / (uint64_t)width;
+            const uint64_t k1 = std::max(k0 + 1, hops * (uint64_t)(x + 1) / (uint64_t)width);
+            for (uint64_t k = k0; k < k1; k++) {
+                // Window centred on the hop, zero-padded before the start
+                const int64_t start = (int64_t)(k * (uint64_t)opt.hop) - n / 2;
+                const int lead = start < 0 ? (int)std::min<int64_t>(-start, n) : 0;
+                std::fill(in, in + lead, 0.0f);
+                wavFile->read((uint64_t)(start + lead), in + lead, (size_t)(n - lead));
+
+                transformWindow(in, out, mags.data());
+                buildLineFromMagnitudes(mags.data(), line.data());
+                for (int i = 0; i < height; i++) column[i] = std::max(column[i], line[(size_t)i]);
+            }
+        }
+
+        fftwf_free(in);
+        fftwf_free(out);
+    };
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        int x0 = (int)((int64_t)width * t / threadCount);
+        int x1 = (int)((int64_t)width * (t + 1) / threadCount);
+        workers.push_back(std::thread(worker, x0, x1));
+    }
+    for (size_t t = 0; t < workers.size(); t++) workers[t].join();
+
+    // Colorize with the Heat Map LUT; low frequencies at the bottom
+    currentColormap = (ColormapType)opt.colormap;
+    colorLUTDirty = true;
+    updateColorLUT();
+    std::vector<unsigned char> rgb((size_t)width * (size_t)height * 3);
+    for (int y = 0; y < height; y++) {
+        const int bar = height - 1 - y;
+        for (int x = 0; x < width; x++) {
+            colorizeValue(grid[(size_t)x * (size_t)height + (size_t)bar], &rgb[((size_t)y * (size_t)width + (size_t)x) * 3]);
+        }
+    }
+
+    bool ok = hasExtension(opt.output, ".png") ? writePNG(opt.output, width, height, rgb)
+                                               : writePPM(opt.output, width, height, rgb);
+    if (!ok) {
+        std::cerr << "Error: Could not write " << opt.output << "\n";
+        return 1;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double audioSeconds = (double)totalFrames / (double)std::max<uint32_t>(1, wavFile->sampleRate);
+    std::cout << "Wrote " << opt.output << " (" << width << "x" << height << ", " << hops << " hops, "
+              << threadCount << " threads) in " << seconds << " s ("
+              << (seconds > 0.0 ? audioSeconds / seconds : 0.0) << "x real time)\n";
+    return 0;
+}
+
+// ===================== Benchmarks =====================
+// Built only into the bench binary (make bench, -DSPECTROGRAM_BENCH). Each hot
+// path runs on synthetic input (plus a real file with --input) across FFT sizes,
+// bar counts and history lengths; results are written as JSON so runs can be
+// compared between releases. Allocations are counted through operator new.
+#ifdef SPECTROGRAM_BENCH
+static std::atomic<uint64_t> gBenchAllocs{0};
+
+void* operator new(size_t size) {
+    gBenchAllocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+
+struct BenchResult {
+    std::string kernel;
+    std::string input;
+    std::vector<std::pair<std::string, long long>> params;
+    uint64_t iterations = 0;
+    double nsPerOp = 0.0;
+    double throughput = 0.0;      // Items per second
+    std::string throughputUnit;
+    double allocsPerOp = 0.0;
+};
+
+static double benchMinSeconds = 0.25;  // Per case (--quick lowers it)
+static const int kBenchBars[] = { 250, 1000, 4000 };
+static const int kBenchHistory[] = { 140, 1024, MAX_HISTORY_LINES };
+static const int kBenchWidths[] = { 800, 1920, 3840 };
+
+// Swallows std::cout while the kernels run (WAVFile::load reports to it)
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// Run 'op' in growing batches until one batch takes benchMinSeconds
+template <typename Op>
+static BenchResult benchRun(const std::string& kernel, Op op, double itemsPerOp, const char* unit) {
+    op();  // Warm caches, lazily sized buffers and plans
+    uint64_t iterations = 1;
+    for (;;) {
+        const uint64_t allocs0 = gBenchAllocs.load(std::memory_order_relaxed);
+        auto t0 = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; i++) op();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        const uint64_t allocs = gBenchAllocs.load(std::memory_order_relaxed) - allocs0;
+
+        if (seconds >= benchMinSeconds || iterations >= (1ull << 32)) {
+            BenchResult r;
+            r.kernel = kernel;
+            r.iterations = iterations;
+            r.nsPerOp = seconds * 1e9 / (double)iterations;
+            r.throughput = seconds > 0.0 ? itemsPerOp * (double)iterations / seconds : 0.0;
+            r.throughputUnit = unit;
+            r.allocsPerOp = (double)allocs / (double)iterations;
+            std::cerr << "bench: " << kernel << " " << r.nsPerOp << " ns/op\n";
+            return r;
+        }
+        const double scale = seconds > 0.0 ? benchMinSeconds / seconds * 1.2 : 10.0;
+        iterations = std::max(iterations * 2, (uint64_t)((double)iterations * std::min(scale, 100.0)));
+    }
+}
+
+// Resize everything that depends on NUM_BARS. Single-threaded bench use only.
+static void setBenchBarCount(int bars) {
+    NUM_BARS = bars;
+    gBarBin0.assign((size_t)bars, 0);
+    gBarBin1.assign((size_t)bars, 0);
+    gBarFrac.assign((size_t)bars, 0.0f);
+    gBarX.assign((size_t)bars, 0.0f);
+    gBarHue.assign((size_t)bars, 0.0f);
+    currentLine.assign((size_t)bars, 0.0f);
+    lineHistory.assign((size_t)MAX_HISTORY_LINES * (size_t)bars * (size_t)gHistoryChannels, 0.0f);
+    historyHead = 0;
+    historyFillCount = 0;
+
+    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+    buildFrequencyMapping();
+    selectAnalysisKernels(fftPlanSize, bars);
+}
+
+// Stereo 16-bit test signal: a log sweep over white noise on the left, a tone
+// stack on the right
+static bool writeBenchWAV(const std::string& path, uint32_t sampleRate, double seconds) {
+    const uint32_t frames = (uint32_t)(sampleRate * seconds);
+    const uint16_t channels = 2;
+    const uint32_t dataBytes = frames * channels * 2;
+    std::ofstream f(path.c_str(), std::ios::binary);
+    if (!f) return false;
+
+    auto put16 = [&](uint16_t v) { char b[2] = { (char)(v & 0xFF), (char)(v >> 8) }; f.write(b, 2); };
+    auto put32 = [&](uint32_t v) { put16((uint16_t)(v & 0xFFFF)); put16((uint16_t)(v >> 16)); };
+    f.write("RIFF", 4); put32(36 + dataBytes); f.write("WAVE", 4);
+    f.write("fmt ", 4); put32(16); put16(1); put16(channels); put32(sampleRate);
+    put32(sampleRate * channels * 2); put16(channels * 2); put16(16);
+    f.write("data", 4); put32(dataBytes);
+
+    std::vector<int16_t> block;
+    block.reserve(8192);
+    uint32_t noise = 12345;
+    double phase = 0.0;
+    for (uint32_t i = 0; i < frames; i++) {
+        const double t = (double)i / (double)sampleRate;
+        const double freq = 50.0 * std::pow(400.0, t / seconds);  // 50 Hz -> 20 kHz
+        phase += 2.0 * M_PI * freq / (double)sampleRate;
+        noise = noise * 1664525u + 1013904223u;
+        const double left = 0.5 * std::sin(phase) + 0.05 * ((double)(noise >> 8) / 8388608.0 - 1.0);
+        const double right = 0.2 * (std::sin(2.0 * M_PI * 440.0 * t) + std::sin(2.0 * M_PI * 3520.0 * t) +
+                                    std::sin(2.0 * M_PI * 10000.0 * t));
+        block.push_back((int16_t)(left * 32767.0));
+        block.push_back((int16_t)(right * 32767.0));
+        if (block.size() >= 8192 || i + 1 == frames) {
+            for (size_t k = 0; k < block.size(); k++) put16((uint16_t)block[k]);
+            block.clear();
+        }
+    }
+    return (bool)f;
+}
+
+static std::string jsonEscape(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++) {
+        const char c = s[i];
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if ((unsigned char)c < 0x20) { out += ' '; }
+        else out += c;
+    }
+    return out;
+}
+
+static void writeBenchJSON(std::ostream& out, const std::vector<BenchResult>& results) {
+#if defined(__AVX2__)
+    const char* simd = "avx2";
+#elif defined(SPECTROGRAM_SSE2)
+    const char* simd = "sse2";
+#elif defined(SPECTROGRAM_NEON)
+    const char* simd = "neon";
+#else
+    const char* simd = "scalar";
+#endif
+    out << "{\n  \"schema\": 1,\n";
+#if defined(__VERSION__)
+    out << "  \"compiler\": \"" << jsonEscape(__VERSION__) << "\",\n";
+#endif
+    out << "  \"simd\": \"" << simd << "\",\n";
+    out << "  \"isa\": \"" << gKernelIsaName << "\",\n";
+    out << "  \"threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        out << "    {\"kernel\": \"" << jsonEscape(r.kernel) << "\", \"input\": \"" << jsonEscape(r.input) << "\"";
+        for (size_t p = 0; p < r.params.size(); p++) {
+            out << ", \"" << r.params[p].first << "\": " << r.params[p].second;
+        }
+        out << ", \"iterations\": " << r.iterations
+            << ", \"ns_per_op\": " << r.nsPerOp
+            << ", \"throughput\": " << r.throughput
+            << ", \"throughput_unit\": \"" << r.throughputUnit << "\""
+            << ", \"allocs_per_op\": " << r.allocsPerOp << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+// Analysis kernels on one loaded file: FFT per size and channel count, then
+// line building per bar count
+static void benchAnalysis(const std::string& inputName, std::vector<BenchResult>& results) {
+    const int hop = std::max(1, ANALYSIS_HOP.load(std::memory_order_relaxed));
+    const uint64_t total = std::max<uint64_t>(1, wavFile->totalFrames);
+    std::vector<float> lines((size_t)4000 * MAX_HISTORY_PLANES);
+    setTransformMode(TRANSFORM_FFT);  // The sliding cases below pick their transform explicitly
+
+    for (int s = 0; s < NUM_FFT_SIZES; s++) {
+        FFT_SIZE = kFFTSizes[s];
+        reinitializeFFT();
+
+        const int maxChannels = std::min<int>(2, std::max<int>(1, wavFile->numChannels));
+        for (int channels = 1; channels <= maxChannels; channels++) {
+            {
+                std::lock_guard<std::mutex> lock(gAnalysisMutex);
+                gAnalysisChannels = channels;
+                gAnalysisMidSide = false;
+            }
+            updateBatchPlan();
+
+            int64_t pos = 0;
+            BenchResult r = benchRun("processAudioFrameSynced", [&]() {
+                pos = (pos + hop) % (int64_t)total;
+                std::lock_guard<std::mutex> lock(gAnalysisMutex);
+                processAudioFrameSynced(pos);
+            }, (double)FFT_SIZE * channels, "samples/s");
+            r.input = inputName;
+            r.params.push_back(std::make_pair(std::string("fft_size"), (long long)FFT_SIZE));
+            r.params.push_back(std::make_pair(std::string("channels"), (long long)channels));
+            results.push_back(r);
+
+            for (size_t b = 0; b < sizeof(kBenchBars) / sizeof(kBenchBars[0]); b++) {
+                setBenchBarCount(kBenchBars[b]);
+                BenchResult line = benchRun("buildCurrentLine", [&]() {
+                    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+                    buildCurrentLine(lines.data(), channels);
+                }, (double)NUM_BARS * channels, "bars/s");
+                line.input = inputName;
+                line.params.push_back(std::make_pair(std::string("fft_size"), (long long)FFT_SIZE));
+                line.params.push_back(std::make_pair(std::string("channels"), (long long)channels));
+                line.params.push_back(std::make_pair(std::string("num_bars"), (long long)NUM_BARS));
+                results.push_back(line);
+            }
+            setBenchBarCount(1000);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gAnalysisMutex);
+        gAnalysisChannels = 1;
+    }
+    updateBatchPlan();
+
+    // Multi-rate: 'levels' small FFTs per hop against the one large FFT above
+    // with the same low-end resolution (fft_size << (levels - 1))
+    const int multiRateSizes[] = { 1024, 2048 };
+    for (size_t s = 0; s < sizeof(multiRateSizes) / sizeof(multiRateSizes[0]); s++) {
+        FFT_SIZE = multiRateSizes[s];
+        reinitializeFFT();
+        for (int levels = 3; levels <= 5; levels++) {
+            setMultiRate(true, levels);
+            int64_t pos = 0;
+            BenchResult r = benchRun("multiRateFrame", [&]() {
+                pos = (pos + hop) % (int64_t)total;
+                std::lock_guard<std::mutex> lock(gAnalysisMutex);
+                processAudioFrameSynced(pos);
+                buildCurrentLine(lines.data(), 1);
+            }, (double)hop, "samples/s");
+            r.input = inputName;
+            r.params.push_back(std::make_pair(std::string("fft_size"), (long long)FFT_SIZE));
+            r.params.push_back(std::make_pair(std::string("levels"), (long long)levels));
+            results.push_back(r);
+        }
+    }
+    setMultiRate(false, 5);
+
+    // Zoom band: mix, decimate and a small complex FFT over 900-1100 Hz, for
+    // comparison with the full-band sizes above
+    FFT_SIZE = 4096;
+    reinitializeFFT();
+    for (int s = 0; s < NUM_ZOOM_SIZES; s += 2) {
+        setZoomBand(true, 900.0f, 1100.0f, kZoomSizes[s]);
+        updateZoomPlan();
+        int64_t pos = 0;
+        BenchResult r = benchRun("zoomBandFrame", [&]() {
+            pos = (pos + hop) % (int64_t)total;
+            std::lock_guard<std::mutex> lock(gAnalysisMutex);
+            processZoomFrame(pos);
+            buildZoomLine(lines.data());
+        }, (double)hop, "samples/s");
+        r.input = inputName;
+        r.params.push_back(std::make_pair(std::string("zoom_size"), (long long)kZoomSizes[s]));
+        r.params.push_back(std::make_pair(std::string("band_hz"), (long long)200));
+        results.push_back(r);
+    }
+    setZoomBand(false, 900.0f, 1100.0f, 1024);
+
+    // Overlay accumulators: peak, EMA and floor for one line
+    setRunningStats(true, 0.25f, 2.0f, 0.10f);
+    for (size_t b = 0; b < sizeof(kBenchBars) / sizeof(kBenchBars[0]); b++) {
+        setBenchBarCount(kBenchBars[b]);
+        for (int i = 0; i < NUM_BARS; i++) lines[(size_t)i] = (float)(i % 97) / 96.0f;
+        BenchResult r = benchRun("runningStats", [&]() {
+            std::lock_guard<std::mutex> lock(gAnalysisMutex);
+            updateRunningStats(lines.data());
+        }, (double)NUM_BARS, "bars/s");
+        r.input = inputName;
+        r.params.push_back(std::make_pair(std::string("num_bars"), (long long)NUM_BARS));
+        results.push_back(r);
+    }
+    setRunningStats(false, 0.25f, 2.0f, 0.10f);
+    setBenchBarCount(1000);
+
+    // Small hops: full FFT against the sliding DFT on consecutive windows
+    const int savedHop = hop;
+    const int slidingSizes[] = { 1024, 4096 };
+    const int slidingHops[] = { 16, 64, 256 };
+    for (size_t s = 0; s < sizeof(slidingSizes) / sizeof(slidingSizes[0]); s++) {
+        FFT_SIZE = slidingSizes[s];
+        reinitializeFFT();
+        for (size_t h = 0; h < sizeof(slidingHops) / sizeof(slidingHops[0]); h++) {
+            const int step = slidingHops[h];
+            ANALYSIS_HOP.store(step, std::memory_order_relaxed);
+            for (int mode = TRANSFORM_FFT; mode <= TRANSFORM_SLIDING; mode++) {
+                setTransformMode(mode);
+                int64_t pos = 0;
+                BenchResult r = benchRun("slidingFrame", [&]() {
+                    pos = (pos + step) % (int64_t)total;
+                    std::lock_guard<std::mutex> lock(gAnalysisMutex);
+                    processAudioFrameSynced(pos);
+                }, (double)step, "samples/s");
+                r.input = inputName;
+                r.params.push_back(std::make_pair(std::string("fft_size"), (long long)FFT_SIZE));
+                r.params.push_back(std::make_pair(std::string("hop"), (long long)step));
+                r.params.push_back(std::make_pair(std::string("sliding"), (long long)(mode == TRANSFORM_SLIDING)));
+                results.push_back(r);
+            }
+        }
+    }
+    setTransformMode(TRANSFORM_AUTO);
+    ANALYSIS_HOP.store(savedHop, std::memory_order_relaxed);
+}
+
+// History push and the 2D texture colorization, per bar count and history length
+static void benchHistory(std::vector<BenchResult>& results) {
+    for (size_t b = 0; b < sizeof(kBenchBars) / sizeof(kBenchBars[0]); b++) {
+        setBenchBarCount(kBenchBars[b]);
+        std::vector<float> line((size_t)NUM_BARS);
+        for (int i = 0; i < NUM_BARS; i++) line[(size_t)i] = (float)(i % 97) / 96.0f;
+        for (size_t k = 0; k < lineHistory.size(); k++) lineHistory[k] = (float)(k % 251) / 250.0f;
+
+        for (size_t h = 0; h < sizeof(kBenchHistory) / sizeof(kBenchHistory[0]); h++) {
+            HISTORY_LINES = kBenchHistory[h];
+            BenchResult r = benchRun("pushLineToHistory", [&]() { pushLineToHistory(line.data()); },
+                                     1.0, "lines/s");
+            r.input = "synthetic";
+            r.params.push_back(std::make_pair(std::string("num_bars"), (long long)NUM_BARS));
+            r.params.push_back(std::make_pair(std::string("history_lines"), (long long)HISTORY_LINES));
+            results.push_back(r);
+        }
+
+        // renderTraditionalSpectrogram's CPU path: full rebuild and per-line column
+        texWidth = MAX_HISTORY_LINES;
+        texHeight = NUM_BARS * gHistoryChannels;
+        textureData.resize((size_t)texWidth * (size_t)texHeight * 3);
+        colorLUTDirty = true;
+        updateColorLUT();
+
+        BenchResult full = benchRun("spectrogramTextureRebuild", []() { colorizeSpectrogramTexture(); },
+                                    (double)texWidth * (double)texHeight, "texels/s");
+        full.input = "synthetic";
+        full.params.push_back(std::make_pair(std::string("num_bars"), (long long)NUM_BARS));
+        full.params.push_back(std::make_pair(std::string("history_lines"), (long long)MAX_HISTORY_LINES));
+        results.push_back(full);
+
+        std::vector<unsigned char> column((size_t)texHeight * 3);
+        BenchResult col = benchRun("spectrogramTextureColumn", [&]() { colorizeSpectrogramColumn(0, column.data()); },
+                                   (double)texHeight, "texels/s");
+        col.input = "synthetic";
+        col.params.push_back(std::make_pair(std::string("num_bars"), (long long)NUM_BARS));
+        results.push_back(col);
+    }
+    HISTORY_LINES = 140;
+    setBenchBarCount(1000);
+}
+
+static void benchWaveform(const std::string& inputName, std::vector<BenchResult>& results) {
+    for (size_t w = 0; w < sizeof(kBenchWidths) / sizeof(kBenchWidths[0]); w++) {
+        const int width = kBenchWidths[w];
+        BenchResult r = benchRun("buildWaveformVertices", [&]() {
+            waveformVerticesDirty = true;
+            buildWaveformVertices(width);
+        }, (double)(width + 1), "pixels/s");
+        r.input = inputName;
+        r.params.push_back(std::make_pair(std::string("width"), (long long)width));
+        results.push_back(r);
+    }
+}
+
+static void benchLoad(const std::string& path, const std::string& inputName, std::vector<BenchResult>& results) {
+    WAVFile probe;
+    if (!probe.load(path)) return;
+    const double frames = (double)probe.totalFrames;
+    probe.close();
+
+    BenchResult r = benchRun("WAVFile::load", [&]() {
+        WAVFile f;
+        f.load(path);
+        f.close();
+    }, frames, "frames/s");
+    r.input = inputName;
+    results.push_back(r);
+}
+
+// Usage: spectrogram_bench [--input file] [--json out.json] [--quick] [--plan-effort x]
+static int runBench(int argc, char* argv[]) {
+    std::string inputPath;
+    std::string jsonPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--input" && hasValue) inputPath = argv[++i];
+        else if (arg == "--json" && hasValue) jsonPath = argv[++i];
+        else if (arg == "--quick") benchMinSeconds = 0.05;
+        else if (arg == "--plan-effort" && hasValue) {
+            if (!parsePlanEffort(argv[++i])) {
+                std::cerr << "Error: --plan-effort must be estimate, measure, patient or exhaustive\n";
+                return 1;
+            }
+        }
+    }
+
+    const std::string syntheticPath = "spectrogram_bench_input.wav";
+    if (!writeBenchWAV(syntheticPath, 48000, 30.0)) {
+        std::cerr << "Error: Could not write " << syntheticPath << "\n";
+        return 1;
+    }
 
-    glDisable(GL_SCISSOR_TEST);
-}
+    NullBuffer nullBuffer;
+    std::streambuf* stdoutBuffer = std::cout.rdbuf(&nullBuffer);
 
-// ===================== Audio Control =====================
-void startAudio() {
-    if (wavFile.audioData.empty()) return;
-    if (audioStream) return;
+    initFFTPlanCache();
+    waitForFFTPlanner();
 
-    // Output mono for mono sources; stereo for anything else (duplicate mono to L/R)
-    gOutputChannels = (wavFile.sourceChannels >= 2) ? 2 : 1;
+    std::vector<BenchResult> results;
+    std::vector<std::pair<std::string, std::string>> inputs;  // (name, path)
+    inputs.push_back(std::make_pair(std::string("synthetic"), syntheticPath));
+    if (!inputPath.empty()) inputs.push_back(std::make_pair(inputPath, inputPath));
 
-    PaError err = Pa_OpenDefaultStream(&audioStream,
-                                       0,
-                                       gOutputChannels,
-                                       paFloat32,
-                                       wavFile.sampleRate,
-                                       FRAMES_PER_BUFFER,
-                                       audioCallback,
-                                       nullptr);
-    if (err == paNoError) {
-        err = Pa_StartStream(audioStream);
-        if (err == paNoError) {
-            isPlaying = true;
-            isPaused.store(false, std::memory_order_relaxed);
+    bool ok = true;
+    for (size_t k = 0; k < inputs.size(); k++) {
+        const std::string& name = inputs[k].first;
+        const std::string& path = inputs[k].second;
 
-            const PaStreamInfo* info = Pa_GetStreamInfo(audioStream);
-            double outLatencySec = info ? info->outputLatency : 0.0;
-            int outLatencySamples = (int)std::llround(outLatencySec * (double)wavFile.sampleRate);
+        benchLoad(path, name, results);
 
-            // playbackPosition is mono samples; latency is in frames -> same unit here.
-            gLatencySamplesBase = outLatencySamples + FRAMES_PER_BUFFER;
+        std::shared_ptr<WAVFile> file = std::make_shared<WAVFile>();
+        if (!file->load(path)) {
+            ok = false;
+            continue;
         }
+        while (!file->overview.complete()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        wavFile = file;
+
+        benchAnalysis(name, results);
+        benchWaveform(name, results);
+        if (k == 0) benchHistory(results);
     }
-}
 
-void stopAudio() {
-    if (audioStream) {
-        Pa_StopStream(audioStream);
-        Pa_CloseStream(audioStream);
-        audioStream = nullptr;
+    std::cout.rdbuf(stdoutBuffer);
+    if (jsonPath.empty()) {
+        writeBenchJSON(std::cout, results);
+    } else {
+        std::ofstream out(jsonPath.c_str());
+        writeBenchJSON(out, results);
+        if (!out) {
+            std::cerr << "Error: Could not write " << jsonPath << "\n";
+            ok = false;
+        }
     }
-    isPlaying = false;
-    isPaused.store(false, std::memory_order_relaxed);
-    playbackPosition.store(0, std::memory_order_relaxed);
+
+    wavFile = std::make_shared<WAVFile>();
+    std::remove(syntheticPath.c_str());
+    destroyFFTPlanCache();
+    destroyBatchPlan(gBatchPlan);
+    destroyZoomPlan(gZoomPlan);
+    return ok ? 0 : 1;
 }
+#endif  // SPECTROGRAM_BENCH
 
 // ===================== Main =====================
 int main(int argc, char* argv[]) {
-    // Load FFTW wisdom for optimized performance
-    fftw_import_wisdom_from_filename("fftw_wisdom.dat");
+#ifdef SPECTROGRAM_BENCH
+    return runBench(argc, argv);
+#endif
+    HeadlessOptions headless;
+    bool headlessMode = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--plan-effort" && hasValue) {
+            if (!parsePlanEffort(argv[++i])) {
+                std::cerr << "Error: --plan-effort must be estimate, measure, patient or exhaustive\n";
+                return 1;
+            }
+        } else if (arg == "--precompute" && hasValue) {
+            std::string backend = argv[++i];
+            if (backend == "gpu") precomputeBackend = PRECOMPUTE_GPU;
+            else if (backend == "cpu") precomputeBackend = PRECOMPUTE_FFTW;
+            else {
+                std::cerr << "Error: --precompute must be cpu or gpu\n";
+                return 1;
+            }
+        } else if (arg == "--publish" && hasValue) {
+            netPublishAddress = argv[++i];
+        } else if (arg == "--publish-bits" && hasValue) {
+            netPublishBits = std::atoi(argv[++i]);
+            if (netPublishBits != 8 && netPublishBits != 16) {
+                std::cerr << "Error: --publish-bits must be 8 or 16\n";
+                return 1;
+            }
+        } else if (arg == "--publish-ttl" && hasValue) {
+            netPublishTtl = std::atoi(argv[++i]);
+        } else if (arg == "--record" && hasValue) {
+            sessionRecordPath = argv[++i];
+        } else if (arg == "--subscribe" && hasValue) {
+            netSubscribeAddress = argv[++i];
+        } else if (arg == "--zoom" && hasValue) {
+            float lo = 0.0f, hi = 0.0f;
+            if (std::sscanf(argv[++i], "%f:%f", &lo, &hi) != 2 || lo <= 0.0f || hi <= lo) {
+                std::cerr << "Error: --zoom must be LO:HI in Hz, e.g. 900:1100\n";
+                return 1;
+            }
+            zoomEnabled = true;
+            zoomLoHz = lo;
+            zoomHiHz = hi;
+        } else if (arg == "--compare" && hasValue) {
+            if (!addCompareFile(argv[++i])) return 1;
+        } else if (arg == "--layout" && hasValue) {
+            const std::string layout = argv[++i];
+            if (layout == "single") {
+                viewLayout = VIEW_SINGLE;
+            } else if (layout == "side") {
+                viewLayout = VIEW_SPLIT_SIDE;
+            } else if (layout == "stacked") {
+                viewLayout = VIEW_SPLIT_STACKED;
+            } else {
+                std::cerr << "Error: --layout must be single, side or stacked\n";
+                return 1;
+            }
+        } else if (arg == "--multirate" && hasValue) {
+            multiRateEnabled = true;
+            multiRateLevels = std::max(2, std::min(std::atoi(argv[++i]), MULTIRATE_MAX_LEVELS));
+        } else if (arg == "--headless" && hasValue) {
+            headlessMode = true;
+            headless.input = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            headless.output = argv[++i];
+        } else if (arg == "--width" && hasValue) {
+            headless.width = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && hasValue) {
+            headless.threads = std::atoi(argv[++i]);
+        } else if (arg == "--fft" && hasValue) {
+            headless.fftSize = std::atoi(argv[++i]);
+        } else if (arg == "--hop" && hasValue) {
+            headless.hop = std::atoi(argv[++i]);
+        } else if (arg == "--colormap" && hasValue) {
+            std::string name = argv[++i];
+            headless.colormap = -1;
+            for (int c = 0; c < IM_ARRAYSIZE(colormapCliNames); c++) {
+                if (name == colormapCliNames[c]) headless.colormap = c;
+            }
+            if (headless.colormap < 0) {
+                std::cerr << "Error: Unknown colormap: " << name << "\n";
+                return 1;
+            }
+        }
+    }
+    if (!netPublishAddress.empty() && !netSubscribeAddress.empty()) {
+        std::cerr << "Error: --publish and --subscribe cannot be combined\n";
+        return 1;
+    }
+    if (headlessMode && headless.output.empty()) {
+        std::cerr << "Error: --headless needs --out <file.png|file.ppm>\n";
+        return 1;
+    }
 
-    // Initialize FFTW
-    fftInput = (double*)fftw_malloc(sizeof(double) * FFT_SIZE);
-    fftOutput = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (FFT_SIZE / 2 + 1));
-    fftPlan = fftw_plan_dft_r2c_1d(FFT_SIZE, fftInput, fftOutput, FFTW_ESTIMATE);
+    // Plan every FFT size (wisdom is loaded first and saved once planning finishes)
+    initFFTPlanCache();
 
-    // Save FFTW wisdom for future runs
-    fftw_export_wisdom_to_filename("fftw_wisdom.dat");
+    // Initialize FFTW (plan, buffers, window table and magnitudes vector)
+    reinitializeFFT();
 
-    // Initialize magnitudes vector
-    magnitudes.resize(getNumFrequencies(), 0.0f);
+    if (headlessMode) {
+        int result = runHeadless(headless);
+        wavFile->close();
+        destroyFFTPlanCache();
+        return result;
+    }
 
     // Load recent files list
     loadRecentFiles();
@@ -1458,22 +8814,10 @@ int main(int argc, char* argv[]) {
 
     // Set up drag & drop callback
     glfwSetDropCallback(window, [](GLFWwindow* win, int count, const char** paths) {
+        noteInputActivity();
         if (count > 0) {
             // Load the first dropped file
-            stopAudio();
-            strncpy(filePathBuffer, paths[0], sizeof(filePathBuffer)-1);
-            filePathBuffer[sizeof(filePathBuffer)-1] = '\0';
-
-            if (wavFile.load(paths[0])) {
-                buildFrequencyMapping();
-                waveformCacheDirty = true;  // Mark waveform cache as dirty
-                loadedFileName = std::string(paths[0]);
-                size_t pos = loadedFileName.find_last_of("/\\");
-                if (pos != std::string::npos) {
-                    loadedFileName = loadedFileName.substr(pos + 1);
-                }
-                addToRecentFiles(paths[0]);
-            }
+            loadAudioFile(paths[0]);
         }
     });
 
@@ -1484,6 +8828,9 @@ int main(int argc, char* argv[]) {
         std::cerr << "Failed to initialize GLEW\n";
         return -1;
     }
+    gGpuTimerSupported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    gGpuComputeSupported = GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object);
+    if (GLEW_VERSION_3_2 || GLEW_ARB_sync) initUploadRing(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage);
 
     // Initialize ImGui
     IMGUI_CHECKVERSION();
@@ -1493,6 +8840,8 @@ int main(int argc, char* argv[]) {
     // Apply initial theme
     applyTheme(useDarkTheme);
 
+    // Before ImGui so its callbacks chain to ours (redraw on input)
+    installActivityCallbacks(window);
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
@@ -1503,14 +8852,26 @@ int main(int argc, char* argv[]) {
         ImGuiIO& io = ImGui::GetIO();
         io.MouseWheelH += (float)xoff;
         io.MouseWheel += (float)yoff;
+        noteInputActivity();
     });
 
+    // Spectrum lines are produced off the GL thread at a fixed hop size, or
+    // arrive from a publisher when subscribed
+    if (!netSubscribeAddress.empty()) {
+        if (!startNetSubscriber(netSubscribeAddress)) return 1;
+    } else {
+        if (!netPublishAddress.empty() && !startNetPublisher(netPublishAddress)) return 1;
+        startAnalysisThread();
+    }
+    if (!sessionRecordPath.empty() && !startSessionRecording(sessionRecordPath)) return 1;
+
     // Keyboard handled in main loop
     bool spacePressed = false, rPressed = false, cPressed = false;
 
     // Main loop
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        waitForFrameEvents();
+        const uint64_t frameStartNs = profileNowNs();
 
         // Calculate viewport dimensions first
         // This is fully dynamic - works at any window/screen size
@@ -1528,8 +8889,19 @@ int main(int argc, char* argv[]) {
         double mx, my;
         glfwGetCursorPos(window, &mx, &my);
 
-        // Mouse button handling for viewport rotation (only in 3D mode)
-        if (!useTraditionalView && !io.WantCaptureMouse && mx >= viewportX) {
+        // The waveform navigator takes the mouse while it is over it (or dragging)
+        const bool waveformMouse = handleWaveformMouse(window, mx, my, windowHeight);
+
+        // Route the mouse to the pane under it; a drag stays with the pane it started in
+        ViewPane pane2D;
+        const bool has2D = traditionalViewPane(pane2D);
+        if (!gDragging && !gZoomSelecting) {
+            ViewPane hover;
+            gMouseIn2D = viewPaneAt(mx, (double)windowHeight - my, hover) ? hover.traditional : useTraditionalView;
+        }
+
+        // Mouse button handling for viewport rotation (only over a 3D pane)
+        if (!gMouseIn2D && !io.WantCaptureMouse && mx >= viewportX && !waveformMouse) {
             if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
                 if (!gDragging) {
                     gDragging = true;
@@ -1554,10 +8926,30 @@ int main(int argc, char* argv[]) {
             if (io.MouseWheel != 0.0f && !sliderConsumedScroll) {
                 gDist -= io.MouseWheel * 0.18f;
                 gDist = clampf(gDist, 1.4f, 12.0f);
+                io.MouseWheel = 0.0f;  // Consumed: skipped frames must not apply it again
                 needsRedraw = true;  // Zoom changed, need redraw
             }
+        } else if (gMouseIn2D && has2D && sessionLogViewing() && !io.WantCaptureMouse && mx >= viewportX &&
+                   !waveformMouse) {
+            // Session log: drag pans through time, scroll zooms around the cursor
+            if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+                if (gDragging) moveSessionLogView(1.0, 1.0, -(mx - gLastX) / (double)pane2D.w);
+                gDragging = true;
+                gLastX = mx;
+            } else {
+                gDragging = false;
+            }
+            if (io.MouseWheel != 0.0f && !sliderConsumedScroll) {
+                moveSessionLogView(std::pow(0.8, (double)io.MouseWheel), (mx - pane2D.x) / (double)pane2D.w, 0.0);
+                io.MouseWheel = 0.0f;
+            }
+        } else if (gMouseIn2D && has2D && !sessionLogViewing() &&
+                   (gZoomSelecting || (!io.WantCaptureMouse && mx >= viewportX && !waveformMouse))) {
+            gDragging = false;
+            handleZoomSelectMouse(window, mx, my, windowHeight, pane2D.x, pane2D.y, pane2D.w, pane2D.h);
         } else {
             gDragging = false;
+            gZoomSelecting = false;
         }
 
         // Keyboard handling
@@ -1567,7 +8959,7 @@ int main(int argc, char* argv[]) {
                 // Toggle pause if already playing
                 bool nowPaused = !isPaused.load(std::memory_order_relaxed);
                 isPaused.store(nowPaused, std::memory_order_relaxed);
-            } else if (!wavFile.audioData.empty()) {
+            } else if (!wavFile->empty()) {
                 // Start playback if not playing
                 startAudio();
             }
@@ -1577,7 +8969,7 @@ int main(int argc, char* argv[]) {
 
         // R - Restart playback
         if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !rPressed && isPlaying) {
-            playbackPosition.store(0, std::memory_order_relaxed);
+            seekTo(0);
             rPressed = true;
         }
         if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) rPressed = false;
@@ -1649,11 +9041,11 @@ int main(int argc, char* argv[]) {
         // LEFT ARROW - Seek backward 5 seconds (only if not typing in UI)
         static bool leftPressed = false;
         if (!ImGui::GetIO().WantCaptureKeyboard &&
-            glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS && !leftPressed && !wavFile.audioData.empty()) {
+            glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS && !leftPressed && !wavFile->empty()) {
             int64_t currentPos = (int64_t)playbackPosition.load(std::memory_order_relaxed);
-            int64_t seekAmount = (int64_t)wavFile.sampleRate * 5;  // 5 seconds (mono samples)
+            int64_t seekAmount = (int64_t)wavFile->sampleRate * 5;  // 5 seconds (mono samples)
             int64_t newPos = std::max((int64_t)0, currentPos - seekAmount);
-            playbackPosition.store((uint64_t)newPos, std::memory_order_relaxed);
+            seekTo((uint64_t)newPos);
             leftPressed = true;
         }
         if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_RELEASE) leftPressed = false;
@@ -1661,11 +9053,11 @@ int main(int argc, char* argv[]) {
         // RIGHT ARROW - Seek forward 5 seconds (only if not typing in UI)
         static bool rightPressed = false;
         if (!ImGui::GetIO().WantCaptureKeyboard &&
-            glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS && !rightPressed && !wavFile.audioData.empty()) {
+            glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS && !rightPressed && !wavFile->empty()) {
             int64_t currentPos = (int64_t)playbackPosition.load(std::memory_order_relaxed);
-            int64_t seekAmount = (int64_t)wavFile.sampleRate * 5;  // 5 seconds (mono samples)
-            int64_t newPos = std::min((int64_t)wavFile.audioData.size(), currentPos + seekAmount);
-            playbackPosition.store((uint64_t)newPos, std::memory_order_relaxed);
+            int64_t seekAmount = (int64_t)wavFile->sampleRate * 5;  // 5 seconds (mono samples)
+            int64_t newPos = std::min((int64_t)wavFile->totalFrames, currentPos + seekAmount);
+            seekTo((uint64_t)newPos);
             rightPressed = true;
         }
         if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_RELEASE) rightPressed = false;
@@ -1680,10 +9072,10 @@ int main(int argc, char* argv[]) {
                 bool pressed = (glfwGetKey(window, keyTop) == GLFW_PRESS ||
                                glfwGetKey(window, keyNumpad) == GLFW_PRESS);
 
-                if (pressed && !numPressed[i] && !wavFile.audioData.empty()) {
+                if (pressed && !numPressed[i] && !wavFile->empty()) {
                     float percent = (i + 1) * 0.1f;  // 1 = 10%, 2 = 20%, etc.
-                    uint64_t newPos = (uint64_t)((double)wavFile.audioData.size() * (double)percent);
-                    playbackPosition.store(newPos, std::memory_order_relaxed);
+                    uint64_t newPos = (uint64_t)((double)wavFile->totalFrames * (double)percent);
+                    seekTo(newPos);
                     numPressed[i] = true;
                 }
 
@@ -1711,7 +9103,7 @@ int main(int argc, char* argv[]) {
         if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_RELEASE) tabPressed = false;
 
         // Auto-rotate camera if enabled (only in 3D mode)
-        if (autoRotate && !useTraditionalView) {
+        if (autoRotate && waterfallPaneShown()) {
             gYaw += 0.05f;  // Rotate at 0.3 degrees per frame
             if (gYaw >= 360.0f) gYaw -= 360.0f;
             needsRedraw = true;  // Camera rotating, need redraw
@@ -1719,32 +9111,66 @@ int main(int argc, char* argv[]) {
 
         // Calculate FPS and CPU (update 10x per second)
         double currentTime = glfwGetTime();
-        frameCount++;
         if (currentTime - lastFPSTime >= 0.1) {  // Update every 0.1 seconds instead of 1.0
             currentFPS = (float)(frameCount / (currentTime - lastFPSTime));
             currentCPU = (float)getCurrentCPUUsage();
+            currentRSSMB = (float)((double)getProcessRSS() / (1024.0 * 1024.0));
             frameCount = 0;
             lastFPSTime = currentTime;
         }
+        if (currentTime - lastProfileTime >= 1.0) {
+            updateProfileStats();
+            lastProfileTime = currentTime;
+        }
+        noteAudioXruns();
+
+        // Install a file the loader thread finished opening
+        pollAudioLoad();
+
+        // Keep the precomputed pyramid in step with the analysis settings, and lay
+        // out the whole-file overview once it is available
+        updatePyramidBuild();
+        pumpGpuPrecompute();
+        updateChannelViews();
+        if (showWholeFile && !sessionLogViewing() && wholeFileLines != HISTORY_LINES && fillHistoryWithWholeFile()) {
+            wholeFileLines = HISTORY_LINES;
+            needsRedraw = true;
+        }
 
-        if (!isPaused.load(std::memory_order_relaxed) && isPlaying) {
-            processAudioFrameSynced();
-            buildCurrentLine();
-            pushLineToHistory();
-            needsRedraw = true;  // New audio data, need redraw
-        } else {
-            // When paused/stopped, reduce update rate to save CPU
-            // Sleep for a bit to lower frame rate when idle
-            if (!isPlaying && !needsRedraw) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(16)); // ~60 FPS when idle
+        // Drain every line the analysis thread finished since the last frame
+        // (recorded, but not shown while the whole-file overview or a log is up)
+        gLineWakePending.store(false);
+        bool newLines = false;
+        uint64_t newestLineStamp = 0;
+        while (const float* line = gLineQueue.front()) {
+            if (gSessionRecorder.isOpen()) gSessionRecorder.append(line, gLineQueue.frontStamp());
+            if (!showWholeFile && !sessionLogViewing() && gLineQueue.frontLines() == gHistoryChannels) {
+                std::memcpy(currentLine.data(), line, sizeof(float) * NUM_BARS);
+                ScopedStageTimer timer(STAGE_HISTORY_PUSH);
+                pushLineToHistory(line);
+                newestLineStamp = gLineQueue.frontStamp();
+                newLines = true;
             }
+            gLineQueue.pop();
+        }
+        if (newLines) {
+            needsRedraw = true;  // New audio data, need redraw
         }
+        if (refreshStatsView()) needsRedraw = true;
+        updateSessionLogView();
+
+        // Nothing changed (or the frame cap is not up yet): skip all GL work
+        const double renderTime = glfwGetTime();
+        if (nextFrameDelay(renderTime) != 0.0) continue;
+        noteFrameRendered(renderTime);
+        frameCount++;
 
         // Clear everything first
         glClearColor(bgColor[0], bgColor[1], bgColor[2], 1.0f);  // Use variable background color
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         // FIRST: Render ImGui (sidebar)
+        const uint64_t imguiStartNs = profileNowNs();
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
@@ -1822,52 +9248,9 @@ int main(int argc, char* argv[]) {
             // 2D/3D toggle
             bool temp2D = useTraditionalView;
             if (ImGui::Checkbox("##2d", &temp2D)) {
-                // Trigger the same logic as the full sidebar
-                useTraditionalView = temp2D;
-                if (useTraditionalView) {
-                    saved3D_FFT_SIZE = FFT_SIZE;
-                    saved3D_HISTORY_LINES = HISTORY_LINES;
-                    saved3D_lineWidth = lineWidth;
-                    saved3D_yScale = yScale;
-                    saved3D_yOffset = yOffset;
-                    saved3D_showGrid = showGrid;
-                    saved3D_autoRotate = autoRotate;
-
-                    // Save color settings
-                    saved3D_useCustomLineColor = useCustomLineColor;
-                    saved3D_useColormap = useColormap;
-                    saved3D_currentColormap = currentColormap;
-                    
-                    // Enable colormap for heat map
-                    useColormap = true;
-                    useCustomLineColor = false;
-
-                    FFT_SIZE = 16384;  // 32x
-                    HISTORY_LINES = 560;  // Maximum history
-                    lineWidth = 1.0f;
-                    yScale = 1.0f;
-                    yOffset = 0.0f;
-                    showGrid = false;
-                    autoRotate = false;
-                    colorLUTDirty = true;  // Rebuild color LUT
-                    reinitializeFFT();
-                } else {
-                    FFT_SIZE = saved3D_FFT_SIZE;
-                    HISTORY_LINES = saved3D_HISTORY_LINES;
-                    lineWidth = saved3D_lineWidth;
-                    yScale = saved3D_yScale;
-                    yOffset = saved3D_yOffset;
-                    showGrid = saved3D_showGrid;
-                    autoRotate = saved3D_autoRotate;
-
-                    // Restore color settings
-                    useCustomLineColor = saved3D_useCustomLineColor;
-                    useColormap = saved3D_useColormap;
-                    currentColormap = saved3D_currentColormap;
-
-                    colorLUTDirty = true;  // Rebuild color LUT
-                    reinitializeFFT();
-                }
+                // Same as the full sidebar
+                viewLayout = VIEW_SINGLE;
+                setTraditionalView(temp2D);
             }
             if (ImGui::IsItemHovered()) ImGui::SetTooltip(useTraditionalView ? "2D Heat Map" : "3D Waterfall");
 
@@ -1911,55 +9294,10 @@ int main(int argc, char* argv[]) {
             ImGui::Spacing();
 
             // NEW: Traditional spectrogram view toggle
-            if (ImGui::Checkbox("2D Heat Map", &useTraditionalView)) {
-                // When switching to 2D view, save current settings and lock to optimal values
-                if (useTraditionalView) {
-                    saved3D_FFT_SIZE = FFT_SIZE;
-                    saved3D_HISTORY_LINES = HISTORY_LINES;
-                    saved3D_lineWidth = lineWidth;
-                    saved3D_yScale = yScale;
-                    saved3D_yOffset = yOffset;
-                    saved3D_showGrid = showGrid;
-                    saved3D_autoRotate = autoRotate;
-
-                    // Set optimal 2D settings - 32x FFT for good frequency resolution
-                    FFT_SIZE = 16384;  // 32x (512 * 32)
-                    HISTORY_LINES = 560;  // Maximum history
-                    lineWidth = 1.0f;   // Not used in 2D but locked
-                    yScale = 1.0f;      // Not used in 2D but locked
-                    yOffset = 0.0f;     // Not used in 2D but locked
-                    showGrid = false;   // Not used in 2D but locked
-                    autoRotate = false; // Not used in 2D but locked
-
-                    // Save color settings BEFORE changing them
-                    saved3D_useCustomLineColor = useCustomLineColor;
-                    saved3D_useColormap = useColormap;
-                    saved3D_currentColormap = currentColormap;
-
-                    // Enable colormap for heat map
-                    useColormap = true;
-                    useCustomLineColor = false;
-
-                    colorLUTDirty = true;  // Rebuild color LUT
-                    reinitializeFFT();
-                } else {
-                    // Restore 3D settings
-                    FFT_SIZE = saved3D_FFT_SIZE;
-                    HISTORY_LINES = saved3D_HISTORY_LINES;
-                    lineWidth = saved3D_lineWidth;
-                    yScale = saved3D_yScale;
-                    yOffset = saved3D_yOffset;
-                    showGrid = saved3D_showGrid;
-                    autoRotate = saved3D_autoRotate;
-
-                    // Restore color settings
-                    useCustomLineColor = saved3D_useCustomLineColor;
-                    useColormap = saved3D_useColormap;
-                    currentColormap = saved3D_currentColormap;
-
-                    colorLUTDirty = true;  // Rebuild color LUT
-                    reinitializeFFT();
-                }
+            bool traditional = useTraditionalView;
+            if (ImGui::Checkbox("2D Heat Map", &traditional)) {
+                viewLayout = VIEW_SINGLE;  // Picking one view leaves a split layout
+                setTraditionalView(traditional);
             }
             ImGui::SameLine();
             if (ImGui::Button("?##viewhelp", ImVec2(20, 0))) {
@@ -1971,8 +9309,16 @@ int main(int argc, char* argv[]) {
                 ImGui::Text("  - Locked at 32x FFT & 560 lines");
                 ImGui::Text("3D View: Waterfall visualization");
                 ImGui::Text("  (with camera controls)");
+                ImGui::Text("Split layouts show both at once");
+                ImGui::Text("  - Using the 3D settings");
                 ImGui::EndPopup();
             }
+            ImGui::PushItemWidth(280);
+            int layout = viewLayout;
+            if (ImGui::Combo("##viewlayout", &layout, viewLayoutNames, VIEW_LAYOUT_COUNT)) {
+                setViewLayout(layout);
+            }
+            ImGui::PopItemWidth();
 
             ImGui::Spacing();
             ImGui::Separator();
@@ -1982,21 +9328,8 @@ int main(int argc, char* argv[]) {
             if (ImGui::Button("Browse...", ImVec2(280, 0))) {
                 std::string file = openFileDialog(window);
                 if (!file.empty()) {
-                    strncpy(filePathBuffer, file.c_str(), sizeof(filePathBuffer)-1);
-                    filePathBuffer[sizeof(filePathBuffer)-1] = '\0';
-
                     // Automatically load the file
-                    stopAudio();
-                    if (wavFile.load(filePathBuffer)) {
-                        buildFrequencyMapping();
-                        waveformCacheDirty = true;  // Mark waveform cache as dirty
-                        loadedFileName = std::string(filePathBuffer);
-                        size_t pos = loadedFileName.find_last_of("/\\");
-                        if (pos != std::string::npos) {
-                            loadedFileName = loadedFileName.substr(pos + 1);
-                        }
-                        addToRecentFiles(filePathBuffer);
-                    }
+                    loadAudioFile(file);
                 }
             }
 
@@ -2005,6 +9338,38 @@ int main(int argc, char* argv[]) {
             if (!loadedFileName.empty()) {
                 ImGui::TextColored(ImVec4(0, 1, 0, 1), "Loaded: %s", loadedFileName.c_str());
             }
+            if (gLoaderBusy) {
+                ImGui::TextDisabled("Opening %s...", gLoaderPath.substr(gLoaderPath.find_last_of("/\\") + 1).c_str());
+            }
+
+            // Compare Files
+            if (!loadedFileName.empty() || !gCompare.empty()) {
+                ImGui::Spacing();
+                if (ImGui::CollapsingHeader("Compare Files")) {
+                    ImGui::BeginDisabled((int)gCompare.size() >= MAX_COMPARE_FILES);
+                    if (ImGui::Button("Compare with...", ImVec2(280, 0))) {
+                        std::string file = openFileDialog(window);
+                        if (!file.empty()) addCompareFile(file);
+                    }
+                    ImGui::EndDisabled();
+                    for (size_t i = 0; i < gCompare.size(); i++) {
+                        ImGui::PushID((int)i);
+                        if (ImGui::Button("Remove")) {
+                            removeCompareFile(i);
+                            ImGui::PopID();
+                            break;
+                        }
+                        ImGui::SameLine();
+                        const CompareStream& c = *gCompare[i];
+                        ImGui::Text("%s", c.path.substr(c.path.find_last_of("/\\") + 1).c_str());
+                        if (!c.engine) {
+                            ImGui::SameLine();
+                            ImGui::TextDisabled(c.sampleRate != (int)analysisSampleRate() ? "(sample rate differs)" : "(waiting)");
+                        }
+                        ImGui::PopID();
+                    }
+                }
+            }
 
             // Recent Files
             if (!recentFiles.empty()) {
@@ -2023,20 +9388,9 @@ int main(int argc, char* argv[]) {
                         }
 
                         if (ImGui::Selectable(filename.c_str())) {
-                            stopAudio();
-                            strncpy(filePathBuffer, recentFiles[i].c_str(), sizeof(filePathBuffer)-1);
-                            filePathBuffer[sizeof(filePathBuffer)-1] = '\0';
-
-                            if (wavFile.load(recentFiles[i])) {
-                                buildFrequencyMapping();
-                                waveformCacheDirty = true;  // Mark waveform cache as dirty
-                                loadedFileName = recentFiles[i];
-                                pos = loadedFileName.find_last_of("/\\");
-                                if (pos != std::string::npos) {
-                                    loadedFileName = loadedFileName.substr(pos + 1);
-                                }
-                                addToRecentFiles(recentFiles[i]);
-                            }
+                            // Copy first: loading reorders recentFiles
+                            const std::string path = recentFiles[i];
+                            loadAudioFile(path);
                         }
                     }
                 }
@@ -2046,6 +9400,68 @@ int main(int argc, char* argv[]) {
             ImGui::Separator();
             ImGui::Spacing();
 
+            // Live input capture
+            ImGui::Text("Live Input:");
+            if (!gCaptureActive) {
+                ImGui::PushItemWidth(280);
+
+                // Device list, labelled with the host API (ASIO, WASAPI, JACK, Core Audio, ...)
+                std::string deviceLabel = "Default Input";
+                if (captureDevice >= 0 && captureDevice < Pa_GetDeviceCount()) {
+                    const PaDeviceInfo* d = Pa_GetDeviceInfo(captureDevice);
+                    if (d) deviceLabel = d->name;
+                }
+                if (ImGui::BeginCombo("##capturedevice", deviceLabel.c_str())) {
+                    if (ImGui::Selectable("Default Input", captureDevice < 0)) captureDevice = -1;
+                    for (int d = 0; d < Pa_GetDeviceCount(); d++) {
+                        const PaDeviceInfo* info = Pa_GetDeviceInfo(d);
+                        if (!info || info->maxInputChannels < 1) continue;
+                        const PaHostApiInfo* api = Pa_GetHostApiInfo(info->hostApi);
+                        std::string name = std::string(info->name) + " (" + (api ? api->name : "?") + ")";
+                        ImGui::PushID(d);
+                        if (ImGui::Selectable(name.c_str(), captureDevice == d)) captureDevice = d;
+                        ImGui::PopID();
+                    }
+                    ImGui::EndCombo();
+                }
+
+                const int bufferSizes[] = { 64, 128, 256, 512, 1024 };
+                const char* bufferNames[] = { "64 frames", "128 frames", "256 frames", "512 frames", "1024 frames" };
+                int bufferIndex = 2;
+                for (int b = 0; b < IM_ARRAYSIZE(bufferSizes); b++) {
+                    if (bufferSizes[b] == captureBufferFrames) bufferIndex = b;
+                }
+                if (ImGui::Combo("##capturebuffer", &bufferIndex, bufferNames, IM_ARRAYSIZE(bufferNames))) {
+                    captureBufferFrames = bufferSizes[bufferIndex];
+                }
+
+                const uint32_t rates[] = { 44100, 48000, 88200, 96000, 192000 };
+                const char* rateNames[] = { "44100 Hz", "48000 Hz", "88200 Hz", "96000 Hz", "192000 Hz" };
+                int rateIndex = 1;
+                for (int r = 0; r < IM_ARRAYSIZE(rates); r++) {
+                    if (rates[r] == gCaptureSampleRate) rateIndex = r;
+                }
+                if (ImGui::Combo("##capturerate", &rateIndex, rateNames, IM_ARRAYSIZE(rateNames))) {
+                    gCaptureSampleRate = rates[rateIndex];
+                }
+
+                ImGui::PopItemWidth();
+                if (ImGui::Button("Start Capture", ImVec2(280, 0))) {
+                    startCapture();
+                }
+            } else {
+                if (ImGui::Button("Stop Capture", ImVec2(280, 0))) {
+                    stopCapture();
+                }
+                ImGui::TextDisabled("Device latency: %.1f ms | Capture to display: %.1f ms",
+                                    1000.0f * (float)gLatencySamplesBase / (float)gCaptureSampleRate,
+                                    measuredCaptureLatencyMs);
+            }
+
+            ImGui::Spacing();
+            ImGui::Separator();
+            ImGui::Spacing();
+
             // Playback controls
             ImGui::Text("Playback:");
 
@@ -2074,12 +9490,12 @@ int main(int argc, char* argv[]) {
             ImGui::Spacing();
 
             // Progress bar for scrubbing through audio (FIXED: MONO TIME BASE)
-            if (!wavFile.audioData.empty()) {
+            if (!wavFile->empty()) {
                 uint64_t currentPos = playbackPosition.load(std::memory_order_relaxed);
-                uint64_t totalSamples = (uint64_t)wavFile.audioData.size(); // MONO samples
+                uint64_t totalSamples = wavFile->totalFrames; // MONO samples
 
-                float currentTime = (wavFile.sampleRate > 0) ? ((float)currentPos / (float)wavFile.sampleRate) : 0.0f;
-                float totalTime   = (wavFile.sampleRate > 0) ? ((float)totalSamples / (float)wavFile.sampleRate) : 0.0f;
+                float currentTime = (wavFile->sampleRate > 0) ? ((float)currentPos / (float)wavFile->sampleRate) : 0.0f;
+                float totalTime   = (wavFile->sampleRate > 0) ? ((float)totalSamples / (float)wavFile->sampleRate) : 0.0f;
 
                 // Display time
                 int currentMin = (int)(currentTime / 60.0f);
@@ -2096,7 +9512,7 @@ int main(int argc, char* argv[]) {
                     // User is scrubbing - update playback position
                     uint64_t newPos = (uint64_t)((double)progress * (double)totalSamples);
                     if (newPos > totalSamples) newPos = totalSamples;
-                    playbackPosition.store(newPos, std::memory_order_relaxed);
+                    seekTo(newPos);
                 }
                 ImGui::PopItemWidth();
             } else {
@@ -2117,7 +9533,7 @@ int main(int argc, char* argv[]) {
 
                 stopAudio();
 
-                if (wasPlaying && !wavFile.audioData.empty()) {
+                if (wasPlaying && !wavFile->empty()) {
                     playbackPosition.store(currentPos, std::memory_order_relaxed);
                     startAudio();
                     if (wasPaused) {
@@ -2129,9 +9545,9 @@ int main(int argc, char* argv[]) {
             ImGui::Spacing();
 
             if (ImGui::Button("Restart", ImVec2(280, 0))) {
-                playbackPosition.store(0, std::memory_order_relaxed);
+                seekTo(0);
                 // Auto-start playback if file is loaded
-                if (!wavFile.audioData.empty() && !isPlaying) {
+                if (!wavFile->empty() && !isPlaying) {
                     startAudio();
                 }
             }
@@ -2141,12 +9557,47 @@ int main(int argc, char* argv[]) {
             if (ImGui::Button("Clear Visualization", ImVec2(280, 0))) {
                 // Stop audio playback
                 stopAudio();
+                gLineQueue.clear();
                 // Clear all history lines to zero
                 std::fill(lineHistory.begin(), lineHistory.end(), 0.0f);
                 std::fill(currentLine.begin(), currentLine.end(), 0.0f);
                 std::fill(magnitudes.begin(), magnitudes.end(), 0.0f);
                 historyFillCount = 0;  // Reset history counter
+                historyHead = 0;
+                historyFullUpload = true;
+                spectrogramFullRebuild = true;
+                showWholeFile = false;
+                wholeFileLines = 0;
+            }
+
+            ImGui::Spacing();
+
+            // Whole-file overview from the precomputed pyramid
+            if (ImGui::Checkbox("Whole File Overview", &showWholeFile)) {
+                if (gHistoryChannels > 1) showWholeFile = false;  // Pyramid is mono only
+                wholeFileLines = 0;
+                if (!showWholeFile && !refillHistoryAt(playbackPosition.load(std::memory_order_relaxed))) {
+                    std::fill(lineHistory.begin(), lineHistory.end(), 0.0f);
+                    markHistoryRewritten(0);
+                }
             }
+            {
+                uint64_t total = gPyramidRowsTotal.load(std::memory_order_relaxed);
+                if (!gPyramidReady.load(std::memory_order_acquire) && total > 0) {
+                    ImGui::TextDisabled("Precomputing spectrogram: %.0f%%",
+                                        100.0 * (double)gPyramidRowsDone.load(std::memory_order_relaxed) / (double)total);
+                }
+            }
+            ImGui::Text("Precompute on:");
+            ImGui::PushItemWidth(280);
+            if (!gGpuComputeSupported) ImGui::BeginDisabled();
+            if (ImGui::Combo("##precompute", &precomputeBackend, precomputeBackendNames, PRECOMPUTE_BACKEND_COUNT) &&
+                !gPyramidPath.empty() && !gPyramidReady.load(std::memory_order_acquire)) {
+                startPyramidBuild(gPyramidPath);  // Restart the running build on the new backend
+            }
+            if (!gGpuComputeSupported) ImGui::EndDisabled();
+            ImGui::PopItemWidth();
+            if (!gGpuComputeSupported) ImGui::TextDisabled("GPU compute needs OpenGL 4.3");
 
             ImGui::Spacing();
 
@@ -2283,6 +9734,169 @@ int main(int argc, char* argv[]) {
                 ImGui::PopItemWidth();
             }
 
+            {
+                int optimized = gPlansOptimized.load(std::memory_order_relaxed);
+                if (optimized < NUM_FFT_SIZES) {
+                    ImGui::TextDisabled("Optimizing FFT plans (%d/%d)...", optimized, NUM_FFT_SIZES);
+                }
+            }
+
+            ImGui::Spacing();
+
+            // Hop size controls (time resolution, independent of frame rate)
+            ImGui::Text("Hop Size (Time Resolution):");
+            ImGui::PushItemWidth(280);
+            {
+                const int hopSizes[] = { 32, 64, 128, 256, 512, 1024, 2048 };
+                const char* hopNames[] = { "32", "64", "128", "256", "512", "1024", "2048" };
+                int currentHop = ANALYSIS_HOP.load(std::memory_order_relaxed);
+                int currentHopIndex = 4;
+                for (int n = 0; n < IM_ARRAYSIZE(hopSizes); n++) {
+                    if (hopSizes[n] == currentHop) currentHopIndex = n;
+                }
+
+                if (ImGui::BeginCombo("##hopsize", hopNames[currentHopIndex])) {
+                    for (int n = 0; n < IM_ARRAYSIZE(hopSizes); n++) {
+                        bool is_selected = (currentHopIndex == n);
+                        if (ImGui::Selectable(hopNames[n], is_selected)) {
+                            ANALYSIS_HOP.store(hopSizes[n], std::memory_order_relaxed);
+                        }
+                        if (is_selected)
+                            ImGui::SetItemDefaultFocus();
+                    }
+                    ImGui::EndCombo();
+                }
+            }
+            ImGui::PopItemWidth();
+            if (analysisSampleRate() > 0) {
+                ImGui::TextDisabled("%.1f lines/sec",
+                                    (float)analysisSampleRate() / (float)ANALYSIS_HOP.load(std::memory_order_relaxed));
+            }
+
+            // Per-line transform: full FFT, sliding DFT, or whichever is cheaper
+            ImGui::Text("Transform:");
+            ImGui::PushItemWidth(280);
+            if (ImGui::BeginCombo("##transformmode", transformModeNames[transformMode])) {
+                for (int n = 0; n < TRANSFORM_MODE_COUNT; n++) {
+                    bool is_selected = (transformMode == n);
+                    if (ImGui::Selectable(transformModeNames[n], is_selected) && !is_selected) {
+                        setTransformMode(n);
+                    }
+                    if (is_selected)
+                        ImGui::SetItemDefaultFocus();
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::PopItemWidth();
+            if (transformMode != TRANSFORM_FFT) {
+                std::lock_guard<std::mutex> lock(gAnalysisMutex);
+                if (gSliding.active) {
+                    ImGui::TextDisabled("Sliding DFT over %d of %d bins", (int)gSliding.bins.size(), fftPlanSize / 2 + 1);
+                } else {
+                    ImGui::TextDisabled(windowType == WINDOW_KAISER ? "Full FFT (Kaiser has no sliding form)"
+                                                                    : "Full FFT (cheaper at this hop)");
+                }
+            }
+
+            ImGui::Spacing();
+
+            // Analysis window (tabulated, so switching costs nothing per frame)
+            ImGui::Text("Window:");
+            ImGui::PushItemWidth(280);
+            if (ImGui::BeginCombo("##windowtype", windowTypeNames[windowType])) {
+                for (int n = 0; n < WINDOW_COUNT; n++) {
+                    bool is_selected = (windowType == n);
+                    if (ImGui::Selectable(windowTypeNames[n], is_selected) && !is_selected) {
+                        setWindowType(n);
+                    }
+                    if (is_selected)
+                        ImGui::SetItemDefaultFocus();
+                }
+                ImGui::EndCombo();
+            }
+            ImGui::PopItemWidth();
+
+            // Octave-band analysis: one FFT of the selected size per decimated octave
+            {
+                bool enabled = multiRateEnabled;
+                int levels = multiRateLevels;
+                bool changed = ImGui::Checkbox("Multi-Rate (octave bands)", &enabled);
+                if (enabled) {
+                    ImGui::PushItemWidth(280);
+                    changed |= ImGui::SliderInt("##multiratelevels", &levels, 2, MULTIRATE_MAX_LEVELS, "%d octave levels");
+                    ImGui::PopItemWidth();
+                    if (analysisSampleRate() > 0) {
+                        ImGui::TextDisabled("Low end: %.2f Hz bins (%d x %d-point FFT)",
+                                            (float)analysisSampleRate() / (float)(fftPlanSize << (levels - 1)),
+                                            levels, fftPlanSize);
+                    }
+                    if (gAnalysisChannels > 1) ImGui::TextDisabled("Per-channel views use the single FFT");
+                }
+                if (changed) setMultiRate(enabled, levels);
+            }
+
+            // Zoom band: heterodyne + decimate + small FFT over one region, shown beside the full band
+            {
+                bool enabled = zoomEnabled;
+                float lo = zoomLoHz, hi = zoomHiHz;
+                int sizeIndex = 0;
+                for (int i = 0; i < NUM_ZOOM_SIZES; i++) {
+                    if (kZoomSizes[i] == zoomFFTSize) sizeIndex = i;
+                }
+                bool changed = ImGui::Checkbox("Zoom Band", &enabled);
+                if (enabled) {
+                    const float nyquist = std::max(2.0f, (float)analysisSampleRate() * 0.5f);
+                    ImGui::PushItemWidth(280);
+                    changed |= ImGui::DragFloatRange2("##zoomband", &lo, &hi, std::max(0.1f, (hi - lo) * 0.01f), 1.0f, nyquist,
+                                                     "%.1f Hz", "%.1f Hz", ImGuiSliderFlags_AlwaysClamp);
+                    char sizeLabel[32];
+                    std::snprintf(sizeLabel, sizeof(sizeLabel), "%d-point zoom", kZoomSizes[sizeIndex]);
+                    changed |= ImGui::SliderInt("##zoomsize", &sizeIndex, 0, NUM_ZOOM_SIZES - 1, sizeLabel);
+                    ImGui::PopItemWidth();
+                    if (analysisSampleRate() > 0) {
+                        // Same derivation as designZoomFilter()
+                        const float sr = (float)analysisSampleRate();
+                        float bandLo = lo, bandHi = hi;
+                        clampZoomBand(sr, bandLo, bandHi);
+                        const double band = (double)(bandHi - bandLo);
+                        const double minRate = std::max(1.5 * band, band + 4.32 * (double)sr / (double)ZOOM_MAX_TAPS);
+                        const double rate = (double)sr / (double)std::max(1, (int)std::floor((double)sr / minRate));
+                        ImGui::TextDisabled("%.3f Hz bins, %.2f s window", rate / (double)kZoomSizes[sizeIndex],
+                                            (double)kZoomSizes[sizeIndex] / rate);
+                    }
+                    if (viewLayout != VIEW_SINGLE || useTraditionalView) {
+                        ImGui::TextDisabled("Right-drag in the 2D view to pick a band");
+                    }
+                }
+                if (changed) setZoomBand(enabled, lo, hi, kZoomSizes[sizeIndex]);
+            }
+
+            ImGui::Spacing();
+
+            // Channels: mono downmix, every channel, or mid/side (stereo only)
+            ImGui::Text("Channels:");
+            ImGui::PushItemWidth(280);
+            if (ImGui::BeginCombo("##channelmode", channelModeNames[channelMode])) {
+                for (int n = 0; n < CHANNEL_MODE_COUNT; n++) {
+                    bool is_selected = (channelMode == n);
+                    if (ImGui::Selectable(channelModeNames[n], is_selected)) channelMode = n;
+                    if (is_selected)
+                        ImGui::SetItemDefaultFocus();
+                }
+                ImGui::EndCombo();
+            }
+            if (channelMode != CHANNELS_MONO || zoomEnabled) {
+                ImGui::Combo("##channellayout", &channelLayout, channelLayoutNames, LAYOUT_COUNT);
+            }
+            ImGui::PopItemWidth();
+            if (channelMode != CHANNELS_MONO && gAnalysisChannels == 1 && (gCaptureActive || !wavFile->empty())) {
+                ImGui::TextDisabled(gCaptureActive ? "Live input is analysed in mono"
+                                                   : channelMode == CHANNELS_MID_SIDE ? "Mid/side needs a stereo file"
+                                                                                      : "File is mono");
+            } else if (wavFile->numChannels > MAX_ANALYSIS_CHANNELS && channelMode == CHANNELS_SEPARATE) {
+                ImGui::TextDisabled("Showing the first %d of %d channels", MAX_ANALYSIS_CHANNELS, (int)wavFile->numChannels);
+            }
+
             ImGui::Spacing();
             ImGui::Separator();
             ImGui::Spacing();
@@ -2315,13 +9929,71 @@ int main(int argc, char* argv[]) {
                     saved3D_autoRotate = autoRotate;  // Save changes
                 }
             }
+            if (waterfallPaneShown()) {
+                ImGui::Checkbox("Waterfall LOD", &waterfallLOD);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Draw far and small rows with fewer vertices and merge rows that\noverlap on screen (peaks are kept)");
+                }
+            }
+
+            // Running statistics overlays (channel 0)
+            bool statsChanged = ImGui::Checkbox("Peak Hold", &showPeakHold);
+            ImGui::SameLine();
+            statsChanged |= ImGui::Checkbox("Average", &showAverage);
+            ImGui::SameLine();
+            statsChanged |= ImGui::Checkbox("Floor", &showNoiseFloor);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Noise floor: the level a chosen share of recent lines stays below");
+            }
+            if (showPeakHold || showAverage || showNoiseFloor) {
+                ImGui::PushItemWidth(280);
+                statsChanged |= ImGui::SliderFloat("##peak_decay", &statsPeakDecay, 0.0f, 1.0f,
+                                                   statsPeakDecay == 0.0f ? "Peak Decay: Hold" : "Peak Decay: %.2f/s");
+                statsChanged |= ImGui::SliderFloat("##stats_time", &statsTime, 0.1f, 30.0f, "Averaging: %.1f s");
+                statsChanged |= ImGui::SliderFloat("##floor_pct", &statsFloorPercent, 1.0f, 50.0f, "Floor Percentile: %.0f%%");
+                ImGui::PopItemWidth();
+                if (ImGui::Button("Reset Traces", ImVec2(280, 0))) resetRunningStats();
+            }
+            if (statsChanged) {
+                setRunningStats(showPeakHold || showAverage || showNoiseFloor, statsPeakDecay, statsTime,
+                                statsFloorPercent / 100.0f);
+                needsRedraw = true;
+            }
 
             ImGui::Checkbox("Show FPS Counter", &showFPS);
             ImGui::Checkbox("Show CPU Usage", &showCPU);
+            ImGui::Checkbox("Show Profiler", &showProfiler);
+            if (ImGui::Button(gTraceRecording.load() ? "Stop Trace" : "Record Trace")) {
+                if (gTraceRecording.load()) stopTraceRecording();
+                else startTraceRecording();
+            }
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Record every timed stage and write Chrome trace JSON\n(open in chrome://tracing or ui.perfetto.dev)");
+            }
+            if (!gLastTracePath.empty()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("%s", gLastTracePath.c_str());
+            }
             ImGui::Checkbox("Show Metadata", &showMetadata);
             ImGui::Checkbox("Show Waveform", &showWaveform);
 
-            ImGui::Text("Number of Lines (10-560):");
+            ImGui::Checkbox("Power Saving", &powerSaving);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Only redraw when something changes (new audio, input, animation)");
+            }
+            ImGui::SameLine();
+            if (ImGui::Checkbox("VSync", &vsyncEnabled)) {
+                glfwSwapInterval(vsyncEnabled ? 1 : 0);
+            }
+            ImGui::Checkbox("Streamed Uploads", &streamUploads);
+            if (ImGui::IsItemHovered()) {
+                ImGui::SetTooltip("Stage texture updates in a fenced, mapped buffer ring instead of\nuploading from client memory");
+            }
+            ImGui::PushItemWidth(280);
+            ImGui::SliderInt("##frame_cap", &frameCapFPS, 0, 240, frameCapFPS == 0 ? "Frame Cap: Off" : "Frame Cap: %d FPS");
+            ImGui::PopItemWidth();
+
+            ImGui::Text("Number of Lines (10-%d):", MAX_HISTORY_LINES);
             ImGui::PushItemWidth(280);
             if (useTraditionalView) {
                 // Show locked status in 2D mode
@@ -2505,6 +10177,14 @@ int main(int argc, char* argv[]) {
                 }
 
                 ImGui::PopItemWidth();
+
+                // Applied in the shaders; no history recompute needed
+                ImGui::Text("Colormap Gamma:");
+                ImGui::PushItemWidth(280);
+                if (SliderFloatWithWheel("##cmapgamma", &colormapGamma, 0.1f, 1.0f)) {
+                    colorLUTDirty = true;  // CPU fallback LUT bakes gamma in
+                }
+                ImGui::PopItemWidth();
             } else {
                 ImGui::TextDisabled("(Colormap disabled)");
             }
@@ -2518,6 +10198,7 @@ int main(int argc, char* argv[]) {
 
             if (ImGui::Button("Reset Colors", ImVec2(280, 0))) {
                 currentColormap = COLORMAP_VIRIDIS;  // Reset to Viridis
+                colormapGamma = 0.2f;
                 colorLUTDirty = true;
                 useCustomLineColor = true;  // Reset to custom green
                 lineColor[0] = 0.0f;  // Green
@@ -2600,6 +10281,9 @@ int main(int argc, char* argv[]) {
             ImGui::Separator();
             ImGui::Spacing();
 
+            drawSessionLogPanel();
+            drawNetworkStatus();
+
             // Controls info - collapsible section (collapsed by default)
             if (ImGui::CollapsingHeader("KEYBOARD SHORTCUTS", ImGuiTreeNodeFlags_None)) {
                 ImGui::BulletText("SPACE: Play/Pause/Start");
@@ -2633,8 +10317,8 @@ int main(int argc, char* argv[]) {
         ImGui::End();
 
         // Render FPS/CPU overlay in top-right of viewport (if enabled)
-        if (showFPS || showCPU) {
-            ImGui::SetNextWindowPos(ImVec2((float)windowWidth - 120, 10));
+        if (showFPS || showCPU || showProfiler) {
+            ImGui::SetNextWindowPos(ImVec2((float)windowWidth - (showProfiler ? 280 : 120), 10));
             ImGui::SetNextWindowBgAlpha(0.35f);
             ImGui::Begin("Stats", nullptr,
                          ImGuiWindowFlags_NoDecoration |
@@ -2647,6 +10331,30 @@ int main(int argc, char* argv[]) {
             }
             if (showCPU) {
                 ImGui::Text("CPU: %.1f%%", currentCPU);
+                ImGui::Text("Mem: %.1f MB", currentRSSMB);
+            }
+            if (showProfiler) {
+                ImGui::Separator();
+                ImGui::Text("%-14s %8s %8s", "Stage", "p50 ms", "p99 ms");
+                for (int s = 0; s < STAGE_COUNT; ++s) {
+                    if (s == STAGE_GPU_VIEW && !gGpuTimerSupported) continue;
+                    ImGui::Text("%-14s %8.3f %8.3f", profileStageNames[s],
+                                gStageStats[s].p50Ms, gStageStats[s].p99Ms);
+                }
+                if (waterfallPaneShown()) {
+                    ImGui::Text("Waterfall verts: %llu", (unsigned long long)gWaterfallVertices);
+                }
+                if (gUploadRing.buffer) {
+                    ImGui::Text("Upload ring: %s, %u stalls", gUploadRing.persistent ? "persistent" : "mapped",
+                                gUploadStalls);
+                }
+                ImGui::TextDisabled("Kernels: %s%s", gKernelIsaName,
+                                    gKernelsSpecialized ? ", fixed size" : ", any size");
+                ImGui::Text("Underruns: %u", gAudioUnderruns.load(std::memory_order_relaxed));
+                if (gCaptureActive) {
+                    ImGui::Text("Input overflows: %u", gCaptureOverflows.load(std::memory_order_relaxed));
+                }
+                if (gTraceRecording.load()) ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Recording trace");
             }
             ImGui::End();
         }
@@ -2663,52 +10371,87 @@ int main(int argc, char* argv[]) {
                          ImGuiWindowFlags_NoNav);
             ImGui::Text("%s", loadedFileName.c_str());
             ImGui::Text("%.1f sec | %d Hz",
-                       (float)wavFile.audioData.size() / (float)wavFile.sampleRate,
-                       (int)wavFile.sampleRate);
-            ImGui::Text("%d ch | %d-bit", (int)wavFile.sourceChannels, (int)wavFile.bitsPerSample);
-            size_t fileSizeBytes = wavFile.audioData.size() * sizeof(float);
+                       (float)wavFile->totalFrames / (float)wavFile->sampleRate,
+                       (int)wavFile->sampleRate);
+            ImGui::Text("%d ch | %d-bit", (int)wavFile->sourceChannels, (int)wavFile->bitsPerSample);
+            size_t fileSizeBytes = (size_t)wavFile->fileBytes;
             float fileSizeMB = (float)fileSizeBytes / (1024.0f * 1024.0f);
             ImGui::Text("%.2f MB", fileSizeMB);
             ImGui::End();
         }
 
-        // Render spectrogram (choose between 3D and traditional view)
-        if (useTraditionalView) {
-            renderTraditionalSpectrogram(viewportX, viewportY, viewportW, viewportH);
-        } else {
-            render3DWaterfall(viewportX, viewportY, viewportW, viewportH);
+        const uint64_t imguiBuildEndNs = profileNowNs();
+
+        // Render the view panes (3D and/or traditional, one per history plane)
+        {
+            ScopedStageTimer timer(STAGE_VIEW_DRAW);
+            beginGpuTimer();
+            beginUploadFrame();
+            renderViewPanes(viewportX, viewportY, viewportW, viewportH);
+            endUploadFrame();
+            endGpuTimer();
         }
 
         // Render waveform overlay (if enabled)
-        if (showWaveform && !wavFile.audioData.empty()) {
+        if (showWaveform && !wavFile->empty()) {
             renderWaveform(viewportX, viewportY, viewportW, viewportH);
         }
 
-        // Render ImGui on top of everything
+        // Keep drawing at a low rate while a widget is hovered (tooltips, hover delays)
+        imguiWantsRefresh = ImGui::IsAnyItemHovered() || ImGui::IsAnyItemActive() || ImGui::GetIO().WantTextInput;
+
+        // Render ImGui on top of everything (building and drawing count as one sample)
+        const uint64_t imguiRenderStartNs = profileNowNs();
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        glfwSwapBuffers(window);
+        const uint64_t imguiRenderEndNs = profileNowNs();
+        profileHistogramAdd(STAGE_IMGUI, (imguiBuildEndNs - imguiStartNs) + (imguiRenderEndNs - imguiRenderStartNs));
+        profileTrace(STAGE_IMGUI, imguiStartNs, imguiBuildEndNs - imguiStartNs);
+        profileTrace(STAGE_IMGUI, imguiRenderStartNs, imguiRenderEndNs - imguiRenderStartNs);
+
+        {
+            ScopedStageTimer timer(STAGE_SWAP);
+            glfwSwapBuffers(window);
+        }
+        if (newLines && gCaptureActive) noteCaptureLineDisplayed(newestLineStamp);
 
         // Reset redraw flag after frame
         if (needsRedraw) needsRedraw = false;
+        profileRecord(STAGE_FRAME, frameStartNs, profileNowNs());
     }
+    if (gTraceRecording.load()) stopTraceRecording();
 
     // Cleanup
     stopAudio();
+    stopCapture();
+    stopAudioLoader();
+    gRetiredTracks.clear();
+    stopAnalysisThread();
+    stopNetSubscriber();
+    stopNetPublisher();
+    gSessionRecorder.close();
 
     // Cleanup texture (IMPORTANT!)
     if (spectrogramTexture) {
         glDeleteTextures(1, &spectrogramTexture);
     }
+    destroyWaterfallGPU();
+    destroySpectrogramGPU();
+    destroyHistoryAndColormap();
+    destroyGpuTimers();
+    destroyWaveformGPU();
+    destroyUploadRing();
+    destroyGpuFFT();
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    if (fftPlan) fftw_destroy_plan(fftPlan);
-    if (fftInput) fftw_free(fftInput);
-    if (fftOutput) fftw_free(fftOutput);
+    stopPyramidBuild();
+    destroyFFTPlanCache();
+    destroyBatchPlan(gBatchPlan);
+    destroyZoomPlan(gZoomPlan);
+    closeCompareFiles();
 
     Pa_Terminate();
     glfwDestroyWindow(window);